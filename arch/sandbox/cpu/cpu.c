@@ -8,6 +8,7 @@
 #include <cpu_func.h>
 #include <errno.h>
 #include <log.h>
+#include <uthread.h>
 #include <asm/global_data.h>
 #include <linux/delay.h>
 #include <linux/libfdt.h>
@@ -49,6 +50,27 @@ void __udelay(unsigned long usec)
 		os_usleep(usec);
 }
 
+#if CONFIG_IS_ENABLED(UTHREAD)
+int arch_uthread_init(struct uthread *thr, void (*fn)(void *arg), void *arg,
+		      size_t stack_size)
+{
+	thr->ctx = os_context_new(fn, arg, stack_size);
+
+	return thr->ctx ? 0 : -ENOMEM;
+}
+
+void arch_uthread_switch(struct uthread *from, struct uthread *to)
+{
+	os_context_switch(from->ctx, to->ctx);
+}
+
+void arch_uthread_free(struct uthread *thr)
+{
+	os_context_free(thr->ctx);
+	thr->ctx = NULL;
+}
+#endif
+
 int cleanup_before_linux(void)
 {
 	return 0;
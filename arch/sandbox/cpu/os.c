@@ -370,6 +370,71 @@ void os_free(void *ptr)
 	}
 }
 
+struct os_context {
+	ucontext_t uc;
+	void (*fn)(void *arg);
+	void *arg;
+	void *stack;
+};
+
+/* makecontext() only passes int arguments, so split the pointer in two */
+static void os_context_start(unsigned int hi, unsigned int lo)
+{
+	struct os_context *ctx;
+
+	ctx = (struct os_context *)(uintptr_t)((uint64_t)hi << 32 | lo);
+	ctx->fn(ctx->arg);
+
+	fprintf(stderr, "Context function returned\n");
+	abort();
+}
+
+void *os_context_new(void (*fn)(void *arg), void *arg, size_t stack_size)
+{
+	struct os_context *ctx;
+	uint64_t ptr;
+
+	ctx = os_malloc(sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	memset(ctx, '\0', sizeof(*ctx));
+	if (!fn)
+		return ctx;
+
+	ctx->stack = os_malloc(stack_size);
+	if (!ctx->stack || getcontext(&ctx->uc)) {
+		os_context_free(ctx);
+		return NULL;
+	}
+	ctx->fn = fn;
+	ctx->arg = arg;
+	ctx->uc.uc_stack.ss_sp = ctx->stack;
+	ctx->uc.uc_stack.ss_size = stack_size;
+	ctx->uc.uc_link = NULL;
+	ptr = (uintptr_t)ctx;
+	makecontext(&ctx->uc, (void (*)(void))os_context_start, 2,
+		    (unsigned int)(ptr >> 32), (unsigned int)ptr);
+
+	return ctx;
+}
+
+void os_context_switch(void *from, void *to)
+{
+	struct os_context *from_ctx = from, *to_ctx = to;
+
+	swapcontext(&from_ctx->uc, &to_ctx->uc);
+}
+
+void os_context_free(void *ctx)
+{
+	struct os_context *os_ctx = ctx;
+
+	if (os_ctx) {
+		os_free(os_ctx->stack);
+		os_free(os_ctx);
+	}
+}
+
 /* These macros are from kernel.h but not accessible in this file */
 #define ALIGN(x, a)		__ALIGN_MASK((x), (typeof(x))(a) - 1)
 #define __ALIGN_MASK(x, mask)	(((x) + (mask)) & ~(mask))
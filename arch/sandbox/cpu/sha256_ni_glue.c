@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 secure hash using the x86 SHA extensions
+ *
+ * Sandbox runs on whatever host it was built on, so the extensions are only
+ * used if the host CPU has them.
+ */
+
+#include <common.h>
+#include <u-boot/sha256.h>
+
+#ifdef __x86_64__
+extern void sha256_ni_transform(uint32_t state[8], const uint8_t *data,
+				unsigned long blocks);
+
+static void cpuid(uint leaf, uint regs[4])
+{
+	asm volatile("cpuid"
+		     : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]),
+		       "=d" (regs[3])
+		     : "a" (leaf), "c" (0));
+}
+
+static bool sha256_ni_supported(void)
+{
+	static int supported = -1;
+	uint regs[4];
+
+	if (supported == -1) {
+		supported = 0;
+		cpuid(0, regs);
+		if (regs[0] >= 7) {
+			/* SHA is leaf 7 EBX bit 29, SSE4.1 is leaf 1 ECX bit 19 */
+			cpuid(7, regs);
+			if (regs[1] & BIT(29)) {
+				cpuid(1, regs);
+				supported = !!(regs[2] & BIT(19));
+			}
+		}
+	}
+
+	return supported;
+}
+
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (sha256_ni_supported())
+		sha256_ni_transform(ctx->state, data, blocks);
+	else
+		sha256_process_generic(ctx, data, blocks);
+}
+#endif
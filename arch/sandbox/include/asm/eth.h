@@ -41,6 +41,33 @@ int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
 int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
 				  unsigned int len);
 
+/*
+ * sandbox_eth_nd_req_to_reply()
+ *
+ * Check for an IPv6 neighbour solicitation to be sent. If so, inject an
+ * advertisement giving the fake host's MAC address
+ *
+ * @dev: device that received the packet
+ * @packet: pointer to the received pacaket buffer
+ * @len: length of received packet
+ * Return: 0 if injected, -EAGAIN if not
+ */
+int sandbox_eth_nd_req_to_reply(struct udevice *dev, void *packet,
+				unsigned int len);
+
+/*
+ * sandbox_eth_ping6_req_to_reply()
+ *
+ * Check for an ICMPv6 echo request to be sent. If so, inject a reply
+ *
+ * @dev: device that received the packet
+ * @packet: pointer to the received pacaket buffer
+ * @len: length of received packet
+ * Return: 0 if injected, -EAGAIN if not
+ */
+int sandbox_eth_ping6_req_to_reply(struct udevice *dev, void *packet,
+				   unsigned int len);
+
 /*
  * sandbox_eth_recv_arp_req()
  *
@@ -61,6 +88,27 @@ int sandbox_eth_recv_arp_req(struct udevice *dev);
  */
 int sandbox_eth_recv_ping_req(struct udevice *dev);
 
+/*
+ * sandbox_eth_recv_buf()
+ *
+ * Get the buffer in which to build the next packet to be received. Once it is
+ * filled in, sandbox_eth_recv_push() queues it.
+ *
+ * @dev: device that will receive the packet
+ * Return: buffer of PKTSIZE_ALIGN bytes, or NULL if the receive ring is full
+ */
+void *sandbox_eth_recv_buf(struct udevice *dev);
+
+/*
+ * sandbox_eth_recv_push()
+ *
+ * Queue the packet built in the buffer from sandbox_eth_recv_buf()
+ *
+ * @dev: device that will receive the packet
+ * @len: length of the packet
+ */
+void sandbox_eth_recv_push(struct udevice *dev, int len);
+
 /**
  * A packet handler
  *
@@ -77,9 +125,12 @@ typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
  * fake_host_hwaddr - MAC address of mocked machine
  * fake_host_ipaddr - IP address of mocked machine
  * disabled - Will not respond
- * recv_packet_buffer - buffers of the packet returned as received
- * recv_packet_length - lengths of the packet returned as received
- * recv_packets - number of packets returned
+ * recv_packet_buffer - ring of packets to be returned as received
+ * recv_packet_length - lengths of the packets in the ring
+ * recv_head - ring index of the next packet to be returned
+ * recv_packets - number of packets waiting in the ring
+ * mcast_hwaddr - multicast MAC address last joined or left
+ * mcast_joined - true if the group in mcast_hwaddr is joined
  * tx_handler - function to generate responses to sent packets
  * priv - a pointer to some structure a test may want to keep track of
  */
@@ -87,9 +138,12 @@ struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
 	bool disabled;
-	uchar * recv_packet_buffer[PKTBUFSRX];
-	int recv_packet_length[PKTBUFSRX];
+	uchar recv_packet_buffer[CONFIG_ETH_RX_RING_SIZE][PKTSIZE_ALIGN];
+	int recv_packet_length[CONFIG_ETH_RX_RING_SIZE];
+	int recv_head;
 	int recv_packets;
+	uchar mcast_hwaddr[ARP_HLEN];
+	bool mcast_joined;
 	sandbox_eth_tx_hand_f *tx_handler;
 	void *priv;
 };
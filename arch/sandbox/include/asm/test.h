@@ -118,6 +118,23 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_usb_flash_get_reads() - Get the number of reads a flash stick had
+ *
+ * @dev:	USB flash stick emulator
+ * Return: number of SCSI read commands it has received since it was probed
+ */
+int sandbox_usb_flash_get_reads(struct udevice *dev);
+
+/**
+ * sandbox_usb_flash_get_vpd_inquiries() - Get the number of VPD inquiries
+ *
+ * @dev:	USB flash stick emulator
+ * Return: number of INQUIRY commands for vital product data it has received
+ * since it was probed
+ */
+int sandbox_usb_flash_get_vpd_inquiries(struct udevice *dev);
+
 /**
  * sandbox_osd_get_mem() - get the internal memory of a sandbox OSD
  *
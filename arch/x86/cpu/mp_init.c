@@ -598,40 +598,48 @@ static void store_callback(struct mp_callback **slot, struct mp_callback *val)
 }
 
 /**
- * run_ap_work() - Run a callback on selected APs
+ * post_ap_work() - Pass a callback to all APs
  *
- * This writes @callback to all APs and waits for them all to acknowledge it,
+ * This writes @callback to the mailbox of every AP and returns without waiting.
  * Note that whether each AP actually calls the callback depends on the value
  * of logical_cpu_number (see struct mp_callback). The logical CPU number is
  * the CPU device's req->seq value.
  *
- * @callback: Callback information to pass to all APs
+ * @callback: Callback information to pass to all APs. This must remain valid
+ *	until wait_ap_work() returns
  * @bsp: CPU device for the BSP
  * @num_cpus: The number of CPUs in the system (= number of APs + 1)
- * @expire_ms: Timeout to wait for all APs to finish, in milliseconds, or 0 for
- *	no timeout
- * Return: 0 if OK, -ETIMEDOUT if one or more APs failed to respond in time
  */
-static int run_ap_work(struct mp_callback *callback, struct udevice *bsp,
-		       int num_cpus, uint expire_ms)
+static void post_ap_work(struct mp_callback *callback, struct udevice *bsp,
+			 int num_cpus)
 {
 	int cur_cpu = dev_seq(bsp);
-	int num_aps = num_cpus - 1; /* number of non-BSPs to get this message */
-	int cpus_accepted;
-	ulong start;
 	int i;
 
-	if (!IS_ENABLED(CONFIG_SMP_AP_WORK)) {
-		printf("APs already parked. CONFIG_SMP_AP_WORK not enabled\n");
-		return -ENOTSUPP;
-	}
-
 	/* Signal to all the APs to run the func. */
 	for (i = 0; i < num_cpus; i++) {
 		if (cur_cpu != i)
 			store_callback(&ap_callbacks[i], callback);
 	}
 	mfence();
+}
+
+/**
+ * wait_ap_work() - Wait for all APs to finish the callback passed to them
+ *
+ * @bsp: CPU device for the BSP
+ * @num_cpus: The number of CPUs in the system (= number of APs + 1)
+ * @expire_ms: Timeout to wait for all APs to finish, in milliseconds, or 0 for
+ *	no timeout
+ * Return: 0 if OK, -ETIMEDOUT if one or more APs failed to respond in time
+ */
+static int wait_ap_work(struct udevice *bsp, int num_cpus, uint expire_ms)
+{
+	int cur_cpu = dev_seq(bsp);
+	int num_aps = num_cpus - 1; /* number of non-BSPs to get this message */
+	int cpus_accepted;
+	ulong start;
+	int i;
 
 	/* Wait for all the APs to signal back that call has been accepted. */
 	start = get_timer(0);
@@ -661,6 +669,34 @@ static int run_ap_work(struct mp_callback *callback, struct udevice *bsp,
 	return 0;
 }
 
+/**
+ * run_ap_work() - Run a callback on selected APs
+ *
+ * This writes @callback to all APs and waits for them all to acknowledge it,
+ * Note that whether each AP actually calls the callback depends on the value
+ * of logical_cpu_number (see struct mp_callback). The logical CPU number is
+ * the CPU device's req->seq value.
+ *
+ * @callback: Callback information to pass to all APs
+ * @bsp: CPU device for the BSP
+ * @num_cpus: The number of CPUs in the system (= number of APs + 1)
+ * @expire_ms: Timeout to wait for all APs to finish, in milliseconds, or 0 for
+ *	no timeout
+ * Return: 0 if OK, -ETIMEDOUT if one or more APs failed to respond in time
+ */
+static int run_ap_work(struct mp_callback *callback, struct udevice *bsp,
+		       int num_cpus, uint expire_ms)
+{
+	if (!IS_ENABLED(CONFIG_SMP_AP_WORK)) {
+		printf("APs already parked. CONFIG_SMP_AP_WORK not enabled\n");
+		return -ENOTSUPP;
+	}
+
+	post_ap_work(callback, bsp, num_cpus);
+
+	return wait_ap_work(bsp, num_cpus, expire_ms);
+}
+
 /**
  * ap_wait_for_instruction() - Wait for and process requests from the main CPU
  *
@@ -756,6 +792,48 @@ int mp_run_on_cpus(int cpu_select, mp_run_func func, void *arg)
 	return 0;
 }
 
+/* Callback for mp_start_on_aps(), which is used after that call returns */
+static struct mp_callback ap_async_callback;
+
+int mp_start_on_aps(mp_run_func func, void *arg)
+{
+	struct udevice *dev;
+	int num_cpus;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_SMP_AP_WORK) ||
+	    !(gd->flags & GD_FLG_SMP_READY))
+		return -ENOTSUPP;
+
+	ret = get_bsp(&dev, &num_cpus);
+	if (ret < 0)
+		return log_msg_ret("bsp", ret);
+
+	ap_async_callback.func = func;
+	ap_async_callback.arg = arg;
+	ap_async_callback.logical_cpu_number = MP_SELECT_APS;
+	post_ap_work(&ap_async_callback, dev, num_cpus);
+
+	return 0;
+}
+
+int mp_wait_aps(uint expire_ms)
+{
+	struct udevice *dev;
+	int num_cpus;
+	int ret;
+
+	ret = get_bsp(&dev, &num_cpus);
+	if (ret < 0)
+		return log_msg_ret("bsp", ret);
+
+	ret = wait_ap_work(dev, num_cpus, expire_ms);
+	if (ret)
+		return log_msg_ret("aps", ret);
+
+	return 0;
+}
+
 static void park_this_cpu(void *unused)
 {
 	stop_this_cpu();
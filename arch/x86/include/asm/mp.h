@@ -128,6 +128,30 @@ typedef void (*mp_run_func)(void *arg);
  */
 int mp_run_on_cpus(int cpu_select, mp_run_func func, void *arg);
 
+/**
+ * mp_start_on_aps() - Start a function on all APs without waiting
+ *
+ * This returns as soon as the APs have been told to run @func, so that the
+ * BSP can do other work meanwhile. The caller must call mp_wait_aps() before
+ * using mp_run_on_cpus() or mp_start_on_aps() again.
+ *
+ * This is only supported if CONFIG_SMP_AP_WORK is enabled
+ *
+ * @func: Function to run
+ * @arg: Argument to pass to the function
+ * Return: 0 on success, -ENOTSUPP if the APs cannot run work, other -ve on
+ *	error
+ */
+int mp_start_on_aps(mp_run_func func, void *arg);
+
+/**
+ * mp_wait_aps() - Wait for the APs to finish the work from mp_start_on_aps()
+ *
+ * @expire_ms: Timeout in milliseconds, or 0 for no timeout
+ * Return: 0 if OK, -ETIMEDOUT if one or more APs did not finish in time
+ */
+int mp_wait_aps(uint expire_ms);
+
 /**
  * mp_park_aps() - Park the APs ready for the OS
  *
@@ -172,6 +196,17 @@ static inline int mp_run_on_cpus(int cpu_select, mp_run_func func, void *arg)
 	return 0;
 }
 
+static inline int mp_start_on_aps(mp_run_func func, void *arg)
+{
+	/* There are no APs, so the caller must do the work itself */
+	return -ENOTSUPP;
+}
+
+static inline int mp_wait_aps(uint expire_ms)
+{
+	return 0;
+}
+
 static inline int mp_park_aps(void)
 {
 	/* No APs to park */
@@ -30,6 +30,12 @@
 #include <dm.h>
 #include <u-boot/hash.h>
 #endif
+#if CONFIG_IS_ENABLED(FIT_PARALLEL_VERIFY)
+#include <hash.h>
+#ifdef CONFIG_SMP_AP_WORK
+#include <asm/mp.h>
+#endif
+#endif
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
@@ -1261,6 +1267,225 @@ int calculate_hash(const void *data, int data_len, const char *name,
 	return 0;
 }
 
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(FIT_PARALLEL_VERIFY)
+/**
+ * struct fit_hash_job - A hash node whose value is calculated ahead of time
+ *
+ * @noffset:	Hash node offset
+ * @algo:	Hash algorithm to use
+ * @data:	Image data to hash
+ * @size:	Size of @data in bytes
+ * @value:	Calculated hash value
+ * @value_len:	Length of @value in bytes
+ */
+struct fit_hash_job {
+	int noffset;
+	struct hash_algo *algo;
+	const void *data;
+	size_t size;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+};
+
+/**
+ * struct fit_hash_queue - Hash jobs shared between all CPUs
+ *
+ * @fit:	FIT the jobs belong to, NULL if there are none
+ * @jobs:	List of jobs
+ * @count:	Number of jobs in @jobs
+ * @next:	Index of the next job to be claimed by a CPU
+ */
+static struct fit_hash_queue {
+	const void *fit;
+	struct fit_hash_job *jobs;
+	int count;
+	int next;
+} fit_hash_queue;
+
+/* Set if the APs may still be using fit_hash_queue, so it is left to them */
+static bool fit_hash_aps_stuck;
+
+/* Run on each CPU: hash images until there are none left */
+static void fit_hash_worker(void *arg)
+{
+	struct fit_hash_queue *queue = arg;
+	struct fit_hash_job *job;
+	int i;
+
+	for (;;) {
+		i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_SEQ_CST);
+		if (i >= queue->count)
+			break;
+		job = &queue->jobs[i];
+		job->algo->hash_func_ws(job->data, job->size, job->value,
+					job->algo->chunk_size);
+		job->value_len = job->algo->digest_size;
+	}
+}
+
+/* Start the other CPUs on the queue, without waiting for them */
+static int fit_hash_start_aps(struct fit_hash_queue *queue)
+{
+#ifdef CONFIG_SMP_AP_WORK
+	return mp_start_on_aps(fit_hash_worker, queue);
+#else
+	/* There are no other CPUs, so the boot CPU does all the work */
+	return -ENOSYS;
+#endif
+}
+
+static int fit_hash_wait_aps(void)
+{
+#ifdef CONFIG_SMP_AP_WORK
+	/* An image may take a while, so wait for as long as it takes */
+	return mp_wait_aps(0);
+#else
+	return 0;
+#endif
+}
+
+static int fit_hash_add_jobs(const void *fit, int image_noffset,
+			     struct fit_hash_job *jobs, int max)
+{
+	const void *data;
+	const char *algo;
+	size_t size;
+	int noffset, ignore, count = 0;
+
+	if (fit_image_get_data_and_size(fit, image_noffset, &data, &size))
+		return 0;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		fit_image_hash_get_ignore(fit, noffset, &ignore);
+		if (ignore)
+			continue;
+		if (count < max) {
+			struct fit_hash_job *job = &jobs[count];
+
+			/* Unsupported algorithms are reported later */
+			if (hash_lookup_algo(algo, &job->algo))
+				continue;
+			job->noffset = noffset;
+			job->data = data;
+			job->size = size;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+static void fit_hash_release(void)
+{
+	struct fit_hash_queue *queue = &fit_hash_queue;
+
+	if (fit_hash_aps_stuck)
+		return;
+	free(queue->jobs);
+	memset(queue, '\0', sizeof(*queue));
+}
+
+/**
+ * fit_hash_precalc() - Calculate all image hashes in a FIT on all CPUs
+ *
+ * The results are picked up by fit_image_check_hash(), so that the normal
+ * verification and its messages are unchanged. Any hash which cannot be
+ * calculated here is simply calculated again later.
+ *
+ * @fit:	FIT to process
+ * @images_noffset:	Offset of the /images node
+ */
+static void fit_hash_precalc(const void *fit, int images_noffset)
+{
+	struct fit_hash_queue *queue = &fit_hash_queue;
+	struct fit_hash_job *jobs;
+	int noffset, count = 0;
+	int ret;
+
+	if (fit_hash_aps_stuck)
+		return;
+	fdt_for_each_subnode(noffset, fit, images_noffset)
+		count += fit_hash_add_jobs(fit, noffset, NULL, 0);
+	if (count < 2)
+		return;
+
+	jobs = calloc(count, sizeof(*jobs));
+	if (!jobs)
+		return;
+
+	count = 0;
+	fdt_for_each_subnode(noffset, fit, images_noffset)
+		count += fit_hash_add_jobs(fit, noffset, jobs + count, INT_MAX);
+
+	queue->jobs = jobs;
+	queue->count = count;
+	queue->next = 0;
+
+	/*
+	 * The boot CPU takes jobs from the queue alongside the APs, then waits
+	 * for the APs to finish the jobs they took. If the APs cannot be
+	 * started, the boot CPU does all the jobs.
+	 */
+	ret = fit_hash_start_aps(queue);
+	if (ret)
+		log_debug("Hashing on the boot CPU only (err=%d)\n", ret);
+	fit_hash_worker(queue);
+	if (!ret) {
+		ret = fit_hash_wait_aps();
+		if (ret) {
+			/*
+			 * The APs may still write to the jobs, so leak them
+			 * rather than free them, and don't use the results.
+			 * Every hash is then calculated again on this CPU.
+			 */
+			log_warning("Cannot use hashes from other CPUs (err=%d)\n",
+				    ret);
+			fit_hash_aps_stuck = true;
+			return;
+		}
+	}
+	queue->fit = fit;
+}
+
+static int fit_hash_lookup(const void *fit, int noffset, const void *data,
+			   uint8_t *value, int *value_len)
+{
+	struct fit_hash_queue *queue = &fit_hash_queue;
+	int i;
+
+	if (queue->fit != fit)
+		return -ENOENT;
+
+	for (i = 0; i < queue->count; i++) {
+		struct fit_hash_job *job = &queue->jobs[i];
+
+		if (job->noffset == noffset && job->data == data &&
+		    job->algo) {
+			memcpy(value, job->value, job->value_len);
+			*value_len = job->value_len;
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+#else
+static inline void fit_hash_precalc(const void *fit, int images_noffset) {}
+static inline void fit_hash_release(void) {}
+static inline int fit_hash_lookup(const void *fit, int noffset,
+				  const void *data, uint8_t *value,
+				  int *value_len)
+{
+	return -ENOENT;
+}
+#endif
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
@@ -1293,7 +1518,8 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (fit_hash_lookup(fit, noffset, data, value, &value_len) &&
+	    calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1446,6 +1672,7 @@ int fit_all_image_verify(const void *fit)
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
+	fit_hash_precalc(fit, images_noffset);
 	for (ndepth = 0, count = 0,
 	     noffset = fdt_next_node(fit, images_noffset, &ndepth);
 			(noffset >= 0) && (ndepth > 0);
@@ -1459,11 +1686,15 @@ int fit_all_image_verify(const void *fit)
 			       fit_get_name(fit, noffset, NULL));
 			count++;
 
-			if (!fit_image_verify(fit, noffset))
+			if (!fit_image_verify(fit, noffset)) {
+				fit_hash_release();
 				return 0;
+			}
 			printf("\n");
 		}
 	}
+	fit_hash_release();
+
 	return 1;
 }
 
@@ -0,0 +1,484 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompress an image while it is being read
+ *
+ * image_decomp() needs the whole compressed image in memory before it can
+ * start. The functions here instead pull the compressed data through a small
+ * bounce buffer, so only the uncompressed image has to fit in RAM.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <common.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <watchdog.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/zstd.h>
+#include <u-boot/lz4.h>
+#include <u-boot/zlib.h>
+
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+
+/* LZMA_Alone header: properties followed by a 64-bit uncompressed size */
+#define LZMA_HDR_SIZE		(LZMA_PROPS_SIZE + sizeof(u64))
+
+/* LZ4 frame header: magic, flags and block descriptor */
+#define LZ4F_HDR_SIZE		(sizeof(u32) + 2)
+#define LZ4F_BLOCKUNCOMPRESSED_FLAG	0x80000000U
+
+/**
+ * struct decomp_stream - State of a streaming decompression
+ *
+ * @strm:	Source of compressed data
+ * @buf:	Bounce buffer holding compressed data
+ * @size:	Size of @buf in bytes
+ * @pos:	Offset of the first unconsumed byte in @buf
+ * @avail:	Number of unconsumed bytes in @buf
+ * @eof:	true if @strm has no more data
+ */
+struct decomp_stream {
+	struct image_stream *strm;
+	uchar *buf;
+	ulong size;
+	ulong pos;
+	ulong avail;
+	bool eof;
+};
+
+/**
+ * stream_fill() - Make sure the bounce buffer holds some data
+ *
+ * Reads from the source until at least @min bytes are available or the end of
+ * the stream is reached. Any unconsumed data is moved to the start of the
+ * buffer first.
+ *
+ * @ds:		Stream state
+ * @min:	Number of bytes wanted, must not exceed the buffer size
+ * Return: 0 if OK, -ve on read error
+ */
+static int stream_fill(struct decomp_stream *ds, ulong min)
+{
+	ulong actread;
+	int ret;
+
+	if (ds->avail >= min)
+		return 0;
+
+	if (ds->pos) {
+		memmove(ds->buf, ds->buf + ds->pos, ds->avail);
+		ds->pos = 0;
+	}
+
+	while (ds->avail < min && !ds->eof) {
+		ret = ds->strm->read(ds->strm, ds->buf + ds->avail,
+				     ds->size - ds->avail, &actread);
+		if (ret)
+			return ret;
+		if (!actread)
+			ds->eof = true;
+		ds->avail += actread;
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
+static void stream_consume(struct decomp_stream *ds, ulong len)
+{
+	ds->pos += len;
+	ds->avail -= len;
+}
+
+/**
+ * stream_grow() - Make sure the bounce buffer can hold a number of bytes
+ *
+ * @ds:		Stream state
+ * @size:	Number of bytes the buffer must hold
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+static int stream_grow(struct decomp_stream *ds, ulong size)
+{
+	uchar *buf;
+
+	if (size <= ds->size)
+		return 0;
+	buf = malloc_cache_aligned(size);
+	if (!buf)
+		return -ENOMEM;
+	memcpy(buf, ds->buf + ds->pos, ds->avail);
+	free(ds->buf);
+	ds->buf = buf;
+	ds->size = size;
+	ds->pos = 0;
+
+	return 0;
+}
+
+static int stream_copy(struct decomp_stream *ds, void *dst, ulong dstlen,
+		       ulong *lenp)
+{
+	ulong done = 0;
+	int ret;
+
+	for (;;) {
+		ret = stream_fill(ds, 1);
+		if (ret)
+			return ret;
+		if (!ds->avail)
+			break;
+		if (ds->avail > dstlen - done)
+			return -ENOSPC;
+		memcpy(dst + done, ds->buf + ds->pos, ds->avail);
+		done += ds->avail;
+		stream_consume(ds, ds->avail);
+	}
+	*lenp = done;
+
+	return 0;
+}
+
+static int stream_gunzip(struct decomp_stream *ds, void *dst, ulong dstlen,
+			 ulong *lenp)
+{
+	z_stream s;
+	int ret, r;
+
+	memset(&s, '\0', sizeof(s));
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+
+	/* Let zlib parse the gzip header and check the trailer */
+	r = inflateInit2(&s, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		log_err("inflateInit2() returned %d\n", r);
+		return -ENOMEM;
+	}
+
+	s.next_out = dst;
+	s.avail_out = dstlen;
+	do {
+		ret = stream_fill(ds, 1);
+		if (ret)
+			goto out;
+		if (!ds->avail) {
+			ret = s.avail_out ? -EIO : -ENOSPC;
+			goto out;
+		}
+		s.next_in = ds->buf + ds->pos;
+		s.avail_in = ds->avail;
+		r = inflate(&s, Z_NO_FLUSH);
+		stream_consume(ds, ds->avail - s.avail_in);
+	} while (r == Z_OK);
+
+	if (r == Z_STREAM_END) {
+		*lenp = s.total_out;
+		ret = 0;
+	} else if (r == Z_BUF_ERROR && !s.avail_out) {
+		ret = -ENOSPC;
+	} else {
+		log_debug("inflate() returned %d\n", r);
+		ret = -EINVAL;
+	}
+out:
+	inflateEnd(&s);
+
+	return ret;
+}
+
+static void *lzma_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void lzma_free(void *p, void *address)
+{
+	free(address);
+}
+
+static int stream_unlzma(struct decomp_stream *ds, void *dst, ulong dstlen,
+			 ulong *lenp)
+{
+	ISzAlloc alloc = { .Alloc = lzma_alloc, .Free = lzma_free };
+	ELzmaStatus status;
+	CLzmaDec dec;
+	SizeT limit, inlen;
+	u64 outsize;
+	int ret;
+	SRes res;
+
+	ret = stream_fill(ds, LZMA_HDR_SIZE);
+	if (ret)
+		return ret;
+	if (ds->avail < LZMA_HDR_SIZE)
+		return -EIO;
+
+	outsize = get_unaligned_le64(ds->buf + ds->pos + LZMA_PROPS_SIZE);
+	/* All ones means the size is unknown and the stream has an end mark */
+	if (outsize != (u64)-1 && outsize > dstlen)
+		return -ENOSPC;
+	limit = min_t(u64, outsize, dstlen);
+
+	LzmaDec_Construct(&dec);
+	res = LzmaDec_AllocateProbs(&dec, ds->buf + ds->pos, LZMA_PROPS_SIZE,
+				    &alloc);
+	if (res != SZ_OK)
+		return -EINVAL;
+	stream_consume(ds, LZMA_HDR_SIZE);
+
+	dec.dic = dst;
+	dec.dicBufSize = dstlen;
+	LzmaDec_Init(&dec);
+
+	for (;;) {
+		ret = stream_fill(ds, 1);
+		if (ret)
+			break;
+		inlen = ds->avail;
+		res = LzmaDec_DecodeToDic(&dec, limit, ds->buf + ds->pos,
+					  &inlen, LZMA_FINISH_ANY, &status);
+		stream_consume(ds, inlen);
+		if (res != SZ_OK) {
+			ret = -EINVAL;
+			break;
+		}
+		if (status == LZMA_STATUS_FINISHED_WITH_MARK ||
+		    dec.dicPos == outsize)
+			break;
+		if (dec.dicPos == dstlen) {
+			ret = -ENOSPC;
+			break;
+		}
+		if (!ds->avail && ds->eof) {
+			ret = -EIO;
+			break;
+		}
+	}
+	*lenp = dec.dicPos;
+	LzmaDec_FreeProbs(&dec, &alloc);
+
+	return ret;
+}
+
+static int stream_unzstd(struct decomp_stream *ds, void *dst, ulong dstlen,
+			 ulong *lenp)
+{
+	ZSTD_frameParams params;
+	ZSTD_DStream *dstream;
+	ZSTD_inBuffer in_buf;
+	ZSTD_outBuffer out_buf;
+	void *workspace;
+	size_t wsize, res;
+	int ret;
+
+	ret = stream_fill(ds, ZSTD_FRAMEHEADERSIZE_MAX);
+	if (ret)
+		return ret;
+	res = ZSTD_getFrameParams(&params, ds->buf + ds->pos, ds->avail);
+	if (res)
+		return ZSTD_isError(res) ? -EINVAL : -EIO;
+
+	/* The window, not the whole image, bounds the memory needed */
+	wsize = ZSTD_DStreamWorkspaceBound(params.windowSize);
+	workspace = malloc(wsize);
+	if (!workspace) {
+		log_debug("cannot allocate workspace of size %zu\n", wsize);
+		return -ENOMEM;
+	}
+
+	dstream = ZSTD_initDStream(params.windowSize, workspace, wsize);
+	if (!dstream) {
+		log_err("ZSTD_initDStream failed\n");
+		ret = -EPERM;
+		goto do_free;
+	}
+
+	out_buf.dst = dst;
+	out_buf.pos = 0;
+	out_buf.size = dstlen;
+	do {
+		ret = stream_fill(ds, 1);
+		if (ret)
+			goto do_free;
+		if (!ds->avail) {
+			ret = out_buf.pos < dstlen ? -EIO : -ENOSPC;
+			goto do_free;
+		}
+		in_buf.src = ds->buf + ds->pos;
+		in_buf.pos = 0;
+		in_buf.size = ds->avail;
+		res = ZSTD_decompressStream(dstream, &out_buf, &in_buf);
+		stream_consume(ds, in_buf.pos);
+		if (ZSTD_isError(res)) {
+			log_err("ZSTD_decompressStream error %d\n",
+				ZSTD_getErrorCode(res));
+			ret = -EINVAL;
+			goto do_free;
+		}
+		if (res && out_buf.pos == dstlen &&
+		    in_buf.pos < in_buf.size) {
+			ret = -ENOSPC;
+			goto do_free;
+		}
+	} while (res);
+	*lenp = out_buf.pos;
+
+do_free:
+	free(workspace);
+
+	return ret;
+}
+
+static int stream_unlz4(struct decomp_stream *ds, void *dst, ulong dstlen,
+			ulong *lenp)
+{
+	u32 block_header, block_size;
+	ulong hdr_size, max_block, need, done = 0;
+	bool has_block_checksum;
+	u8 flags, block_desc;
+	int ret;
+
+	ret = stream_fill(ds, LZ4F_HDR_SIZE);
+	if (ret)
+		return ret;
+	if (ds->avail < LZ4F_HDR_SIZE)
+		return -EIO;
+	if (get_unaligned_le32(ds->buf + ds->pos) != LZ4F_MAGIC)
+		return -EPROTONOSUPPORT;
+	flags = ds->buf[ds->pos + 4];
+	block_desc = ds->buf[ds->pos + 5];
+	if (((flags >> 6) & 0x3) != 1)
+		return -EPROTONOSUPPORT;
+	if ((flags & 0x03) || (block_desc & 0x8f) ||
+	    ((block_desc >> 4) & 0x7) < 4)
+		return -EINVAL;
+
+	/* As with ulz4fn(), blocks must not refer back to earlier ones */
+	if (!(flags & 0x20))
+		return -EPROTONOSUPPORT;
+	has_block_checksum = flags & 0x10;
+
+	/* Skip the optional content size and the header checksum */
+	hdr_size = LZ4F_HDR_SIZE + (flags & 0x08 ? sizeof(u64) : 0) + 1;
+	ret = stream_fill(ds, hdr_size);
+	if (ret)
+		return ret;
+	if (ds->avail < hdr_size)
+		return -EIO;
+	stream_consume(ds, hdr_size);
+
+	/* Each block, 64KiB to 4MiB, must fit in the bounce buffer at once */
+	max_block = 1UL << (8 + 2 * ((block_desc >> 4) & 0x7));
+	ret = stream_grow(ds, max_block + sizeof(u32));
+	if (ret)
+		return ret;
+
+	for (;;) {
+		ret = stream_fill(ds, sizeof(u32));
+		if (ret)
+			return ret;
+		if (ds->avail < sizeof(u32))
+			return -EIO;
+		block_header = get_unaligned_le32(ds->buf + ds->pos);
+		stream_consume(ds, sizeof(u32));
+		block_size = block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		if (!block_size)
+			break;
+		if (block_size > max_block)
+			return -EINVAL;
+
+		need = block_size + (has_block_checksum ? sizeof(u32) : 0);
+		ret = stream_fill(ds, need);
+		if (ret)
+			return ret;
+		if (ds->avail < need)
+			return -EIO;
+
+		if (block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+			if (block_size > dstlen - done)
+				return -ENOSPC;
+			memcpy(dst + done, ds->buf + ds->pos, block_size);
+			ret = block_size;
+		} else {
+			ret = LZ4_decompress_safe((char *)ds->buf + ds->pos,
+						  dst + done, block_size,
+						  dstlen - done);
+			/* The decoder does not say why it failed */
+			if (ret < 0)
+				return dstlen - done < max_block ? -ENOSPC :
+					-EINVAL;
+		}
+		stream_consume(ds, need);
+		done += ret;
+	}
+	*lenp = done;
+
+	return 0;
+}
+
+int image_decomp_stream(int comp, void *load_buf, ulong unc_len,
+			struct image_stream *strm, ulong *lenp)
+{
+	struct decomp_stream ds;
+	ulong len = 0;
+	int ret;
+
+	memset(&ds, '\0', sizeof(ds));
+	ds.strm = strm;
+	ds.size = CONFIG_IMAGE_DECOMP_STREAM_CHUNK;
+	ds.buf = malloc_cache_aligned(ds.size);
+	if (!ds.buf)
+		return -ENOMEM;
+
+	if (comp < 0) {
+		ret = stream_fill(&ds, 2);
+		if (ret)
+			goto out;
+		comp = image_decomp_type(ds.buf, ds.avail);
+		if (comp < 0)
+			comp = IH_COMP_NONE;
+	}
+
+	switch (comp) {
+	case IH_COMP_NONE:
+		ret = stream_copy(&ds, load_buf, unc_len, &len);
+		break;
+	case IH_COMP_GZIP:
+		ret = -EPROTONOSUPPORT;
+		if (CONFIG_IS_ENABLED(GZIP))
+			ret = stream_gunzip(&ds, load_buf, unc_len, &len);
+		break;
+	case IH_COMP_LZMA:
+		ret = -EPROTONOSUPPORT;
+		if (CONFIG_IS_ENABLED(LZMA))
+			ret = stream_unlzma(&ds, load_buf, unc_len, &len);
+		break;
+	case IH_COMP_ZSTD:
+		ret = -EPROTONOSUPPORT;
+		if (CONFIG_IS_ENABLED(ZSTD))
+			ret = stream_unzstd(&ds, load_buf, unc_len, &len);
+		break;
+	case IH_COMP_LZ4:
+		ret = -EPROTONOSUPPORT;
+		if (CONFIG_IS_ENABLED(LZ4))
+			ret = stream_unlz4(&ds, load_buf, unc_len, &len);
+		break;
+	default:
+		/* bzip2 and lzo only have buffer-to-buffer decoders */
+		ret = -EPROTONOSUPPORT;
+		break;
+	}
+	if (ret)
+		log_debug("%s stream failed (err=%d)\n",
+			  genimg_get_comp_name(comp), ret);
+	else
+		*lenp = len;
+out:
+	free(ds.buf);
+
+	return ret;
+}
@@ -41,6 +41,26 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 )
 
+#if IS_ENABLED(CONFIG_CMD_ZLOAD)
+static int do_zload_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	return do_zload(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	zload,	6,	0,	do_zload_wrapper,
+	"load and decompress a file from a filesystem",
+	"<interface> <dev[:part]> <addr> <filename> [max_size]\n"
+	"    - Load file 'filename' from partition 'part' on device type\n"
+	"      'interface' instance 'dev' and decompress it to address 'addr'\n"
+	"      while reading, without keeping the compressed file in memory.\n"
+	"      The compression type is detected from the file contents.\n"
+	"      'max_size' limits the uncompressed size and defaults to\n"
+	"      CONFIG_SYS_BOOTM_LEN."
+)
+#endif
+
 static int do_save_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
 			   char *const argv[])
 {
@@ -14,11 +14,30 @@
 #include <env.h>
 #include <image.h>
 #include <net.h>
+#include <net6.h>
 #include <net/udp.h>
 #include <net/sntp.h>
 
 static int netboot_common(enum proto_t, struct cmd_tbl *, int, char * const []);
 
+/* Commands that can use IPv6 take a trailing -ipv6 flag */
+#define IPV6_MAXARGS	IS_ENABLED(CONFIG_IPV6)
+#if defined(CONFIG_IPV6)
+#define IPV6_USAGE	" [-ipv6]"
+#else
+#define IPV6_USAGE	""
+#endif
+
+static bool net_strip_ipv6_flag(int *argc, char *const argv[])
+{
+	if (!IS_ENABLED(CONFIG_IPV6) || *argc < 2 ||
+	    strcmp(argv[*argc - 1], "-ipv6"))
+		return false;
+	(*argc)--;
+
+	return true;
+}
+
 #ifdef CONFIG_CMD_BOOTP
 static int do_bootp(struct cmd_tbl *cmdtp, int flag, int argc,
 		    char *const argv[])
@@ -45,9 +64,9 @@ int do_tftpb(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 }
 
 U_BOOT_CMD(
-	tftpboot,	3,	1,	do_tftpb,
+	tftpboot,	3 + IPV6_MAXARGS,	1,	do_tftpb,
 	"boot image via network using TFTP protocol",
-	"[loadAddress] [[hostIPaddr:]bootfilename]"
+	"[loadAddress] [[hostIPaddr:]bootfilename]" IPV6_USAGE
 );
 #endif
 
@@ -59,9 +78,9 @@ static int do_tftpput(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	tftpput,	4,	1,	do_tftpput,
+	tftpput,	4 + IPV6_MAXARGS,	1,	do_tftpput,
 	"TFTP put command, for uploading files to a server",
-	"Address Size [[hostIPaddr:]filename]"
+	"Address Size [[hostIPaddr:]filename]" IPV6_USAGE
 );
 #endif
 
@@ -124,6 +143,20 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(struct cmd_tbl *cmdtp, int flag, int argc,
+		   char *const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -197,9 +230,13 @@ static int netboot_common(enum proto_t proto, struct cmd_tbl *cmdtp, int argc,
 	int   rcode = 0;
 	int   size;
 	ulong addr;
+	bool use_ip6 = false;
 
 	net_boot_file_name_explicit = false;
 
+	if (proto == TFTPGET || proto == TFTPPUT)
+		use_ip6 = net_strip_ipv6_flag(&argc, argv);
+
 	/* pre-set image_load_addr */
 	s = env_get("loadaddr");
 	if (s != NULL)
@@ -257,7 +294,11 @@ static int netboot_common(enum proto_t proto, struct cmd_tbl *cmdtp, int argc,
 	}
 	bootstage_mark(BOOTSTAGE_ID_NET_START);
 
+	if (IS_ENABLED(CONFIG_IPV6))
+		net_use_ip6 = use_ip6;
 	size = net_loop(proto);
+	if (IS_ENABLED(CONFIG_IPV6))
+		net_use_ip6 = false;
 	if (size < 0) {
 		bootstage_error(BOOTSTAGE_ID_NET_NETLOOP_OK);
 		return CMD_RET_FAILURE;
@@ -312,6 +353,39 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_PING6)
+static int do_ping6(struct cmd_tbl *cmdtp, int flag, int argc,
+		    char *const argv[])
+{
+	int ret;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	if (string_to_ip6(argv[1], strlen(argv[1]), &net_ping_ip6))
+		return CMD_RET_USAGE;
+
+	/* A link-local host can be reached without asking for an address */
+	net_use_ip6 = !ip6_is_link_local_addr(&net_ping_ip6);
+	ret = net_loop(PING6);
+	net_use_ip6 = false;
+	if (ret < 0) {
+		printf("ping6 failed; host %s is not alive\n", argv[1]);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("host %s is alive\n", argv[1]);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ping6,	2,	1,	do_ping6,
+	"send ICMPv6 ECHO_REQUEST to network host",
+	"pingAddress"
+);
+#endif
+
 #if defined(CONFIG_CMD_CDP)
 
 static void cdp_update_env(void)
@@ -406,6 +480,10 @@ U_BOOT_CMD(
 #if defined(CONFIG_CMD_DNS)
 int do_dns(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
+	bool use_ip6;
+	int ret;
+
+	use_ip6 = net_strip_ipv6_flag(&argc, argv);
 	if (argc == 1)
 		return CMD_RET_USAGE;
 
@@ -433,7 +511,12 @@ int do_dns(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	else
 		net_dns_env_var = NULL;
 
-	if (net_loop(DNS) < 0) {
+	if (IS_ENABLED(CONFIG_IPV6))
+		net_use_ip6 = use_ip6;
+	ret = net_loop(DNS);
+	if (IS_ENABLED(CONFIG_IPV6))
+		net_use_ip6 = false;
+	if (ret < 0) {
 		printf("dns lookup of %s failed, check setup\n", argv[1]);
 		return CMD_RET_FAILURE;
 	}
@@ -442,9 +525,9 @@ int do_dns(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 }
 
 U_BOOT_CMD(
-	dns,	3,	1,	do_dns,
+	dns,	3 + IPV6_MAXARGS,	1,	do_dns,
 	"lookup the IP of a hostname",
-	"hostname [envvar]"
+	"hostname [envvar]" IPV6_USAGE
 );
 
 #endif	/* CONFIG_CMD_DNS */
@@ -496,8 +579,31 @@ static int do_net_list(struct cmd_tbl *cmdtp, int flag, int argc, char *const ar
 	return CMD_RET_SUCCESS;
 }
 
+static int do_net_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			char *const argv[])
+{
+	const struct eth_stats *st;
+	struct udevice *dev;
+	struct uclass *uc;
+
+	uclass_id_foreach_dev(UCLASS_ETH, dev, uc) {
+		/* Counters only exist once a device is probed */
+		if (!device_active(dev))
+			continue;
+		st = eth_get_stats(dev);
+		printf("eth%d : %s\n", dev_seq(dev), dev->name);
+		printf("  rx: %lu packets, %lu bytes, %lu errors, %lu dropped, %lu overruns\n",
+		       st->rx_packets, st->rx_bytes, st->rx_errors,
+		       st->rx_dropped, st->rx_overruns);
+		printf("  tx: %lu packets, %lu bytes, %lu errors\n",
+		       st->tx_packets, st->tx_bytes, st->tx_errors);
+	}
+	return CMD_RET_SUCCESS;
+}
+
 static struct cmd_tbl cmd_net[] = {
 	U_BOOT_CMD_MKENT(list, 1, 0, do_net_list, "", ""),
+	U_BOOT_CMD_MKENT(stats, 1, 0, do_net_stats, "", ""),
 };
 
 static int do_net(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
@@ -522,5 +628,6 @@ U_BOOT_CMD(
 	net, 2, 1, do_net,
 	"NET sub-system",
 	"list - list available devices\n"
+	"net stats - show traffic counters of probed devices\n"
 );
 #endif // CONFIG_DM_ETH
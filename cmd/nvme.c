@@ -8,10 +8,39 @@
 #include <blk.h>
 #include <command.h>
 #include <dm.h>
+#include <mapmem.h>
 #include <nvme.h>
+#include <time.h>
 
 static int nvme_curr_dev;
 
+static int do_nvme_bench(ulong addr, lbaint_t blk, lbaint_t cnt)
+{
+	struct blk_desc *desc;
+	struct udevice *udev;
+	ulong start, us, n;
+	void *buf;
+	int ret;
+
+	ret = blk_get_device(IF_TYPE_NVME, nvme_curr_dev, &udev);
+	if (ret < 0)
+		return CMD_RET_FAILURE;
+	desc = dev_get_uclass_plat(udev);
+
+	/* Measure the device, not the block cache */
+	blkcache_invalidate(IF_TYPE_NVME, desc->devnum);
+	buf = map_sysmem(addr, cnt << desc->log2blksz);
+	start = timer_get_us();
+	n = blk_dread(desc, blk, cnt, buf);
+	us = timer_get_us() - start;
+	unmap_sysmem(buf);
+
+	printf("%lu blocks read in %lu us: %lu MB/s\n", n, us,
+	       (ulong)((u64)n << desc->log2blksz) / max(us, 1UL));
+
+	return n == cnt ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
+}
+
 static int do_nvme(struct cmd_tbl *cmdtp, int flag, int argc,
 		   char *const argv[])
 {
@@ -38,6 +67,10 @@ static int do_nvme(struct cmd_tbl *cmdtp, int flag, int argc,
 			return ret;
 		}
 	}
+	if (argc == 5 && !strcmp(argv[1], "bench"))
+		return do_nvme_bench(hextoul(argv[2], NULL),
+				     hextoul(argv[3], NULL),
+				     hextoul(argv[4], NULL));
 
 	return blk_common_cmd(argc, argv, IF_TYPE_NVME, &nvme_curr_dev);
 }
@@ -53,5 +86,7 @@ U_BOOT_CMD(
 	"nvme read addr blk# cnt - read `cnt' blocks starting at block\n"
 	"     `blk#' to memory address `addr'\n"
 	"nvme write addr blk# cnt - write `cnt' blocks starting at block\n"
-	"     `blk#' from memory address `addr'"
+	"     `blk#' from memory address `addr'\n"
+	"nvme bench addr blk# cnt - read `cnt' blocks starting at block\n"
+	"     `blk#' to memory address `addr' and show the speed"
 );
@@ -954,8 +954,31 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+/**
+ * usb_stor_hcd_max_blk() - Limit a transfer to what the host controller takes
+ *
+ * @udev:	USB device
+ * @blk:	Number of blocks wanted in each transfer
+ * @blksz:	Size of each block
+ * Return: @blk, or fewer if the controller cannot transfer that many at once
+ */
+static unsigned short usb_stor_hcd_max_blk(struct usb_device *udev,
+					   unsigned short blk, u32 blksz)
+{
+#if CONFIG_IS_ENABLED(DM_USB)
+	size_t size;
+	int ret;
+
+	ret = usb_get_max_xfer_size(udev, (size_t *)&size);
+	if ((ret >= 0) && (size < blk * blksz))
+		blk = size / blksz;
+#endif
+
+	return blk;
+}
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
-				      struct us_data *us)
+				      struct us_data *us, u32 blksz)
 {
 	/*
 	 * Limit the total size of a transfer to 120 KB.
@@ -973,19 +996,18 @@ static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 	 * Windows 7 limiting transfers to 128 sectors for both USB2 and USB3
 	 * and Apple Mac OS X 10.11 limiting transfers to 256 sectors for USB2
 	 * and 2048 for USB3 devices.
+	 *
+	 * Like the latter, allow USB3 devices 2048 sectors. Those which
+	 * report their own limit can have that instead; see
+	 * usb_stor_get_block_limits(). USB2 devices keep to 240 sectors
+	 * whatever they report.
 	 */
 	unsigned short blk = 240;
 
-#if CONFIG_IS_ENABLED(DM_USB)
-	size_t size;
-	int ret;
-
-	ret = usb_get_max_xfer_size(udev, (size_t *)&size);
-	if ((ret >= 0) && (size < blk * 512))
-		blk = size / 512;
-#endif
+	if (udev->speed >= USB_SPEED_SUPER)
+		blk = 2048;
 
-	us->max_xfer_blk = blk;
+	us->max_xfer_blk = usb_stor_hcd_max_blk(udev, blk, blksz);
 }
 
 static int usb_inquiry(struct scsi_cmd *srb, struct us_data *ss)
@@ -1012,6 +1034,58 @@ static int usb_inquiry(struct scsi_cmd *srb, struct us_data *ss)
 	return 0;
 }
 
+static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss);
+
+/**
+ * usb_stor_get_block_limits() - Use the largest transfer the device reports
+ *
+ * @udev:	USB device
+ * @srb:	Command block to use
+ * @ss:		Storage device
+ * @blksz:	Size of each block
+ *
+ * SuperSpeed devices which claim SPC-3 or later may say in the Block Limits
+ * page of their vital product data how many blocks they can transfer at
+ * once. Use that, within what the host controller can take. Other devices
+ * keep the limit from usb_stor_set_max_xfer_blk() and are not asked, since
+ * some older sticks do not cope with the request.
+ */
+static void usb_stor_get_block_limits(struct usb_device *udev,
+				      struct scsi_cmd *srb, struct us_data *ss,
+				      u32 blksz)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, vpd, 64);
+	u32 max_blk;
+	int i;
+
+	srb->pdata = vpd;
+	for (i = 0; i < 2; i++) {
+		memset(&srb->cmd[0], 0, 12);
+		memset(vpd, '\0', 64);
+		srb->cmd[0] = SCSI_INQUIRY;
+		srb->cmd[1] = srb->lun << 5 | 1;	/* EVPD */
+		srb->cmd[2] = i ? 0xb0 : 0x00;
+		srb->cmd[4] = 64;
+		srb->datalen = 64;
+		srb->cmdlen = 12;
+		if (ss->transport(srb, ss) != USB_STOR_TRANSPORT_GOOD) {
+			usb_request_sense(srb, ss);
+			return;
+		}
+		/* Look for the Block Limits page in the list of pages */
+		if (!i && !memchr(vpd + 4, 0xb0, min(vpd[3], (u8)60)))
+			return;
+	}
+
+	max_blk = get_unaligned_be32(vpd + 8);
+	if (vpd[1] != 0xb0 || !max_blk)
+		return;
+	max_blk = min(max_blk, (u32)USHRT_MAX);
+	ss->max_xfer_blk = usb_stor_hcd_max_blk(udev, max_blk, blksz);
+	debug("%s: device transfers up to %u blocks, using %u\n", __func__,
+	      max_blk, ss->max_xfer_blk);
+}
+
 static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss)
 {
 	char *ptr;
@@ -1426,8 +1500,11 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		dev->irq_handle = usb_stor_irq;
 	}
 
-	/* Set the maximum transfer size per host controller setting */
-	usb_stor_set_max_xfer_blk(dev, ss);
+	/*
+	 * Set the maximum transfer size per host controller setting, assuming
+	 * 512-byte blocks until usb_stor_get_info() reads the real size
+	 */
+	usb_stor_set_max_xfer_blk(dev, ss, 512);
 
 	dev->privptr = (void *)ss;
 	return 1;
@@ -1516,6 +1593,10 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 	dev_desc->type = perq;
 	debug(" address %d\n", dev_desc->target);
 
+	usb_stor_set_max_xfer_blk(dev, ss, blksz);
+	if (dev->speed >= USB_SPEED_SUPER && (usb_stor_buf[2] & 0xff) >= 5)
+		usb_stor_get_block_limits(dev, pccb, ss, blksz);
+
 	return 1;
 }
 
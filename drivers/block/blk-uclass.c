@@ -12,6 +12,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
+#include <watchdog.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -436,25 +437,236 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/**
+ * struct blk_queue - asynchronous transfers on a block device
+ *
+ * This is the uclass-private data for each block device
+ *
+ * @done:	Requests which have finished but have not been reported yet
+ * @depth:	Maximum number of requests the driver accepts at once
+ * @inflight:	Number of requests submitted and not yet reported
+ * @busy:	Number of requests which the driver has not finished yet
+ */
+struct blk_queue {
+	struct list_head done;
+	uint depth;
+	uint inflight;
+	uint busy;
+};
+
+static unsigned long blk_read_now(struct blk_desc *block_dev, lbaint_t start,
+				  lbaint_t blkcnt, void *buffer)
+{
+	const struct blk_ops *ops = blk_get_ops(block_dev->bdev);
+
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE))
+		return blkcache_read_dev(block_dev, start, blkcnt, buffer);
+
+	return ops->read(block_dev->bdev, start, blkcnt, buffer);
+}
+
+static unsigned long blk_write_now(struct blk_desc *block_dev, lbaint_t start,
+				   lbaint_t blkcnt, const void *buffer)
+{
+	const struct blk_ops *ops = blk_get_ops(block_dev->bdev);
+	ulong blks_written;
+
+	blks_written = ops->write(block_dev->bdev, start, blkcnt, buffer);
+	if (blks_written == blkcnt)
+		blkcache_write(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	else
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+
+	return blks_written;
+}
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+void blk_set_queue_depth(struct udevice *dev, uint depth)
+{
+	struct blk_queue *queue = dev_get_uclass_priv(dev);
+
+	queue->depth = max(depth, 1U);
+}
+
+void blk_req_done(struct blk_req *req, long result)
+{
+	struct blk_queue *queue = dev_get_uclass_priv(req->dev);
+
+	req->result = result;
+	queue->busy--;
+	list_add_tail(&req->sibling, &queue->done);
+}
+
+/*
+ * Wait until the driver has finished every request, without reporting them.
+ * This runs no completion callbacks, so it is safe to call from one.
+ */
+static int blk_quiesce(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_queue *queue = dev_get_uclass_priv(dev);
+	int ret;
+
+	while (queue->busy) {
+		ret = ops->poll(dev);
+		if (ret)
+			return log_msg_ret("poll", ret);
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_queue *queue = dev_get_uclass_priv(dev);
+	struct blk_req *req;
+	int ret;
+
+	if (ops->poll) {
+		ret = ops->poll(dev);
+		if (ret)
+			return log_msg_ret("poll", ret);
+	}
+
+	/* A callback may submit more requests, so take one at a time */
+	while (!list_empty(&queue->done)) {
+		req = list_first_entry(&queue->done, struct blk_req, sibling);
+		list_del(&req->sibling);
+		queue->inflight--;
+		req->complete = true;
+		if (req->done)
+			req->done(req);
+	}
+
+	return queue->inflight;
+}
+
+int blk_submit(struct blk_req *req)
+{
+	struct udevice *dev = req->dev;
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_queue *queue = dev_get_uclass_priv(dev);
+	long result;
+	int ret;
+
+	if (req->write ? !ops->write : !ops->read)
+		return -ENOSYS;
+	req->complete = false;
+	req->result = 0;
+	if (req->write)
+		blkcache_invalidate(desc->if_type, desc->devnum);
+
+	while (ops->submit) {
+		if (queue->busy < queue->depth) {
+			ret = ops->submit(dev, req);
+			if (!ret) {
+				queue->inflight++;
+				queue->busy++;
+				return 0;
+			}
+			if (ret == -ENOSYS)
+				break;
+			if (ret != -EAGAIN || !queue->busy)
+				return log_msg_ret("sub", ret);
+		}
+
+		/*
+		 * Wait for the driver to finish an earlier request. Leave
+		 * reporting it to blk_poll(), since this may be called from a
+		 * completion callback.
+		 */
+		ret = ops->poll(dev);
+		if (ret)
+			return log_msg_ret("poll", ret);
+		WATCHDOG_RESET();
+	}
+
+	/* Fall back to a synchronous transfer, once the driver is idle */
+	if (ops->submit) {
+		ret = blk_quiesce(dev);
+		if (ret)
+			return ret;
+	}
+	if (req->write)
+		result = blk_write_now(desc, req->start, req->blkcnt,
+				       req->buffer);
+	else
+		result = blk_read_now(desc, req->start, req->blkcnt,
+				      req->buffer);
+	queue->inflight++;
+	queue->busy++;
+	blk_req_done(req, result);
+
+	return 0;
+}
+
+long blk_wait(struct blk_req *req)
+{
+	int ret;
+
+	while (!req->complete) {
+		ret = blk_poll(req->dev);
+		if (ret < 0)
+			return ret;
+		WATCHDOG_RESET();
+	}
+
+	return req->result;
+}
+
+int blk_drain(struct udevice *dev)
+{
+	struct blk_queue *queue = dev_get_uclass_priv(dev);
+	int ret;
+
+	while (queue->inflight) {
+		ret = blk_poll(dev);
+		if (ret < 0)
+			return ret;
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+#endif
+
+static int blk_pre_probe(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_queue *queue = dev_get_uclass_priv(dev);
+
+	if (CONFIG_IS_ENABLED(BLK_ASYNC)) {
+		/* Submitted requests can only be waited for using poll() */
+		if (ops->submit && !ops->poll)
+			return log_msg_ret("poll", -EINVAL);
+		INIT_LIST_HEAD(&queue->done);
+		queue->depth = 1;
+	}
+
+	return 0;
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
+	int ret;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
+	if (CONFIG_IS_ENABLED(BLK_ASYNC)) {
+		ret = blk_drain(dev);
+		if (ret)
+			return ret;
+	}
 
-	return blks_read;
+	return blk_read_now(block_dev, start, blkcnt, buffer);
 }
 
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -462,12 +674,18 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return ops->write(dev, start, blkcnt, buffer);
+	if (CONFIG_IS_ENABLED(BLK_ASYNC)) {
+		ret = blk_drain(dev);
+		if (ret)
+			return ret;
+	}
+
+	return blk_write_now(block_dev, start, blkcnt, buffer);
 }
 
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
@@ -475,10 +693,17 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->erase)
 		return -ENOSYS;
 
+	if (CONFIG_IS_ENABLED(BLK_ASYNC)) {
+		ret = blk_drain(dev);
+		if (ret)
+			return ret;
+	}
+
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
 	return ops->erase(dev, start, blkcnt);
 }
@@ -760,6 +985,9 @@ static int blk_post_probe(struct udevice *dev)
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
+	.pre_probe	= blk_pre_probe,
 	.post_probe	= blk_post_probe,
 	.per_device_plat_auto	= sizeof(struct blk_desc),
+	.per_device_auto	= CONFIG_IS_ENABLED(BLK_ASYNC) ?
+				  sizeof(struct blk_queue) : 0,
 };
@@ -6,32 +6,73 @@
  */
 #include <common.h>
 #include <blk.h>
+#include <div64.h>
+#include <dm.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/rbtree.h>
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
-struct block_cache_node {
+/*
+ * The cache is split into entries of max_blocks_per_entry blocks, each
+ * aligned to a multiple of that size on the device. Entries are indexed by
+ * their start block in a per-device rbtree, so that a lookup costs
+ * O(log n) and a request spanning several entries can be served from all
+ * of them. All entries are also kept on a single list in MRU order, which
+ * is used to pick the entry to evict when the cache is full.
+ */
+
+/**
+ * struct block_cache_dev - cache state for one block device
+ *
+ * @lh: link in the block_cache_devs list
+ * @iftype: IF_TYPE_x for type of device
+ * @devnum: device index of particular type
+ * @blksz: size in bytes of each block
+ * @root: cache entries for this device, sorted by start block
+ */
+struct block_cache_dev {
 	struct list_head lh;
 	int iftype;
 	int devnum;
+	unsigned long blksz;
+	struct rb_root root;
+};
+
+/**
+ * struct block_cache_node - a cached run of blocks
+ *
+ * @rb: node in the device's rbtree
+ * @lh: link in the MRU list
+ * @cdev: device this entry belongs to
+ * @start: first block held, a multiple of max_blocks_per_entry
+ * @blkcnt: number of blocks held, less than max_blocks_per_entry only at
+ *	the end of the device
+ * @cache: cached data
+ */
+struct block_cache_node {
+	struct rb_node rb;
+	struct list_head lh;
+	struct block_cache_dev *cdev;
 	lbaint_t start;
 	lbaint_t blkcnt;
-	unsigned long blksz;
 	char *cache;
 };
 
+static LIST_HEAD(block_cache_devs);
 static LIST_HEAD(block_cache);
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_entries = 256,
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE,
 };
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
@@ -42,41 +83,230 @@ int blkcache_init(void)
 	head->next = (uintptr_t)head->next + gd->reloc_off;
 	head->prev = (uintptr_t)head->prev + gd->reloc_off;
 
+	head = &block_cache_devs;
+	head->next = (uintptr_t)head->next + gd->reloc_off;
+	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+
 	return 0;
 }
 #endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+/* Round a block number down to the start of the entry containing it */
+static lbaint_t cache_align(lbaint_t start)
 {
-	struct block_cache_node *node;
+	u64 n = start;
+
+	return start - do_div(n, _stats.max_blocks_per_entry);
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	debug("drop: start " LBAF ", count " LBAFU "\n",
+	      node->start, node->blkcnt);
+	rb_erase(&node->rb, &node->cdev->root);
+	list_del(&node->lh);
+	_stats.entries--;
+	_stats.bytes -= node->blkcnt * node->cdev->blksz;
+	free(node->cache);
+	free(node);
+}
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+static void cache_drop_dev(struct block_cache_dev *cdev)
+{
+	struct rb_node *rb;
+
+	while ((rb = rb_first(&cdev->root)))
+		cache_drop(rb_entry(rb, struct block_cache_node, rb));
+}
+
+static struct block_cache_dev *cache_find_dev(int iftype, int devnum,
+					      unsigned long blksz, bool create)
+{
+	struct block_cache_dev *cdev;
+
+	list_for_each_entry(cdev, &block_cache_devs, lh) {
+		if (cdev->iftype == iftype && cdev->devnum == devnum) {
+			if (cdev->blksz != blksz) {
+				/* the device was re-initialised */
+				cache_drop_dev(cdev);
+				cdev->blksz = blksz;
 			}
-			return node;
+			return cdev;
 		}
-	return 0;
+	}
+	if (!create)
+		return NULL;
+
+	cdev = malloc(sizeof(*cdev));
+	if (!cdev)
+		return NULL;
+	cdev->iftype = iftype;
+	cdev->devnum = devnum;
+	cdev->blksz = blksz;
+	cdev->root = RB_ROOT;
+	list_add(&cdev->lh, &block_cache_devs);
+
+	return cdev;
+}
+
+/* Find the first entry which ends after @start */
+static struct block_cache_node *cache_find(struct block_cache_dev *cdev,
+					   lbaint_t start)
+{
+	struct rb_node *rb = cdev->root.rb_node;
+	struct block_cache_node *found = NULL;
+
+	while (rb) {
+		struct block_cache_node *node;
+
+		node = rb_entry(rb, struct block_cache_node, rb);
+		if (node->start + node->blkcnt <= start) {
+			rb = rb->rb_right;
+		} else {
+			found = node;
+			if (node->start <= start)
+				break;
+			rb = rb->rb_left;
+		}
+	}
+
+	return found;
+}
+
+static struct block_cache_node *cache_next(struct block_cache_node *node)
+{
+	struct rb_node *rb = rb_next(&node->rb);
+
+	return rb ? rb_entry(rb, struct block_cache_node, rb) : NULL;
+}
+
+static void cache_touch(struct block_cache_node *node)
+{
+	if (block_cache.next != &node->lh) {
+		/* maintain MRU ordering */
+		list_del(&node->lh);
+		list_add(&node->lh, &block_cache);
+	}
+}
+
+/**
+ * cache_covered() - check whether a range of blocks is entirely cached
+ *
+ * @cdev: device to check
+ * @start: first block of the range
+ * @blkcnt: number of blocks in the range
+ * Return: first entry of the range if it is covered, NULL otherwise
+ */
+static struct block_cache_node *cache_covered(struct block_cache_dev *cdev,
+					      lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_node *first, *node;
+	lbaint_t pos = start;
+
+	first = cache_find(cdev, start);
+	for (node = first; node && pos < start + blkcnt;
+	     node = cache_next(node)) {
+		if (node->start > pos)
+			return NULL;
+		pos = node->start + node->blkcnt;
+	}
+
+	return pos >= start + blkcnt ? first : NULL;
+}
+
+/* Copy the part of @node which overlaps the given range into @buffer */
+static void cache_copy_out(struct block_cache_node *node, lbaint_t start,
+			   lbaint_t blkcnt, void *buffer)
+{
+	unsigned long blksz = node->cdev->blksz;
+	lbaint_t from = max(start, node->start);
+	lbaint_t to = min(start + blkcnt, node->start + node->blkcnt);
+
+	memcpy(buffer + (from - start) * blksz,
+	       node->cache + (from - node->start) * blksz,
+	       (to - from) * blksz);
+	cache_touch(node);
+}
+
+/**
+ * cache_new() - allocate a new entry, evicting old ones to make room
+ *
+ * The entry is not added to the index; use cache_insert() for that.
+ *
+ * @cdev: device the entry belongs to
+ * @start: first block of the entry
+ * @blkcnt: number of blocks in the entry
+ * Return: new entry, or NULL if it does not fit or out of memory
+ */
+static struct block_cache_node *cache_new(struct block_cache_dev *cdev,
+					  lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_node *node;
+	ulong bytes = blkcnt * cdev->blksz;
+
+	if (!_stats.max_entries || bytes > _stats.max_bytes)
+		return NULL;
+
+	while (!list_empty(&block_cache) &&
+	       (_stats.entries >= _stats.max_entries ||
+		_stats.bytes + bytes > _stats.max_bytes)) {
+		/* pop LRU */
+		cache_drop(list_last_entry(&block_cache,
+					   struct block_cache_node, lh));
+		_stats.evictions++;
+	}
+
+	node = malloc(sizeof(*node));
+	if (!node)
+		return NULL;
+	node->cache = malloc(bytes);
+	if (!node->cache) {
+		free(node);
+		return NULL;
+	}
+	node->cdev = cdev;
+	node->start = start;
+	node->blkcnt = blkcnt;
+
+	return node;
+}
+
+static void cache_insert(struct block_cache_node *node)
+{
+	struct rb_root *root = &node->cdev->root;
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+
+	while (*link) {
+		struct block_cache_node *tmp;
+
+		parent = *link;
+		tmp = rb_entry(parent, struct block_cache_node, rb);
+		if (node->start < tmp->start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&node->rb, parent, link);
+	rb_insert_color(&node->rb, root);
+
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+	_stats.bytes += node->blkcnt * node->cdev->blksz;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
+	struct block_cache_node *node;
+	struct block_cache_dev *cdev;
+
+	cdev = cache_find_dev(iftype, devnum, blksz, false);
+	node = cdev ? cache_covered(cdev, start, blkcnt) : NULL;
 	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+		for (; node && node->start < start + blkcnt;
+		     node = cache_next(node))
+			cache_copy_out(node, start, blkcnt, buffer);
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
 		++_stats.hits;
@@ -93,93 +323,154 @@ void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
 	struct block_cache_node *node;
+	struct block_cache_dev *cdev;
+	lbaint_t chunk = _stats.max_blocks_per_entry;
+	lbaint_t pos;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (!chunk || blkcnt > chunk)
 		return;
 
-	if (_stats.max_entries == 0)
+	cdev = cache_find_dev(iftype, devnum, blksz, true);
+	if (!cdev)
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
+	/* only whole entries can be filled from a caller's buffer */
+	for (pos = cache_align(start); pos + chunk <= start + blkcnt;
+	     pos += chunk) {
+		if (pos < start)
+			continue;
+		node = cache_find(cdev, pos);
+		if (node && node->start <= pos)
+			continue;
+		node = cache_new(cdev, pos, chunk);
 		if (!node)
 			return;
-		node->cache = 0;
+		debug("fill: start " LBAF ", count " LBAFU "\n",
+		      pos, chunk);
+		memcpy(node->cache, buffer + (pos - start) * blksz,
+		       chunk * blksz);
+		cache_insert(node);
 	}
+}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
+ulong blkcache_read_dev(struct blk_desc *desc, lbaint_t start,
+			lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = desc->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct block_cache_node *node;
+	struct block_cache_dev *cdev;
+	lbaint_t chunk = _stats.max_blocks_per_entry;
+	lbaint_t pos, cnt;
+	bool hit = true;
+
+	if (!chunk || blkcnt > chunk ||
+	    (desc->lba && start + blkcnt > desc->lba)) {
+		if (blkcache_read(desc->if_type, desc->devnum, start, blkcnt,
+				  desc->blksz, buffer))
+			return blkcnt;
+		return ops->read(dev, start, blkcnt, buffer);
+	}
+
+	cdev = cache_find_dev(desc->if_type, desc->devnum, desc->blksz, true);
+	if (!cdev)
+		return ops->read(dev, start, blkcnt, buffer);
+
+	/*
+	 * Small reads are widened to the entries containing them, so that
+	 * the blocks around them are read ahead. Any entries which are already
+	 * cached are used as is, even if others have to be read.
+	 */
+	for (pos = cache_align(start); pos < start + blkcnt; pos += chunk) {
+		node = cache_find(cdev, pos);
+		if (!node || node->start > pos) {
+			cnt = chunk;
+			if (desc->lba)
+				cnt = min(cnt, desc->lba - pos);
+			node = cache_new(cdev, pos, cnt);
+			if (!node)
+				return ops->read(dev, start, blkcnt, buffer);
+			if (ops->read(dev, pos, cnt, node->cache) != cnt) {
+				free(node->cache);
+				free(node);
+				return ops->read(dev, start, blkcnt, buffer);
+			}
+			debug("readahead: start " LBAF ", count " LBAFU "\n",
+			      pos, cnt);
+			cache_insert(node);
+			hit = false;
 		}
+		cache_copy_out(node, start, blkcnt, buffer);
 	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	if (hit)
+		++_stats.hits;
+	else
+		++_stats.misses;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	return blkcnt;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_write(int iftype, int devnum,
+		    lbaint_t start, lbaint_t blkcnt,
+		    unsigned long blksz, void const *buffer)
 {
-	struct list_head *entry, *n;
 	struct block_cache_node *node;
+	struct block_cache_dev *cdev;
+	lbaint_t from, to;
+
+	cdev = cache_find_dev(iftype, devnum, blksz, false);
+	if (!cdev)
+		return;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	/* update any cached blocks so they match what is now on the device */
+	for (node = cache_find(cdev, start);
+	     node && node->start < start + blkcnt; node = cache_next(node)) {
+		from = max(start, node->start);
+		to = min(start + blkcnt, node->start + node->blkcnt);
+		memcpy(node->cache + (from - node->start) * blksz,
+		       buffer + (from - start) * blksz, (to - from) * blksz);
+	}
+}
+
+void blkcache_invalidate(int iftype, int devnum)
+{
+	struct block_cache_dev *cdev, *n;
+
+	list_for_each_entry_safe(cdev, n, &block_cache_devs, lh) {
+		if ((cdev->iftype == iftype) &&
+		    (cdev->devnum == devnum)) {
+			cache_drop_dev(cdev);
+			list_del(&cdev->lh);
+			free(cdev);
 		}
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned blocks, unsigned entries, ulong bytes)
 {
-	struct block_cache_node *node;
+	struct block_cache_dev *cdev, *n;
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
+	    (entries != _stats.max_entries) ||
+	    (bytes != _stats.max_bytes)) {
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
+		list_for_each_entry_safe(cdev, n, &block_cache_devs, lh) {
+			cache_drop_dev(cdev);
+			list_del(&cdev->lh);
+			free(cdev);
 		}
-		_stats.entries = 0;
 	}
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+	_stats.max_bytes = bytes;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -187,4 +478,5 @@ void blkcache_stats(struct block_cache_stats *stats)
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
@@ -11,10 +11,12 @@
 #include <os.h>
 #include <malloc.h>
 #include <sandboxblockdev.h>
+#include <time.h>
 #include <asm/global_data.h>
 #include <dm/device_compat.h>
 #include <linux/errno.h>
 #include <dm/device-internal.h>
+#include <linux/delay.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -50,6 +52,8 @@ static unsigned long host_block_read(struct blk_desc *block_dev,
 		return -1;
 #endif
 
+	if (host_dev->latency_us)
+		udelay(host_dev->latency_us);
 	if (os_lseek(host_dev->fd, start * block_dev->blksz, OS_SEEK_SET) ==
 			-1) {
 		printf("ERROR: Invalid block %lx\n", start);
@@ -77,6 +81,8 @@ static unsigned long host_block_write(struct blk_desc *block_dev,
 	struct host_block_dev *host_dev = find_host_device(dev);
 #endif
 
+	if (host_dev->latency_us)
+		udelay(host_dev->latency_us);
 	if (os_lseek(host_dev->fd, start * block_dev->blksz, OS_SEEK_SET) ==
 			-1) {
 		printf("ERROR: Invalid block %lx\n", start);
@@ -248,15 +254,72 @@ int sandbox_host_unbind(struct udevice *dev)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_block_dev *host_dev = dev_get_plat(dev);
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	ulong size = req->blkcnt * block_dev->blksz;
+	ssize_t len;
+
+	/* Do the transfer now but only report it once the latency is up */
+	if (os_lseek(host_dev->fd, req->start * block_dev->blksz,
+		     OS_SEEK_SET) == -1)
+		return -EINVAL;
+	if (req->write)
+		len = os_write(host_dev->fd, req->buffer, size);
+	else
+		len = os_read(host_dev->fd, req->buffer, size);
+	req->result = len >= 0 ? len / block_dev->blksz : -EIO;
+	req->drv_data = timer_get_us() + host_dev->latency_us;
+	list_add_tail(&req->sibling, &host_dev->pending);
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_plat(dev);
+	struct blk_req *req, *next;
+	ulong now = timer_get_us();
+
+	list_for_each_entry_safe(req, next, &host_dev->pending, sibling) {
+		/* Requests all have the same latency, so finish in order */
+		if ((long)(now - req->drv_data) < 0)
+			break;
+		list_del(&req->sibling);
+		blk_req_done(req, req->result);
+	}
+
+	return 0;
+}
+#endif
+
+static int sandbox_host_probe(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_plat(dev);
+
+	INIT_LIST_HEAD(&host_dev->pending);
+	if (CONFIG_IS_ENABLED(BLK_ASYNC))
+		blk_set_queue_depth(dev, SANDBOX_HOST_QUEUE_DEPTH);
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
+#endif
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= sandbox_host_probe,
 	.unbind		= sandbox_host_unbind,
 	.plat_auto	= sizeof(struct host_block_dev),
 };
@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Binding device tree nodes only when their devices are looked up
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <common.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+#include <dm/util.h>
+#include <linux/bitops.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/**
+ * struct dm_deferred_node - A node which is not bound yet
+ *
+ * @sibling: Node in the list in struct dm_defer_state
+ * @parent: Device to bind the node under
+ * @node: The node
+ * @pre_reloc_only: Bind the node as before relocation
+ * @scanned: true if @uclasses includes those of the subnodes
+ * @uclasses: Bitmap of the uclasses which binding the node may add devices to
+ */
+struct dm_deferred_node {
+	struct list_head sibling;
+	struct udevice *parent;
+	ofnode node;
+	bool pre_reloc_only;
+	bool scanned;
+	ulong uclasses[BITS_TO_LONGS(UCLASS_COUNT)];
+};
+
+/*
+ * Devices in these uclasses are mostly added by their parent when it is bound
+ * or probed, rather than from a node of their own, so looking for one binds
+ * every deferred node. This is what bootstd does when looking for something
+ * to boot, so binding is only lazy until then.
+ */
+static const enum uclass_id child_uclasses[] = {
+	UCLASS_BLK,
+	UCLASS_BOOTDEV,
+	UCLASS_PARTITION,
+};
+
+static bool uclass_bit(const ulong *uclasses, enum uclass_id id)
+{
+	return uclasses[BIT_WORD(id)] & BIT_MASK(id);
+}
+
+/* Reading the time may look up the timer, which could be deferred itself */
+static bool dm_defer_can_time(void)
+{
+#ifdef CONFIG_TIMER
+	return gd->timer;
+#else
+	return true;
+#endif
+}
+
+struct dm_defer_state *dm_defer_state(void)
+{
+	return gd_dm_defer();
+}
+
+int dm_set_defer_bind(bool defer)
+{
+	struct dm_defer_state *state = gd_dm_defer();
+	struct dm_deferred_node *dn, *next;
+
+	if (defer) {
+		if (state)
+			return 0;
+		state = calloc(1, sizeof(*state));
+		if (!state)
+			return -ENOMEM;
+		INIT_LIST_HEAD(&state->nodes);
+		gd_set_dm_defer(state);
+
+		return 0;
+	}
+
+	if (!state)
+		return 0;
+	list_for_each_entry_safe(dn, next, &state->nodes, sibling) {
+		list_del(&dn->sibling);
+		free(dn);
+	}
+	free(state);
+	gd_set_dm_defer(NULL);
+
+	return 0;
+}
+
+int dm_defer_node(struct udevice *parent, ofnode node, bool pre_reloc_only)
+{
+	struct dm_defer_state *state = gd_dm_defer();
+	ulong uclasses[BITS_TO_LONGS(UCLASS_COUNT)] = {0};
+	struct dm_deferred_node *dn;
+
+	if (!state)
+		return -EAGAIN;
+
+	/* A node with no driver would not be bound now either */
+	if (lists_ofnode_uclasses(node, pre_reloc_only, uclasses))
+		return 0;
+
+	dn = malloc(sizeof(*dn));
+	if (!dn)
+		return -EAGAIN;
+	dn->parent = parent;
+	dn->node = node;
+	dn->pre_reloc_only = pre_reloc_only;
+	dn->scanned = false;
+	memcpy(dn->uclasses, uclasses, sizeof(uclasses));
+	list_add_tail(&dn->sibling, &state->nodes);
+	state->deferred++;
+	memset(state->done, '\0', sizeof(state->done));
+
+	return 0;
+}
+
+static void dm_defer_scan(ofnode parent, bool pre_reloc_only, ulong *uclasses)
+{
+	ofnode node;
+
+	ofnode_for_each_subnode(node, parent) {
+		if (!ofnode_is_enabled(node))
+			continue;
+		lists_ofnode_uclasses(node, pre_reloc_only, uclasses);
+		dm_defer_scan(node, pre_reloc_only, uclasses);
+	}
+}
+
+static void dm_defer_bind_one(struct dm_defer_state *state,
+			      struct dm_deferred_node *dn)
+{
+	struct udevice *dev = NULL;
+	ulong start = 0;
+	bool timed;
+	int ret;
+
+	/* Binding may look up other devices, so take this node off first */
+	list_del(&dn->sibling);
+	timed = !state->depth++ && dm_defer_can_time();
+	if (timed)
+		start = timer_get_us();
+
+	ret = lists_bind_fdt(dn->parent, dn->node, &dev, NULL,
+			     dn->pre_reloc_only);
+	if (ret)
+		log_debug("%s: ret=%d\n", ofnode_get_name(dn->node), ret);
+	state->bound++;
+
+	if (timed)
+		state->time_us += timer_get_us() - start;
+	state->depth--;
+
+	/* Probe what asks for it, as after scanning the tree */
+	if (dev)
+		dm_probe_devices(dev, dn->pre_reloc_only);
+	free(dn);
+}
+
+void dm_bind_deferred(enum uclass_id id)
+{
+	struct dm_defer_state *state = gd_dm_defer();
+	struct dm_deferred_node *dn;
+	bool all = false;
+	int i;
+
+	/* Devices bound along the way are added without looking further */
+	if (!state || state->depth || id < 0 || id >= UCLASS_COUNT ||
+	    uclass_bit(state->done, id))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(child_uclasses); i++) {
+		if (id == child_uclasses[i])
+			all = true;
+	}
+
+again:
+	list_for_each_entry(dn, &state->nodes, sibling) {
+		if (!all && !dn->scanned) {
+			dm_defer_scan(dn->node, dn->pre_reloc_only,
+				      dn->uclasses);
+			dn->scanned = true;
+		}
+		if (all || uclass_bit(dn->uclasses, id)) {
+			/* The list may change, so start again afterwards */
+			dm_defer_bind_one(state, dn);
+			goto again;
+		}
+	}
+	__set_bit(id, state->done);
+}
+
+static struct dm_deferred_node *dm_defer_find(struct dm_defer_state *state,
+					      ofnode node)
+{
+	struct dm_deferred_node *dn;
+
+	list_for_each_entry(dn, &state->nodes, sibling) {
+		if (ofnode_equal(dn->node, node))
+			return dn;
+	}
+
+	return NULL;
+}
+
+void dm_bind_deferred_node(ofnode node)
+{
+	struct dm_defer_state *state = gd_dm_defer();
+	struct dm_deferred_node *dn;
+	ofnode parent;
+
+	if (!state || state->depth || list_empty(&state->nodes) ||
+	    !ofnode_valid(node))
+		return;
+
+	dn = dm_defer_find(state, node);
+	if (!dn) {
+		/* Binding the parent may defer this node, if not bind it */
+		parent = ofnode_get_parent(node);
+		if (!ofnode_valid(parent))
+			return;
+		dm_bind_deferred_node(parent);
+		dn = dm_defer_find(state, node);
+		if (!dn)
+			return;
+	}
+	dm_defer_bind_one(state, dn);
+}
+
+void dm_defer_drop(struct udevice *parent)
+{
+	struct dm_defer_state *state = gd_dm_defer();
+	struct dm_deferred_node *dn, *next;
+
+	if (!state)
+		return;
+	list_for_each_entry_safe(dn, next, &state->nodes, sibling) {
+		if (dn->parent == parent) {
+			list_del(&dn->sibling);
+			free(dn);
+		}
+	}
+}
+
+static int dm_count_probed(struct udevice *parent)
+{
+	struct udevice *dev;
+	int count = 0;
+
+	if (dev_get_flags(parent) & DM_FLAG_ACTIVATED)
+		count++;
+	device_foreach_child(dev, parent)
+		count += dm_count_probed(dev);
+
+	return count;
+}
+
+void dm_dump_defer(void)
+{
+	struct dm_defer_state *state = gd_dm_defer();
+	struct dm_deferred_node *dn;
+	int dev_count, uc_count;
+	int pending = 0;
+
+	dm_get_stats(&dev_count, &uc_count);
+	printf("Devices bound:  %d\n", dev_count);
+	printf("Devices probed: %d\n", dm_count_probed(gd->dm_root));
+	if (!state) {
+		printf("Binding is not deferred\n");
+		return;
+	}
+	list_for_each_entry(dn, &state->nodes, sibling)
+		pending++;
+	printf("Nodes deferred: %d\n", state->deferred);
+	printf("Bound later:    %d\n", state->bound);
+	printf("Not bound:      %d\n", pending);
+	printf("Time binding:   %lu us\n", state->time_us);
+}
@@ -16,6 +16,7 @@
 #include <malloc.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -94,6 +95,7 @@ int device_unbind(struct udevice *dev)
 	ret = device_chld_unbind(dev, NULL);
 	if (ret)
 		return log_msg_ret("child unbind", ret);
+	dm_defer_drop(dev);
 
 	ret = uclass_pre_unbind_device(dev);
 	if (ret)
@@ -207,6 +209,10 @@ int device_remove(struct udevice *dev, uint flags)
 	if (!(dev_get_flags(dev) & DM_FLAG_ACTIVATED))
 		return 0;
 
+	/* A device which fails to finish probing is no longer active */
+	if (device_probe_join(dev))
+		return 0;
+
 	ret = device_notify(dev, EVT_DM_PRE_REMOVE);
 	if (ret)
 		return ret;
@@ -26,6 +26,7 @@
 #include <dm/pinctrl.h>
 #include <dm/platdata.h>
 #include <dm/read.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -33,6 +34,8 @@
 #include <linux/err.h>
 #include <linux/list.h>
 #include <power-domain.h>
+#include <uthread.h>
+#include <watchdog.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -477,7 +480,136 @@ static int device_get_dma_constraints(struct udevice *dev)
 	return 0;
 }
 
-int device_probe(struct udevice *dev)
+/**
+ * device_probe_finish() - Finish probing a device after its probe() method
+ *
+ * @dev: Device being probed
+ * Return: 0 if OK, -ve on error, in which case the device is not active
+ */
+static int device_probe_finish(struct udevice *dev)
+{
+	int ret;
+
+	ret = uclass_post_probe_device(dev);
+	if (ret)
+		goto fail_uclass;
+
+	if (dev->parent && device_get_uclass_id(dev) == UCLASS_PINCTRL) {
+		ret = pinctrl_select_state(dev, "default");
+		if (ret && ret != -ENOSYS)
+			log_debug("Device '%s' failed to configure default pinctrl: %d (%s)\n",
+				  dev->name, ret, errno_str(ret));
+	}
+
+	ret = device_notify(dev, EVT_DM_POST_PROBE);
+	if (ret)
+		return ret;
+
+	return 0;
+fail_uclass:
+	if (device_remove(dev, DM_REMOVE_NORMAL)) {
+		dm_warn("%s: Device '%s' failed to remove on error path\n",
+			__func__, dev->name);
+	}
+	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
+
+	device_free(dev);
+
+	return ret;
+}
+
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+/* Mark a device as still probing, if its driver can finish it later */
+static bool device_probe_later(struct udevice *dev)
+{
+	if (!dev->driver->probe_poll)
+		return false;
+	dev_or_flags(dev, DM_FLAG_PROBE_PENDING);
+	gd->dm_probe_pending++;
+
+	return true;
+}
+
+/**
+ * device_probe_poll() - Call a pending device's probe_poll() method once
+ *
+ * @dev: Device to poll
+ * Return: -EAGAIN if the device is still pending, 0 if it is ready, other -ve
+ *	on error, in which case the device is not active
+ */
+static int device_probe_poll(struct udevice *dev)
+{
+	int ret;
+
+	dev_or_flags(dev, DM_FLAG_PROBE_POLLING);
+	ret = dev->driver->probe_poll(dev);
+	dev_bic_flags(dev, DM_FLAG_PROBE_POLLING);
+	if (ret == -EAGAIN)
+		return ret;
+
+	dev_bic_flags(dev, DM_FLAG_PROBE_PENDING);
+	gd->dm_probe_pending--;
+	if (ret) {
+		dev_bic_flags(dev, DM_FLAG_ACTIVATED);
+		device_free(dev);
+		return ret;
+	}
+
+	return device_probe_finish(dev);
+}
+
+static void device_poll_children(struct udevice *parent, struct udevice *skip)
+{
+	struct udevice *dev;
+
+	device_foreach_child(dev, parent) {
+		if (!gd->dm_probe_pending)
+			return;
+		if (dev != skip &&
+		    (dev_get_flags(dev) & (DM_FLAG_PROBE_PENDING |
+					   DM_FLAG_PROBE_POLLING)) ==
+		    DM_FLAG_PROBE_PENDING)
+			device_probe_poll(dev);
+		device_poll_children(dev, skip);
+	}
+}
+
+int device_poll_pending(void)
+{
+	if (gd->dm_probe_pending && gd->dm_root)
+		device_poll_children(gd->dm_root, NULL);
+
+	return gd->dm_probe_pending;
+}
+
+int device_probe_join(struct udevice *dev)
+{
+	int ret;
+
+	/* As in device_probe(), a device being probed counts as active */
+	if (dev_get_flags(dev) & DM_FLAG_PROBE_POLLING)
+		return 0;
+	while (dev_get_flags(dev) & DM_FLAG_PROBE_PENDING) {
+		ret = device_probe_poll(dev);
+		if (ret != -EAGAIN)
+			return ret;
+
+		/* Let the others, and any threads, make progress while waiting */
+		device_poll_children(gd->dm_root, dev);
+		uthread_schedule();
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+#else
+static bool device_probe_later(struct udevice *dev)
+{
+	return false;
+}
+#endif
+
+static int device_do_probe(struct udevice *dev, bool async)
 {
 	const struct driver *drv;
 	int ret;
@@ -486,7 +618,7 @@ int device_probe(struct udevice *dev)
 		return -EINVAL;
 
 	if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
-		return 0;
+		return async ? 0 : device_probe_join(dev);
 
 	ret = device_notify(dev, EVT_DM_PRE_PROBE);
 	if (ret)
@@ -512,7 +644,7 @@ int device_probe(struct udevice *dev)
 		 * so that we don't mess up the device.
 		 */
 		if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
-			return 0;
+			return async ? 0 : device_probe_join(dev);
 	}
 
 	dev_or_flags(dev, DM_FLAG_ACTIVATED);
@@ -581,31 +713,13 @@ int device_probe(struct udevice *dev)
 
 	if (drv->probe) {
 		ret = drv->probe(dev);
+		if (ret == -EINPROGRESS && device_probe_later(dev))
+			return async ? 0 : device_probe_join(dev);
 		if (ret)
 			goto fail;
 	}
 
-	ret = uclass_post_probe_device(dev);
-	if (ret)
-		goto fail_uclass;
-
-	if (dev->parent && device_get_uclass_id(dev) == UCLASS_PINCTRL) {
-		ret = pinctrl_select_state(dev, "default");
-		if (ret && ret != -ENOSYS)
-			log_debug("Device '%s' failed to configure default pinctrl: %d (%s)\n",
-				  dev->name, ret, errno_str(ret));
-	}
-
-	ret = device_notify(dev, EVT_DM_POST_PROBE);
-	if (ret)
-		return ret;
-
-	return 0;
-fail_uclass:
-	if (device_remove(dev, DM_REMOVE_NORMAL)) {
-		dm_warn("%s: Device '%s' failed to remove on error path\n",
-			__func__, dev->name);
-	}
+	return device_probe_finish(dev);
 fail:
 	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
 
@@ -614,6 +728,22 @@ fail:
 	return ret;
 }
 
+int device_probe(struct udevice *dev)
+{
+	return device_do_probe(dev, false);
+}
+
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+int device_probe_async(struct udevice *dev)
+{
+	/* Devices used before relocation are not left half-probed */
+	if (!(gd->flags & GD_FLG_RELOC))
+		return device_probe(dev);
+
+	return device_do_probe(dev, true);
+}
+#endif
+
 void *dev_get_plat(const struct udevice *dev)
 {
 	if (!dev) {
@@ -894,6 +1024,7 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
+	dm_bind_deferred_node(ofnode);
 	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 
 	return *devp ? 0 : -ENOENT;
@@ -903,6 +1034,7 @@ int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	struct udevice *dev;
 
+	dm_bind_deferred_node(ofnode);
 	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
@@ -9,8 +9,11 @@
 #define LOG_CATEGORY LOGC_DM
 
 #include <common.h>
+#include <bootstage.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
+#include <asm/global_data.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -19,6 +22,10 @@
 #include <dm/util.h>
 #include <fdtdec.h>
 #include <linux/compiler.h>
+#include <linux/err.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -181,11 +188,180 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
-		   struct driver *drv, bool pre_reloc_only)
+/* Marks an empty slot in the compatible-string index */
+#define COMPAT_SLOT_EMPTY	0xffff
+
+/**
+ * struct dm_compat_slot - A compatible string in the index
+ *
+ * Drivers and their of_match entries are recorded by position, since the
+ * index may be built before relocation
+ *
+ * @drv:	Position of the driver in the driver list
+ * @id:		Position of the compatible string in the driver's of_match
+ */
+struct dm_compat_slot {
+	u16 drv;
+	u16 id;
+};
+
+/**
+ * struct dm_compat_index - Hash table of the drivers' compatible strings
+ *
+ * Each compatible string appears once, for the first driver which has it,
+ * since that is the driver a search of the driver list would find
+ *
+ * @mask:	Number of slots - 1
+ * @slots:	Slots, found by hashing the string and then probing linearly
+ */
+struct dm_compat_index {
+	uint mask;
+	struct dm_compat_slot slots[];
+};
+
+static uint compat_hash(const char *str)
+{
+	uint hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + *str++;
+
+	return hash;
+}
+
+/**
+ * compat_index_find() - Find a compatible string in the index
+ *
+ * @idx:	Index to search
+ * @compat:	Compatible string to look for
+ * @idp:	Returns the driver's match for @compat, if found
+ * @slotp:	Returns the empty slot where @compat belongs, if not found
+ * Return: driver with @compat, or NULL if none
+ */
+static struct driver *compat_index_find(struct dm_compat_index *idx,
+					const char *compat,
+					const struct udevice_id **idp,
+					struct dm_compat_slot **slotp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const struct udevice_id *id;
+	struct dm_compat_slot *slot;
+	uint i;
+
+	for (i = compat_hash(compat) & idx->mask;; i = (i + 1) & idx->mask) {
+		slot = &idx->slots[i];
+		if (slot->drv == COMPAT_SLOT_EMPTY)
+			break;
+		id = driver[slot->drv].of_match + slot->id;
+		if (!strcmp(id->compatible, compat)) {
+			*idp = id;
+			return &driver[slot->drv];
+		}
+	}
+	*slotp = slot;
+
+	return NULL;
+}
+
+static struct dm_compat_index *compat_index_build(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct dm_compat_index *idx;
+	const struct udevice_id *id;
+	struct dm_compat_slot *slot;
+	uint count = 0, size;
+	int i, j;
+
+	if (n_ents >= COMPAT_SLOT_EMPTY)
+		return NULL;
+	for (i = 0; i < n_ents; i++) {
+		for (id = driver[i].of_match; id && id->compatible; id++)
+			count++;
+	}
+
+	/* Keep at least half of the slots empty so that probes are short */
+	size = roundup_pow_of_two(count * 2 + 1);
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT) &&
+	    sizeof(*idx) + size * sizeof(*slot) >
+	    (gd->malloc_limit - gd->malloc_ptr) / 4)
+		return NULL;
+#endif
+	idx = malloc(sizeof(*idx) + size * sizeof(*slot));
+	if (!idx)
+		return NULL;
+	memset(idx->slots, '\xff', size * sizeof(*slot));
+	idx->mask = size - 1;
+
+	for (i = 0; i < n_ents; i++) {
+		for (j = 0, id = driver[i].of_match; id && id->compatible;
+		     j++, id++) {
+			const struct udevice_id *found;
+
+			if (compat_index_find(idx, id->compatible, &found,
+					      &slot))
+				continue;
+			slot->drv = i;
+			slot->id = j;
+		}
+	}
+
+	return idx;
+}
+
+/**
+ * driver_find_compatible() - Find the driver to bind for a compatible string
+ *
+ * @drv:	Only consider this driver, or NULL for any
+ * @compat:	The compatible string to search for
+ * @idp:	Returns the match that was found
+ * Return: first driver in the list which matches @compat, or NULL if none
+ */
+static struct driver *driver_find_compatible(struct driver *drv,
+					     const char *compat,
+					     const struct udevice_id **idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+	if (CONFIG_IS_ENABLED(DM_COMPAT_INDEX) && !drv) {
+		struct dm_compat_index *idx = gd_dm_compat_index();
+		struct dm_compat_slot *slot;
+
+		/*
+		 * Build the index when first needed, remembering if that fails
+		 * so it is not tried again for every node. initr_dm() clears
+		 * it, since the early malloc() area is gone after relocation.
+		 */
+		if (!idx) {
+			idx = compat_index_build();
+			if (!idx)
+				idx = ERR_PTR(-ENOMEM);
+			gd_set_dm_compat_index(idx);
+		}
+		if (!IS_ERR(idx))
+			return compat_index_find(idx, compat, idp, &slot);
+	}
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (drv) {
+			if (drv != entry)
+				continue;
+			if (!entry->of_match)
+				return entry;
+		}
+		if (!driver_check_compatible(entry->of_match, idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
+int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+		   struct driver *drv, bool pre_reloc_only)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -222,20 +398,14 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		log_debug("   - attempt to match compatible string '%s'\n",
 			  compat);
 
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			if (drv) {
-				if (drv != entry)
-					continue;
-				if (!entry->of_match)
-					break;
-			}
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
-		}
-		if (entry == driver + n_ents)
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DM_MATCH, "dm_match");
+		entry = driver_find_compatible(drv, compat, &id);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_MATCH);
+		if (!entry) {
+			ret = -ENOENT;
 			continue;
+		}
+		ret = 0;
 
 		if (pre_reloc_only) {
 			if (!ofnode_pre_reloc(node) &&
@@ -272,4 +442,34 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 
 	return result;
 }
+
+int lists_ofnode_uclasses(ofnode node, bool pre_reloc_only, ulong *uclasses)
+{
+	const char *compat_list, *compat;
+	const struct udevice_id *id;
+	struct driver *entry;
+	int compat_length, i;
+	bool found = false;
+
+	compat_list = ofnode_get_property(node, "compatible", &compat_length);
+	if (!compat_list)
+		return -ENOENT;
+
+	for (i = 0; i < compat_length; i += strlen(compat) + 1) {
+		compat = compat_list + i;
+		entry = driver_find_compatible(NULL, compat, &id);
+		if (!entry)
+			continue;
+
+		/* The first driver found decides, as in lists_bind_fdt() */
+		if (!found && pre_reloc_only && !ofnode_pre_reloc(node) &&
+		    !(entry->flags & DM_FLAG_PRE_RELOC))
+			return -ENOENT;
+		if (entry->id >= 0 && entry->id < UCLASS_COUNT)
+			__set_bit(entry->id, uclasses);
+		found = true;
+	}
+
+	return found ? 0 : -ENOENT;
+}
 #endif
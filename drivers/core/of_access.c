@@ -29,6 +29,7 @@
 #include <linux/ctype.h>
 #include <linux/err.h>
 #include <linux/ioport.h>
+#include <linux/log2.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -38,6 +39,15 @@ LIST_HEAD(aliases_lookup);
 /* "/aliaes" node */
 static struct device_node *of_aliases;
 
+/*
+ * Nodes with a phandle, indexed by the phandle's low bits, and the tree they
+ * belong to. Phandles are normally numbered from 1, so this rarely has
+ * collisions; any lookup which misses falls back to searching the tree.
+ */
+static struct device_node **phandle_table;
+static phandle phandle_mask;
+static struct device_node *phandle_root;
+
 /* "/chosen" node */
 static struct device_node *of_chosen;
 
@@ -445,6 +455,41 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 	return np;
 }
 
+int of_build_phandle_table(struct device_node *root)
+{
+	struct device_node *np;
+	phandle size = 0;
+
+	free(phandle_table);
+	phandle_table = NULL;
+	phandle_root = NULL;
+	for (np = root; np; np = of_find_all_nodes(np))
+		if (np->phandle)
+			size++;
+	if (!size)
+		return 0;
+
+	size = roundup_pow_of_two(size);
+	phandle_table = calloc(size, sizeof(*phandle_table));
+	if (!phandle_table)
+		return -ENOMEM;
+	phandle_mask = size - 1;
+	phandle_root = root;
+
+	/* Keep the first node with each phandle, as a search would find */
+	for (np = root; np; np = of_find_all_nodes(np)) {
+		struct device_node **entry;
+
+		if (!np->phandle)
+			continue;
+		entry = &phandle_table[np->phandle & phandle_mask];
+		if (!*entry)
+			*entry = np;
+	}
+
+	return 0;
+}
+
 struct device_node *of_find_node_by_phandle(phandle handle)
 {
 	struct device_node *np;
@@ -452,6 +497,12 @@ struct device_node *of_find_node_by_phandle(phandle handle)
 	if (!handle)
 		return NULL;
 
+	if (phandle_table && phandle_root == gd_of_root()) {
+		np = phandle_table[handle & phandle_mask];
+		if (np && np->phandle == handle)
+			return of_node_get(np);
+	}
+
 	for_each_of_allnodes(np)
 		if (np->phandle == handle)
 			break;
@@ -207,6 +207,15 @@ int dm_init(bool of_live)
 
 	INIT_LIST_HEAD((struct list_head *)&gd->dmtag_list);
 
+	/* Deferred nodes belong to the devices being replaced */
+	dm_set_defer_bind(false);
+	if (CONFIG_IS_ENABLED(DM_DEFER_BIND) &&
+	    ofnode_conf_read_bool("u-boot,defer-bind")) {
+		ret = dm_set_defer_bind(true);
+		if (ret)
+			return ret;
+	}
+
 	return 0;
 }
 
@@ -217,6 +226,7 @@ int dm_uninit(void)
 	device_remove(dm_root(), DM_REMOVE_NORMAL);
 	device_unbind(dm_root());
 	gd->dm_root = NULL;
+	dm_set_defer_bind(false);
 
 	return 0;
 }
@@ -271,11 +281,16 @@ static int dm_scan_fdt_node(struct udevice *parent, ofnode parent_node,
 			    bool pre_reloc_only)
 {
 	int ret = 0, err = 0;
+	bool defer;
 	ofnode node;
 
 	if (!ofnode_valid(parent_node))
 		return 0;
 
+	/* Other buses may expect all their children to be bound */
+	defer = dm_defer_state() && (parent == gd->dm_root ||
+			device_get_uclass_id(parent) == UCLASS_SIMPLE_BUS);
+
 	for (node = ofnode_first_subnode(parent_node);
 	     ofnode_valid(node);
 	     node = ofnode_next_subnode(node)) {
@@ -285,6 +300,11 @@ static int dm_scan_fdt_node(struct udevice *parent, ofnode parent_node,
 			pr_debug("   - ignoring disabled device\n");
 			continue;
 		}
+		if (defer) {
+			err = dm_defer_node(parent, node, pre_reloc_only);
+			if (err != -EAGAIN)
+				continue;
+		}
 		err = lists_bind_fdt(parent, node, NULL, NULL, pre_reloc_only);
 		if (err && !ret) {
 			ret = err;
@@ -361,7 +381,7 @@ void *dm_priv_to_rw(void *priv)
 }
 #endif
 
-static int dm_probe_devices(struct udevice *dev, bool pre_reloc_only)
+int dm_probe_devices(struct udevice *dev, bool pre_reloc_only)
 {
 	u32 mask = DM_FLAG_PROBE_AFTER_BIND;
 	u32 flags = dev_get_flags(dev);
@@ -372,7 +392,7 @@ static int dm_probe_devices(struct udevice *dev, bool pre_reloc_only)
 		mask |= DM_FLAG_PRE_RELOC;
 
 	if ((flags & mask) == mask) {
-		ret = device_probe(dev);
+		ret = device_probe_async(dev);
 		if (ret)
 			return ret;
 	}
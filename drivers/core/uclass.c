@@ -17,6 +17,7 @@
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -149,6 +150,7 @@ int uclass_get(enum uclass_id id, struct uclass **ucp)
 	/* Immediately fail if driver model is not set up */
 	if (!gd->uclass_root)
 		return -EDEADLK;
+	dm_bind_deferred(id);
 	*ucp = NULL;
 	uc = uclass_find(id);
 	if (!uc) {
@@ -12,6 +12,7 @@
 #include <fb_nand.h>
 #include <part.h>
 #include <stdlib.h>
+#include <linux/sizes.h>
 
 /**
  * image_size - final fastboot image size
@@ -28,7 +29,50 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/*
+ * Room kept before each half of the buffer for data left over from the
+ * other half, so that it stays next to the data which follows it
+ */
+#define STREAM_PAD	SZ_4K
+/* Least amount of new data worth writing before a half is full */
+#define STREAM_WRITE_MIN	SZ_16K
+
+/**
+ * struct fb_stream - Downloads being written to flash as they arrive
+ *
+ * The buffer is split into two halves, each with a pad before it. Data is
+ * written as it completes, while the transport receives what follows it,
+ * moving on to the other half once one is full.
+ *
+ * @part:	Partition to stream downloads to, or "" if not streaming
+ * @active:	true if the current download is being streamed
+ * @done:	true if the last download was streamed, so a "flash" command
+ *		for @part has nothing left to do
+ * @err:	true if writing failed; the rest of the download is discarded
+ * @cur:	Half of the buffer receiving data, 0 or 1
+ * @half_size:	Size of each half of the buffer
+ * @fill:	Offset in the buffer where the next data goes
+ * @used:	Offset of the first byte not yet written to flash
+ * @ready:	Offset of the end of a half waiting to be written, or 0
+ * @response:	Response to send when the download completes, if @err
+ */
+static struct fb_stream {
+	char part[PART_NAME_LEN];
+	bool active;
+	bool done;
+	bool err;
+	int cur;
+	u32 half_size;
+	u32 fill;
+	u32 used;
+	u32 ready;
+	char response[FASTBOOT_RESPONSE_LEN];
+} fb_stream;
+#endif
+
 static void okay(char *, char *);
+static void boot(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH)
@@ -47,6 +91,9 @@ static void oem_partconf(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 static void oem_bootbus(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 static void run_ucmd(char *, char *);
@@ -77,7 +124,7 @@ static const struct {
 #endif
 	[FASTBOOT_COMMAND_BOOT] =  {
 		.command = "boot",
-		.dispatch = okay
+		.dispatch = boot
 	},
 	[FASTBOOT_COMMAND_CONTINUE] =  {
 		.command = "continue",
@@ -121,6 +168,12 @@ static const struct {
 		.dispatch = oem_bootbus,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	[FASTBOOT_COMMAND_UCMD] = {
 		.command = "UCmd",
@@ -181,6 +234,26 @@ static void okay(char *cmd_parameter, char *response)
 	fastboot_okay(NULL, response);
 }
 
+/**
+ * boot() - Execute the boot command
+ *
+ * @cmd_parameter: Pointer to command parameter
+ * @response: Pointer to fastboot response buffer
+ *
+ * The image is booted after the response has been sent, if it is OKAY.
+ */
+static void boot(char *cmd_parameter, char *response)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* Only the tail of a streamed download is left in the buffer */
+	if (fb_stream.done) {
+		fastboot_fail("cannot boot a streamed download", response);
+		return;
+	}
+#endif
+	fastboot_okay(NULL, response);
+}
+
 /**
  * getvar() - Read a config/version variable
  *
@@ -192,6 +265,58 @@ static void getvar(char *cmd_parameter, char *response)
 	fastboot_getvar(cmd_parameter, response);
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static u32 stream_half_start(int half)
+{
+	return STREAM_PAD + half * (STREAM_PAD + fb_stream.half_size);
+}
+
+/**
+ * stream_start() - Start writing a download to flash as it arrives
+ *
+ * @response: Pointer to fastboot response buffer, set on failure
+ * Return: 0 if OK, -ve on error
+ */
+static int stream_start(char *response)
+{
+	struct fb_stream *st = &fb_stream;
+	int ret;
+
+	ret = fastboot_mmc_stream_start(st->part, response);
+	if (ret)
+		return ret;
+	st->active = true;
+	st->err = false;
+	st->cur = 0;
+	st->fill = stream_half_start(0);
+	st->used = st->fill;
+	st->ready = 0;
+
+	return 0;
+}
+
+/**
+ * stream_received() - Account for data received into the buffer
+ *
+ * @len: Number of bytes received at the fill point
+ *
+ * Once the half receiving data is full, or the download is finished, it
+ * is ready to write and the other half starts receiving.
+ */
+static void stream_received(u32 len)
+{
+	struct fb_stream *st = &fb_stream;
+
+	st->fill += len;
+	if (st->fill < stream_half_start(st->cur) + st->half_size &&
+	    fastboot_data_remaining())
+		return;
+	st->ready = st->fill;
+	st->cur = !st->cur;
+	st->fill = stream_half_start(st->cur);
+}
+#endif
+
 /**
  * fastboot_download() - Start a download transfer from the client
  *
@@ -212,6 +337,18 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected nonzero image size", response);
 		return;
 	}
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* A streamed download can be larger than the buffer */
+	fb_stream.done = false;
+	if (fb_stream.part[0]) {
+		if (stream_start(response))
+			return;
+		printf("Starting download of %d bytes to '%s'\n",
+		       fastboot_bytes_expected, fb_stream.part);
+		fastboot_response("DATA", response, "%s", cmd_parameter);
+		return;
+	}
+#endif
 	/*
 	 * Nothing to download yet. Response is of the form:
 	 * [DATA|FAIL]$cmd_parameter
@@ -254,23 +391,71 @@ u32 fastboot_data_remaining(void)
 void fastboot_data_download(const void *fastboot_data,
 			    unsigned int fastboot_data_len,
 			    char *response)
+{
+	void *buf;
+	u32 len;
+
+	if (fastboot_data_len == 0 ||
+	    fastboot_data_len > fastboot_data_remaining()) {
+		fastboot_fail("Received invalid data length",
+			      response);
+		return;
+	}
+	/* A streamed download may wrap round the buffer */
+	do {
+		buf = fastboot_data_buf(&len);
+		len = min(len, fastboot_data_len);
+		memcpy(buf, fastboot_data, len);
+		fastboot_data_received(len, response);
+		fastboot_data_flush();
+		fastboot_data += len;
+		fastboot_data_len -= len;
+	} while (fastboot_data_len);
+}
+
+/**
+ * fastboot_data_buf() - Find where the next download data should go
+ *
+ * @len: Returns the number of bytes which may be placed there
+ * Return: Pointer to place the data
+ */
+void *fastboot_data_buf(u32 *len)
+{
+	u32 remaining = fastboot_data_remaining();
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (fb_stream.active) {
+		*len = min(remaining, stream_half_start(fb_stream.cur) +
+			   fb_stream.half_size - fb_stream.fill);
+		return fastboot_buf_addr + fb_stream.fill;
+	}
+#endif
+	*len = remaining;
+
+	return fastboot_buf_addr + fastboot_bytes_received;
+}
+
+/**
+ * fastboot_data_received() - Account for data placed by the transport
+ *
+ * @len: Number of bytes placed at fastboot_data_buf()
+ * @response: Pointer to fastboot response buffer, set on failure
+ */
+void fastboot_data_received(u32 len, char *response)
 {
 #define BYTES_PER_DOT	0x20000
 	u32 pre_dot_num, now_dot_num;
+	u32 room;
 
-	if (fastboot_data_len == 0 ||
-	    (fastboot_bytes_received + fastboot_data_len) >
-	    fastboot_bytes_expected) {
+	fastboot_data_buf(&room);
+	if (len == 0 || len > room) {
 		fastboot_fail("Received invalid data length",
 			      response);
 		return;
 	}
-	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
-	fastboot_bytes_received += fastboot_data_len;
+	fastboot_bytes_received += len;
 	now_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 
 	if (pre_dot_num != now_dot_num) {
@@ -278,9 +463,62 @@ void fastboot_data_download(const void *fastboot_data,
 		if (!(now_dot_num % 74))
 			putc('\n');
 	}
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (fb_stream.active)
+		stream_received(len);
+#endif
 	*response = '\0';
 }
 
+/**
+ * fastboot_data_flush() - Write any complete part of a streamed download
+ *
+ * Data is written once there is enough of it, or its half of the buffer is
+ * full. Whatever the flash writer leaves, such as part of a sparse chunk
+ * header, stays where it is to be written with what follows it, moving to
+ * the pad before the other half if this one is full. After an error the
+ * rest of the download is read and discarded, so that the host sees the
+ * failure when it completes.
+ */
+void fastboot_data_flush(void)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	struct fb_stream *st = &fb_stream;
+	u32 end = st->ready ? st->ready : st->fill;
+	u32 left = 0;
+	long ret;
+
+	if (!st->active)
+		return;
+	if (!st->ready && end - st->used < STREAM_WRITE_MIN)
+		return;
+
+	if (!st->err) {
+		ret = fastboot_mmc_stream_write(fastboot_buf_addr + st->used,
+						end - st->used,
+						!fastboot_data_remaining(),
+						st->response);
+		if (ret < 0)
+			st->err = true;
+		else
+			left = end - st->used - ret;
+	}
+	if (!st->ready) {
+		st->used = end - left;
+		return;
+	}
+	if (left > STREAM_PAD) {
+		fastboot_fail("too much data left over", st->response);
+		st->err = true;
+		left = 0;
+	}
+	st->used = stream_half_start(st->cur) - left;
+	memmove(fastboot_buf_addr + st->used,
+		fastboot_buf_addr + st->ready - left, left);
+	st->ready = 0;
+#endif
+}
+
 /**
  * fastboot_data_complete() - Mark current transfer complete
  *
@@ -292,6 +530,20 @@ void fastboot_data_complete(char *response)
 {
 	/* Download complete. Respond with "OKAY" */
 	fastboot_okay(NULL, response);
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* Unless it was streamed and could not be written */
+	if (fb_stream.active) {
+		fastboot_data_flush();
+		if (fb_stream.err)
+			strlcpy(response, fb_stream.response,
+				FASTBOOT_RESPONSE_LEN);
+		else
+			fastboot_mmc_stream_finish(response);
+		fb_stream.active = false;
+		fb_stream.done = true;
+		fb_stream.err = strncmp("OKAY", response, 4);
+	}
+#endif
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
 	image_size = fastboot_bytes_received;
 	env_set_hex("filesize", image_size);
@@ -311,6 +563,19 @@ void fastboot_data_complete(char *response)
  */
 static void flash(char *cmd_parameter, char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* A streamed image was written as it downloaded */
+	if (fb_stream.done) {
+		if (fb_stream.err)
+			fastboot_fail("streamed download failed", response);
+		else if (!cmd_parameter || strcmp(cmd_parameter, fb_stream.part))
+			fastboot_fail("image was streamed to another partition",
+				      response);
+		else
+			fastboot_okay(NULL, response);
+		return;
+	}
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
 	fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				 response);
@@ -513,3 +778,36 @@ static void oem_bootbus(char *cmd_parameter, char *response)
 		fastboot_okay(NULL, response);
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * oem_stream() - Execute the OEM stream command
+ *
+ * @cmd_parameter: Pointer to partition name, or empty to stop streaming
+ * @response: Pointer to fastboot response buffer
+ *
+ * Later downloads are written to the partition as they arrive.
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	u32 half_size;
+
+	if (!cmd_parameter || !*cmd_parameter) {
+		fb_stream.part[0] = '\0';
+		fastboot_okay(NULL, response);
+		return;
+	}
+
+	half_size = 0;
+	if (fastboot_buf_size > 2 * STREAM_PAD)
+		half_size = ALIGN_DOWN((fastboot_buf_size - 2 * STREAM_PAD) / 2,
+				       SZ_4K);
+	if (!half_size) {
+		fastboot_fail("buffer too small to stream", response);
+		return;
+	}
+	fb_stream.half_size = half_size;
+	strlcpy(fb_stream.part, cmd_parameter, sizeof(fb_stream.part));
+	fastboot_okay(NULL, response);
+}
+#endif
@@ -13,9 +13,11 @@
 #include <image-sparse.h>
 #include <image.h>
 #include <log.h>
+#include <malloc.h>
 #include <part.h>
 #include <mmc.h>
 #include <div64.h>
+#include <asm/cache.h>
 #include <linux/compat.h>
 #include <android_image.h>
 
@@ -632,6 +634,250 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * struct fb_mmc_stream - An image being written to eMMC as it downloads
+ *
+ * @dev_desc:	Device holding the partition
+ * @info:	Partition being written
+ * @sparse_priv: Private data for @sparse
+ * @sparse:	Storage for a sparse image
+ * @ss:		Progress through a sparse image
+ * @started:	true once the start of the image has been seen
+ * @is_sparse:	true if the image is sparse, false if raw
+ * @blk:	Next block to write in a raw image
+ */
+static struct fb_mmc_stream {
+	struct blk_desc *dev_desc;
+	struct disk_partition info;
+	struct fb_mmc_sparse sparse_priv;
+	struct sparse_storage sparse;
+	struct sparse_stream ss;
+	bool started;
+	bool is_sparse;
+	lbaint_t blk;
+} fb_mmc_stream;
+
+/**
+ * fastboot_mmc_stream_start() - Start writing an image to eMMC as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @response: Pointer to fastboot response buffer, set on failure
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	int ret;
+
+	/* These need the whole image before anything is written */
+#ifdef CONFIG_FASTBOOT_MMC_BOOT_SUPPORT
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MMC_BOOT1_NAME) ||
+	    !strcmp(cmd, CONFIG_FASTBOOT_MMC_BOOT2_NAME))
+		goto whole_image;
+#endif
+#if CONFIG_IS_ENABLED(EFI_PARTITION)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_GPT_NAME))
+		goto whole_image;
+#endif
+#if CONFIG_IS_ENABLED(DOS_PARTITION)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MBR_NAME))
+		goto whole_image;
+#endif
+#ifdef CONFIG_ANDROID_BOOT_IMAGE
+	if (!strncasecmp(cmd, "zimage", 6))
+		goto whole_image;
+#endif
+
+	memset(st, '\0', sizeof(*st));
+#if CONFIG_IS_ENABLED(FASTBOOT_MMC_USER_SUPPORT)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MMC_USER_NAME)) {
+		st->dev_desc = fastboot_mmc_get_dev(response);
+		if (!st->dev_desc)
+			return -ENODEV;
+
+		strlcpy((char *)&st->info.name, cmd, sizeof(st->info.name));
+		st->info.size	= st->dev_desc->lba;
+		st->info.blksz	= st->dev_desc->blksz;
+	}
+#endif
+	if (!st->info.name[0]) {
+		ret = fastboot_mmc_get_part_info(cmd, &st->dev_desc, &st->info,
+						 response);
+		if (ret < 0)
+			return ret;
+		strlcpy((char *)&st->info.name, cmd, sizeof(st->info.name));
+	}
+	st->blk = st->info.start;
+
+	return 0;
+
+#if defined(CONFIG_FASTBOOT_MMC_BOOT_SUPPORT) || \
+	CONFIG_IS_ENABLED(EFI_PARTITION) || \
+	CONFIG_IS_ENABLED(DOS_PARTITION) || defined(CONFIG_ANDROID_BOOT_IMAGE)
+whole_image:
+	fastboot_fail("cannot stream to this partition", response);
+
+	return -EINVAL;
+#endif
+}
+
+/* Set up to write the image, once enough has arrived to see what it is */
+static void fb_mmc_stream_begin(struct fb_mmc_stream *st, const void *data,
+				u32 len)
+{
+	st->started = true;
+	st->is_sparse = len >= sizeof(sparse_header_t) &&
+		is_sparse_image((void *)data);
+	if (!st->is_sparse) {
+		puts("Flashing Raw Image\n");
+		return;
+	}
+
+	st->sparse_priv.dev_desc = st->dev_desc;
+	st->sparse.blksz = st->info.blksz;
+	st->sparse.start = st->info.start;
+	st->sparse.size = st->info.size;
+	st->sparse.write = fb_mmc_sparse_write;
+	st->sparse.reserve = fb_mmc_sparse_reserve;
+	st->sparse.mssg = fastboot_fail;
+	st->sparse.priv = &st->sparse_priv;
+
+	printf("Flashing sparse image at offset " LBAFU "\n", st->sparse.start);
+	sparse_stream_start(&st->ss, &st->sparse);
+}
+
+/*
+ * Write whole blocks of a raw image. Data left over by the last call is moved
+ * in front of what follows it in the download buffer, so @data need not be
+ * aligned for DMA. Bounce it through an aligned buffer in that case, as
+ * write_sparse_chunk_raw() does.
+ */
+static int fb_mmc_stream_raw(struct fb_mmc_stream *st, const void *data,
+			     lbaint_t blkcnt)
+{
+	ulong blksz = st->info.blksz;
+	lbaint_t blks, n, bounce_blks = 100;
+	void *buf;
+	int ret = 0;
+
+	if (CONFIG_IS_ENABLED(SYS_DCACHE_OFF) ||
+	    IS_ALIGNED((ulong)data, ARCH_DMA_MINALIGN)) {
+		blks = fb_mmc_blk_write(st->dev_desc, st->blk, blkcnt, data);
+		if (blks != blkcnt)
+			return -EIO;
+		st->blk += blks;
+
+		return 0;
+	}
+
+	buf = memalign(ARCH_DMA_MINALIGN, blksz * bounce_blks);
+	if (!buf)
+		return -ENOMEM;
+	while (blkcnt) {
+		n = min(blkcnt, bounce_blks);
+		memcpy(buf, data, n * blksz);
+		blks = fb_mmc_blk_write(st->dev_desc, st->blk, n, buf);
+		if (blks != n) {
+			ret = -EIO;
+			break;
+		}
+		st->blk += n;
+		data += n * blksz;
+		blkcnt -= n;
+	}
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * @data: Data following what was used by the last call
+ * @len: Number of bytes at @data
+ * @last: true if this is the end of the image
+ * @response: Pointer to fastboot response buffer, set on failure
+ * Return: number of bytes used, or -ve on error. Unless @last is true, some
+ * bytes may be left over, for the caller to pass again with what follows
+ */
+long fastboot_mmc_stream_write(const void *data, u32 len, bool last,
+			       char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	struct disk_partition *info = &st->info;
+	lbaint_t blkcnt, blks;
+	u32 tail;
+
+	if (!st->started) {
+		if (len < sizeof(sparse_header_t) && !last)
+			return 0;
+		fb_mmc_stream_begin(st, data, len);
+	}
+	if (st->is_sparse)
+		return sparse_stream_write(&st->ss, data, len, response);
+
+	/* A raw image is written in whole blocks, padding the last */
+	blkcnt = lldiv(len, info->blksz);
+	tail = len - blkcnt * info->blksz;
+	if (!last)
+		tail = 0;
+	if (st->blk + blkcnt + !!tail > info->start + info->size) {
+		pr_err("too large for partition: '%s'\n", (char *)info->name);
+		fastboot_fail("too large for partition", response);
+		return -EFBIG;
+	}
+
+	if (fb_mmc_stream_raw(st, data, blkcnt))
+		goto write_fail;
+
+	if (tail) {
+		void *buf = memalign(ARCH_DMA_MINALIGN, info->blksz);
+
+		if (!buf) {
+			fastboot_fail("out of memory", response);
+			return -ENOMEM;
+		}
+		memcpy(buf, data + blkcnt * info->blksz, tail);
+		memset(buf + tail, '\0', info->blksz - tail);
+		blks = fb_mmc_blk_write(st->dev_desc, st->blk, 1, buf);
+		free(buf);
+		if (blks != 1)
+			goto write_fail;
+		st->blk++;
+	}
+
+	return blkcnt * info->blksz + tail;
+
+write_fail:
+	pr_err("failed writing to device %d\n", st->dev_desc->devnum);
+	fastboot_fail("failed writing to device", response);
+
+	return -EIO;
+}
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @response: Pointer to fastboot response buffer, set to OKAY or FAIL
+ */
+void fastboot_mmc_stream_finish(char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	const char *name = (char *)st->info.name;
+
+	if (st->is_sparse) {
+		if (!sparse_stream_finish(&st->ss, name, response))
+			fastboot_okay(NULL, response);
+		return;
+	}
+
+	printf("........ wrote " LBAFU " bytes to '%s'\n",
+	       (st->blk - st->info.start) * st->info.blksz, name);
+	fastboot_okay(NULL, response);
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
@@ -128,8 +128,11 @@ static int sb_dsa_handler(struct udevice *dev, void *packet,
 	return 0;
 
 dsa_tagging:
-	master_priv->recv_packets--;
-	i = master_priv->recv_packets;
+	if (!master_priv->recv_packets)
+		return 0;
+	/* Tag the packet just queued, at the tail of the ring */
+	i = (master_priv->recv_head + master_priv->recv_packets - 1) %
+		CONFIG_ETH_RX_RING_SIZE;
 	rx_buf = master_priv->recv_packet_buffer[i];
 	len = master_priv->recv_packet_length[i];
 	memmove(rx_buf + DSA_SANDBOX_TAG_LEN, rx_buf, len);
@@ -139,7 +142,6 @@ dsa_tagging:
 	tag->port = port_index;
 	len += DSA_SANDBOX_TAG_LEN;
 	master_priv->recv_packet_length[i] = len;
-	master_priv->recv_packets++;
 
 	return 0;
 }
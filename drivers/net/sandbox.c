@@ -10,7 +10,9 @@
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <ndisc.h>
 #include <net.h>
+#include <net6.h>
 #include <asm/eth.h>
 #include <asm/global_data.h>
 #include <asm/test.h>
@@ -49,6 +51,42 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+static int sb_eth_recv_tail(struct eth_sandbox_priv *priv)
+{
+	return (priv->recv_head + priv->recv_packets) % CONFIG_ETH_RX_RING_SIZE;
+}
+
+/*
+ * sandbox_eth_recv_buf()
+ *
+ * Get the buffer for the next packet to be received, counting an overrun if
+ * the ring is full
+ */
+void *sandbox_eth_recv_buf(struct udevice *dev)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	if (priv->recv_packets >= CONFIG_ETH_RX_RING_SIZE) {
+		eth_get_stats(dev)->rx_overruns++;
+		return NULL;
+	}
+
+	return priv->recv_packet_buffer[sb_eth_recv_tail(priv)];
+}
+
+/*
+ * sandbox_eth_recv_push()
+ *
+ * Queue the packet built in the buffer from sandbox_eth_recv_buf()
+ */
+void sandbox_eth_recv_push(struct udevice *dev, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	priv->recv_packet_length[sb_eth_recv_tail(priv)] = len;
+	priv->recv_packets++;
+}
+
 /*
  * sandbox_eth_arp_req_to_reply()
  *
@@ -74,14 +112,14 @@ int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
 		return -EAGAIN;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
 		return 0;
 
 	/* store this as the assumed IP of the fake host */
 	priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
 
 	/* Formulate a fake response */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
 	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
 	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
 	eth_recv->et_protlen = htons(PROT_ARP);
@@ -97,9 +135,7 @@ int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
 	memcpy(&arp_recv->ar_tha, &arp->ar_sha, ARP_HLEN);
 	net_copy_ip(&arp_recv->ar_tpa, &arp->ar_spa);
 
-	priv->recv_packet_length[priv->recv_packets] =
-		ETHER_HDR_SIZE + ARP_HDR_SIZE;
-	++priv->recv_packets;
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + ARP_HDR_SIZE);
 
 	return 0;
 }
@@ -136,11 +172,11 @@ int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
 		return -EAGAIN;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
 		return 0;
 
 	/* reply to the ping */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
 	memcpy(eth_recv, packet, len);
 	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
 	icmpr = (struct icmp_hdr *)&ipr->udp_src;
@@ -156,12 +192,125 @@ int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
 	icmpr->checksum = 0;
 	icmpr->checksum = compute_ip_checksum(icmpr, ICMP_HDR_SIZE);
 
-	priv->recv_packet_length[priv->recv_packets] = len;
-	++priv->recv_packets;
+	sandbox_eth_recv_push(dev, len);
 
 	return 0;
 }
 
+#ifdef CONFIG_IPV6
+/* Fill in the IPv6 and ICMPv6 checksum of a packet to be received */
+static void sb_eth_icmp6_finish(struct ip6_hdr *ip6, int plen)
+{
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+
+	ip6->payload_len = htons(plen);
+	icmp->icmp6_cksum = 0;
+	icmp->icmp6_cksum = htons(csum_ipv6_magic(&ip6->saddr, &ip6->daddr,
+						  plen, IPPROTO_ICMPV6,
+						  csum_partial((uchar *)icmp,
+							       plen, 0)));
+}
+
+/*
+ * sandbox_eth_nd_req_to_reply()
+ *
+ * Check for a neighbour solicitation to be sent. If so, inject an
+ * advertisement
+ *
+ * returns 0 if injected, -EAGAIN if not
+ */
+int sandbox_eth_nd_req_to_reply(struct udevice *dev, void *packet,
+				unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+	struct nd_msg *msg = (struct nd_msg *)(ip6 + 1);
+	struct ethernet_hdr *eth_recv;
+	struct ip6_hdr *ip6r;
+	struct nd_msg *msgr;
+
+	if (ntohs(eth->et_protlen) != PROT_IPV6 ||
+	    len < ETHER_HDR_SIZE + IP6_HDR_SIZE + sizeof(*msg) ||
+	    ip6->nexthdr != IPPROTO_ICMPV6 ||
+	    msg->icmph.icmp6_type != ICMPV6_NEIGHBOR_SOLICIT)
+		return -EAGAIN;
+
+	/* Don't allow the buffer to overrun */
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return 0;
+
+	/* Formulate a fake advertisement for the address asked about */
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IPV6);
+
+	ip6r = (void *)eth_recv + ETHER_HDR_SIZE;
+	ip6_add_hdr((uchar *)ip6r, &msg->target, &ip6->saddr, IPPROTO_ICMPV6,
+		    255, 0);
+	msgr = (struct nd_msg *)(ip6r + 1);
+	msgr->icmph.icmp6_type = ICMPV6_NEIGHBOR_ADVERT;
+	msgr->icmph.icmp6_code = 0;
+	msgr->icmph.un.data = htonl(ND_NA_FLAG_SOLICITED | ND_NA_FLAG_OVERRIDE);
+	net_copy_ip6(&msgr->target, &msg->target);
+	msgr->opt[0] = ND_OPT_TARGET_LL_ADDR;
+	msgr->opt[1] = ND_OPT_LLADDR_LEN;
+	memcpy(&msgr->opt[2], priv->fake_host_hwaddr, ARP_HLEN);
+	sb_eth_icmp6_finish(ip6r, sizeof(*msgr) + ND_OPT_LLADDR_SIZE);
+
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP6_HDR_SIZE +
+			      sizeof(*msgr) + ND_OPT_LLADDR_SIZE);
+
+	return 0;
+}
+
+/*
+ * sandbox_eth_ping6_req_to_reply()
+ *
+ * Check for an ICMPv6 echo request to be sent. If so, inject a reply
+ *
+ * returns 0 if injected, -EAGAIN if not
+ */
+int sandbox_eth_ping6_req_to_reply(struct udevice *dev, void *packet,
+				   unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	struct ethernet_hdr *eth_recv;
+	struct ip6_hdr *ip6r;
+	struct icmp6_hdr *icmpr;
+
+	if (ntohs(eth->et_protlen) != PROT_IPV6 ||
+	    len < ETHER_HDR_SIZE + IP6_HDR_SIZE + ICMP6_HDR_SIZE ||
+	    ip6->nexthdr != IPPROTO_ICMPV6 ||
+	    icmp->icmp6_type != ICMPV6_ECHO_REQUEST)
+		return -EAGAIN;
+
+	/* Don't allow the buffer to overrun */
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return 0;
+
+	/* reply to the ping */
+	memcpy(eth_recv, packet, len);
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	ip6r = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_copy_ip6(&ip6r->saddr, &ip6->daddr);
+	net_copy_ip6(&ip6r->daddr, &ip6->saddr);
+	icmpr = (struct icmp6_hdr *)(ip6r + 1);
+	icmpr->icmp6_type = ICMPV6_ECHO_REPLY;
+	sb_eth_icmp6_finish(ip6r, ntohs(ip6->payload_len));
+
+	sandbox_eth_recv_push(dev, len);
+
+	return 0;
+}
+#endif
+
 /*
  * sandbox_eth_recv_arp_req()
  *
@@ -176,11 +325,11 @@ int sandbox_eth_recv_arp_req(struct udevice *dev)
 	struct arp_hdr *arp_recv;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
 		return -EOVERFLOW;
 
 	/* Formulate a fake request */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
 	memcpy(eth_recv->et_dest, net_bcast_ethaddr, ARP_HLEN);
 	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
 	eth_recv->et_protlen = htons(PROT_ARP);
@@ -196,9 +345,7 @@ int sandbox_eth_recv_arp_req(struct udevice *dev)
 	memcpy(&arp_recv->ar_tha, net_null_ethaddr, ARP_HLEN);
 	net_write_ip(&arp_recv->ar_tpa, net_ip);
 
-	priv->recv_packet_length[priv->recv_packets] =
-		ETHER_HDR_SIZE + ARP_HDR_SIZE;
-	++priv->recv_packets;
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + ARP_HDR_SIZE);
 
 	return 0;
 }
@@ -218,12 +365,11 @@ int sandbox_eth_recv_ping_req(struct udevice *dev)
 	struct icmp_hdr *icmpr;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
 		return -EOVERFLOW;
 
 	/* Formulate a fake ping */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
-
 	memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
 	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
 	eth_recv->et_protlen = htons(PROT_IP);
@@ -247,9 +393,7 @@ int sandbox_eth_recv_ping_req(struct udevice *dev)
 	icmpr->un.echo.sequence = htons(1);
 	icmpr->checksum = compute_ip_checksum(icmpr, ICMP_HDR_SIZE);
 
-	priv->recv_packet_length[priv->recv_packets] =
-		ETHER_HDR_SIZE + IP_ICMP_HDR_SIZE;
-	++priv->recv_packets;
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP_ICMP_HDR_SIZE);
 
 	return 0;
 }
@@ -270,6 +414,12 @@ static int sb_default_handler(struct udevice *dev, void *packet,
 		return 0;
 	if (!sandbox_eth_ping_req_to_reply(dev, packet, len))
 		return 0;
+#ifdef CONFIG_IPV6
+	if (!sandbox_eth_nd_req_to_reply(dev, packet, len))
+		return 0;
+	if (!sandbox_eth_ping6_req_to_reply(dev, packet, len))
+		return 0;
+#endif
 
 	return 0;
 }
@@ -326,11 +476,8 @@ static int sb_eth_start(struct udevice *dev)
 
 	debug("eth_sandbox: Start\n");
 
+	priv->recv_head = 0;
 	priv->recv_packets = 0;
-	for (int i = 0; i < PKTBUFSRX; i++) {
-		priv->recv_packet_buffer[i] = net_rx_packets[i];
-		priv->recv_packet_length[i] = 0;
-	}
 
 	return 0;
 }
@@ -347,42 +494,84 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 	return priv->tx_handler(dev, packet, length);
 }
 
-static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
+static void sb_eth_check_timeout(void)
 {
-	struct eth_sandbox_priv *priv = dev_get_priv(dev);
-
 	if (skip_timeout) {
 		timer_test_add_offset(11000UL);
 		skip_timeout = false;
 	}
+}
+
+static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	sb_eth_check_timeout();
 
 	if (priv->recv_packets) {
-		int lcl_recv_packet_length = priv->recv_packet_length[0];
+		int lcl_recv_packet_length =
+			priv->recv_packet_length[priv->recv_head];
 
 		debug("eth_sandbox: received packet[%d], %d waiting\n",
 		      lcl_recv_packet_length, priv->recv_packets - 1);
-		*packetp = priv->recv_packet_buffer[0];
+		*packetp = priv->recv_packet_buffer[priv->recv_head];
 		return lcl_recv_packet_length;
 	}
 	return 0;
 }
 
+static int sb_eth_recv_batch(struct udevice *dev, int flags,
+			     struct eth_rx_pkt *pkts, int max)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int i, n, idx;
+
+	sb_eth_check_timeout();
+
+	n = min(max, priv->recv_packets);
+	for (i = 0; i < n; i++) {
+		idx = (priv->recv_head + i) % CONFIG_ETH_RX_RING_SIZE;
+		pkts[i].packet = priv->recv_packet_buffer[idx];
+		pkts[i].len = priv->recv_packet_length[idx];
+	}
+	debug("eth_sandbox: received %d packets, %d waiting\n", n,
+	      priv->recv_packets - n);
+
+	return n;
+}
+
+static int sb_eth_recv_split(struct udevice *dev, int flags, uchar **packetp,
+			     struct eth_rx_place *place)
+{
+	int len, rest;
+
+	len = sb_eth_recv(dev, flags, packetp);
+	rest = len - place->hdr_len;
+	if (!place->payload || rest <= 0 || rest > place->max_len)
+		return len;
+
+	/*
+	 * Act like a scatter-gather DMA engine: the rest of the frame is not
+	 * left in the packet buffer, so anything reading it there sees zeroes
+	 */
+	memcpy(place->payload, *packetp + place->hdr_len, rest);
+	memset(*packetp + place->hdr_len, '\0', rest);
+	place->placed = true;
+
+	return len;
+}
+
 static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
-	int i;
 
-	if (!priv->recv_packets)
+	/* Packets are freed in order; ignore any from before a restart */
+	if (!priv->recv_packets ||
+	    packet != priv->recv_packet_buffer[priv->recv_head])
 		return 0;
 
+	priv->recv_head = (priv->recv_head + 1) % CONFIG_ETH_RX_RING_SIZE;
 	--priv->recv_packets;
-	for (i = 0; i < priv->recv_packets; i++) {
-		priv->recv_packet_length[i] = priv->recv_packet_length[i + 1];
-		memcpy(priv->recv_packet_buffer[i],
-		       priv->recv_packet_buffer[i + 1],
-		       priv->recv_packet_length[i + 1]);
-	}
-	priv->recv_packet_length[priv->recv_packets] = 0;
 
 	return 0;
 }
@@ -392,6 +581,18 @@ static void sb_eth_stop(struct udevice *dev)
 	debug("eth_sandbox: Stop\n");
 }
 
+static int sb_eth_mcast(struct udevice *dev, const u8 *enetaddr, int join)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	debug("eth_sandbox %s: %s multicast %pM\n", dev->name,
+	      join ? "Join" : "Leave", enetaddr);
+	memcpy(priv->mcast_hwaddr, enetaddr, ARP_HLEN);
+	priv->mcast_joined = join;
+
+	return 0;
+}
+
 static int sb_eth_write_hwaddr(struct udevice *dev)
 {
 	struct eth_pdata *pdata = dev_get_plat(dev);
@@ -407,8 +608,11 @@ static const struct eth_ops sb_eth_ops = {
 	.start			= sb_eth_start,
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
+	.recv_batch		= sb_eth_recv_batch,
+	.recv_split		= sb_eth_recv_split,
 	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
+	.mcast			= sb_eth_mcast,
 	.write_hwaddr		= sb_eth_write_hwaddr,
 };
 
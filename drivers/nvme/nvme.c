@@ -17,7 +17,7 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		64
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
@@ -26,6 +26,8 @@
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
 #define MAX_PRP_POOL		512
+/* Command IDs of asynchronous requests have this set, plus the tag number */
+#define NVME_ASYNC_CMD_ID	0x8000
 
 static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 {
@@ -45,8 +47,8 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+static int nvme_setup_prps(struct nvme_dev *dev, u64 **poolp, u32 *entriesp,
+			   u64 *prp2, int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
@@ -72,39 +74,42 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
+	/* Each full page but the last gives up an entry to link to the next */
+	num_pages = DIV_ROUND_UP(nprps - 1, prps_per_page - 1);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
+	if (nprps > *entriesp) {
+		free(*poolp);
 		/*
 		 * Always increase in increments of pages.  It doesn't waste
 		 * much memory and reduces the number of allocations.
 		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
+		*poolp = memalign(page_size, num_pages * page_size);
+		if (!*poolp) {
 			printf("Error: malloc prp_pool fail\n");
+			*entriesp = 0;
 			return -ENOMEM;
 		}
-		dev->prp_entry_num = prps_per_page * num_pages;
+		*entriesp = num_pages * (prps_per_page - 1) + 1;
 	}
 
-	prp_pool = dev->prp_pool;
+	prp_pool = *poolp;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
+		if (i == prps_per_page - 1 && nprps > 1) {
+			/* The last entry of each page points to the next */
+			*(prp_pool + i) = cpu_to_le64((ulong)(prp_pool +
+							      prps_per_page));
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += prps_per_page;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)*poolp;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   dev->prp_entry_num * sizeof(u64));
+	flush_dcache_range((ulong)*poolp,
+			   ALIGN((ulong)(prp_pool + i), ARCH_DMA_MINALIGN));
 
 	return 0;
 }
@@ -714,11 +719,319 @@ static int nvme_blk_probe(struct udevice *udev)
 	memcpy(desc->vendor, ndev->vendor, sizeof(ndev->vendor));
 	memcpy(desc->product, ndev->serial, sizeof(ndev->serial));
 	memcpy(desc->revision, ndev->firmware_rev, sizeof(ndev->firmware_rev));
+	if (CONFIG_IS_ENABLED(BLK_ASYNC) && ndev->io_tags)
+		blk_set_queue_depth(udev, ndev->io_tag_count);
 
 	free(id);
 	return 0;
 }
 
+/**
+ * nvme_io_reap() - reap completed commands on the I/O queue
+ *
+ * This handles commands which were given a tag. The queue is shared by all
+ * namespaces, so this may complete requests for any block device on the
+ * controller.
+ *
+ * @dev:	NVMe controller
+ */
+static void nvme_io_reap(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_io_tag *tag;
+	struct blk_req *req;
+	u16 head, status, cid;
+
+	for (;;) {
+		head = nvmeq->cq_head;
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != nvmeq->cq_phase)
+			break;
+		cid = readw(&nvmeq->cqes[head].command_id);
+
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			nvmeq->cq_phase = !nvmeq->cq_phase;
+		}
+		writel(head, nvmeq->q_db + dev->db_stride);
+		nvmeq->cq_head = head;
+
+		if (!(cid & NVME_ASYNC_CMD_ID) ||
+		    (cid & ~NVME_ASYNC_CMD_ID) >= dev->io_tag_count)
+			continue;
+		tag = &dev->io_tags[cid & ~NVME_ASYNC_CMD_ID];
+		if (!tag->busy)
+			continue;
+		tag->busy = false;
+		tag->status = status >> 1;
+		if (tag->status)
+			printf("ERROR: status = %x, cid = %x\n", tag->status,
+			       cid);
+
+		req = tag->req;
+		if (CONFIG_IS_ENABLED(BLK_ASYNC) && req) {
+			tag->req = NULL;
+			if (!req->write)
+				invalidate_dcache_range((ulong)req->buffer,
+							(ulong)req->buffer +
+							req->drv_data);
+			blk_req_done(req, tag->status ? -EIO : req->blkcnt);
+		}
+	}
+}
+
+/**
+ * nvme_io_abandon() - give up on the I/O queue after a command timed out
+ *
+ * The controller may still complete the outstanding commands, or DMA into
+ * their buffers, so the tags cannot simply be released. Disable the
+ * controller instead, which aborts every command it holds, then fail the
+ * outstanding commands. The controller is unusable until it is probed again.
+ *
+ * @dev:	NVMe controller
+ */
+static void nvme_io_abandon(struct nvme_dev *dev)
+{
+	struct nvme_io_tag *tag;
+	struct blk_req *req;
+	int i;
+
+	printf("ERROR: %s: I/O timeout\n", dev->udev->name);
+	dev->io_dead = true;
+	if (nvme_disable_ctrl(dev)) {
+		/* Keep the tags busy, since their buffers may still change */
+		printf("ERROR: %s: controller did not stop\n",
+		       dev->udev->name);
+		return;
+	}
+
+	for (i = 0; i < dev->io_tag_count; i++) {
+		tag = &dev->io_tags[i];
+		if (!tag->busy)
+			continue;
+		tag->busy = false;
+		tag->status = NVME_SC_ABORT_REQ;
+
+		req = tag->req;
+		if (CONFIG_IS_ENABLED(BLK_ASYNC) && req) {
+			tag->req = NULL;
+			blk_req_done(req, -ETIMEDOUT);
+		}
+	}
+}
+
+/**
+ * nvme_io_poll() - reap completed commands and check for a timeout
+ *
+ * If a command has been outstanding for too long, the queue is abandoned and
+ * all outstanding commands fail.
+ *
+ * @dev:	NVMe controller
+ * Return: 0 if OK, -ETIMEDOUT if the queue was abandoned now, -EIO if it was
+ * abandoned earlier
+ */
+static int nvme_io_poll(struct nvme_dev *dev)
+{
+	ulong timeout_us = IO_TIMEOUT * 100000;
+	ulong now;
+	int i;
+
+	if (dev->io_dead)
+		return -EIO;
+	nvme_io_reap(dev);
+
+	now = timer_get_us();
+	for (i = 0; i < dev->io_tag_count; i++) {
+		if (dev->io_tags[i].busy &&
+		    now - dev->io_tags[i].start >= timeout_us) {
+			nvme_io_abandon(dev);
+			return -ETIMEDOUT;
+		}
+	}
+
+	return 0;
+}
+
+/* Wait for all tagged commands, before using the queue synchronously */
+static int nvme_io_drain(struct nvme_dev *dev)
+{
+	int i, ret;
+
+	for (i = 0; i < dev->io_tag_count; i++) {
+		while (dev->io_tags[i].busy) {
+			ret = nvme_io_poll(dev);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * nvme_io_start() - send a read or write command using a tag
+ *
+ * @ns:		Namespace to access
+ * @tag_num:	Tag to use, which must not be busy
+ * @slba:	First block to transfer
+ * @lbas:	Number of blocks, no more than the maximum transfer size
+ * @buffer:	Data buffer, which must already be flushed from the cache
+ * @read:	true to read, false to write
+ * Return: 0 if OK, -ENOMEM if the PRP list could not be allocated
+ */
+static int nvme_io_start(struct nvme_ns *ns, int tag_num, u64 slba,
+			 lbaint_t lbas, ulong buffer, bool read)
+{
+	struct nvme_dev *dev = ns->dev;
+	struct nvme_io_tag *tag = &dev->io_tags[tag_num];
+	struct nvme_command c;
+	u64 prp2;
+
+	if (nvme_setup_prps(dev, &tag->prp_pool, &tag->prp_entry_num, &prp2,
+			    lbas << ns->lba_shift, buffer))
+		return -ENOMEM;
+
+	memset(&c, '\0', sizeof(c));
+	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
+	c.rw.command_id = cpu_to_le16(NVME_ASYNC_CMD_ID | tag_num);
+	c.rw.nsid = cpu_to_le32(ns->ns_id);
+	c.rw.slba = cpu_to_le64(slba);
+	c.rw.length = cpu_to_le16(lbas - 1);
+	c.rw.prp1 = cpu_to_le64(buffer);
+	c.rw.prp2 = cpu_to_le64(prp2);
+
+	tag->busy = true;
+	tag->status = 0;
+	tag->start = timer_get_us();
+	nvme_submit_cmd(dev->queues[NVME_IO_Q], &c);
+
+	return 0;
+}
+
+/**
+ * nvme_blk_rw_queued() - transfer blocks with several commands in flight
+ *
+ * The transfer is split at the maximum transfer size as before, but the
+ * commands are queued together so the controller always has the next one
+ * ready, rather than waiting for each completion before sending the next.
+ *
+ * Return: number of blocks transferred before the first error
+ */
+static ulong nvme_blk_rw_queued(struct udevice *udev, lbaint_t blknr,
+				lbaint_t blkcnt, void *buffer, bool read)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	lbaint_t max_lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
+	lbaint_t next = 0, failed = blkcnt;
+	ulong total_len = blkcnt << ns->lba_shift;
+	struct nvme_io_tag *tag;
+	uint inflight = 0;
+	lbaint_t lbas;
+	int i;
+
+	if (nvme_io_drain(dev))
+		return 0;
+	flush_dcache_range((ulong)buffer, (ulong)buffer + total_len);
+
+	for (;;) {
+		/* Keep every free tag busy until an error is seen */
+		for (i = 0; i < dev->io_tag_count; i++) {
+			tag = &dev->io_tags[i];
+			if (next == blkcnt || failed != blkcnt)
+				break;
+			if (tag->busy)
+				continue;
+			lbas = min(max_lbas, blkcnt - next);
+			if (nvme_io_start(ns, i, blknr + next, lbas,
+					  (ulong)buffer +
+					  (next << ns->lba_shift), read)) {
+				failed = next;
+				break;
+			}
+			tag->blk = next;
+			tag->sync = true;
+			next += lbas;
+			inflight++;
+		}
+		if (!inflight)
+			break;
+
+		/* On a timeout, every command fails or stays busy */
+		if (nvme_io_poll(dev))
+			failed = 0;
+		for (i = 0; i < dev->io_tag_count; i++) {
+			tag = &dev->io_tags[i];
+			if (!tag->sync || tag->busy)
+				continue;
+			tag->sync = false;
+			inflight--;
+			if (tag->status && tag->blk < failed)
+				failed = tag->blk;
+		}
+		if (dev->io_dead)
+			break;
+	}
+
+	if (read)
+		invalidate_dcache_range((ulong)buffer,
+					(ulong)buffer + total_len);
+
+	return failed;
+}
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+static int nvme_blk_submit(struct udevice *udev, struct blk_req *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	ulong buffer = (ulong)req->buffer;
+	ulong total_len = req->blkcnt << ns->lba_shift;
+	int i;
+
+	if (dev->io_dead)
+		return -EIO;
+
+	/* Requests needing more than one command are handled synchronously */
+	if (!dev->io_tags || !req->blkcnt ||
+	    req->blkcnt > 1 << (dev->max_transfer_shift - ns->lba_shift))
+		return -ENOSYS;
+
+	for (i = 0; i < dev->io_tag_count && dev->io_tags[i].busy; i++)
+		;
+	if (i == dev->io_tag_count)
+		return -EAGAIN;
+
+	flush_dcache_range(buffer, buffer + total_len);
+	/* Keep the length for invalidating the buffer on completion */
+	req->drv_data = total_len;
+	dev->io_tags[i].req = req;
+	if (nvme_io_start(ns, i, req->start, req->blkcnt, buffer,
+			  !req->write)) {
+		dev->io_tags[i].req = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	int ret;
+
+	/*
+	 * Requests fail when the queue is abandoned, so they can be reported.
+	 * After that, any left are stuck in a controller which did not stop.
+	 */
+	ret = nvme_io_poll(ns->dev);
+	if (ret == -ETIMEDOUT)
+		return 0;
+
+	return ret;
+}
+#endif
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
@@ -736,6 +1049,11 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
 	u64 total_lbas = blkcnt;
 
+	if (dev->io_dead)
+		return 0;
+	if (dev->io_tags)
+		return nvme_blk_rw_queued(udev, blknr, blkcnt, buffer, read);
+
 	flush_dcache_range((unsigned long)buffer,
 			   (unsigned long)buffer + total_len);
 
@@ -757,8 +1075,8 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			total_lbas -= lbas;
 		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, temp_buffer))
+		if (nvme_setup_prps(dev, &dev->prp_pool, &dev->prp_entry_num,
+				    &prp2, lbas << ns->lba_shift, temp_buffer))
 			return -EIO;
 		c.rw.slba = cpu_to_le64(slba);
 		slba += lbas;
@@ -795,6 +1113,10 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
+#endif
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -809,6 +1131,7 @@ int nvme_init(struct udevice *udev)
 {
 	struct nvme_dev *ndev = dev_get_priv(udev);
 	struct nvme_id_ns *id;
+	struct nvme_ops *ops;
 	int ret;
 
 	ndev->udev = udev;
@@ -849,6 +1172,21 @@ int nvme_init(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
+	/*
+	 * Keep one queue entry free so a full queue is not seen as empty.
+	 * Controller-specific queues only handle one command at a time.
+	 */
+	ops = (struct nvme_ops *)udev->driver->ops;
+	if (!(ops && ops->submit_cmd) && ndev->q_depth > 1) {
+		ndev->io_tag_count = ndev->q_depth - 1;
+		ndev->io_tags = calloc(ndev->io_tag_count,
+				       sizeof(*ndev->io_tags));
+		if (!ndev->io_tags) {
+			ret = -ENOMEM;
+			goto free_queue;
+		}
+	}
+
 	nvme_get_info_from_identify(ndev);
 
 	/* Create a blk device for each namespace */
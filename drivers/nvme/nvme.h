@@ -594,6 +594,21 @@ enum {
 	NVME_CSTS_SHST_MASK	= 3 << 2,
 };
 
+/*
+ * A slot for a command on the I/O queue, so that several can be in flight.
+ * The slot number is the command ID, with NVME_ASYNC_CMD_ID set.
+ */
+struct nvme_io_tag {
+	bool busy;		/* command sent and not yet completed */
+	bool sync;		/* used by a synchronous transfer */
+	u16 status;		/* status of the last completed command */
+	ulong start;		/* time the command was sent, in us */
+	lbaint_t blk;		/* offset of the command in the transfer */
+	struct blk_req *req;	/* asynchronous request, if any */
+	u64 *prp_pool;
+	u32 prp_entry_num;
+};
+
 /* Represents an NVM Express device. Each nvme_dev is a PCI function. */
 struct nvme_dev {
 	struct udevice *udev;
@@ -621,6 +636,9 @@ struct nvme_dev {
 	u64 *prp_pool;
 	u32 prp_entry_num;
 	u32 nn;
+	struct nvme_io_tag *io_tags;
+	u32 io_tag_count;
+	bool io_dead;		/* I/O queue abandoned after a timeout */
 };
 
 /* Admin queue and a single I/O queue. */
@@ -1888,6 +1888,18 @@ U_BOOT_DRIVER(pci_generic_drv) = {
 int pci_init(void)
 {
 	struct udevice *bus;
+	struct uclass *uc;
+
+	/*
+	 * Start all the controllers first, so that those which wait for a
+	 * link to come up can do so together
+	 */
+	if (CONFIG_IS_ENABLED(DM_PROBE_ASYNC)) {
+		uclass_id_foreach_dev(UCLASS_PCI, bus, uc) {
+			if (!device_is_on_pci_bus(bus))
+				device_probe_async(bus);
+		}
+	}
 
 	/*
 	 * Enumerate all known controller devices. Enumeration has the side-
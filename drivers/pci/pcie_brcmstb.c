@@ -17,6 +17,7 @@
 #include <dm.h>
 #include <dm/ofnode.h>
 #include <pci.h>
+#include <time.h>
 #include <asm/io.h>
 #include <linux/bitfield.h>
 #include <linux/log2.h>
@@ -135,12 +136,14 @@
  * @gen: Non-zero value indicates limitation of the PCIe controller operation
  *       to a specific generation (1, 2 or 3)
  * @ssc: true indicates active Spread Spectrum Clocking operation
+ * @link_start: Time at which the fundamental reset was deasserted
  */
 struct brcm_pcie {
 	void __iomem		*base;
 
 	int			gen;
 	bool			ssc;
+	ulong			link_start;
 };
 
 /**
@@ -421,20 +424,98 @@ static void brcm_pcie_set_outbound_win(struct brcm_pcie *pcie,
 	writel(tmp, base + PCIE_MEM_WIN0_LIMIT_HI(win));
 }
 
-static int brcm_pcie_probe(struct udevice *dev)
+/**
+ * brcm_pcie_probe_poll() - Finish probing once the link is up
+ * @dev: PCIe controller
+ *
+ * The RC/EP is given up to 100ms to wake up after the fundamental reset is
+ * deasserted by brcm_pcie_probe().
+ *
+ * Return: -EAGAIN if the link may still come up, 0 if OK, other -ve on error
+ */
+static int brcm_pcie_probe_poll(struct udevice *dev)
 {
 	struct udevice *ctlr = pci_get_controller(dev);
 	struct pci_controller *hose = dev_get_uclass_priv(ctlr);
 	struct brcm_pcie *pcie = dev_get_priv(dev);
 	void __iomem *base = pcie->base;
-	struct pci_region region;
 	bool ssc_good = false;
 	int num_out_wins = 0;
-	u64 rc_bar2_offset, rc_bar2_size;
-	unsigned int scb_size_val;
 	int i, ret;
 	u16 nlw, cls, lnksta;
+
+	if (!brcm_pcie_link_up(pcie)) {
+		if (get_timer(pcie->link_start) < 100)
+			return -EAGAIN;
+		printf("PCIe BRCM: link down\n");
+		return -EINVAL;
+	}
+
+	if (!brcm_pcie_rc_mode(pcie)) {
+		printf("PCIe misconfigured; is in EP mode\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < hose->region_count; i++) {
+		struct pci_region *reg = &hose->regions[i];
+
+		if (reg->flags != PCI_REGION_MEM)
+			continue;
+
+		if (num_out_wins >= BRCM_NUM_PCIE_OUT_WINS)
+			return -EINVAL;
+
+		brcm_pcie_set_outbound_win(pcie, num_out_wins, reg->phys_start,
+					   reg->bus_start, reg->size);
+
+		num_out_wins++;
+	}
+
+	/*
+	 * For config space accesses on the RC, show the right class for
+	 * a PCIe-PCIe bridge (the default setting is to be EP mode).
+	 */
+	clrsetbits_le32(base + PCIE_RC_CFG_PRIV1_ID_VAL3,
+			CFG_PRIV1_ID_VAL3_CLASS_CODE_MASK, 0x060400);
+
+	if (pcie->ssc) {
+		ret = brcm_pcie_set_ssc(pcie->base);
+		if (!ret)
+			ssc_good = true;
+		else
+			printf("PCIe BRCM: failed attempt to enter SSC mode\n");
+	}
+
+	lnksta = readw(base + BRCM_PCIE_CAP_REGS + PCI_EXP_LNKSTA);
+	cls = lnksta & PCI_EXP_LNKSTA_CLS;
+	nlw = (lnksta & PCI_EXP_LNKSTA_NLW) >> PCI_EXP_LNKSTA_NLW_SHIFT;
+
+	printf("PCIe BRCM: link up, %s Gbps x%u %s\n", link_speed_to_str(cls),
+	       nlw, ssc_good ? "(SSC)" : "(!SSC)");
+
+	/* PCIe->SCB endian mode for BAR */
+	clrsetbits_le32(base + PCIE_RC_CFG_VENDOR_SPECIFIC_REG1,
+			VENDOR_SPECIFIC_REG1_ENDIAN_MODE_BAR2_MASK,
+			VENDOR_SPECIFIC_REG1_LITTLE_ENDIAN);
+	/*
+	 * Refclk from RC should be gated with CLKREQ# input when ASPM L0s,L1
+	 * is enabled => setting the CLKREQ_DEBUG_ENABLE field to 1.
+	 */
+	setbits_le32(base + PCIE_MISC_HARD_PCIE_HARD_DEBUG,
+		     PCIE_HARD_DEBUG_CLKREQ_DEBUG_ENABLE_MASK);
+
+	return 0;
+}
+
+static int brcm_pcie_probe(struct udevice *dev)
+{
+	struct brcm_pcie *pcie = dev_get_priv(dev);
+	void __iomem *base = pcie->base;
+	struct pci_region region;
+	u64 rc_bar2_offset, rc_bar2_size;
+	unsigned int scb_size_val;
 	u32 tmp;
+	int ret;
 
 	/*
 	 * Reset the bridge, assert the fundamental reset. Note for some SoCs,
@@ -505,71 +586,20 @@ static int brcm_pcie_probe(struct udevice *dev)
 	clrbits_le32(pcie->base + PCIE_RGR1_SW_INIT_1,
 		     RGR1_SW_INIT_1_PERST_MASK);
 
-	/* Give the RC/EP time to wake up, before trying to configure RC.
-	 * Intermittently check status for link-up, up to a total of 100ms.
-	 */
-	for (i = 0; i < 100 && !brcm_pcie_link_up(pcie); i += 5)
-		mdelay(5);
-
-	if (!brcm_pcie_link_up(pcie)) {
-		printf("PCIe BRCM: link down\n");
-		return -EINVAL;
-	}
-
-	if (!brcm_pcie_rc_mode(pcie)) {
-		printf("PCIe misconfigured; is in EP mode\n");
-		return -EINVAL;
-	}
-
-	for (i = 0; i < hose->region_count; i++) {
-		struct pci_region *reg = &hose->regions[i];
-
-		if (reg->flags != PCI_REGION_MEM)
-			continue;
-
-		if (num_out_wins >= BRCM_NUM_PCIE_OUT_WINS)
-			return -EINVAL;
-
-		brcm_pcie_set_outbound_win(pcie, num_out_wins, reg->phys_start,
-					   reg->bus_start, reg->size);
-
-		num_out_wins++;
-	}
-
 	/*
-	 * For config space accesses on the RC, show the right class for
-	 * a PCIe-PCIe bridge (the default setting is to be EP mode).
+	 * Give the RC/EP time to wake up before trying to configure RC. The
+	 * link is checked by brcm_pcie_probe_poll(), which other devices can
+	 * probe alongside.
 	 */
-	clrsetbits_le32(base + PCIE_RC_CFG_PRIV1_ID_VAL3,
-			CFG_PRIV1_ID_VAL3_CLASS_CODE_MASK, 0x060400);
-
-	if (pcie->ssc) {
-		ret = brcm_pcie_set_ssc(pcie->base);
-		if (!ret)
-			ssc_good = true;
-		else
-			printf("PCIe BRCM: failed attempt to enter SSC mode\n");
-	}
-
-	lnksta = readw(base + BRCM_PCIE_CAP_REGS + PCI_EXP_LNKSTA);
-	cls = lnksta & PCI_EXP_LNKSTA_CLS;
-	nlw = (lnksta & PCI_EXP_LNKSTA_NLW) >> PCI_EXP_LNKSTA_NLW_SHIFT;
+	pcie->link_start = get_timer(0);
+	if (CONFIG_IS_ENABLED(DM_PROBE_ASYNC))
+		return -EINPROGRESS;
 
-	printf("PCIe BRCM: link up, %s Gbps x%u %s\n", link_speed_to_str(cls),
-	       nlw, ssc_good ? "(SSC)" : "(!SSC)");
+	do {
+		ret = brcm_pcie_probe_poll(dev);
+	} while (ret == -EAGAIN);
 
-	/* PCIe->SCB endian mode for BAR */
-	clrsetbits_le32(base + PCIE_RC_CFG_VENDOR_SPECIFIC_REG1,
-			VENDOR_SPECIFIC_REG1_ENDIAN_MODE_BAR2_MASK,
-			VENDOR_SPECIFIC_REG1_LITTLE_ENDIAN);
-	/*
-	 * Refclk from RC should be gated with CLKREQ# input when ASPM L0s,L1
-	 * is enabled => setting the CLKREQ_DEBUG_ENABLE field to 1.
-	 */
-	setbits_le32(base + PCIE_MISC_HARD_PCIE_HARD_DEBUG,
-		     PCIE_HARD_DEBUG_CLKREQ_DEBUG_ENABLE_MASK);
-
-	return 0;
+	return ret;
 }
 
 static int brcm_pcie_remove(struct udevice *dev)
@@ -629,6 +659,7 @@ U_BOOT_DRIVER(pcie_brcm_base) = {
 	.ops			= &brcm_pcie_ops,
 	.of_match		= brcm_pcie_ids,
 	.probe			= brcm_pcie_probe,
+	PROBE_POLL_PTR(brcm_pcie_probe_poll)
 	.remove			= brcm_pcie_remove,
 	.of_to_plat	= brcm_pcie_of_to_plat,
 	.priv_auto	= sizeof(struct brcm_pcie),
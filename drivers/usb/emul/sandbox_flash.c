@@ -10,6 +10,8 @@
 #include <os.h>
 #include <scsi.h>
 #include <usb.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
 
 /*
  * This driver emulates a flash stick using the UFI command specification and
@@ -21,6 +23,8 @@ enum {
 	SANDBOX_FLASH_EP_OUT		= 1,	/* endpoints */
 	SANDBOX_FLASH_EP_IN		= 2,
 	SANDBOX_FLASH_BLOCK_LEN		= 512,
+	/* Largest read, reported in the Block Limits VPD page */
+	SANDBOX_FLASH_MAX_XFER_BLKS	= 1024,
 };
 
 enum cmd_phase {
@@ -45,6 +49,8 @@ enum {
  * @transfer_len: Transfer length from CBW header
  * @read_len:	Number of blocks of data left in the current read command
  * @tag:	Tag value from last command
+ * @read_count:	Number of read commands received
+ * @vpd_count:	Number of INQUIRY commands received for vital product data
  * @fd:		File descriptor of backing file
  * @file_size:	Size of file in bytes
  * @status_buff:	Data buffer for outgoing status
@@ -58,6 +64,8 @@ struct sandbox_flash_priv {
 	int read_len;
 	enum cmd_phase phase;
 	u32 tag;
+	int read_count;
+	int vpd_count;
 	int fd;
 	loff_t file_size;
 	struct umass_bbb_csw status;
@@ -168,6 +176,18 @@ static void *flash_desc_list[] = {
 	NULL,
 };
 
+/* A SuperSpeed stick differs only in the USB version it reports */
+static struct usb_device_descriptor flash_ss_device_desc;
+
+static void *flash_ss_desc_list[] = {
+	&flash_ss_device_desc,
+	&flash_config0,
+	&flash_interface0,
+	&flash_endpoint0_out,
+	&flash_endpoint1_in,
+	NULL,
+};
+
 static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 				 unsigned long pipe, void *buff, int len,
 				 struct devrequest *setup)
@@ -228,6 +248,7 @@ static void handle_read(struct sandbox_flash_priv *priv, ulong lba,
 			ulong transfer_len)
 {
 	debug("%s: lba=%lx, transfer_len=%lx\n", __func__, lba, transfer_len);
+	priv->read_count++;
 	priv->read_len = transfer_len;
 	if (priv->fd != -1) {
 		os_lseek(priv->fd, lba * SANDBOX_FLASH_BLOCK_LEN, OS_SEEK_SET);
@@ -238,6 +259,31 @@ static void handle_read(struct sandbox_flash_priv *priv, ulong lba,
 	}
 }
 
+/* Answer an INQUIRY for a page of vital product data */
+static void handle_inquiry_vpd(struct sandbox_flash_priv *priv, int page)
+{
+	u8 *resp = priv->buff;
+
+	memset(resp, '\0', 64);
+	resp[1] = page;
+	switch (page) {
+	case 0x00:	/* supported pages */
+		resp[3] = 2;
+		resp[4] = 0x00;
+		resp[5] = 0xb0;
+		setup_response(priv, resp, 4 + resp[3]);
+		break;
+	case 0xb0:	/* block limits */
+		resp[3] = 0x3c;
+		put_unaligned_be32(SANDBOX_FLASH_MAX_XFER_BLKS, resp + 8);
+		setup_response(priv, resp, 4 + resp[3]);
+		break;
+	default:
+		setup_fail_response(priv);
+		break;
+	}
+}
+
 static int handle_ufi_command(struct sandbox_flash_plat *plat,
 			      struct sandbox_flash_priv *priv, const void *buff,
 			      int len)
@@ -249,7 +295,13 @@ static int handle_ufi_command(struct sandbox_flash_plat *plat,
 		struct scsi_inquiry_resp *resp = (void *)priv->buff;
 
 		priv->alloc_len = req->cmd[4];
+		if (req->cmd[1] & 1) {
+			priv->vpd_count++;
+			handle_inquiry_vpd(priv, req->cmd[2]);
+			break;
+		}
 		memset(resp, '\0', sizeof(*resp));
+		resp->version = 5;	/* SPC-3 */
 		resp->data_format = 1;
 		resp->additional_len = 0x1f;
 		strncpy(resp->vendor,
@@ -393,6 +445,13 @@ static int sandbox_flash_bind(struct udevice *dev)
 	fs[2].id = STRINGID_SERIAL;
 	fs[2].s = dev->name;
 
+	if (dev_read_bool(dev, "sandbox,superspeed")) {
+		flash_ss_device_desc = flash_device_desc;
+		flash_ss_device_desc.bcdUSB = __constant_cpu_to_le16(0x0300);
+		return usb_emul_setup_device(dev, plat->flash_strings,
+					     flash_ss_desc_list);
+	}
+
 	return usb_emul_setup_device(dev, plat->flash_strings, flash_desc_list);
 }
 
@@ -408,6 +467,20 @@ static int sandbox_flash_probe(struct udevice *dev)
 	return 0;
 }
 
+int sandbox_usb_flash_get_reads(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->read_count;
+}
+
+int sandbox_usb_flash_get_vpd_inquiries(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->vpd_count;
+}
+
 static const struct dm_usb_ops sandbox_usb_flash_ops = {
 	.control	= sandbox_flash_control,
 	.bulk		= sandbox_flash_bulk,
@@ -44,6 +44,8 @@ struct f_fastboot {
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+	/* Buffer of out_req, which may point into the download buffer */
+	void *out_buf;
 };
 
 static char fb_ext_prop_name[] = "DeviceInterfaceGUID";
@@ -282,7 +284,7 @@ static void fastboot_disable(struct usb_function *f)
 	usb_ep_disable(f_fb->in_ep);
 
 	if (f_fb->out_req) {
-		free(f_fb->out_req->buf);
+		free(f_fb->out_buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
 		f_fb->out_req = NULL;
 	}
@@ -337,6 +339,7 @@ static int fastboot_set_alt(struct usb_function *f,
 		ret = -EINVAL;
 		goto err;
 	}
+	f_fb->out_buf = f_fb->out_req->buf;
 	f_fb->out_req->complete = rx_handler_command;
 
 	d = fb_ep_desc(gadget, &fs_ep_in, &hs_ep_in, &ss_ep_in);
@@ -447,6 +450,37 @@ static unsigned int rx_bytes_expected(struct usb_ep *ep)
 	return rx_remain;
 }
 
+/**
+ * rx_setup_dl() - Set up the request for the next part of a download
+ *
+ * @ep: OUT endpoint
+ * @req: Request to set up
+ *
+ * With streaming enabled, whole packets are received straight into the
+ * download buffer, which saves a copy and lets the controller receive while
+ * flash is written. A short packet at the end goes through the endpoint
+ * buffer.
+ */
+static void rx_setup_dl(struct usb_ep *ep, struct usb_request *req)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	unsigned int maxpacket = usb_endpoint_maxp(ep->desc);
+	void *buf;
+	u32 len;
+
+	buf = fastboot_data_buf(&len);
+	len = min_t(u32, len, CONFIG_FASTBOOT_FLASH_STREAM_USB_SIZE);
+	len -= len % maxpacket;
+	if (len) {
+		req->buf = buf;
+		req->length = len;
+		return;
+	}
+#endif
+	req->buf = fastboot_func->out_buf;
+	req->length = rx_bytes_expected(ep);
+}
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	char response[FASTBOOT_RESPONSE_LEN] = {0};
@@ -462,7 +496,10 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	if (buffer_size < transfer_size)
 		transfer_size = buffer_size;
 
-	fastboot_data_download(buffer, transfer_size, response);
+	if (req->buf == fastboot_func->out_buf)
+		fastboot_data_download(buffer, transfer_size, response);
+	else
+		fastboot_data_received(transfer_size, response);
 	if (response[0]) {
 		fastboot_tx_write_str(response);
 	} else if (!fastboot_data_remaining()) {
@@ -472,15 +509,19 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		 * Reset global transfer variable
 		 */
 		req->complete = rx_handler_command;
+		req->buf = fastboot_func->out_buf;
 		req->length = EP_BUFFER_SIZE;
 
 		fastboot_tx_write_str(response);
 	} else {
-		req->length = rx_bytes_expected(ep);
+		rx_setup_dl(ep, req);
 	}
 
 	req->actual = 0;
 	usb_ep_queue(ep, req, 0);
+
+	/* Write to flash while the next part is received */
+	fastboot_data_flush();
 }
 
 static void do_exit_on_complete(struct usb_ep *ep, struct usb_request *req)
@@ -525,7 +566,7 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 
 	if (!strncmp("DATA", response, 4)) {
 		req->complete = rx_handler_dl_image;
-		req->length = rx_bytes_expected(ep);
+		rx_setup_dl(ep, req);
 	}
 
 	if (!strncmp("OKAY", response, 4)) {
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <virtio_types.h>
 #include <virtio.h>
@@ -55,6 +56,78 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
 }
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+/**
+ * struct virtio_blk_req - an asynchronous request on the virtqueue
+ *
+ * @out_hdr:	Request header. This must come first, since it is the buffer
+ *		which virtqueue_get_buf() returns when the request completes
+ * @status:	Status written by the device
+ * @req:	Block request being carried out
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct blk_req *req;
+};
+
+static int virtio_blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_sg hdr_sg, data_sg, status_sg;
+	struct virtio_blk_req *vreq;
+	struct virtio_sg *sgs[3];
+	uint num_out;
+	int ret;
+
+	vreq = malloc(sizeof(*vreq));
+	if (!vreq)
+		return -ENOMEM;
+	vreq->out_hdr.type = cpu_to_virtio32(dev, req->write ?
+					     VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN);
+	vreq->out_hdr.ioprio = 0;
+	vreq->out_hdr.sector = cpu_to_virtio64(dev, req->start);
+	vreq->req = req;
+
+	hdr_sg.addr = &vreq->out_hdr;
+	hdr_sg.length = sizeof(vreq->out_hdr);
+	data_sg.addr = req->buffer;
+	data_sg.length = req->blkcnt * 512;
+	status_sg.addr = &vreq->status;
+	status_sg.length = sizeof(vreq->status);
+
+	sgs[0] = &hdr_sg;
+	sgs[1] = &data_sg;
+	sgs[2] = &status_sg;
+	num_out = req->write ? 2 : 1;
+
+	ret = virtqueue_add(priv->vq, sgs, num_out, 3 - num_out);
+	if (ret) {
+		free(vreq);
+		return ret == -ENOSPC ? -EAGAIN : ret;
+	}
+	virtqueue_kick(priv->vq);
+
+	return 0;
+}
+
+static int virtio_blk_poll(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_req *vreq;
+	struct blk_req *req;
+
+	while ((vreq = virtqueue_get_buf(priv->vq, NULL))) {
+		req = vreq->req;
+		blk_req_done(req, vreq->status == VIRTIO_BLK_S_OK ?
+			     req->blkcnt : -EIO);
+		free(vreq);
+	}
+
+	return 0;
+}
+#endif
+
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
 			     lbaint_t blkcnt, void *buffer)
 {
@@ -119,12 +192,21 @@ static int virtio_blk_probe(struct udevice *dev)
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
+	/* Each request uses three descriptors */
+	if (CONFIG_IS_ENABLED(BLK_ASYNC))
+		blk_set_queue_depth(dev,
+				    virtqueue_get_vring_size(priv->vq) / 3);
+
 	return 0;
 }
 
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
+#endif
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
@@ -13,7 +13,7 @@
 #include "virtio_net.h"
 
 /* Amount of buffers to keep in the RX virtqueue */
-#define VIRTIO_NET_NUM_RX_BUFS	32
+#define VIRTIO_NET_NUM_RX_BUFS	CONFIG_ETH_RX_RING_SIZE
 
 /*
  * This value comes from the VirtIO spec: 1500 for maximum packet size,
@@ -32,6 +32,8 @@ struct virtio_net_priv {
 
 	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
 	bool rx_running;
+	bool rx_refill;
+	int rx_posted;
 	int net_hdr_len;
 };
 
@@ -62,8 +64,10 @@ static int virtio_net_start(struct udevice *dev)
 		/* setup the receive buffer address */
 		for (i = 0; i < VIRTIO_NET_NUM_RX_BUFS; i++) {
 			sg.addr = priv->rx_buff[i];
-			virtqueue_add(priv->rx_vq, sgs, 0, 1);
+			if (virtqueue_add(priv->rx_vq, sgs, 0, 1))
+				break;
 		}
+		priv->rx_posted = i;
 
 		virtqueue_kick(priv->rx_vq);
 
@@ -106,13 +110,39 @@ static int virtio_net_send(struct udevice *dev, void *packet, int length)
 	return 0;
 }
 
+/* Tell the device about buffers given back since the last poll */
+static void virtio_net_rx_refill(struct virtio_net_priv *priv)
+{
+	if (priv->rx_refill) {
+		virtqueue_kick(priv->rx_vq);
+		priv->rx_refill = false;
+	}
+}
+
+static void *virtio_net_rx_get(struct udevice *dev, unsigned int *lenp)
+{
+	struct virtio_net_priv *priv = dev_get_priv(dev);
+	void *buf;
+
+	buf = virtqueue_get_buf(priv->rx_vq, lenp);
+	if (!buf)
+		return NULL;
+
+	/* With no buffers left the device has to drop what arrives */
+	if (!--priv->rx_posted)
+		eth_get_stats(dev)->rx_overruns++;
+
+	return buf;
+}
+
 static int virtio_net_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct virtio_net_priv *priv = dev_get_priv(dev);
 	unsigned int len;
 	void *buf;
 
-	buf = virtqueue_get_buf(priv->rx_vq, &len);
+	virtio_net_rx_refill(priv);
+	buf = virtio_net_rx_get(dev, &len);
 	if (!buf)
 		return -EAGAIN;
 
@@ -120,6 +150,26 @@ static int virtio_net_recv(struct udevice *dev, int flags, uchar **packetp)
 	return len - priv->net_hdr_len;
 }
 
+static int virtio_net_recv_batch(struct udevice *dev, int flags,
+				 struct eth_rx_pkt *pkts, int max)
+{
+	struct virtio_net_priv *priv = dev_get_priv(dev);
+	unsigned int len;
+	void *buf;
+	int n;
+
+	virtio_net_rx_refill(priv);
+	for (n = 0; n < max; n++) {
+		buf = virtio_net_rx_get(dev, &len);
+		if (!buf)
+			break;
+		pkts[n].packet = buf + priv->net_hdr_len;
+		pkts[n].len = len - priv->net_hdr_len;
+	}
+
+	return n;
+}
+
 static int virtio_net_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct virtio_net_priv *priv = dev_get_priv(dev);
@@ -127,8 +177,11 @@ static int virtio_net_free_pkt(struct udevice *dev, uchar *packet, int length)
 	struct virtio_sg sg = { buf, VIRTIO_NET_RX_BUF_SIZE };
 	struct virtio_sg *sgs[] = { &sg };
 
-	/* Put the buffer back to the rx ring */
-	virtqueue_add(priv->rx_vq, sgs, 0, 1);
+	/* Put the buffer back to the rx ring; the next poll kicks the device */
+	if (!virtqueue_add(priv->rx_vq, sgs, 0, 1)) {
+		priv->rx_posted++;
+		priv->rx_refill = true;
+	}
 
 	return 0;
 }
@@ -220,6 +273,7 @@ static const struct eth_ops virtio_net_ops = {
 	.start = virtio_net_start,
 	.send = virtio_net_send,
 	.recv = virtio_net_recv,
+	.recv_batch = virtio_net_recv_batch,
 	.free_pkt = virtio_net_free_pkt,
 	.stop = virtio_net_stop,
 	.write_hwaddr = virtio_net_write_hwaddr,
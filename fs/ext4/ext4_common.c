@@ -1995,6 +1995,169 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	return blknr;
 }
 
+static int ext4fs_extent_map_add(struct ext_extent_map **mapp,
+				 struct ext4_extent *extent)
+{
+	struct ext_extent_map *map = *mapp;
+	struct ext_extent_map_entry *ent;
+
+	if (map->count == map->alloced) {
+		int alloced = map->alloced * 2;
+
+		map = realloc(map, sizeof(*map) + alloced * sizeof(*ent));
+		if (!map)
+			return -ENOMEM;
+		map->alloced = alloced;
+		*mapp = map;
+	}
+
+	ent = &map->ext[map->count++];
+	ent->block = le32_to_cpu(extent->ee_block);
+	ent->len = le16_to_cpu(extent->ee_len);
+	ent->start = le16_to_cpu(extent->ee_start_hi);
+	ent->start = (ent->start << 32) + le32_to_cpu(extent->ee_start_lo);
+
+	return 0;
+}
+
+/* Add the extents below @ext_block, which is at @depth in the tree */
+static int ext4fs_extent_map_walk(struct ext_extent_map **mapp,
+				  struct ext4_extent_header *ext_block,
+				  int depth)
+{
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	struct ext4_extent_idx *index;
+	unsigned long long block;
+	int blksz, log2_blksz;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth ||
+	    entries > le16_to_cpu(ext_block->eh_max))
+		return -EINVAL;
+
+	if (!depth) {
+		struct ext4_extent *extent;
+
+		extent = (struct ext4_extent *)(ext_block + 1);
+		for (i = 0; i < entries && !ret; i++)
+			ret = ext4fs_extent_map_add(mapp, &extent[i]);
+
+		return ret;
+	}
+
+	/* Only the index blocks below the inode need the filesystem */
+	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	buf = memalign(ARCH_DMA_MINALIGN, blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < entries && !ret; i++) {
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf)) {
+			ret = -EIO;
+			break;
+		}
+		ret = ext4fs_extent_map_walk(mapp,
+					     (struct ext4_extent_header *)buf,
+					     depth - 1);
+	}
+	free(buf);
+
+	return ret;
+}
+
+static struct ext_extent_map *ext4fs_extent_map_build(struct ext2_inode *inode)
+{
+	struct ext4_extent_header *root;
+	struct ext_extent_map *map;
+	int depth, ret;
+
+	root = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	depth = le16_to_cpu(root->eh_depth);
+	if (depth > EXT4_MAX_EXTENT_DEPTH)
+		return NULL;
+
+	map = malloc(sizeof(*map) + 16 * sizeof(map->ext[0]));
+	if (!map)
+		return NULL;
+	map->count = 0;
+	map->alloced = 16;
+	map->last = 0;
+
+	ret = ext4fs_extent_map_walk(&map, root, depth);
+	if (ret) {
+		debug("%s: cannot map extents (err=%d)\n", __func__, ret);
+		free(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+/**
+ * ext4fs_map_block() - get the filesystem block holding a block of a file
+ *
+ * For inodes using extents, the whole extent tree is read into
+ * @node->extmap the first time this is called, so that later lookups do not
+ * need to walk the tree.
+ *
+ * @node: node of the file
+ * @fileblock: block number within the file
+ * @cache: cache for extent blocks, used if the tree cannot be mapped
+ * Return: filesystem block number, 0 for a hole, or -ve on error
+ */
+long int ext4fs_map_block(struct ext2fs_node *node, int fileblock,
+			  struct ext_block_cache *cache)
+{
+	struct ext_extent_map *map;
+	struct ext_extent_map_entry *ent;
+	int lo, hi, mid;
+
+	if (!(le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL))
+		return read_allocated_block(&node->inode, fileblock, cache);
+
+	if (!node->extmap)
+		node->extmap = ext4fs_extent_map_build(&node->inode);
+	map = node->extmap;
+	if (!map)
+		return read_allocated_block(&node->inode, fileblock, cache);
+
+	/* Try the last extent and the one after it, then search */
+	for (mid = map->last; mid < map->count && mid <= map->last + 1; mid++) {
+		ent = &map->ext[mid];
+		if (fileblock >= ent->block && fileblock < ent->block + ent->len)
+			goto found;
+	}
+
+	lo = 0;
+	hi = map->count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		ent = &map->ext[mid];
+		if (fileblock < ent->block)
+			hi = mid;
+		else if (fileblock >= ent->block + ent->len)
+			lo = mid + 1;
+		else
+			goto found;
+	}
+
+	/* Sparse file */
+	return 0;
+
+found:
+	map->last = mid;
+
+	return ent->start + (fileblock - ent->block);
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -2035,6 +2198,7 @@ void ext4fs_close(void)
 		ext4fs_file = NULL;
 	}
 	if (ext4fs_root != NULL) {
+		free(ext4fs_root->diropen.extmap);
 		free(ext4fs_root);
 		ext4fs_root = NULL;
 	}
@@ -40,8 +40,10 @@ struct ext_filesystem *get_fs(void)
 
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
-	if ((node != &ext4fs_root->diropen) && (node != currroot))
+	if ((node != &ext4fs_root->diropen) && (node != currroot)) {
+		free(node->extmap);
 		free(node);
+	}
 }
 
 /*
@@ -87,7 +89,7 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		int blockoff = pos - (blocksize * i);
 		int blockend = blocksize;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
+		blknr = ext4fs_map_block(node, i, &cache);
 		if (blknr < 0) {
 			ext_cache_fini(&cache);
 			return -1;
@@ -39,6 +39,21 @@ static void downcase(char *str, size_t len)
 static struct blk_desc *cur_dev;
 static struct disk_partition cur_part_info;
 
+/*
+ * Cluster where the last read of a file started, so that reading a file in
+ * pieces does not follow its cluster chain from the start each time. This is
+ * dropped whenever the device changes or the FAT is written.
+ *
+ * @start:	First cluster of the file, 0 if there is no hint
+ * @pos:	Offset of @clust within the file
+ * @clust:	Cluster at @pos
+ */
+static struct {
+	__u32 start;
+	loff_t pos;
+	__u32 clust;
+} fat_read_hint;
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -64,6 +79,7 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, struct disk_partition *info)
 
 	cur_dev = dev_desc;
 	cur_part_info = *info;
+	fat_read_hint.start = 0;
 
 	/* Make sure it has a valid FAT header */
 	if (disk_read(0, 1, buffer) != 1) {
@@ -157,6 +173,95 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 }
 #endif
 
+/*
+ * Allocate the FAT buffers for a filesystem, all initially empty.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_alloc_buffers(fsdata *mydata)
+{
+	int way;
+
+	mydata->fatcache = malloc_cache_aligned(FATBUFSIZE * FATBUFWAYS);
+	if (!mydata->fatcache) {
+		mydata->fatbuf = NULL;
+		return -1;
+	}
+	for (way = 0; way < FATBUFWAYS; way++) {
+		mydata->fatcachenum[way] = -1;
+		mydata->fatcacheage[way] = 0;
+	}
+	mydata->fatcachetick = 0;
+	mydata->fatbuf = mydata->fatcache;
+	mydata->fatbufnum = -1;
+	mydata->fat_dirty = 0;
+
+	return 0;
+}
+
+static void fat_free_buffers(fsdata *mydata)
+{
+	free(mydata->fatcache);
+	mydata->fatcache = NULL;
+	mydata->fatbuf = NULL;
+}
+
+/*
+ * Make block 'bufnum' of the FAT the current one in mydata->fatbuf.
+ *
+ * The last FATBUFWAYS blocks used are kept, so that following a fragmented
+ * cluster chain back and forth across the FAT does not read the same blocks
+ * again. Only the current block can be dirty: it is written back before
+ * switching to another one.
+ *
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_select_buf(fsdata *mydata, __u32 bufnum)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	__u8 *bufptr;
+	int way, lru = 0;
+
+	if (bufnum == mydata->fatbufnum)
+		return 0;
+
+	/* Write back the fatbuf to the disk */
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	for (way = 0; way < FATBUFWAYS; way++) {
+		if (mydata->fatcachenum[way] == bufnum)
+			break;
+		if (mydata->fatcacheage[way] < mydata->fatcacheage[lru])
+			lru = way;
+	}
+
+	if (way == FATBUFWAYS) {
+		/* Read a new block of FAT entries into the cache. */
+		way = lru;
+		bufptr = mydata->fatcache + way * FATBUFSIZE;
+
+		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		if (startblock + getsize > mydata->fatlength)
+			getsize = mydata->fatlength - startblock;
+
+		startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+		if (disk_read(startblock, getsize, bufptr) < 0) {
+			debug("Error reading FAT blocks\n");
+			mydata->fatcachenum[way] = -1;
+			return -1;
+		}
+		mydata->fatcachenum[way] = bufnum;
+	}
+
+	mydata->fatcacheage[way] = ++mydata->fatcachetick;
+	mydata->fatbuf = mydata->fatcache + way * FATBUFSIZE;
+	mydata->fatbufnum = bufnum;
+
+	return 0;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -194,29 +299,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_select_buf(mydata, bufnum) < 0)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
@@ -342,6 +426,11 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	debug("%llu bytes\n", filesize);
 
 	actsize = bytesperclust;
+	if (curclust && fat_read_hint.start == curclust &&
+	    fat_read_hint.pos <= pos) {
+		curclust = fat_read_hint.clust;
+		actsize += fat_read_hint.pos;
+	}
 
 	/* go to cluster at pos */
 	while (actsize <= pos) {
@@ -356,6 +445,9 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	/* actsize > pos */
 	actsize -= bytesperclust;
+	fat_read_hint.start = START(dentptr);
+	fat_read_hint.pos = actsize;
+	fat_read_hint.clust = curclust;
 	filesize -= actsize;
 	pos -= actsize;
 
@@ -427,7 +519,8 @@ getit:
 		filesize -= actsize;
 		buffer += actsize;
 
-		curclust = get_fatent(mydata, endclust);
+		/* the next extent starts where the chain broke off */
+		curclust = newclust;
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
@@ -623,10 +716,7 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_alloc_buffers(mydata) < 0) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -1178,7 +1268,7 @@ int fat_exists(const char *filename)
 		goto out;
 
 	ret = fat_itr_resolve(itr, filename, TYPE_ANY);
-	free(fsdata.fatbuf);
+	fat_free_buffers(&fsdata);
 out:
 	free(itr);
 	return ret == 0;
@@ -1225,7 +1315,7 @@ int fat_size(const char *filename, loff_t *size)
 		 * Directories don't have size, but fs_size() is not
 		 * expected to fail if passed a directory path:
 		 */
-		free(fsdata.fatbuf);
+		fat_free_buffers(&fsdata);
 		ret = fat_itr_root(itr, &fsdata);
 		if (ret)
 			goto out_free_itr;
@@ -1237,7 +1327,7 @@ int fat_size(const char *filename, loff_t *size)
 
 	*size = FAT2CPU32(itr->dent->size);
 out_free_both:
-	free(fsdata.fatbuf);
+	fat_free_buffers(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1269,7 +1359,7 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	ret = get_contents(&fsdata, dentptr, pos, buffer, maxsize, actread);
 
 out_free_both:
-	free(fsdata.fatbuf);
+	fat_free_buffers(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1328,7 +1418,7 @@ int fat_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	return 0;
 
 fail_free_both:
-	free(dir->fsdata.fatbuf);
+	fat_free_buffers(&dir->fsdata);
 fail_free_dir:
 	free(dir);
 	return ret;
@@ -1368,12 +1458,13 @@ int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
 void fat_closedir(struct fs_dir_stream *dirs)
 {
 	fat_dir *dir = (fat_dir *)dirs;
-	free(dir->fsdata.fatbuf);
+	fat_free_buffers(&dir->fsdata);
 	free(dir);
 }
 
 void fat_close(void)
 {
+	fat_read_hint.start = 0;
 }
 
 int fat_uuid(char *uuid_str)
@@ -18,6 +18,7 @@
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <image.h>
 #include <sandboxfs.h>
 #include <semihostingfs.h>
 #include <ubifs_uboot.h>
@@ -824,6 +825,110 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	return 0;
 }
 
+#if IS_ENABLED(CONFIG_CMD_ZLOAD)
+/**
+ * struct fs_stream - Feeds a file to image_decomp_stream() piece by piece
+ *
+ * The filesystem stays mounted while the file is read, so that its caches
+ * survive from one piece to the next.
+ *
+ * @strm:	Stream passed to image_decomp_stream()
+ * @info:	Filesystem to read from
+ * @filename:	File to read
+ * @pos:	Offset of the next read within the file
+ * @size:	Size of the file
+ */
+struct fs_stream {
+	struct image_stream strm;
+	struct fstype_info *info;
+	const char *filename;
+	loff_t pos;
+	loff_t size;
+};
+
+static int fs_stream_read(struct image_stream *strm, void *buf, ulong len,
+			  ulong *actread)
+{
+	struct fs_stream *fst = container_of(strm, struct fs_stream, strm);
+	loff_t len_read;
+	int ret;
+
+	if (fst->pos >= fst->size) {
+		*actread = 0;
+		return 0;
+	}
+	len = min_t(loff_t, len, fst->size - fst->pos);
+
+	ret = fst->info->read(fst->filename, buf, fst->pos, len, &len_read);
+	if (ret < 0)
+		return ret;
+	fst->pos += len_read;
+	*actread = len_read;
+
+	return 0;
+}
+
+int do_zload(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
+	     int fstype)
+{
+	struct fs_stream fst;
+	unsigned long addr, max_len, time;
+	ulong len;
+	void *buf;
+	char *ep;
+	int ret;
+
+	if (argc < 5 || argc > 6)
+		return CMD_RET_USAGE;
+
+	addr = hextoul(argv[3], &ep);
+	if (ep == argv[3] || *ep != '\0')
+		return CMD_RET_USAGE;
+	if (argc >= 6)
+		max_len = hextoul(argv[5], NULL);
+	else
+		max_len = CONFIG_SYS_BOOTM_LEN;
+
+	if (fs_set_blk_dev(argv[1], argv[2], fstype)) {
+		log_err("Can't set block device\n");
+		return 1;
+	}
+
+	memset(&fst, '\0', sizeof(fst));
+	fst.strm.read = fs_stream_read;
+	fst.info = fs_get_info(fs_type);
+	fst.filename = argv[4];
+	if (fst.info->size(fst.filename, &fst.size) < 0) {
+		fs_close();
+		log_err("Failed to load '%s'\n", fst.filename);
+		return 1;
+	}
+
+	time = get_timer(0);
+	buf = map_sysmem(addr, max_len);
+	ret = image_decomp_stream(-1, buf, max_len, &fst.strm, &len);
+	time = get_timer(time);
+	unmap_sysmem(buf);
+	fs_close();
+	if (ret) {
+		if (ret == -ENOSPC)
+			log_err("Image too large: max size %lx\n", max_len);
+		else if (ret == -EPROTONOSUPPORT)
+			log_err("Compression cannot be streamed, use 'load'\n");
+		log_err("Failed to load '%s' (err=%d)\n", fst.filename, ret);
+		return 1;
+	}
+
+	printf("%llu bytes read and %lu bytes uncompressed in %lu ms\n",
+	       fst.pos, len, time);
+
+	env_set_hex("fileaddr", addr);
+	env_set_hex("filesize", len);
+
+	return 0;
+}
+#endif
+
 int do_ls(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	  int fstype)
 {
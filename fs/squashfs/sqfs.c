@@ -94,65 +94,78 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Reads the fragment index table, i.e. the positions of the metadata blocks
+ * which make up the fragment table
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static int sqfs_read_frag_index(void)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
-
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	u64 start, n_blks, table_offset, table_size, table_start;
+	unsigned char *table;
+	int count;
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	count = DIV_ROUND_UP(get_unaligned_le32(&sblk->fragments),
+			     SQFS_MAX_ENTRIES);
+	table_size = count * sizeof(u64);
 
-	start = get_unaligned_le64(&sblk->fragment_table_start) /
-		ctxt.cur_dev->blksz;
+	table_start = get_unaligned_le64(&sblk->fragment_table_start);
+	start = table_start / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
+				  cpu_to_le64(table_start + table_size),
 				  &table_offset);
 
 	/* Allocate a proper sized buffer to store the fragment index table */
 	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!table)
+		return -ENOMEM;
 
 	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+		free(table);
+		return -EINVAL;
 	}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	ctxt.frag_index = malloc(table_size);
+	ctxt.frag_table = calloc(count, sizeof(*ctxt.frag_table));
+	if (!ctxt.frag_index || !ctxt.frag_table) {
+		free(ctxt.frag_index);
+		free(ctxt.frag_table);
+		ctxt.frag_index = NULL;
+		ctxt.frag_table = NULL;
+		free(table);
+		return -ENOMEM;
+	}
+	memcpy(ctxt.frag_index, table + table_offset, table_size);
+	free(table);
+
+	return 0;
+}
+
+/* Reads and decompresses one metadata block of the fragment table */
+static int sqfs_read_frag_table_block(int block)
+{
+	u64 start, n_blks, src_len, table_offset, start_block;
+	struct squashfs_fragment_block_entry *entries;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	unsigned char *metadata_buffer, *metadata;
+	unsigned long dest_len;
+	int ret;
+	u16 header;
 
 	/*
 	 * Get the start offset of the metadata block that contains the right
 	 * fragment block entry
 	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+	start_block = get_unaligned_le64(&ctxt.frag_index[block]);
 
 	start = start_block / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
 				  sblk->fragment_table_start, &table_offset);
 
 	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!metadata_buffer)
+		return -ENOMEM;
 
+	entries = NULL;
 	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
 		ret = -EINVAL;
 		goto out;
@@ -186,17 +199,162 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
 	}
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	ctxt.frag_table[block] = entries;
+	entries = NULL;
+	ret = 0;
 
 out:
 	free(entries);
 	free(metadata_buffer);
-	free(table);
 
 	return ret;
 }
 
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	int block, offset, ret;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
+	if (!ctxt.frag_index) {
+		ret = sqfs_read_frag_index();
+		if (ret)
+			return ret;
+	}
+
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+
+	if (!ctxt.frag_table[block]) {
+		ret = sqfs_read_frag_table_block(block);
+		if (ret)
+			return ret;
+	}
+
+	*e = ctxt.frag_table[block][offset];
+
+	return SQFS_COMPRESSED_BLOCK(e->size);
+}
+
+/*
+ * Returns the contents of a fragment block, decompressed if needed. The last
+ * few are kept, since small files sharing a fragment block tend to be read
+ * one after the other.
+ */
+static int sqfs_read_fragment(struct squashfs_fragment_block_entry *fentry,
+			      bool comp, unsigned char **datap,
+			      unsigned long *sizep)
+{
+	struct squashfs_fragment_cache *cache, *lru = &ctxt.frag_cache[0];
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_size, table_offset;
+	unsigned char *fragment, *data;
+	unsigned long dest_len;
+	int i, ret;
+
+	for (i = 0; i < SQFS_FRAGMENT_CACHE_SIZE; i++) {
+		cache = &ctxt.frag_cache[i];
+		if (cache->data && cache->start == fentry->start) {
+			cache->age = ++ctxt.frag_cache_tick;
+			*datap = cache->data;
+			*sizep = cache->size;
+			return 0;
+		}
+		if (cache->age < lru->age)
+			lru = cache;
+	}
+
+	start = lldiv(fentry->start, ctxt.cur_dev->blksz);
+	table_size = SQFS_BLOCK_SIZE(fentry->size);
+	table_offset = fentry->start - (start * ctxt.cur_dev->blksz);
+	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
+
+	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!fragment)
+		return -ENOMEM;
+
+	ret = sqfs_disk_read(start, n_blks, fragment);
+	if (ret < 0)
+		goto out;
+
+	if (comp) {
+		/* File compressed and fragmented */
+		dest_len = get_unaligned_le32(&sblk->block_size);
+		data = malloc(dest_len);
+		if (!data) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		ret = sqfs_decompress(&ctxt, data, &dest_len,
+				      fragment + table_offset, fentry->size);
+		if (ret) {
+			free(data);
+			goto out;
+		}
+	} else {
+		dest_len = table_size;
+		data = malloc(dest_len);
+		if (!data) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		memcpy(data, fragment + table_offset, dest_len);
+	}
+
+	free(lru->data);
+	lru->start = fentry->start;
+	lru->size = dest_len;
+	lru->data = data;
+	lru->age = ++ctxt.frag_cache_tick;
+	*datap = data;
+	*sizep = dest_len;
+	ret = 0;
+
+out:
+	free(fragment);
+
+	return ret;
+}
+
+static void sqfs_free_cache(void)
+{
+	int i, count;
+
+	free(ctxt.inode_table);
+	free(ctxt.dir_table);
+	free(ctxt.dir_pos_list);
+	ctxt.inode_table = NULL;
+	ctxt.dir_table = NULL;
+	ctxt.dir_pos_list = NULL;
+	ctxt.dir_metablks_count = 0;
+
+	if (ctxt.frag_table) {
+		count = DIV_ROUND_UP(get_unaligned_le32(&ctxt.sblk->fragments),
+				     SQFS_MAX_ENTRIES);
+		for (i = 0; i < count; i++)
+			free(ctxt.frag_table[i]);
+	}
+	free(ctxt.frag_table);
+	free(ctxt.frag_index);
+	ctxt.frag_table = NULL;
+	ctxt.frag_index = NULL;
+
+	for (i = 0; i < SQFS_FRAGMENT_CACHE_SIZE; i++) {
+		free(ctxt.frag_cache[i].data);
+		ctxt.frag_cache[i].data = NULL;
+		ctxt.frag_cache[i].age = 0;
+	}
+	ctxt.frag_cache_tick = 0;
+}
+
 /*
  * The entry name is a flexible array member, and we don't know its size before
  * actually reading the entry. So we need a first copy to retrieve this size so
@@ -874,11 +1032,9 @@ out:
 
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
 	int j, token_count = 0, ret = 0, metablks_count;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
@@ -891,17 +1047,25 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
+	/* The tables are kept until sqfs_close(), so only read them once */
+	if (!ctxt.inode_table) {
+		ret = sqfs_read_inode_table(&ctxt.inode_table);
+		if (ret) {
+			ret = -EINVAL;
+			goto out;
+		}
 	}
 
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto out;
+	if (!ctxt.dir_table) {
+		metablks_count = sqfs_read_directory_table(&ctxt.dir_table,
+							   &ctxt.dir_pos_list);
+		if (metablks_count < 1) {
+			ret = -EINVAL;
+			goto out;
+		}
+		ctxt.dir_metablks_count = metablks_count;
 	}
+	metablks_count = ctxt.dir_metablks_count;
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
@@ -930,9 +1094,9 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	 * ldir's (extended directory) size is greater than dir, so it works as
 	 * a general solution for the malloc size, since 'i' is a union.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
+	dirs->inode_table = ctxt.inode_table;
+	dirs->dir_table = ctxt.dir_table;
+	ret = sqfs_search_dir(dirs, token_list, token_count, ctxt.dir_pos_list,
 			      metablks_count);
 	if (ret)
 		goto out;
@@ -957,12 +1121,9 @@ out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 	free(path);
-	if (ret) {
-		free(inode_table);
+	if (ret)
 		free(dirs);
-	}
 
 	return ret;
 }
@@ -1087,6 +1248,10 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 	struct squashfs_super_block *sblk;
 	int ret;
 
+	/* Drop anything cached from a previous mount */
+	if (ctxt.sblk)
+		sqfs_free_cache();
+
 	ctxt.cur_dev = fs_dev_desc;
 	ctxt.cur_part_info = *fs_partition;
 
@@ -1314,8 +1479,8 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	      loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
+	char *dir = NULL, *datablock = NULL, *file = NULL, *resolved, *data;
+	unsigned char *fragment_block;
 	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
 	int ret, j, i_number, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
@@ -1520,53 +1685,20 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-	if (!fragment) {
-		ret = -ENOMEM;
+	ret = sqfs_read_fragment(&frag_entry, finfo.comp, &fragment_block,
+				 &dest_len);
+	if (ret)
 		goto out;
-	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	if (finfo.offset + finfo.size - *actread > dest_len) {
+		ret = -EINVAL;
 		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
 	}
 
+	memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
+	*actread = finfo.size;
+
 out:
-	free(fragment);
 	free(datablock);
 	free(file);
 	free(dir);
@@ -1705,6 +1837,7 @@ free_strings:
 
 void sqfs_close(void)
 {
+	sqfs_free_cache();
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
@@ -1719,8 +1852,6 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
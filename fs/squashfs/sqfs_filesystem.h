@@ -73,6 +73,22 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/* Number of decompressed fragment blocks kept in memory */
+#define SQFS_FRAGMENT_CACHE_SIZE 2
+
+struct squashfs_fragment_block_entry;
+
+/*
+ * A decompressed fragment block. 'data' is NULL if the entry is unused, 'age'
+ * is used to find the least recently used entry.
+ */
+struct squashfs_fragment_cache {
+	u64 start;
+	unsigned long size;
+	unsigned char *data;
+	u32 age;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
@@ -80,6 +96,19 @@ struct squashfs_ctxt {
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	/*
+	 * Decompressed metadata, read on first use and freed in sqfs_close(),
+	 * so that it is not read again for every file looked up.
+	 */
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	u32 *dir_pos_list;
+	int dir_metablks_count;
+	/* Fragment index, and the fragment table blocks which were used */
+	u64 *frag_index;
+	struct squashfs_fragment_block_entry **frag_table;
+	struct squashfs_fragment_cache frag_cache[SQFS_FRAGMENT_CACHE_SIZE];
+	u32 frag_cache_tick;
 };
 
 struct squashfs_directory_index {
@@ -274,7 +303,8 @@ struct squashfs_dir_stream {
 	struct squashfs_ldir_inode i_ldir;
 	/*
 	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * sqfs_opendir() and belong to the mount context, which frees them in
+	 * sqfs_close().
 	 */
 	unsigned char *inode_table;
 	unsigned char *dir_table;
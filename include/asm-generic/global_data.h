@@ -226,6 +226,27 @@ struct global_data {
 	 */
 	void *dm_priv_base;
 # endif
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/**
+	 * @dm_compat_index: index of driver compatible strings, NULL if
+	 * not built yet, or an error pointer if it could not be built
+	 */
+	struct dm_compat_index *dm_compat_index;
+#endif
+#if CONFIG_IS_ENABLED(DM_DEFER_BIND)
+	/**
+	 * @dm_defer: nodes whose binding is deferred, or NULL if binding
+	 * is not being deferred
+	 */
+	struct dm_defer_state *dm_defer;
+#endif
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+	/**
+	 * @dm_probe_pending: number of devices which have started probing
+	 * but are not ready yet
+	 */
+	int dm_probe_pending;
+#endif
 #endif
 #ifdef CONFIG_TIMER
 	/**
@@ -513,6 +534,22 @@ static_assert(sizeof(struct global_data) == GD_SIZE);
 #define gd_dm_driver_rt()		NULL
 #endif
 
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+#define gd_dm_compat_index()		gd->dm_compat_index
+#define gd_set_dm_compat_index(idx)	gd->dm_compat_index = idx
+#else
+#define gd_dm_compat_index()		NULL
+#define gd_set_dm_compat_index(idx)
+#endif
+
+#if CONFIG_IS_ENABLED(DM_DEFER_BIND)
+#define gd_dm_defer()			gd->dm_defer
+#define gd_set_dm_defer(state)		gd->dm_defer = state
+#else
+#define gd_dm_defer()			NULL
+#define gd_set_dm_defer(state)
+#endif
+
 #if CONFIG_IS_ENABLED(OF_PLATDATA_RT)
 #define gd_set_dm_udevice_rt(dyn)	gd->dm_udevice_rt = dyn
 #define gd_dm_udevice_rt()		gd->dm_udevice_rt
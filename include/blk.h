@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -119,6 +120,25 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/**
+ * blkcache_read_dev() - read a set of blocks through the block cache
+ *
+ * Blocks which are cached are copied from the cache. Small reads which miss
+ * are widened to whole cache entries, so that the adjacent blocks are read
+ * ahead and cached too. Large reads bypass the cache.
+ *
+ * This is only available with CONFIG_BLOCK_CACHE
+ *
+ * @param desc - block device descriptor
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to read
+ * @param buffer - buffer to contain the data
+ *
+ * Return: number of blocks read, or -ve error number from the driver
+ */
+ulong blkcache_read_dev(struct blk_desc *desc, lbaint_t start,
+			lbaint_t blkcnt, void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 
 /**
@@ -158,6 +178,23 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_write() - update the block cache after a write to the device
+ *
+ * Any cached copies of the blocks are updated, so the cache does not need
+ * to be discarded.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks written
+ * @param blksz - size in bytes of each block
+ * @param buffer - buffer containing the data written
+ */
+void blkcache_write(int iftype, int dev,
+		    lbaint_t start, lbaint_t blkcnt,
+		    unsigned long blksz, void const *buffer);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -172,8 +209,9 @@ void blkcache_invalidate(int iftype, int dev);
  *
  * @param blocks - maximum blocks per entry
  * @param entries - maximum entries in cache
+ * @param bytes - maximum number of bytes of data in cache
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned blocks, unsigned entries, ulong bytes);
 
 /*
  * statistics of the block cache
@@ -181,9 +219,12 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned evictions;
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	ulong bytes; /* current size of cached data */
+	ulong max_bytes;
 };
 
 /**
@@ -206,6 +247,10 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline void blkcache_write(int iftype, int dev,
+				  lbaint_t start, lbaint_t blkcnt,
+				  unsigned long blksz, void const *buffer) {}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -213,6 +258,42 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/**
+ * struct blk_req - an asynchronous block transfer
+ *
+ * The submitter fills in everything up to @priv and passes the request to
+ * blk_submit(). The request must stay valid until it completes.
+ *
+ * @dev:	Block device to access
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Data buffer
+ * @write:	true to write @buffer to the device, false to read into it
+ * @done:	Called when the request completes, or NULL. This is always
+ *		called from blk_poll(), never from the driver directly
+ * @priv:	Private data for the submitter
+ * @result:	Number of blocks transferred, or -ve error number, once
+ *		complete
+ * @complete:	true once the request has completed
+ * @drv_data:	For use by the driver while the request is in flight
+ * @sibling:	Owned by the driver while the request is in flight, then used
+ *		by the uclass to hold it until the completion is reported
+ */
+struct blk_req {
+	struct udevice *dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool write;
+	void (*done)(struct blk_req *req);
+	void *priv;
+
+	long result;
+	bool complete;
+	ulong drv_data;
+	struct list_head sibling;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -271,10 +352,107 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous transfer
+	 *
+	 * This is optional. Without it, blk_submit() carries out the
+	 * transfer synchronously using read() or write(). A driver which
+	 * provides it must also provide poll(), else it fails to probe.
+	 *
+	 * The driver must call blk_req_done() once the transfer finishes,
+	 * normally from its poll() method. It is never asked to have more
+	 * requests in flight than set by blk_set_queue_depth().
+	 *
+	 * @dev:	Device to access
+	 * @req:	Request to start
+	 * @return 0 if started, -EAGAIN if the driver cannot accept another
+	 * request until one completes, -ENOSYS to have the uclass carry out
+	 * this request synchronously, other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - check for finished asynchronous transfers
+	 *
+	 * This calls blk_req_done() for each request which has finished. It
+	 * must not wait for transfers which are still in progress. It is
+	 * required if submit() is provided.
+	 *
+	 * @dev:	Device to check
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
 
+/**
+ * blk_submit() - start an asynchronous transfer
+ *
+ * If the device's queue is full, this waits until the driver has finished an
+ * earlier request. Devices without native support complete the transfer
+ * before this returns, but the callback is still only called from blk_poll().
+ * This never runs completion callbacks itself, so a callback may use it to
+ * start another transfer. Callbacks must not wait for transfers though, e.g.
+ * with blk_wait(), blk_drain() or blk_dread().
+ *
+ * @req:	Request to start, see struct blk_req for the fields to set
+ * Return: 0 if started, -ve on error (the request is then not queued)
+ */
+int blk_submit(struct blk_req *req);
+
+/**
+ * blk_poll() - report completed transfers
+ *
+ * Checks the device for finished transfers and calls the completion callback
+ * of each request which has finished.
+ *
+ * @dev:	Block device to check
+ * Return: number of requests still in flight, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - wait for a request to complete
+ *
+ * @req:	Request to wait for
+ * Return: number of blocks transferred, or -ve error number
+ */
+long blk_wait(struct blk_req *req);
+
+/**
+ * blk_drain() - wait for all requests on a device to complete
+ *
+ * blk_dread(), blk_dwrite() and blk_derase() do this first, so that
+ * synchronous and asynchronous transfers are never in flight together.
+ *
+ * @dev:	Block device to drain
+ * Return: 0 if OK, -ve on error
+ */
+int blk_drain(struct udevice *dev);
+
+/**
+ * blk_req_done() - mark a request as finished
+ *
+ * This is for use by drivers. The completion callback runs from the next
+ * blk_poll().
+ *
+ * @req:	Request which has finished
+ * @result:	Number of blocks transferred, or -ve error number
+ */
+void blk_req_done(struct blk_req *req, long result);
+
+/**
+ * blk_set_queue_depth() - set how many requests a device can have in flight
+ *
+ * The default is one. Drivers normally call this from their probe() method.
+ *
+ * @dev:	Block device
+ * @depth:	Maximum number of requests the driver accepts at once
+ */
+void blk_set_queue_depth(struct udevice *dev, uint depth);
+
 /*
  * These functions should take struct udevice instead of struct blk_desc,
  * but this is convenient for migration to driver model. Add a 'd' prefix
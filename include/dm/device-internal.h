@@ -192,6 +192,57 @@ int device_of_to_plat(struct udevice *dev);
  */
 int device_probe(struct udevice *dev);
 
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+/**
+ * device_probe_async() - Start probing a device, without waiting for it
+ *
+ * This is like device_probe() except that if the driver's probe() method
+ * returns -EINPROGRESS, the device is left pending (DM_FLAG_PROBE_PENDING).
+ * Its probe_poll() method is then called when device_probe() is next called
+ * on the device, e.g. when it is first used, or by device_poll_pending().
+ *
+ * Before relocation this is the same as device_probe()
+ *
+ * @dev: Pointer to device to probe
+ * Return: 0 if OK or pending, -ve on error
+ */
+int device_probe_async(struct udevice *dev);
+
+/**
+ * device_probe_join() - Wait for a device to finish probing
+ *
+ * While waiting, other pending devices are polled as well
+ *
+ * @dev: Device to wait for
+ * Return: 0 if OK, if the device is not pending or if called while its
+ *	probe_poll() method is running, -ve on error, in which case the device
+ *	is no longer active
+ */
+int device_probe_join(struct udevice *dev);
+
+/**
+ * device_poll_pending() - Poll each device which is still probing once
+ *
+ * Return: number of devices still pending
+ */
+int device_poll_pending(void);
+#else
+static inline int device_probe_async(struct udevice *dev)
+{
+	return device_probe(dev);
+}
+
+static inline int device_probe_join(struct udevice *dev)
+{
+	return 0;
+}
+
+static inline int device_poll_pending(void)
+{
+	return 0;
+}
+#endif
+
 /**
  * device_remove() - Remove a device, de-activating it
  *
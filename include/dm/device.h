@@ -84,6 +84,12 @@ struct driver_info;
 /* Device must be probed after it was bound */
 #define DM_FLAG_PROBE_AFTER_BIND	(1 << 15)
 
+/* Device has started probing but is not ready yet, see driver->probe_poll */
+#define DM_FLAG_PROBE_PENDING		(1 << 16)
+
+/* Device's probe_poll() method is running */
+#define DM_FLAG_PROBE_POLLING		(1 << 17)
+
 /*
  * One or multiple of these flags are passed to device_remove() so that
  * a selective device removal as specified by the remove-stage and the
@@ -366,6 +372,11 @@ struct udevice_id {
  * @flags: driver flags - see `DM_FLAGS_...`
  * @acpi_ops: Advanced Configuration and Power Interface (ACPI) operations,
  * allowing the device to add things to the ACPI tables passed to Linux
+ * @probe_poll: Called to finish probing a device whose probe() method returned
+ * -EINPROGRESS, after starting something slow such as bringing up a link. It
+ * is called repeatedly, while other devices make progress, until it returns
+ * something other than -EAGAIN: 0 when the device is ready, or an error. Use
+ * PROBE_POLL_PTR() to set this.
  */
 struct driver {
 	char *name;
@@ -388,8 +399,18 @@ struct driver {
 #if CONFIG_IS_ENABLED(ACPIGEN)
 	struct acpi_ops *acpi_ops;
 #endif
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+	int (*probe_poll)(struct udevice *dev);
+#endif
 };
 
+/* Allow the probe_poll() method to be optional */
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+#define PROBE_POLL_PTR(_fn)	.probe_poll	= _fn,
+#else
+#define PROBE_POLL_PTR(_fn)
+#endif
+
 /**
  * U_BOOT_DRIVER() - Declare a new U-Boot driver
  * @__name: name of the driver
@@ -64,6 +64,21 @@ int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
 int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		   struct driver *drv, bool pre_reloc_only);
 
+/**
+ * lists_ofnode_uclasses() - Find the uclasses a node may be bound in
+ *
+ * This finds the driver for each of the node's compatible strings, as
+ * lists_bind_fdt() would try them.
+ *
+ * @node: device tree node to check
+ * @pre_reloc_only: If true, consider binding only as lists_bind_fdt() would
+ * before relocation
+ * @uclasses: Bitmap of UCLASS_COUNT bits; the bit for the uclass of each driver
+ * found is set
+ * Return: 0 if a driver was found, -ENOENT if the node would not be bound
+ */
+int lists_ofnode_uclasses(ofnode node, bool pre_reloc_only, ulong *uclasses);
+
 /**
  * device_bind_driver() - bind a device to a driver
  *
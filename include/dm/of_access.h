@@ -255,9 +255,24 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 					       const char *propname,
 					       const void *propval,
 					       int proplen);
+/**
+ * of_build_phandle_table() - Build a table for looking up phandles
+ *
+ * This allows of_find_node_by_phandle() to find most nodes in @root without
+ * searching the tree. It replaces any table built before.
+ *
+ * @root:	Root of the tree to index, which must be the control tree, or
+ *		NULL to drop the table so that every lookup searches the tree
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int of_build_phandle_table(struct device_node *root);
+
 /**
  * of_find_node_by_phandle() - Find a node given a phandle
  *
+ * This uses the table from of_build_phandle_table() if it is for the current
+ * control tree, else searches the whole tree.
+ *
  * @handle:	phandle of the node to find
  *
  * Return: node pointer, or NULL if not found
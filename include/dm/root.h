@@ -9,7 +9,12 @@
 #ifndef _DM_ROOT_H_
 #define _DM_ROOT_H_
 
+#include <dm/ofnode_decl.h>
 #include <dm/tag.h>
+#include <dm/uclass-id.h>
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/list.h>
 
 struct udevice;
 
@@ -123,6 +128,18 @@ int dm_extended_scan(bool pre_reloc_only);
  */
 int dm_scan_other(bool pre_reloc_only);
 
+/**
+ * dm_probe_devices() - Probe devices which ask to be probed once bound
+ *
+ * Probes @dev and its descendants which have the DM_FLAG_PROBE_AFTER_BIND
+ * flag, as is done after scanning for devices
+ *
+ * @dev: Device to start from
+ * @pre_reloc_only: If true, only probe devices with the DM_FLAG_PRE_RELOC flag
+ * Return: 0 if OK, -ve on error
+ */
+int dm_probe_devices(struct udevice *dev, bool pre_reloc_only);
+
 /**
  * dm_init_and_scan() - Initialise Driver Model structures and scan for devices
  *
@@ -186,4 +203,102 @@ void dm_get_stats(int *device_countp, int *uclass_countp);
  */
 void dm_get_mem(struct dm_stats *stats);
 
+/**
+ * struct dm_defer_state - Nodes whose binding is deferred
+ *
+ * @nodes: Nodes not bound yet (struct dm_deferred_node)
+ * @deferred: Number of nodes deferred so far
+ * @bound: Number of those which have since been bound
+ * @time_us: Time spent binding them
+ * @depth: Number of calls binding deferred nodes in progress
+ * @done: Bitmap of uclasses for which all the deferred nodes are bound
+ */
+struct dm_defer_state {
+	struct list_head nodes;
+	int deferred;
+	int bound;
+	ulong time_us;
+	int depth;
+	ulong done[BITS_TO_LONGS(UCLASS_COUNT)];
+};
+
+#if CONFIG_IS_ENABLED(DM_DEFER_BIND)
+/**
+ * dm_set_defer_bind() - Select whether to defer binding devices
+ *
+ * When deferring, the nodes at the top level of the device tree and those in
+ * simple buses are not bound when they are scanned. Each is bound instead
+ * when something looks for a device which it or one of its subnodes could
+ * provide, either in a uclass or by ofnode.
+ *
+ * Stopping binds nothing: any nodes still deferred are forgotten.
+ *
+ * @defer: true to defer binding nodes scanned from now on, false to stop
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int dm_set_defer_bind(bool defer);
+
+/**
+ * dm_defer_state() - Get the state of deferred binding
+ *
+ * Return: state, or NULL if binding is not being deferred
+ */
+struct dm_defer_state *dm_defer_state(void);
+
+/**
+ * dm_defer_node() - Defer binding a node, if binding is being deferred
+ *
+ * @parent: Device to bind the node under
+ * @node: Node to defer
+ * @pre_reloc_only: If true, bind the node only if it has special devicetree
+ *	properties or its driver has the DM_FLAG_PRE_RELOC flag
+ * Return: 0 if deferred, -EAGAIN if the caller should bind it now, other -ve
+ *	on error
+ */
+int dm_defer_node(struct udevice *parent, ofnode node, bool pre_reloc_only);
+
+/**
+ * dm_bind_deferred() - Bind the deferred nodes which may hold some devices
+ *
+ * @id: Uclass of the devices being looked for
+ */
+void dm_bind_deferred(enum uclass_id id);
+
+/**
+ * dm_bind_deferred_node() - Bind a node if it is deferred
+ *
+ * This also binds any deferred node that @node is in
+ *
+ * @node: Node being looked for
+ */
+void dm_bind_deferred_node(ofnode node);
+
+/**
+ * dm_defer_drop() - Forget the deferred nodes for a device being unbound
+ *
+ * @parent: Device being unbound
+ */
+void dm_defer_drop(struct udevice *parent);
+#else
+static inline int dm_set_defer_bind(bool defer)
+{
+	return defer ? -ENOSYS : 0;
+}
+
+static inline struct dm_defer_state *dm_defer_state(void)
+{
+	return NULL;
+}
+
+static inline int dm_defer_node(struct udevice *parent, ofnode node,
+				bool pre_reloc_only)
+{
+	return -EAGAIN;
+}
+
+static inline void dm_bind_deferred(enum uclass_id id) {}
+static inline void dm_bind_deferred_node(ofnode node) {}
+static inline void dm_defer_drop(struct udevice *parent) {}
+#endif
+
 #endif
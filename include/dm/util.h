@@ -57,6 +57,14 @@ void dm_dump_static_driver_info(void);
  */
 void dm_dump_mem(struct dm_stats *stats);
 
+/**
+ * dm_dump_defer() - Dump stats on deferred binding
+ *
+ * This shows how many devices are bound and probed, and if binding is being
+ * deferred, how many nodes were deferred and how many have been bound since
+ */
+void dm_dump_defer(void);
+
 #if CONFIG_IS_ENABLED(OF_PLATDATA_INST) && CONFIG_IS_ENABLED(READ_ONLY)
 void *dm_priv_to_rw(void *priv);
 #else
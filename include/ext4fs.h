@@ -33,6 +33,7 @@ struct disk_partition;
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_MAX_EXTENT_DEPTH		5
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM 0x0400
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
@@ -125,6 +126,27 @@ struct ext_block_cache {
 	int size;
 };
 
+/**
+ * struct ext_extent_map - extent tree of an inode, flattened into one array
+ *
+ * This avoids walking the extent tree for every block of a file read.
+ *
+ * @count: number of extents in @ext
+ * @alloced: number of extents allocated in @ext
+ * @last: index of the extent last looked up, since reads are sequential
+ * @ext: extents, sorted by logical block
+ */
+struct ext_extent_map {
+	int count;
+	int alloced;
+	int last;
+	struct ext_extent_map_entry {
+		u32 block;	/* first logical block */
+		u32 len;	/* number of blocks */
+		u64 start;	/* first physical block */
+	} ext[];
+};
+
 extern struct ext2_data *ext4fs_root;
 extern struct ext2fs_node *ext4fs_file;
 
@@ -157,6 +179,8 @@ int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, struct disk_partition *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache);
+long int ext4fs_map_block(struct ext2fs_node *node, int fileblock,
+			  struct ext_block_cache *cache);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 struct disk_partition *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -198,11 +198,14 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+struct ext_extent_map;
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext_extent_map *extmap;	/* Built on first read, may be NULL */
 };
 
 /* Information about a "mounted" ext2 filesystem. */
@@ -44,6 +44,9 @@ enum {
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 	FASTBOOT_COMMAND_OEM_BOOTBUS,
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	FASTBOOT_COMMAND_OEM_STREAM,
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	FASTBOOT_COMMAND_ACMD,
 	FASTBOOT_COMMAND_UCMD,
@@ -164,6 +167,36 @@ u32 fastboot_data_remaining(void);
 void fastboot_data_download(const void *fastboot_data,
 			    unsigned int fastboot_data_len, char *response);
 
+/**
+ * fastboot_data_buf() - Find where the next download data should go
+ *
+ * A transport which can receive straight into memory uses this instead of
+ * fastboot_data_download(), then calls fastboot_data_received() once the
+ * data is there.
+ *
+ * @len: Returns the number of bytes which may be placed there. This is less
+ * than fastboot_data_remaining() when the download is streamed to flash
+ * Return: Pointer to place the data
+ */
+void *fastboot_data_buf(u32 *len);
+
+/**
+ * fastboot_data_received() - Account for data placed by the transport
+ *
+ * @len: Number of bytes placed at fastboot_data_buf()
+ * @response: Pointer to fastboot response buffer, set on failure
+ */
+void fastboot_data_received(u32 len, char *response);
+
+/**
+ * fastboot_data_flush() - Write any complete part of a streamed download
+ *
+ * When a download is streamed to flash this writes whatever part of the
+ * buffer has filled up. A transport which can receive while this happens
+ * should start receiving the next data first. Otherwise this does nothing.
+ */
+void fastboot_data_flush(void);
+
 /**
  * fastboot_data_complete() - Mark current transfer complete
  *
@@ -26,6 +26,11 @@ struct disk_partition;
 			 sizeof(dir_entry))
 
 #define FATBUFBLOCKS	6
+#if CONFIG_IS_ENABLED(FS_FAT)
+#define FATBUFWAYS	CONFIG_VAL(FS_FAT_CACHE_WAYS)
+#else
+#define FATBUFWAYS	1
+#endif
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -178,6 +183,10 @@ typedef struct {
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	__u8	*fatcache;	/* FATBUFWAYS buffers, fatbuf is one of them */
+	int	fatcachenum[FATBUFWAYS];	/* FAT block held by each buffer */
+	__u32	fatcacheage[FATBUFWAYS];	/* Last use of each buffer */
+	__u32	fatcachetick;	/* Incremented on each buffer switch */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
@@ -39,4 +39,33 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_start() - Start writing an image to eMMC as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @response: Pointer to fastboot response buffer, set on failure
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * @data: Data following what was used by the last call
+ * @len: Number of bytes at @data
+ * @last: true if this is the end of the image
+ * @response: Pointer to fastboot response buffer, set on failure
+ * Return: number of bytes used, or -ve on error. Unless @last is true, some
+ * bytes may be left over, for the caller to pass again with what follows
+ */
+long fastboot_mmc_stream_write(const void *data, u32 len, bool last,
+			       char *response);
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @response: Pointer to fastboot response buffer, set to OKAY or FAIL
+ */
+void fastboot_mmc_stream_finish(char *response);
 #endif
@@ -695,6 +695,19 @@ int fdtdec_get_chosen_node(const void *blob, const char *name);
  */
 const char *fdtdec_get_compatible(enum fdt_compat_id id);
 
+/**
+ * fdtdec_node_offset_by_phandle() - Find a node given a phandle
+ *
+ * This is like fdt_node_offset_by_phandle(), but after relocation it keeps an
+ * index of the phandles in the control FDT, so that most lookups do not need
+ * to search the whole tree.
+ *
+ * @blob:	FDT blob
+ * @phandle:	phandle of the node to find
+ * Return: offset of the node, or -ve FDT_ERR_... on error
+ */
+int fdtdec_node_offset_by_phandle(const void *blob, uint32_t phandle);
+
 /* Look up a phandle and follow it to its node. Then return the offset
  * of that node.
  *
@@ -40,3 +40,63 @@ static inline int is_sparse_image(void *buf)
 
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
+
+/**
+ * struct sparse_stream - A sparse image being written as it arrives
+ *
+ * @info:	Storage the image is written to
+ * @header:	Image header, once it has arrived
+ * @chunk:	Header of the chunk being written
+ * @state:	Which part of the image comes next
+ * @chunk_num:	Number of the chunk being written
+ * @left:	Bytes of the chunk's data still to come
+ * @blk:	Next block to write
+ * @bytes_written: Bytes written to storage so far
+ * @total_blocks: Image blocks accounted for so far
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	sparse_header_t header;
+	chunk_header_t chunk;
+	int state;
+	unsigned int chunk_num;
+	u64 left;
+	lbaint_t blk;
+	u64 bytes_written;
+	u32 total_blocks;
+};
+
+/**
+ * sparse_stream_start() - Start writing a sparse image a piece at a time
+ *
+ * @ss:		Stream to set up
+ * @info:	Storage to write the image to
+ */
+void sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info);
+
+/**
+ * sparse_stream_write() - Write the next piece of a sparse image
+ *
+ * Writes as much of @data as it can. Headers and raw data which are not
+ * yet complete are left for the caller to pass again, with what follows
+ * them, in the next call. Raw data is written in whole storage blocks.
+ *
+ * @ss:		Stream being written
+ * @data:	Data following what was used by the last call
+ * @len:	Number of bytes at @data
+ * @response:	Fastboot response, set on failure
+ * Return: number of bytes used from @data, or -1 on failure
+ */
+long sparse_stream_write(struct sparse_stream *ss, const void *data,
+			 size_t len, char *response);
+
+/**
+ * sparse_stream_finish() - Check that the whole sparse image was written
+ *
+ * @ss:		Stream being written
+ * @part_name:	Name of the partition, for the message
+ * @response:	Fastboot response, set on failure
+ * Return: 0 if OK, -1 if the image was incomplete or inconsistent
+ */
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response);
@@ -854,6 +854,40 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * struct image_stream - Source of data for image_decomp_stream()
+ *
+ * @read:	Read up to @len bytes of compressed data into @buf. Reads are
+ *		sequential. A short read is fine; @actread is set to 0 at the
+ *		end of the data. Returns 0 if OK, -ve on error
+ * @priv:	Private data for the caller
+ */
+struct image_stream {
+	int (*read)(struct image_stream *strm, void *buf, ulong len,
+		    ulong *actread);
+	void *priv;
+};
+
+/**
+ * image_decomp_stream() - decompress an image while reading it
+ *
+ * Unlike image_decomp() this does not need the compressed image in memory.
+ * The data is pulled from @strm in CONFIG_IMAGE_DECOMP_STREAM_CHUNK pieces
+ * and decompressed straight to @load_buf. lz4 data is decompressed a block
+ * at a time, so the buffer grows to hold the largest block the frame allows.
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...), or -1 to
+ *		detect it from the start of the data
+ * @load_buf:	Place to decompress to
+ * @unc_len:	Available space for decompression
+ * @strm:	Source of the compressed data
+ * @lenp:	Returns the number of bytes written to @load_buf
+ * Return: 0 if OK, -EPROTONOSUPPORT if the algorithm cannot be streamed,
+ * -ENOSPC if @unc_len is too small, other -ve value on error
+ */
+int image_decomp_stream(int comp, void *load_buf, ulong unc_len,
+			struct image_stream *strm, ulong *lenp);
+
 /**
  * Set up properties in the FDT
  *
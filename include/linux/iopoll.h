@@ -10,6 +10,7 @@
 #include <linux/errno.h>
 #include <linux/io.h>
 #include <time.h>
+#include <uthread.h>
 
 /**
  * read_poll_timeout - Periodically poll an address until a condition is met or a timeout occurs
@@ -39,6 +40,8 @@
 		} \
 		if (sleep_us) \
 			udelay(sleep_us); \
+		else \
+			uthread_schedule(); \
 	} \
 	(cond) ? 0 : -ETIMEDOUT; \
 })
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * IPv6 neighbour discovery (RFC 4861)
+ *
+ * This finds the MAC address of neighbours, much as ARP does for IPv4, and
+ * answers neighbours looking for us. The addresses found are kept in a small
+ * cache for the rest of the network operation. Router advertisements give us
+ * a global address (SLAAC, RFC 4862) and a default router.
+ */
+
+#ifndef __NDISC_H__
+#define __NDISC_H__
+
+#include <net6.h>
+
+/* Option types */
+#define ND_OPT_SOURCE_LL_ADDR	1
+#define ND_OPT_TARGET_LL_ADDR	2
+#define ND_OPT_PREFIX_INFO	3
+
+/* Length of a link-layer address option, in units of 8 bytes */
+#define ND_OPT_LLADDR_LEN	1
+#define ND_OPT_LLADDR_SIZE	(ND_OPT_LLADDR_LEN * 8)
+
+/* Flags in a neighbour advertisement */
+#define ND_NA_FLAG_ROUTER	0x80000000
+#define ND_NA_FLAG_SOLICITED	0x40000000
+#define ND_NA_FLAG_OVERRIDE	0x20000000
+
+/* Flags in a prefix information option */
+#define ND_OPT_PI_FLAG_ONLINK	0x80
+#define ND_OPT_PI_FLAG_AUTO	0x40
+
+/* Number of neighbours remembered */
+#define NDISC_CACHE_SIZE	8
+/* Time between router solicitations, and how many to send (RFC 4861) */
+#define NDISC_RS_INTERVAL	4000UL
+#define NDISC_RS_COUNT		3
+
+/**
+ * struct nd_msg - Neighbour solicitation or advertisement
+ *
+ * @icmph:	ICMPv6 header, whose last four bytes hold the flags
+ * @target:	Address being looked for, or advertised
+ * @opt:	Options, normally the link-layer address of the sender
+ */
+struct nd_msg {
+	struct icmp6_hdr	icmph;
+	struct in6_addr		target;
+	u8			opt[];
+} __packed;
+
+/**
+ * struct rs_msg - Router solicitation
+ *
+ * @icmph:	ICMPv6 header
+ * @opt:	Options, normally our link-layer address
+ */
+struct rs_msg {
+	struct icmp6_hdr	icmph;
+	u8			opt[];
+} __packed;
+
+/**
+ * struct ra_msg - Router advertisement
+ *
+ * @icmph:	ICMPv6 header: hop limit, flags and router lifetime in seconds
+ * @reachable_time: Time a neighbour is thought reachable after a reply (ms)
+ * @retrans_timer: Time between neighbour solicitations (ms)
+ * @opt:	Options, such as prefix information
+ */
+struct ra_msg {
+	struct icmp6_hdr	icmph;
+	__be32			reachable_time;
+	__be32			retrans_timer;
+	u8			opt[];
+} __packed;
+
+/**
+ * struct nd_opt_prefix_info - Prefix information option
+ *
+ * @type:	ND_OPT_PREFIX_INFO
+ * @len:	Length in units of 8 bytes (4)
+ * @prefix_len:	Number of valid leading bits in @prefix
+ * @flags:	ND_OPT_PI_FLAG_...
+ * @valid_lifetime: Time the prefix is valid for (s)
+ * @preferred_lifetime: Time addresses made from the prefix are preferred (s)
+ * @reserved:	Reserved, zero
+ * @prefix:	The prefix
+ */
+struct nd_opt_prefix_info {
+	u8			type;
+	u8			len;
+	u8			prefix_len;
+	u8			flags;
+	__be32			valid_lifetime;
+	__be32			preferred_lifetime;
+	__be32			reserved;
+	struct in6_addr		prefix;
+} __packed;
+
+/* Address of a neighbour we are waiting to hear from, zero if none */
+extern struct in6_addr net_nd_sol_packet_ip6;
+/* Next hop of the waiting packet, which may be a router */
+extern struct in6_addr net_nd_rep_packet_ip6;
+/* MAC address to fill in when the neighbour replies */
+extern uchar *net_nd_packet_mac;
+/* Size of the packet in net_tx_packet waiting to be sent */
+extern int net_nd_tx_packet_size;
+extern ulong net_nd_timer_start;
+extern int net_nd_try;
+
+/**
+ * ndisc_init() - Set up neighbour discovery (once, from net_init())
+ */
+void ndisc_init(void);
+
+/**
+ * ndisc_flush() - Forget all neighbours and any packet waiting to be sent
+ */
+void ndisc_flush(void);
+
+/**
+ * ndisc_lookup() - Look up a neighbour in the cache
+ *
+ * @ip6:	Address of the neighbour
+ * @enetaddr:	Returns its MAC address if found
+ * Return: true if found
+ */
+bool ndisc_lookup(const struct in6_addr *ip6, u8 enetaddr[ARP_HLEN]);
+
+/**
+ * ndisc_request() - Send a neighbour solicitation for the waiting packet
+ */
+void ndisc_request(void);
+
+/**
+ * ndisc_timeout_check() - Send the solicitation again if it timed out
+ *
+ * Return: 1 if a packet is waiting for a neighbour, else 0
+ */
+int ndisc_timeout_check(void);
+
+/**
+ * ndisc_is_waiting() - Check if a packet is waiting for a neighbour
+ *
+ * Return: true if so
+ */
+static inline bool ndisc_is_waiting(void)
+{
+	return !ip6_is_unspecified_addr(&net_nd_sol_packet_ip6);
+}
+
+/**
+ * ndisc_receive() - Process a neighbour discovery message
+ *
+ * @et:		Ethernet header of the packet
+ * @ip6:	IPv6 header of the packet
+ * @len:	Length of the packet from @ip6 on
+ * Return: 0 if handled, -ve if dropped
+ */
+int ndisc_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len);
+
+/**
+ * ndisc_rs_start() - Ask for a router advertisement, to get an address
+ *
+ * This is the start function of the RS protocol in net_loop(), which
+ * succeeds once a router advertisement gives us an address
+ */
+void ndisc_rs_start(void);
+
+#endif /* __NDISC_H__ */
@@ -95,6 +95,36 @@ typedef void rxhand_icmp_f(unsigned type, unsigned code, unsigned dport,
  */
 typedef void	thand_f(void);
 
+/**
+ * A handler saying where the payload of the next UDP packet should go.
+ * @param app_hdr_len	returns the number of bytes at the start of the UDP
+ *			payload to leave in the packet buffer (must be even)
+ * @param max_len	returns the most bytes to place after those
+ * @param port		returns the UDP port which the packet must be sent to
+ * @return destination for the rest of the UDP payload, or NULL for none
+ */
+typedef void *rxplace_f(int *app_hdr_len, int *max_len, int *port);
+
+/**
+ * struct eth_rx_place - Where a driver may put part of a received frame
+ *
+ * @payload: Destination for the bytes of the frame after the first @hdr_len,
+ *	     or NULL to receive the whole frame into the packet buffer
+ * @hdr_len: Number of bytes at the start of the frame to keep in the packet
+ *	     buffer
+ * @max_len: Most bytes which may be written to @payload
+ * @port: UDP port the payload is wanted from; a frame sent to any other port
+ *	  is copied back into the packet buffer. Drivers can ignore this.
+ * @placed: Set by the driver when it wrote the rest of the frame to @payload
+ */
+struct eth_rx_place {
+	void *payload;
+	int hdr_len;
+	int max_len;
+	int port;
+	bool placed;
+};
+
 enum eth_state_t {
 	ETH_STATE_INIT,
 	ETH_STATE_PASSIVE,
@@ -127,6 +157,48 @@ enum eth_recv_flags {
 	ETH_RECV_CHECK_DEVICE		= 1 << 0,
 };
 
+/**
+ * struct eth_rx_pkt - A packet returned by the recv_batch() method
+ *
+ * @packet: Start of the received frame
+ * @len: Length of the frame in bytes
+ */
+struct eth_rx_pkt {
+	uchar *packet;
+	int len;
+};
+
+/**
+ * struct eth_stats - Traffic counters kept for each Ethernet device
+ *
+ * The uclass counts packets, bytes and errors. Drivers count frames they had
+ * to discard with eth_get_stats().
+ *
+ * @rx_packets: Packets passed to the network stack
+ * @rx_bytes: Bytes passed to the network stack
+ * @rx_errors: Number of times recv(), recv_batch() or recv_split()
+ *	failed
+ * @rx_dropped: Frames received but discarded by the driver
+ * @rx_overruns: Frames lost because the receive ring was full (or, if the
+ *	driver cannot tell, the number of times the ring ran out of buffers)
+ * @rx_placed: Packets whose payload recv_split() put straight where the
+ *	protocol wanted it
+ * @tx_packets: Packets sent
+ * @tx_bytes: Bytes sent
+ * @tx_errors: Number of times send() failed
+ */
+struct eth_stats {
+	ulong rx_packets;
+	ulong rx_bytes;
+	ulong rx_errors;
+	ulong rx_dropped;
+	ulong rx_overruns;
+	ulong rx_placed;
+	ulong tx_packets;
+	ulong tx_bytes;
+	ulong tx_errors;
+};
+
 /**
  * struct eth_ops - functions of Ethernet MAC controllers
  *
@@ -137,6 +209,18 @@ enum eth_recv_flags {
  *	 indicate that the hardware receive FIFO is empty. If 0 is returned, the
  *	 network stack will not process the empty packet, but free_pkt() will be
  *	 called if supplied
+ * recv_batch: Like recv, but return up to "max" packets at once in "pkts".
+ *	       Return the number of packets (0 if none) or an error. The stack
+ *	       processes them all, then calls free_pkt() on each in order. This
+ *	       is used instead of recv when supplied - optional
+ * recv_split: Like recv, but if place->payload is set and the frame is
+ *	       longer than place->hdr_len by no more than place->max_len, write
+ *	       the bytes after place->hdr_len to place->payload (e.g. by DMA)
+ *	       and set place->placed. The packet buffer must still have room
+ *	       for the whole frame. Return the full length of the frame. This
+ *	       is used instead of recv and recv_batch when supplied, while a
+ *	       protocol asks for it. Only the sandbox driver has it so far -
+ *	       optional
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
@@ -158,6 +242,10 @@ struct eth_ops {
 	int (*start)(struct udevice *dev);
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
+	int (*recv_batch)(struct udevice *dev, int flags,
+			  struct eth_rx_pkt *pkts, int max);
+	int (*recv_split)(struct udevice *dev, int flags, uchar **packetp,
+			  struct eth_rx_place *place);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
 	void (*stop)(struct udevice *dev);
 	int (*mcast)(struct udevice *dev, const u8 *enetaddr, int join);
@@ -176,6 +264,14 @@ struct udevice *eth_get_dev(void); /* get the current device */
 struct udevice *eth_get_dev_by_name(const char *devname);
 unsigned char *eth_get_ethaddr(void); /* get the current device MAC */
 
+/**
+ * eth_get_stats() - Get the traffic counters of an Ethernet device
+ *
+ * @dev: Ethernet device, which must be probed
+ * Return: counters of the device
+ */
+struct eth_stats *eth_get_stats(struct udevice *dev);
+
 /* Used only when NetConsole is enabled */
 int eth_is_active(struct udevice *dev); /* Test device for active state */
 int eth_init_state_only(void); /* Set active state */
@@ -305,6 +401,15 @@ void eth_halt(void);			/* stop SCC */
 const char *eth_get_name(void);		/* get name of current device */
 int eth_mcast_join(struct in_addr mcast_addr, int join);
 
+/**
+ * net_mcast_leave() - Leave the multicast group in net_mcast_addr, if any
+ *
+ * This runs whenever net_loop() finishes or restarts, so a protocol which
+ * joins a group does not leave the device receiving it after an error or
+ * abort.
+ */
+void net_mcast_leave(void);
+
 /**********************************************************************/
 /*
  *	Protocol headers.
@@ -365,6 +470,7 @@ struct vlan_ethernet_hdr {
 #define PROT_NCSI	0x88f8		/* NC-SI control packets        */
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -544,10 +650,13 @@ extern u8		net_ethaddr[ARP_HLEN];		/* Our ethernet address */
 extern u8		net_server_ethaddr[ARP_HLEN];	/* Boot server enet address */
 extern struct in_addr	net_ip;		/* Our    IP addr (0 = unknown) */
 extern struct in_addr	net_server_ip;	/* Server IP addr (0 = unknown) */
+extern struct in_addr	net_mcast_addr;	/* Multicast group (0 = none) */
 extern uchar		*net_tx_packet;		/* THE transmit packet */
 extern uchar		*net_rx_packets[PKTBUFSRX]; /* Receive packets */
 extern uchar		*net_rx_packet;		/* Current receive packet */
 extern int		net_rx_packet_len;	/* Current rx packet length */
+/* Payload of the current rx packet if placed apart from it, else NULL */
+extern uchar		*net_rx_payload;
 extern const u8		net_bcast_ethaddr[ARP_HLEN];	/* Ethernet broadcast address */
 extern const u8		net_null_ethaddr[ARP_HLEN];
 
@@ -560,7 +669,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, UDP
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, UDP, WGET, RS, PING6
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -659,6 +768,7 @@ void net_set_arp_handler(rxhand_f *);	/* Set ARP RX packet handler */
 bool arp_is_waiting(void);		/* Waiting for ARP reply? */
 void net_set_icmp_handler(rxhand_icmp_f *f); /* Set ICMP RX handler */
 void net_set_timeout_handler(ulong, thand_f *);/* Set timeout handler */
+void net_set_rx_place_handler(rxplace_f *f); /* Set RX placement handler */
 
 /* Network loop state */
 enum net_loop_state {
@@ -709,6 +819,35 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
 
+/**
+ * net_rx_place() - Find out where a driver should put the next payload
+ *
+ * This asks the handler set by net_set_rx_place_handler(), if any.
+ *
+ * @place: Returns the placement, with place->payload NULL if there is none
+ * Return: true if the protocol wants the next payload placed
+ */
+bool net_rx_place(struct eth_rx_place *place);
+
+/**
+ * net_process_received_split() - Process a packet split by recv_split()
+ *
+ * @in_packet: Packet buffer holding the first place->hdr_len bytes
+ * @len: Full length of the packet
+ * @place: Placement used by the driver
+ */
+void net_process_received_split(uchar *in_packet, int len,
+				const struct eth_rx_place *place);
+
+/**
+ * net_rx_unsplit() - Copy a placed payload back into the current packet
+ *
+ * Handlers call this before parsing a packet which was not what they
+ * expected when asking for the placement, so that it is all in one buffer.
+ * It does nothing if the payload was not placed.
+ */
+void net_rx_unsplit(void);
+
 #if defined(CONFIG_NETCONSOLE) && !defined(CONFIG_SPL_BUILD)
 void nc_start(void);
 int nc_input_packet(uchar *pkt, struct in_addr src_ip, unsigned dest_port,
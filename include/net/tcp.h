@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client, enough to pull a file from a server
+ *
+ * Only one connection is supported at a time and it is always opened by us.
+ * Received data is handed to the caller as soon as it arrives, so the receive
+ * window never has to be held in a buffer here.
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include <net.h>
+
+/*
+ *	Internet Protocol (IP) + TCP header.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgment number	*/
+	u8		tcp_hlen;	/* Header length in top 4 bits	*/
+	u8		tcp_flags;	/* Control flags		*/
+	u16		tcp_win;	/* Receive window		*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_urg;	/* Urgent pointer		*/
+} __attribute__((packed));
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+/* Control flags */
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PUSH	0x08
+#define TCP_ACK		0x10
+
+/* Options */
+#define TCP_OPT_EOL	0
+#define TCP_OPT_NOP	1
+#define TCP_OPT_MSS	2
+#define TCP_OPT_WS	3
+
+/* Room for the MSS and window-scale options we put in a SYN */
+#define TCP_SYN_OPT_SIZE	8
+
+/* Largest segment that fits in a standard Ethernet frame */
+#define TCP_MSS		(1500 - IP_TCP_HDR_SIZE)
+
+/**
+ * enum tcp_state - State of our connection
+ *
+ * @TCP_CLOSED:		No connection
+ * @TCP_SYN_SENT:	SYN sent, waiting for the server to accept
+ * @TCP_ESTABLISHED:	Data can flow both ways
+ * @TCP_CLOSE_WAIT:	The server has closed its side; we may still send
+ * @TCP_FIN_WAIT:	We have closed our side and are waiting for the server
+ */
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_CLOSE_WAIT,
+	TCP_FIN_WAIT,
+};
+
+/**
+ * enum tcp_event - Things the connection reports to its user
+ *
+ * @TCP_EV_CONNECTED:	The connection is established
+ * @TCP_EV_DATA:	More data has arrived in order, see tcp_get_rx_len()
+ * @TCP_EV_CLOSED:	The server closed the connection; no more data follows
+ * @TCP_EV_RESET:	The server reset the connection
+ * @TCP_EV_TIMEOUT:	The server stopped answering
+ */
+enum tcp_event {
+	TCP_EV_CONNECTED,
+	TCP_EV_DATA,
+	TCP_EV_CLOSED,
+	TCP_EV_RESET,
+	TCP_EV_TIMEOUT,
+};
+
+/**
+ * typedef tcp_rx_handler_f - Store data received from the server
+ *
+ * Segments that arrive ahead of a missing one are passed on as well, so that
+ * only the missing one needs to be sent again. The handler may refuse such a
+ * segment, in which case it is dropped and the server sends it again later.
+ * Refusing data that arrives in order resets the connection.
+ *
+ * @offset:	Position of @data in the stream, starting at 0
+ * @data:	Received data
+ * @len:	Number of bytes in @data
+ * Return: 0 if the data was stored, -ve to drop it
+ */
+typedef int tcp_rx_handler_f(u32 offset, const uchar *data, uint len);
+
+/**
+ * typedef tcp_event_f - Report a change in the connection
+ *
+ * @event:	What happened
+ */
+typedef void tcp_event_f(enum tcp_event event);
+
+/**
+ * tcp_connect() - Open a connection to a server
+ *
+ * This must be called from within net_loop(). The connection takes over the
+ * network timeout handler, which it uses for retransmission.
+ *
+ * @dest:	IP address of the server
+ * @dport:	TCP port of the server
+ * @rx:		Handler for received data
+ * @event:	Handler for connection events
+ * Return: 0 if the SYN was sent (or is waiting for ARP), -ve on error
+ */
+int tcp_connect(struct in_addr dest, int dport, tcp_rx_handler_f *rx,
+		tcp_event_f *event);
+
+/**
+ * tcp_send() - Send data to the server
+ *
+ * Only one segment may be outstanding at a time, which is all that a request
+ * to the server needs.
+ *
+ * @data:	Data to send
+ * @len:	Number of bytes to send, at most the MSS of the server
+ * Return: 0 if OK, -ENOTCONN if not connected, -EBUSY if a segment is still
+ *	unacknowledged, -E2BIG if @len is too large
+ */
+int tcp_send(const void *data, uint len);
+
+/**
+ * tcp_close() - Close our side of the connection
+ *
+ * Sends a FIN. Nothing more is passed to the handlers after this.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_get_state() - Get the state of the connection
+ *
+ * Return: current state
+ */
+enum tcp_state tcp_get_state(void);
+
+/**
+ * tcp_get_rx_len() - Get the amount of data received in order
+ *
+ * Return: number of bytes received from the start of the stream without a gap
+ */
+u32 tcp_get_rx_len(void);
+
+/**
+ * tcp_reset_state() - Forget any connection
+ *
+ * This is called by net_loop() when it exits so that late packets are ignored.
+ */
+void tcp_reset_state(void);
+
+/**
+ * tcp_set_tcp_header() - Fill in the IP and TCP headers of a segment
+ *
+ * @pkt:	Start of the IP header
+ * @dest:	IP address of the server
+ * @dport:	TCP port of the server
+ * @sport:	Our TCP port
+ * @payload_len: Number of bytes of data following the header
+ * @action:	TCP flags to send
+ * @seq:	Sequence number
+ * @ack:	Acknowledgment number
+ * Return: size of the IP and TCP headers including options
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 seq, u32 ack);
+
+/**
+ * tcp_receive() - Process a received TCP segment
+ *
+ * @ip:		IP packet holding the segment
+ * @len:	Length of the IP packet
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, int len);
+
+#endif /* __TCP_H__ */
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Download a file over HTTP
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+/* Default HTTP port, which the "httpdstp" variable overrides */
+#define WGET_HTTP_PORT		80
+
+/**
+ * wget_start() - Start an HTTP download
+ *
+ * Fetches net_boot_file_name from net_server_ip (or the server given in the
+ * file name) into image_load_addr. This is called from net_loop().
+ */
+void wget_start(void);
+
+#endif /* __WGET_H__ */
@@ -0,0 +1,323 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * IPv6 support
+ *
+ * Our address comes from the ip6addr variable or, if that is not set, from a
+ * router advertisement (SLAAC). Neighbours are found with neighbour discovery
+ * (see ndisc.h). Protocols use IPv6 instead of IPv4 while net_use_ip6 is set.
+ */
+
+#ifndef __NET6_H__
+#define __NET6_H__
+
+#include <net.h>
+
+/**
+ * struct in6_addr - IPv6 address
+ *
+ * The address is kept in network order, as it appears in packets
+ */
+struct in6_addr {
+	union {
+		u8	u6_addr8[16];
+		__be16	u6_addr16[8];
+		__be32	u6_addr32[4];
+	} in6_u;
+#define s6_addr		in6_u.u6_addr8
+#define s6_addr16	in6_u.u6_addr16
+#define s6_addr32	in6_u.u6_addr32
+} __packed;
+
+#define IN6ADDRSZ	sizeof(struct in6_addr)
+
+/**
+ * struct ip6_hdr - IPv6 header (RFC 8200)
+ *
+ * @ver_tc_flow:	Version (top 4 bits), traffic class and flow label
+ * @payload_len:	Number of bytes following this header
+ * @nexthdr:		Protocol of the payload
+ * @hop_limit:		Number of routers the packet may pass through
+ * @saddr:		Source address
+ * @daddr:		Destination address
+ */
+struct ip6_hdr {
+	__be32		ver_tc_flow;
+	__be16		payload_len;
+	u8		nexthdr;
+	u8		hop_limit;
+	struct in6_addr	saddr;
+	struct in6_addr	daddr;
+} __packed;
+
+#define IP6_HDR_SIZE		(sizeof(struct ip6_hdr))
+#define IP6_VERSION		6
+/* Hop limit for the packets we send */
+#define IP6_HOP_LIMIT		64
+
+/**
+ * struct udp_hdr - UDP header, which follows the IPv6 header
+ */
+struct udp_hdr {
+	__be16		udp_src;	/* UDP source port		*/
+	__be16		udp_dst;	/* UDP destination port		*/
+	__be16		udp_len;	/* Length of UDP packet		*/
+	__be16		udp_xsum;	/* Checksum			*/
+} __packed;
+
+#define IP6_UDPHDR_SIZE		(IP6_HDR_SIZE + UDP_HDR_SIZE)
+
+#define IPPROTO_ICMPV6		58
+
+/* ICMPv6 message types */
+#define ICMPV6_ECHO_REQUEST	128
+#define ICMPV6_ECHO_REPLY	129
+#define ICMPV6_ROUTER_SOLICIT	133
+#define ICMPV6_ROUTER_ADVERT	134
+#define ICMPV6_NEIGHBOR_SOLICIT	135
+#define ICMPV6_NEIGHBOR_ADVERT	136
+
+/**
+ * struct icmp6_hdr - ICMPv6 header
+ *
+ * The last four bytes depend on the message type. Neighbour discovery
+ * messages use them for flags, see ndisc.h
+ */
+struct icmp6_hdr {
+	u8		icmp6_type;
+	u8		icmp6_code;
+	__be16		icmp6_cksum;
+	union {
+		struct {
+			__be16	id;
+			__be16	sequence;
+		} echo;
+		__be32	data;
+	} un;
+} __packed;
+
+#define ICMP6_HDR_SIZE		(sizeof(struct icmp6_hdr))
+
+extern const struct in6_addr net_null_addr_ip6;	/* All zeroes */
+extern struct in6_addr net_ip6;		/* Our IPv6 address (0 = unknown) */
+extern struct in6_addr net_link_local_ip6;	/* Our link-local address */
+extern u32 net_prefix_length;		/* Length of our subnet prefix */
+extern struct in6_addr net_gateway6;	/* Our default router */
+extern struct in6_addr net_server_ip6;	/* Server IPv6 address */
+extern struct in6_addr net_rx_src_ip6;	/* Sender of UDP being handled */
+extern struct in6_addr net_dns_server6;	/* Our IPv6 DNS server */
+extern struct in6_addr net_ping_ip6;	/* The address to ping */
+extern bool net_use_ip6;		/* Use IPv6 for the next transfer */
+
+/**
+ * string_to_ip6() - Convert a string to an IPv6 address
+ *
+ * Accepts the usual colon-separated groups of hex digits, with "::" standing
+ * for one run of zero groups, e.g. "2001:db8::1"
+ *
+ * @s:		String to convert
+ * @len:	Number of characters of @s to use
+ * @addr:	Returns the address
+ * Return: 0 if OK, -EINVAL if @s is not a valid address
+ */
+int string_to_ip6(const char *s, size_t len, struct in6_addr *addr);
+
+static inline bool ip6_is_unspecified_addr(const struct in6_addr *addr)
+{
+	return !(addr->s6_addr32[0] | addr->s6_addr32[1] |
+		 addr->s6_addr32[2] | addr->s6_addr32[3]);
+}
+
+static inline bool ip6_is_link_local_addr(const struct in6_addr *addr)
+{
+	return addr->s6_addr[0] == 0xfe && (addr->s6_addr[1] & 0xc0) == 0x80;
+}
+
+static inline bool ip6_is_multicast_addr(const struct in6_addr *addr)
+{
+	return addr->s6_addr[0] == 0xff;
+}
+
+static inline void net_copy_ip6(void *to, const void *from)
+{
+	memcpy(to, from, IN6ADDRSZ);
+}
+
+/**
+ * ip6_is_our_addr() - Check if an address is one of ours
+ *
+ * @addr:	Address to check
+ * Return: true if @addr is our global or link-local address
+ */
+bool ip6_is_our_addr(const struct in6_addr *addr);
+
+/**
+ * ip6_make_eui64() - Make the interface ID for a MAC address
+ *
+ * Fills in the last 64 bits of @addr as described in RFC 4291 appendix A
+ *
+ * @addr:	Address whose interface ID is set
+ * @enetaddr:	MAC address to use
+ */
+void ip6_make_eui64(struct in6_addr *addr, const u8 enetaddr[ARP_HLEN]);
+
+/**
+ * ip6_make_lladdr() - Make the link-local address for a MAC address
+ *
+ * @lladdr:	Returns the link-local address
+ * @enetaddr:	MAC address to use
+ */
+void ip6_make_lladdr(struct in6_addr *lladdr, const u8 enetaddr[ARP_HLEN]);
+
+/**
+ * ip6_make_snma() - Make the solicited-node multicast address for an address
+ *
+ * @mcast_addr:	Returns the multicast address
+ * @ip6_addr:	Address being solicited
+ */
+void ip6_make_snma(struct in6_addr *mcast_addr, const struct in6_addr *ip6_addr);
+
+/**
+ * ip6_make_mult_ethdstaddr() - Make the MAC address for a multicast address
+ *
+ * @enetaddr:	Returns the MAC address (33:33 and the last 32 bits)
+ * @mcast_addr:	Multicast address
+ */
+void ip6_make_mult_ethdstaddr(u8 enetaddr[ARP_HLEN],
+			      const struct in6_addr *mcast_addr);
+
+/**
+ * ip6_addr_in_subnet() - Check if two addresses share a prefix
+ *
+ * @our_addr:	First address
+ * @neigh_addr:	Second address
+ * @prefix_length: Number of leading bits to compare
+ * Return: true if the first @prefix_length bits are the same
+ */
+bool ip6_addr_in_subnet(const struct in6_addr *our_addr,
+			const struct in6_addr *neigh_addr, u32 prefix_length);
+
+/**
+ * ip6_src_addr() - Choose our address to send from
+ *
+ * @dest:	Address the packet is going to
+ * Return: our link-local address for a link-local or multicast destination
+ *	or before we have a global address, else our global address
+ */
+const struct in6_addr *ip6_src_addr(const struct in6_addr *dest);
+
+/**
+ * csum_partial() - Add up data for an Internet checksum
+ *
+ * @buff:	Data to add up, taken as big-endian 16-bit words
+ * @len:	Number of bytes in @buff
+ * @sum:	Running total to add to
+ * Return: new running total, not yet folded to 16 bits
+ */
+unsigned int csum_partial(const unsigned char *buff, int len, unsigned int sum);
+
+/**
+ * csum_ipv6_magic() - Finish an ICMPv6 or UDP checksum
+ *
+ * Adds in the IPv6 pseudo-header and folds the result. Checking a received
+ * packet by passing the sum of the whole payload gives 0 if it is correct.
+ *
+ * @saddr:	Source address
+ * @daddr:	Destination address
+ * @len:	Length of the payload
+ * @proto:	Protocol of the payload
+ * @csum:	csum_partial() of the payload
+ * Return: checksum, in host order
+ */
+u16 csum_ipv6_magic(const struct in6_addr *saddr, const struct in6_addr *daddr,
+		    u16 len, u8 proto, unsigned int csum);
+
+/**
+ * ip6_add_hdr() - Fill in an IPv6 header
+ *
+ * @xip:	Place for the header
+ * @src:	Source address
+ * @dest:	Destination address
+ * @nextheader:	Protocol of the payload
+ * @hoplimit:	Hop limit
+ * @payload_len: Length of the payload following the header
+ * Return: size of the header
+ */
+int ip6_add_hdr(uchar *xip, const struct in6_addr *src,
+		const struct in6_addr *dest, int nextheader, int hoplimit,
+		int payload_len);
+
+/**
+ * net_send_ip6_packet() - Send an IPv6 packet from net_tx_packet
+ *
+ * The payload must already be in net_tx_packet, after room for the Ethernet
+ * and IPv6 headers. If the MAC address of the next hop is not known yet,
+ * the packet is held while neighbour discovery finds it.
+ *
+ * @ether:	MAC address of the next hop, or all zeroes if not known. It
+ *		is filled in once found.
+ * @dest:	Destination address
+ * @nextheader:	Protocol of the payload
+ * @payload_len: Length of the payload
+ * Return: 0 if sent, 1 if waiting for neighbour discovery
+ */
+int net_send_ip6_packet(uchar *ether, const struct in6_addr *dest,
+			int nextheader, int payload_len);
+
+/**
+ * net_send_udp_packet6() - Send a UDP packet over IPv6
+ *
+ * @ether:	MAC address of the next hop, as for net_send_ip6_packet()
+ * @dest:	Destination address
+ * @dport:	Destination UDP port
+ * @sport:	Source UDP port
+ * @len:	Length of the data, which is in net_tx_packet after room for
+ *		the Ethernet, IPv6 and UDP headers
+ * Return: 0 if sent, 1 if waiting for neighbour discovery
+ */
+int net_send_udp_packet6(uchar *ether, const struct in6_addr *dest, int dport,
+			 int sport, int len);
+
+/**
+ * net_ip6_handler() - Process a received IPv6 packet
+ *
+ * @et:		Ethernet header of the packet
+ * @ip6:	IPv6 header of the packet
+ * @len:	Length of the packet from @ip6 on
+ * Return: 0 if handled, -ve if dropped
+ */
+int net_ip6_handler(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len);
+
+/**
+ * is_serverip6_in_cmd() - Check if the boot file name gives a server address
+ *
+ * Return: true if net_boot_file_name has the form "[addr]:filename"
+ */
+bool is_serverip6_in_cmd(void);
+
+/**
+ * net_parse_bootfile6() - Split net_boot_file_name into server and file name
+ *
+ * @ipaddr:	Updated with the server address if the name has one
+ * @filename:	Returns the file name
+ * @max_len:	Size of @filename
+ * Return: 1 if there is a file name, 0 if not, -EINVAL if the server
+ *	address is invalid
+ */
+int net_parse_bootfile6(struct in6_addr *ipaddr, char *filename, int max_len);
+
+/**
+ * ping6_start() - Start sending an echo request to net_ping_ip6
+ */
+void ping6_start(void);
+
+/**
+ * ping6_receive() - Handle an echo reply
+ *
+ * @et:		Ethernet header of the packet
+ * @ip6:	IPv6 header of the packet
+ * @len:	Length of the packet from @ip6 on
+ * Return: 0 if it was the reply we were waiting for, -ve if not
+ */
+int ping6_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len);
+
+#endif /* __NET6_H__ */
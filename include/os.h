@@ -496,4 +496,32 @@ long os_get_time_offset(void);
  */
 void os_set_time_offset(long offset);
 
+/**
+ * os_context_new() - create a context which runs a function on its own stack
+ *
+ * @fn:		function to run when the context is first switched to, or NULL
+ *		for a context which only saves the state of the caller of
+ *		os_context_switch(). @fn must not return.
+ * @arg:	argument to pass to @fn
+ * @stack_size:	size of stack to allocate for @fn
+ * Return:	context, or NULL if out of memory
+ */
+void *os_context_new(void (*fn)(void *arg), void *arg, size_t stack_size);
+
+/**
+ * os_context_switch() - save the current context and switch to another
+ *
+ * @from:	context to save the current state in
+ * @to:		context to switch to
+ */
+void os_context_switch(void *from, void *to);
+
+/**
+ * os_context_free() - free a context and its stack
+ *
+ * @ctx:	context to free, which must not be running. If this is NULL
+ *		then this function does nothing
+ */
+void os_context_free(void *ctx);
+
 #endif
@@ -6,15 +6,32 @@
 #ifndef __SANDBOX_BLOCK_DEV__
 #define __SANDBOX_BLOCK_DEV__
 
+#include <linux/list.h>
+
 /* Maximum number of host devices - see drivers/block/sandbox.c */
 #define SANDBOX_HOST_MAX_DEVICES	4
 
+/* Number of asynchronous requests a host device accepts at once */
+#define SANDBOX_HOST_QUEUE_DEPTH	32
+
+/**
+ * struct host_block_dev - a block device backed by a host file
+ *
+ * @filename:	Name of the host file
+ * @fd:		File descriptor for the host file
+ * @latency_us:	Simulated access time of each transfer, 0 for none
+ * @pending:	Asynchronous requests waiting for their latency to pass
+ */
 struct host_block_dev {
 #ifndef CONFIG_BLK
 	struct blk_desc blk_dev;
 #endif
 	char *filename;
 	int fd;
+	uint latency_us;
+#ifdef CONFIG_BLK
+	struct list_head pending;
+#endif
 };
 
 /**
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Helpers for tests which load a file from a server attached to the sandbox
+ * Ethernet driver
+ */
+
+#ifndef __TEST_NET_H__
+#define __TEST_NET_H__
+
+#include <asm/eth.h>
+
+struct unit_test_state;
+
+/* Address which the commands run by net_test_load() must load to */
+#define NET_TEST_ADDR		0x1000000
+
+/**
+ * net_test_run() - Run a command with a server on the first sandbox Ethernet
+ *
+ * @server: Server, called with each packet which the command sends
+ * @srv: Server state, which @server finds in the priv of the device
+ * @cmd: Command to run
+ * Return: result of the command
+ */
+int net_test_run(sandbox_eth_tx_hand_f *server, void *srv, const char *cmd);
+
+/**
+ * net_test_load() - Load a file with a command and check what arrives
+ *
+ * This fills @file with test data, runs @cmd with @server, then checks that
+ * a file of the right size was loaded to NET_TEST_ADDR and that it matches.
+ *
+ * @uts: Test state
+ * @server: Server, called with each packet which the command sends
+ * @srv: Server state, which @server finds in the priv of the device
+ * @cmd: Command to run
+ * @file: File for @server to send, usually within @srv
+ * @size: Size of @file in bytes
+ * @seed: Selects the data put in @file
+ * Return: 0 if OK, -ve on error
+ */
+int net_test_load(struct unit_test_state *uts, sandbox_eth_tx_hand_f *server,
+		  void *srv, const char *cmd, void *file, uint size, uint seed);
+
+#endif /* __TEST_NET_H__ */
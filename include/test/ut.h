@@ -345,6 +345,19 @@ ulong ut_check_free(void);
  */
 long ut_check_delta(ulong last);
 
+/**
+ * ut_fill_pattern() - Fill a buffer with test data
+ *
+ * The data repeats every 128KiB, so data which ends up in the wrong place shows
+ * up unless it is out by a multiple of that. The same @seed always gives the
+ * same data.
+ *
+ * @buf: Buffer to fill
+ * @size: Number of bytes to fill
+ * @seed: Selects the data, so that different buffers can be told apart
+ */
+void ut_fill_pattern(void *buf, ulong size, uint seed);
+
 /**
  * ut_silence_console() - Silence the console if requested by the user
  *
@@ -22,4 +22,21 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * sha256_process() - Hash whole 64-byte blocks
+ *
+ * This is a weak function which may be replaced by an accelerated version,
+ * which falls back to sha256_process_generic() when the CPU cannot run it.
+ *
+ * @ctx:	Context to update
+ * @data:	Data to hash
+ * @blocks:	Number of 64-byte blocks in @data
+ */
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+
+/* Portable version of sha256_process() */
+void sha256_process_generic(sha256_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
 #endif /* _SHA256_H */
@@ -25,6 +25,22 @@ void sha512_finish(sha512_context * ctx, uint8_t digest[SHA512_SUM_LEN]);
 void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * sha512_process() - Hash whole 128-byte blocks, for SHA-384 and SHA-512
+ *
+ * This is a weak function which may be replaced by an accelerated version,
+ * which falls back to sha512_process_generic() when the CPU cannot run it.
+ *
+ * @ctx:	Context to update
+ * @data:	Data to hash
+ * @blocks:	Number of 128-byte blocks in @data
+ */
+void sha512_process(sha512_context *ctx, const uint8_t *data, int blocks);
+
+/* Portable version of sha512_process() */
+void sha512_process_generic(sha512_context *ctx, const uint8_t *data,
+			    int blocks);
+
 extern const uint8_t sha384_der_prefix[];
 
 void sha384_starts(sha512_context * ctx);
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Cooperative threads, which switch only where they wait
+ */
+
+#ifndef __UTHREAD_H
+#define __UTHREAD_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+/**
+ * struct uthread - A thread of execution with its own stack
+ *
+ * Threads only switch when one of them calls uthread_schedule(), which
+ * udelay() and the polling helpers do while waiting. Code between such calls
+ * runs without interruption, but two threads should not use the same device
+ * or subsystem at once unless it is known to be safe.
+ *
+ * @name: Name of the thread, for debugging
+ * @fn: Function which the thread runs
+ * @arg: Argument to pass to @fn
+ * @ctx: Saved context, owned by the architecture code
+ * @done: true once @fn has returned
+ * @sibling: Node in the list of threads to run in turn
+ */
+struct uthread {
+	const char *name;
+	void (*fn)(void *arg);
+	void *arg;
+	void *ctx;
+	bool done;
+	struct list_head sibling;
+};
+
+#if CONFIG_IS_ENABLED(UTHREAD)
+/**
+ * uthread_create() - Create a thread and make it ready to run
+ *
+ * The thread first runs when the caller, or another thread, next calls
+ * uthread_schedule(). This is only possible after relocation.
+ *
+ * @thr: Thread to set up, which must stay valid until uthread_join() returns
+ * @name: Name of the thread
+ * @fn: Function to run in the thread
+ * @arg: Argument to pass to @fn
+ * @stack_size: Size of stack for the thread, 0 for CONFIG_UTHREAD_STACK_SIZE
+ * Return: 0 if OK, -EPERM before relocation, -ENOMEM if out of memory
+ */
+int uthread_create(struct uthread *thr, const char *name,
+		   void (*fn)(void *arg), void *arg, size_t stack_size);
+
+/**
+ * uthread_schedule() - Let the next thread run
+ *
+ * This returns when the calling thread's turn comes round again. It does
+ * nothing if no threads have been created.
+ */
+void uthread_schedule(void);
+
+/**
+ * uthread_join() - Wait for a thread to finish and free its stack
+ *
+ * Other threads run while waiting
+ *
+ * @thr: Thread to wait for
+ * Return: 0 if OK, -EDEADLK if called from @thr itself
+ */
+int uthread_join(struct uthread *thr);
+
+/**
+ * uthread_delay() - Wait for a time, letting other threads run
+ *
+ * This is used by udelay() when there are threads, so that each thread's
+ * waits overlap with those of the others.
+ *
+ * @usec: Time to wait in microseconds
+ * Return: true if this waited, false if there are no threads and the caller
+ *	should wait as usual
+ */
+bool uthread_delay(unsigned long usec);
+#else
+static inline void uthread_schedule(void)
+{
+}
+
+static inline bool uthread_delay(unsigned long usec)
+{
+	return false;
+}
+#endif
+
+/**
+ * arch_uthread_init() - Set up the context of a thread
+ *
+ * This is provided by the architecture
+ *
+ * @thr: Thread to set up; this sets @thr->ctx
+ * @fn: Function to run in the thread, NULL for a context which is only used
+ *	to hold the state of the code which calls arch_uthread_switch()
+ * @arg: Argument to pass to @fn
+ * @stack_size: Size of stack to allocate for @fn
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int arch_uthread_init(struct uthread *thr, void (*fn)(void *arg), void *arg,
+		      size_t stack_size);
+
+/**
+ * arch_uthread_switch() - Save the current context and switch to another
+ *
+ * This is provided by the architecture
+ *
+ * @from: Thread to save the current context in
+ * @to: Thread to switch to
+ */
+void arch_uthread_switch(struct uthread *from, struct uthread *to);
+
+/**
+ * arch_uthread_free() - Free the context of a thread
+ *
+ * This is provided by the architecture. It is not called on a running thread.
+ *
+ * @thr: Thread whose context to free
+ */
+void arch_uthread_free(struct uthread *thr);
+
+#endif
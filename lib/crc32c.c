@@ -13,9 +13,28 @@
 #include <common.h>
 #include <compiler.h>
 
+/* Bit-reflected Castagnoli polynomial, as used by the ARMv8 instructions */
+#define CRC32C_POLY_LE	0x82f63b78
+
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
+#ifdef CONFIG_ARM64_CRC32
+	/*
+	 * Entry 128 of the table is the polynomial itself; only use the
+	 * instructions if they compute the CRC the caller set up for
+	 */
+	if (crc32c_table[128] == CRC32C_POLY_LE) {
+		while (length && ((ulong)data & 7)) {
+			crc = __builtin_aarch64_crc32cb(crc, *data++);
+			length--;
+		}
+		for (; length >= 8; length -= 8, data += 8)
+			crc = __builtin_aarch64_crc32cx(crc,
+						*(const uint64_t *)data);
+	}
+#endif
+
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
 
@@ -25,6 +25,7 @@
 #include <asm/global_data.h>
 #include <asm/sections.h>
 #include <linux/ctype.h>
+#include <linux/log2.h>
 #include <linux/lzo.h>
 #include <linux/ioport.h>
 
@@ -624,6 +625,75 @@ int fdtdec_prepare_fdt(void)
 	return 0;
 }
 
+/*
+ * Offsets of nodes with a phandle in the control FDT, indexed by the
+ * phandle's low bits. This is only used after relocation, when it can be
+ * kept in BSS. Entries are checked before use, since the FDT may change.
+ */
+static const void *phandle_index_blob;
+static int *phandle_index;
+static uint32_t phandle_index_mask;
+
+static int fdtdec_build_phandle_index(const void *blob)
+{
+	uint32_t size = 0;
+	int offset;
+
+	free(phandle_index);
+	phandle_index = NULL;
+	for (offset = fdt_next_node(blob, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(blob, offset, NULL))
+		if (fdt_get_phandle(blob, offset))
+			size++;
+	/* Record the blob even if empty, so this is not tried again */
+	phandle_index_blob = blob;
+	if (!size)
+		return 0;
+
+	size = roundup_pow_of_two(size);
+	phandle_index = malloc(size * sizeof(*phandle_index));
+	if (!phandle_index)
+		return -ENOMEM;
+	memset(phandle_index, '\xff', size * sizeof(*phandle_index));
+	phandle_index_mask = size - 1;
+
+	/* Keep the first node with each phandle, as a search would find */
+	for (offset = fdt_next_node(blob, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(blob, offset, NULL)) {
+		uint32_t phandle = fdt_get_phandle(blob, offset);
+		int *entry = &phandle_index[phandle & phandle_index_mask];
+
+		if (phandle && *entry < 0)
+			*entry = offset;
+	}
+
+	return 0;
+}
+
+int fdtdec_node_offset_by_phandle(const void *blob, uint32_t phandle)
+{
+	int *entry = NULL;
+	int offset;
+
+	if (blob == gd->fdt_blob && (gd->flags & GD_FLG_RELOC) && phandle &&
+	    phandle != ~0U) {
+		if (phandle_index_blob != blob)
+			fdtdec_build_phandle_index(blob);
+		if (phandle_index) {
+			entry = &phandle_index[phandle & phandle_index_mask];
+			if (*entry >= 0 &&
+			    fdt_get_phandle(blob, *entry) == phandle)
+				return *entry;
+		}
+	}
+
+	offset = fdt_node_offset_by_phandle(blob, phandle);
+	if (entry && offset >= 0)
+		*entry = offset;
+
+	return offset;
+}
+
 int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 {
 	const u32 *phandle;
@@ -634,7 +704,7 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
-	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
+	lookup = fdtdec_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
 
@@ -765,8 +835,8 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				node = fdtdec_node_offset_by_phandle(blob,
+								     phandle);
 				if (node < 0) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
@@ -1465,7 +1535,7 @@ int fdtdec_get_carveout(const void *blob, const char *node,
 
 	phandle = fdt32_to_cpu(prop[index]);
 
-	offset = fdt_node_offset_by_phandle(blob, phandle);
+	offset = fdtdec_node_offset_by_phandle(blob, phandle);
 	if (offset < 0) {
 		debug("failed to find node for phandle %u\n", phandle);
 		return offset;
@@ -106,41 +106,42 @@ write_fail:
 	return -1;
 }
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+/* Where a sparse_stream is in the image */
+enum {
+	SPARSE_STREAM_HEADER,
+	SPARSE_STREAM_CHUNK,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_SKIP,
+	SPARSE_STREAM_DONE,
+};
+
+void sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
-	lbaint_t blks;
-	uint64_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
-
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->state = SPARSE_STREAM_HEADER;
+	ss->blk = info->start;
+	if (!info->mssg)
+		info->mssg = default_log;
+}
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+/* Move on to the next chunk, or finish if that was the last */
+static void sparse_stream_next(struct sparse_stream *ss)
+{
+	if (++ss->chunk_num < ss->header.total_chunks)
+		ss->state = SPARSE_STREAM_CHUNK;
+	else
+		ss->state = SPARSE_STREAM_DONE;
+}
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
-	}
+static int sparse_stream_header(struct sparse_stream *ss, const void *data,
+				char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	unsigned int offset;
 
-	if (!info->mssg)
-		info->mssg = default_log;
+	memcpy(sparse_header, data, sizeof(*sparse_header));
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -156,163 +157,249 @@ int write_sparse_image(struct sparse_storage *info,
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
+	div_u64_rem(sparse_header->blk_sz, ss->info->blksz, &offset);
 	if (offset) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		info->mssg("sparse image block size issue", response);
+		ss->info->mssg("sparse image block size issue", response);
 		return -1;
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	ss->state = SPARSE_STREAM_CHUNK;
+	if (!sparse_header->total_chunks)
+		ss->state = SPARSE_STREAM_DONE;
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
+	return 0;
+}
 
-		chunk_data_sz = ((u64)sparse_header->blk_sz) * chunk_header->chunk_sz;
-		blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
-					   response);
-				return -1;
-			}
+static int sparse_stream_chunk(struct sparse_stream *ss, const void *data,
+			       char *response)
+{
+	struct sparse_storage *info = ss->info;
+	chunk_header_t *chunk_header = &ss->chunk;
+	uint64_t chunk_data_sz;
+	lbaint_t blkcnt;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+	memcpy(chunk_header, data, sizeof(*chunk_header));
 
-			blks = write_sparse_chunk_raw(info, blk, blkcnt,
-						      data, response);
-			if (blks < 0)
-				return -1;
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
 
-			blk += blks;
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	chunk_data_sz = ((u64)ss->header.blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (ss->header.chunk_hdr_sz + chunk_data_sz)) {
+			info->mssg("Bogus chunk size for chunk type Raw",
+				   response);
+			return -1;
+		}
+		break;
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (ss->header.chunk_hdr_sz + sizeof(uint32_t))) {
+			info->mssg("Bogus chunk size for chunk type FILL",
+				   response);
+			return -1;
+		}
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next(ss);
+		return 0;
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != ss->header.chunk_hdr_sz) {
+			info->mssg("Bogus chunk size for chunk type Dont Care",
+				   response);
+			return -1;
+		}
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->left = chunk_data_sz;
+		ss->state = SPARSE_STREAM_SKIP;
+		return 0;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		info->mssg("Unknown chunk type", response);
+		return -1;
+	}
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
+	if (ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		info->mssg("Request would exceed partition size!", response);
+		return -1;
+	}
+	ss->left = chunk_data_sz;
+	ss->state = chunk_header->chunk_type == CHUNK_TYPE_RAW ?
+		SPARSE_STREAM_RAW : SPARSE_STREAM_FILL;
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
+	return 0;
+}
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+static int sparse_stream_fill(struct sparse_stream *ss, uint32_t fill_val,
+			      char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blkcnt = DIV_ROUND_UP_ULL(ss->left, info->blksz);
+	int fill_buf_num_blks;
+	uint32_t *fill_buf;
+	lbaint_t blks;
+	int i;
+	int j;
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
-							 sparse_header->blk_sz);
+	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	fill_buf = (uint32_t *)
+		   memalign(ARCH_DMA_MINALIGN,
+			    ROUNDUP(info->blksz * fill_buf_num_blks,
+				    ARCH_DMA_MINALIGN));
+	if (!fill_buf) {
+		info->mssg("Malloc failed for: CHUNK_TYPE_FILL", response);
+		return -1;
+	}
+
+	for (i = 0; i < (info->blksz * fill_buf_num_blks / sizeof(fill_val));
+	     i++)
+		fill_buf[i] = fill_val;
+
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		blks = info->write(info, ss->blk, j, fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s " LBAFU " [%d]\n", __func__,
+			       "Write failed, block #", ss->blk, j);
+			info->mssg("flash write failure", response);
 			free(fill_buf);
-			break;
+			return -1;
+		}
+		ss->blk += blks;
+		i += j;
+	}
+	ss->bytes_written += ((u64)blkcnt) * info->blksz;
+	ss->total_blocks += DIV_ROUND_UP_ULL(ss->left, ss->header.blk_sz);
+	free(fill_buf);
+	sparse_stream_next(ss);
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
-			break;
+	return 0;
+}
+
+long sparse_stream_write(struct sparse_stream *ss, const void *data,
+			 size_t len, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	size_t pos = 0, need, n;
+	lbaint_t blks;
 
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				info->mssg("Bogus chunk size for chunk type Dont Care",
-					   response);
+	while (ss->state != SPARSE_STREAM_DONE) {
+		switch (ss->state) {
+		case SPARSE_STREAM_HEADER:
+			/* The header says how long it is */
+			need = sizeof(sparse_header_t);
+			if (len - pos >= need)
+				need = max_t(size_t, need, ((sparse_header_t *)
+					     (data + pos))->file_hdr_sz);
+			if (len - pos < need)
+				return pos;
+			if (sparse_stream_header(ss, data + pos, response))
 				return -1;
+			/*
+			 * Skip the remaining bytes in a header that is longer
+			 * than we expected.
+			 */
+			pos += need;
+			break;
+		case SPARSE_STREAM_CHUNK:
+			need = max_t(size_t, sizeof(chunk_header_t),
+				     ss->header.chunk_hdr_sz);
+			if (len - pos < need)
+				return pos;
+			if (sparse_stream_chunk(ss, data + pos, response))
+				return -1;
+			pos += need;
+			break;
+		case SPARSE_STREAM_RAW:
+			/* Write whatever whole blocks have arrived */
+			n = min_t(u64, ss->left, len - pos);
+			n -= n % info->blksz;
+			if (!n)
+				return pos;
+			blks = write_sparse_chunk_raw(info, ss->blk,
+						      n / info->blksz,
+						      (void *)data + pos,
+						      response);
+			if (blks < 0)
+				return -1;
+			ss->blk += blks;
+			ss->bytes_written += n;
+			ss->left -= n;
+			pos += n;
+			if (!ss->left) {
+				ss->total_blocks += ss->chunk.chunk_sz;
+				sparse_stream_next(ss);
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
 			break;
-
-		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
-			return -1;
+		case SPARSE_STREAM_FILL:
+			if (len - pos < sizeof(uint32_t))
+				return pos;
+			if (sparse_stream_fill(ss, *(uint32_t *)(data + pos),
+					       response))
+				return -1;
+			pos += sizeof(uint32_t);
+			break;
+		case SPARSE_STREAM_SKIP:
+			n = min_t(u64, ss->left, len - pos);
+			ss->left -= n;
+			pos += n;
+			if (ss->left)
+				return pos;
+			sparse_stream_next(ss);
+			break;
 		}
 	}
 
+	return pos;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response)
+{
+	if (ss->state != SPARSE_STREAM_DONE) {
+		ss->info->mssg("sparse image is incomplete", response);
+		return -1;
+	}
+
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %llu bytes to '%s'\n", bytes_written, part_name);
+	      ss->total_blocks, ss->header.total_blks);
+	printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+	       part_name);
 
-	if (total_blocks != sparse_header->total_blks) {
-		info->mssg("sparse image write failure", response);
+	if (ss->total_blocks != ss->header.total_blks) {
+		ss->info->mssg("sparse image write failure", response);
 		return -1;
 	}
 
 	return 0;
 }
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	struct sparse_stream ss;
+
+	/* The whole image is in memory, so let the stream take all of it */
+	sparse_stream_start(&ss, info);
+	if (sparse_stream_write(&ss, data, SSIZE_MAX, response) < 0)
+		return -1;
+
+	return sparse_stream_finish(&ss, part_name, response);
+}
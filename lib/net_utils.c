@@ -11,6 +11,8 @@
 
 #include <common.h>
 #include <net.h>
+#include <net6.h>
+#include <linux/ctype.h>
 
 struct in_addr string_to_ip(const char *s)
 {
@@ -43,6 +45,59 @@ struct in_addr string_to_ip(const char *s)
 	return addr;
 }
 
+#if IS_ENABLED(CONFIG_IPV6)
+int string_to_ip6(const char *s, size_t len, struct in6_addr *addr)
+{
+	u16 groups[8];
+	int count = 0, gap = -1;
+	const char *end = s + len;
+	unsigned int val;
+	int digits, i;
+
+	if (!s || !len)
+		return -EINVAL;
+
+	if (len >= 2 && s[0] == ':' && s[1] == ':') {
+		gap = 0;
+		s += 2;
+	}
+	while (s < end) {
+		for (val = 0, digits = 0; s < end && isxdigit(*s); s++) {
+			if (++digits > 4)
+				return -EINVAL;
+			val = val << 4 | (isdigit(*s) ? *s - '0' :
+					  tolower(*s) - 'a' + 10);
+		}
+		if (!digits || count == 8)
+			return -EINVAL;
+		groups[count++] = val;
+		if (s == end)
+			break;
+		if (*s++ != ':' || s == end)
+			return -EINVAL;
+		if (*s == ':') {
+			/* "::" may only appear once */
+			if (gap != -1)
+				return -EINVAL;
+			gap = count;
+			s++;
+		}
+	}
+
+	if (gap == -1 ? count != 8 : count > 7)
+		return -EINVAL;
+
+	memset(addr, '\0', IN6ADDRSZ);
+	for (i = 0; i < count; i++) {
+		int pos = (gap != -1 && i >= gap) ? i + 8 - count : i;
+
+		addr->s6_addr16[pos] = htons(groups[i]);
+	}
+
+	return 0;
+}
+#endif
+
 void string_to_enetaddr(const char *addr, uint8_t *enetaddr)
 {
 	char *end;
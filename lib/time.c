@@ -13,6 +13,7 @@
 #include <spl.h>
 #include <time.h>
 #include <timer.h>
+#include <uthread.h>
 #include <watchdog.h>
 #include <div64.h>
 #include <asm/global_data.h>
@@ -194,6 +195,10 @@ void udelay(unsigned long usec)
 {
 	ulong kv;
 
+	/* Let any other threads run while waiting */
+	if (uthread_delay(usec))
+		return;
+
 	do {
 		WATCHDOG_RESET();
 		kv = usec > CONFIG_WD_PERIOD ? CONFIG_WD_PERIOD : usec;
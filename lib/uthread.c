@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Cooperative threads, which switch only where they wait
+ */
+
+#include <common.h>
+#include <time.h>
+#include <uthread.h>
+#include <watchdog.h>
+#include <asm/global_data.h>
+#include <linux/delay.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Longest that a waiting thread sleeps before letting the others run */
+#define UTHREAD_SLICE_US	100
+
+/* The code which created the threads, which takes its turn with them */
+static struct uthread uthread_main = {
+	.name	= "main",
+};
+
+/* Threads taking turns, including uthread_main while there are any others */
+static LIST_HEAD(uthread_list);
+
+/* Thread which is running, NULL if there are no threads */
+static struct uthread *uthread_current;
+
+static bool uthread_active(void)
+{
+	/* Nothing here is set up before relocation */
+	return (gd->flags & GD_FLG_RELOC) && uthread_current;
+}
+
+static struct uthread *uthread_next(struct uthread *thr)
+{
+	if (list_is_last(&thr->sibling, &uthread_list))
+		return list_first_entry(&uthread_list, struct uthread, sibling);
+
+	return list_entry(thr->sibling.next, struct uthread, sibling);
+}
+
+/* Go back to running without threads once only the main code is left */
+static void uthread_tidy(void)
+{
+	if (!list_is_singular(&uthread_list))
+		return;
+	list_del(&uthread_main.sibling);
+	arch_uthread_free(&uthread_main);
+	uthread_current = NULL;
+}
+
+static void uthread_entry(void *arg)
+{
+	struct uthread *thr = arg;
+	struct uthread *next;
+
+	thr->fn(thr->arg);
+
+	/* Leave the list for good; uthread_join() frees the stack later */
+	thr->done = true;
+	next = uthread_next(thr);
+	list_del(&thr->sibling);
+	uthread_current = next;
+	arch_uthread_switch(thr, next);
+}
+
+int uthread_create(struct uthread *thr, const char *name,
+		   void (*fn)(void *arg), void *arg, size_t stack_size)
+{
+	int ret;
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return -EPERM;
+	if (!stack_size)
+		stack_size = CONFIG_UTHREAD_STACK_SIZE;
+
+	if (!uthread_current) {
+		ret = arch_uthread_init(&uthread_main, NULL, NULL, 0);
+		if (ret)
+			return ret;
+		list_add_tail(&uthread_main.sibling, &uthread_list);
+		uthread_current = &uthread_main;
+	}
+
+	thr->name = name;
+	thr->fn = fn;
+	thr->arg = arg;
+	thr->done = false;
+	ret = arch_uthread_init(thr, uthread_entry, thr, stack_size);
+	if (ret) {
+		uthread_tidy();
+		return ret;
+	}
+	list_add_tail(&thr->sibling, &uthread_list);
+
+	return 0;
+}
+
+void uthread_schedule(void)
+{
+	struct uthread *prev, *next;
+
+	if (!uthread_active())
+		return;
+	prev = uthread_current;
+	next = uthread_next(prev);
+	if (next == prev)
+		return;
+
+	uthread_current = next;
+	arch_uthread_switch(prev, next);
+}
+
+int uthread_join(struct uthread *thr)
+{
+	if (thr == uthread_current)
+		return -EDEADLK;
+	while (!thr->done)
+		uthread_schedule();
+	arch_uthread_free(thr);
+	uthread_tidy();
+
+	return 0;
+}
+
+bool uthread_delay(unsigned long usec)
+{
+	unsigned long start, elapsed;
+
+	if (!uthread_active())
+		return false;
+
+	start = timer_get_us();
+	for (;;) {
+		uthread_schedule();
+		elapsed = timer_get_us() - start;
+		if (elapsed >= usec)
+			break;
+		WATCHDOG_RESET();
+		__udelay(min(usec - elapsed, (unsigned long)UTHREAD_SLICE_US));
+	}
+
+	return true;
+}
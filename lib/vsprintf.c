@@ -366,6 +366,44 @@ static char *ip6_addr_string(char *buf, char *end, u8 *addr, int field_width,
 		      flags & ~SPECIAL);
 }
 
+/* As ip6_addr_string() but with the longest run of zero groups as "::" */
+static char *ip6_compressed_string(char *buf, char *end, u8 *addr,
+				   int field_width, int precision, int flags)
+{
+	char ip6_addr[8 * 5];
+	char *p = ip6_addr;
+	int zero_start = -1, zero_len = 0;
+	int i, j;
+	u16 word;
+
+	for (i = 0; i < 8; i = j + 1) {
+		for (j = i; j < 8 && !addr[2 * j] && !addr[2 * j + 1]; j++)
+			;
+		if (j - i > zero_len && j - i > 1) {
+			zero_start = i;
+			zero_len = j - i;
+		}
+	}
+
+	for (i = 0; i < 8; i++) {
+		if (i == zero_start) {
+			*p++ = ':';
+			if (!i)
+				*p++ = ':';
+			i += zero_len - 1;
+			continue;
+		}
+		word = addr[2 * i] << 8 | addr[2 * i + 1];
+		p += sprintf(p, "%x", word);
+		if (i != 7)
+			*p++ = ':';
+	}
+	*p = '\0';
+
+	return string(buf, end, ip6_addr, field_width, precision,
+		      flags & ~SPECIAL);
+}
+
 static char *ip4_addr_string(char *buf, char *end, u8 *addr, int field_width,
 			 int precision, int flags)
 {
@@ -450,10 +488,10 @@ static char *uuid_string(char *buf, char *end, u8 *addr, int field_width,
  *       decimal for v4 and colon separated network-order 16 bit hex for v6)
  * - 'i' [46] for 'raw' IPv4/IPv6 addresses, IPv6 omits the colons, IPv4 is
  *       currently the same
+ * - 'I6c' for an IPv6 address in the usual compressed form (RFC 5952)
  *
- * Note: IPv6 support is currently if(0)'ed out. If you ever need
- * %pI6, please add an IPV6 Kconfig knob, make your code select or
- * depend on that, and change the 0 below to CONFIG_IS_ENABLED(IPV6).
+ * Note: IPv6 support is only built with CONFIG_IPV6; without it %pI6 prints
+ * the pointer.
  */
 static char *pointer(const char *fmt, char *buf, char *end, void *ptr,
 		int field_width, int precision, int flags)
@@ -498,10 +536,14 @@ static char *pointer(const char *fmt, char *buf, char *end, void *ptr,
 		flags |= SPECIAL;
 		/* Fallthrough */
 	case 'I':
-		/* %pI6 currently unused */
-		if (0 && fmt[1] == '6')
+		if (CONFIG_IS_ENABLED(IPV6) && fmt[1] == '6') {
+			if (fmt[2] == 'c')
+				return ip6_compressed_string(buf, end, ptr,
+							     field_width,
+							     precision, flags);
 			return ip6_addr_string(buf, end, ptr, field_width,
 					       precision, flags);
+		}
 		if (fmt[1] == '4')
 			return ip4_addr_string(buf, end, ptr, field_width,
 					       precision, flags);
@@ -27,6 +27,7 @@
 #include <env.h>
 #include <log.h>
 #include <net.h>
+#include <net6.h>
 #include <asm/unaligned.h>
 
 #include "dns.h"
@@ -36,6 +37,18 @@ char *net_dns_env_var;	/* The envvar to store the answer in */
 
 static int dns_our_port;
 
+/* Over IPv6 we ask dnsip6 for an AAAA record, else dnsip for an A record */
+#ifdef CONFIG_IPV6
+#define dns_use_ip6	net_use_ip6
+#else
+#define dns_use_ip6	false
+#endif
+
+static enum dns_query_type dns_qtype(void)
+{
+	return dns_use_ip6 ? DNS_AAAA_RECORD : DNS_A_RECORD;
+}
+
 /*
  * make port a little random (1024-17407)
  * This keeps the math somewhat trivial to compute, and seems to work with
@@ -53,10 +66,11 @@ static void dns_send(void)
 	uchar *p, *pkt;
 	const char *s;
 	const char *name;
-	enum dns_query_type qtype = DNS_A_RECORD;
+	enum dns_query_type qtype = dns_qtype();
 
 	name = net_dns_resolve;
-	pkt = (uchar *)(net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE);
+	pkt = (uchar *)(net_tx_packet + net_eth_hdr_size() +
+			(dns_use_ip6 ? IP6_UDPHDR_SIZE : IP_UDP_HDR_SIZE));
 	p = pkt;
 
 	/* Prepare DNS packet header */
@@ -101,8 +115,14 @@ static void dns_send(void)
 
 	dns_our_port = random_port();
 
-	net_send_udp_packet(net_server_ethaddr, net_dns_server,
-			    DNS_SERVICE_PORT, dns_our_port, n);
+#ifdef CONFIG_IPV6
+	if (dns_use_ip6)
+		net_send_udp_packet6(net_server_ethaddr, &net_dns_server6,
+				     DNS_SERVICE_PORT, dns_our_port, n);
+	else
+#endif
+		net_send_udp_packet(net_server_ethaddr, net_dns_server,
+				    DNS_SERVICE_PORT, dns_our_port, n);
 	debug("DNS packet sent\n");
 }
 
@@ -119,8 +139,9 @@ static void dns_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	const unsigned char *p, *e, *s;
 	u16 type, i;
 	int found, stop, dlen;
-	char ip_str[22];
+	char ip_str[40];
 	struct in_addr ip_addr;
+	int addr_len = dns_use_ip6 ? 16 : 4;
 
 
 	debug("%s\n", __func__);
@@ -149,9 +170,10 @@ static void dns_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	for (p = s; p < e && *p != '\0'; p++)
 		continue;
 
-	/* We sent query class 1, query type 1 */
-	if (&p[5] > e || get_unaligned_be16(p+1) != DNS_A_RECORD) {
-		puts("DNS: response was not an A record\n");
+	/* We sent query class 1, query type 1 (A) or 28 (AAAA) */
+	if (&p[5] > e || get_unaligned_be16(p+1) != dns_qtype()) {
+		printf("DNS: response was not an %s record\n",
+		       dns_use_ip6 ? "AAAA" : "A");
 		net_set_state(NETLOOP_SUCCESS);
 		return;
 	}
@@ -159,7 +181,7 @@ static void dns_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	/* Go to the first answer section */
 	p += 5;
 
-	/* Loop through the answers, we want A type answer */
+	/* Loop through the answers, we want the type we asked for */
 	for (found = stop = 0; !stop && &p[12] < e; ) {
 		/* Skip possible name in CNAME answer */
 		if (*p != 0xc0) {
@@ -177,8 +199,8 @@ static void dns_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			dlen = get_unaligned_be16(p+10);
 			debug("dlen = %d\n", dlen);
 			p += 12 + dlen;
-		} else if (type == DNS_A_RECORD) {
-			debug("Found A-record\n");
+		} else if (type == dns_qtype()) {
+			debug("Found %s-record\n", dns_use_ip6 ? "AAAA" : "A");
 			found = 1;
 			stop = 1;
 		} else {
@@ -190,10 +212,14 @@ static void dns_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	if (found && &p[12] < e) {
 		dlen = get_unaligned_be16(p+10);
 		p += 12;
-		memcpy(&ip_addr, p, 4);
 
-		if (p + dlen <= e) {
-			ip_to_string(ip_addr, ip_str);
+		if (dlen == addr_len && p + dlen <= e) {
+			if (dns_use_ip6) {
+				sprintf(ip_str, "%pI6c", p);
+			} else {
+				memcpy(&ip_addr, p, 4);
+				ip_to_string(ip_addr, ip_str);
+			}
 			printf("%s\n", ip_str);
 			if (net_dns_env_var)
 				env_set(net_dns_env_var, ip_str);
@@ -15,6 +15,7 @@ enum dns_query_type {
 	DNS_A_RECORD = 0x01,
 	DNS_CNAME_RECORD = 0x05,
 	DNS_MX_RECORD = 0x0f,
+	DNS_AAAA_RECORD = 0x1c,
 };
 
 /*
@@ -28,10 +28,12 @@ DECLARE_GLOBAL_DATA_PTR;
  * struct eth_device_priv - private structure for each Ethernet device
  *
  * @state: The state of the Ethernet MAC driver (defined by enum eth_state_t)
+ * @stats: Traffic counters, shown by 'net stats'
  */
 struct eth_device_priv {
 	enum eth_state_t state;
 	bool running;
+	struct eth_stats stats;
 };
 
 /**
@@ -356,8 +358,39 @@ int eth_is_active(struct udevice *dev)
 	return priv->state == ETH_STATE_ACTIVE;
 }
 
+int eth_mcast_join(struct in_addr mcast_ip, int join)
+{
+	struct udevice *current;
+	u8 mcast_mac[ARP_HLEN];
+	u32 addr = ntohl(mcast_ip.s_addr);
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+	if (!eth_get_ops(current)->mcast)
+		return -ENOSYS;
+
+	/* The group maps onto 01:00:5e plus its low 23 bits (RFC 1112) */
+	mcast_mac[0] = 0x01;
+	mcast_mac[1] = 0x00;
+	mcast_mac[2] = 0x5e;
+	mcast_mac[3] = (addr >> 16) & 0x7f;
+	mcast_mac[4] = (addr >> 8) & 0xff;
+	mcast_mac[5] = addr & 0xff;
+
+	return eth_get_ops(current)->mcast(current, mcast_mac, join);
+}
+
+struct eth_stats *eth_get_stats(struct udevice *dev)
+{
+	struct eth_device_priv *priv = dev_get_uclass_priv(dev);
+
+	return &priv->stats;
+}
+
 int eth_send(void *packet, int length)
 {
+	struct eth_device_priv *priv;
 	struct udevice *current;
 	int ret;
 
@@ -368,10 +401,15 @@ int eth_send(void *packet, int length)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+	priv = dev_get_uclass_priv(current);
 	ret = eth_get_ops(current)->send(current, packet, length);
 	if (ret < 0) {
 		/* We cannot completely return the error at present */
 		debug("%s: send() returned error %d\n", __func__, ret);
+		priv->stats.tx_errors++;
+	} else {
+		priv->stats.tx_packets++;
+		priv->stats.tx_bytes += length;
 	}
 #if defined(CONFIG_CMD_PCAP)
 	if (ret >= 0)
@@ -380,8 +418,76 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+static void eth_rx_packet(struct eth_device_priv *priv, uchar *packet,
+			  int len)
+{
+	priv->stats.rx_packets++;
+	priv->stats.rx_bytes += len;
+	net_process_received_packet(packet, len);
+}
+
+/*
+ * Fetch everything the driver has in one call, so that it can walk its ring
+ * and hand the buffers back to the hardware only once per poll
+ */
+static int eth_rx_batch(struct udevice *dev, struct eth_device_priv *priv)
+{
+	struct eth_rx_pkt pkts[ETH_PACKETS_BATCH_RECV];
+	struct eth_ops *ops = eth_get_ops(dev);
+	int ret;
+	int i;
+
+	ret = ops->recv_batch(dev, ETH_RECV_CHECK_DEVICE, pkts,
+			      ARRAY_SIZE(pkts));
+	for (i = 0; i < ret; i++) {
+		if (pkts[i].len > 0)
+			eth_rx_packet(priv, pkts[i].packet, pkts[i].len);
+	}
+	for (i = 0; i < ret && ops->free_pkt; i++)
+		ops->free_pkt(dev, pkts[i].packet, pkts[i].len);
+
+	return ret;
+}
+
+/*
+ * Fetch one frame at a time, since where the protocol wants the payload of
+ * each depends on what the previous one contained
+ */
+static int eth_rx_split(struct udevice *dev, struct eth_device_priv *priv,
+			struct eth_rx_place *place)
+{
+	struct eth_ops *ops = eth_get_ops(dev);
+	int flags = ETH_RECV_CHECK_DEVICE;
+	uchar *packet;
+	int ret;
+	int i;
+
+	for (i = 0; i < ETH_PACKETS_BATCH_RECV; i++) {
+		if (i)
+			net_rx_place(place);
+		ret = ops->recv_split(dev, flags, &packet, place);
+		flags = 0;
+		if (ret > 0 && place->placed) {
+			priv->stats.rx_packets++;
+			priv->stats.rx_bytes += ret;
+			priv->stats.rx_placed++;
+			net_process_received_split(packet, ret, place);
+		} else if (ret > 0) {
+			eth_rx_packet(priv, packet, ret);
+		}
+		if (ret >= 0 && ops->free_pkt)
+			ops->free_pkt(dev, packet, ret);
+		if (ret <= 0)
+			break;
+	}
+
+	return ret;
+}
+
 int eth_rx(void)
 {
+	struct eth_rx_place place;
+	struct eth_device_priv *priv;
 	struct udevice *current;
 	uchar *packet;
 	int flags;
@@ -395,23 +501,35 @@ int eth_rx(void)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+	priv = dev_get_uclass_priv(current);
+	if (eth_get_ops(current)->recv_split && net_rx_place(&place)) {
+		ret = eth_rx_split(current, priv, &place);
+		goto done;
+	}
+	if (eth_get_ops(current)->recv_batch) {
+		ret = eth_rx_batch(current, priv);
+		goto done;
+	}
+
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < ETH_PACKETS_BATCH_RECV; i++) {
 		ret = eth_get_ops(current)->recv(current, flags, &packet);
 		flags = 0;
 		if (ret > 0)
-			net_process_received_packet(packet, ret);
+			eth_rx_packet(priv, packet, ret);
 		if (ret >= 0 && eth_get_ops(current)->free_pkt)
 			eth_get_ops(current)->free_pkt(current, packet, ret);
 		if (ret <= 0)
 			break;
 	}
+done:
 	if (ret == -EAGAIN)
 		ret = 0;
 	if (ret < 0) {
 		/* We cannot completely return the error at present */
 		debug("%s: recv() returned error %d\n", __func__, ret);
+		priv->stats.rx_errors++;
 	}
 	return ret;
 }
@@ -546,6 +664,8 @@ static int eth_post_probe(struct udevice *dev)
 			ops->send += gd->reloc_off;
 		if (ops->recv)
 			ops->recv += gd->reloc_off;
+		if (ops->recv_batch)
+			ops->recv_batch += gd->reloc_off;
 		if (ops->free_pkt)
 			ops->free_pkt += gd->reloc_off;
 		if (ops->stop)
@@ -8,6 +8,7 @@
 #include <fastboot.h>
 #include <net.h>
 #include <net/fastboot.h>
+#include <asm/unaligned.h>
 
 enum {
 	FASTBOOT_ERROR = 0,
@@ -22,16 +23,27 @@ struct __packed fastboot_header {
 	unsigned short seq;
 };
 
-#define PACKET_SIZE 1024
-#define DATA_SIZE (PACKET_SIZE - sizeof(struct fastboot_header))
+#define PACKET_SIZE CONFIG_UDP_FUNCTION_FASTBOOT_PACKET_SIZE
+/* Longest reply we send: a header and a response */
+#define REPLY_SIZE (sizeof(struct fastboot_header) + FASTBOOT_RESPONSE_LEN)
 
 /* Sequence number sent for every packet */
 static unsigned short sequence_number = 1;
 static const unsigned short packet_size = PACKET_SIZE;
 static const unsigned short udp_version = 1;
 
+/*
+ * Download packets the host may send before waiting for a reply, agreed
+ * when the session starts; 1 unless the host asks for more
+ */
+static unsigned short window_size = 1;
+/* Download packets received since the last reply */
+static unsigned short unacked;
+/* Already told the host about a packet lost from the current window */
+static bool lost_acked;
+
 /* Keep track of last packet for resubmission */
-static uchar last_packet[PACKET_SIZE];
+static uchar last_packet[REPLY_SIZE];
 static unsigned int last_packet_len;
 
 static struct in_addr fastboot_remote_ip;
@@ -106,6 +118,34 @@ static void fastboot_timed_send_info(const char *msg)
 }
 #endif
 
+/**
+ * fastboot_send_ack() - Reply to the last download packet received in order
+ *
+ * This acknowledges it and every packet before it, so that a host sending a
+ * window of packets knows where to carry on from.
+ */
+static void fastboot_send_ack(void)
+{
+	uchar *packet;
+	struct fastboot_header response_header = {
+		.id = FASTBOOT_FASTBOOT,
+		.flags = 0,
+		.seq = htons(sequence_number - 1)
+	};
+
+	packet = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+	memcpy(packet, &response_header, sizeof(response_header));
+
+	/* Save packet for retransmitting */
+	last_packet_len = sizeof(response_header);
+	memcpy(last_packet, packet, last_packet_len);
+	unacked = 0;
+
+	net_send_udp_packet(net_server_ethaddr, fastboot_remote_ip,
+			    fastboot_remote_port, fastboot_our_port,
+			    last_packet_len);
+}
+
 /**
  * fastboot_send() - Sends a packet in response to received fastboot packet
  *
@@ -161,6 +201,24 @@ static void fastboot_send(struct fastboot_header header, char *fastboot_data,
 		tmp = htons(packet_size);
 		memcpy(packet, &tmp, sizeof(tmp));
 		packet += sizeof(tmp);
+		/*
+		 * A host which can send several download packets per reply
+		 * adds the number it would like after its version and packet
+		 * size; tell it how many it may
+		 */
+		window_size = 1;
+		unacked = 0;
+		lost_acked = false;
+		if (fastboot_data_len >= 3 * sizeof(tmp)) {
+			window_size = get_unaligned_be16(fastboot_data +
+							 2 * sizeof(tmp));
+			window_size = clamp(window_size, (unsigned short)1,
+					    (unsigned short)
+					    CONFIG_UDP_FUNCTION_FASTBOOT_WINDOW);
+			tmp = htons(window_size);
+			memcpy(packet, &tmp, sizeof(tmp));
+			packet += sizeof(tmp);
+		}
 		break;
 	case FASTBOOT_ERROR:
 		memcpy(packet, error_msg, strlen(error_msg));
@@ -174,11 +232,19 @@ static void fastboot_send(struct fastboot_header header, char *fastboot_data,
 				fastboot_data_download(fastboot_data,
 						       fastboot_data_len,
 						       response);
+				/*
+				 * Only the last packet of a window, or of the
+				 * download, needs a reply
+				 */
+				if (!*response && fastboot_data_remaining() &&
+				    ++unacked < window_size)
+					return;
 			}
 		} else if (!pending_command) {
-			strlcpy(command, fastboot_data,
-				min((size_t)fastboot_data_len + 1,
-				    sizeof(command)));
+			len = min((size_t)fastboot_data_len,
+				  sizeof(command) - 1);
+			memcpy(command, fastboot_data, len);
+			command[len] = '\0';
 			pending_command = true;
 		} else {
 			cmd = fastboot_handle_command(command, response);
@@ -207,6 +273,7 @@ static void fastboot_send(struct fastboot_header header, char *fastboot_data,
 	/* Save packet for retransmitting */
 	last_packet_len = len;
 	memcpy(last_packet, packet_base, last_packet_len);
+	unacked = 0;
 
 	net_send_udp_packet(net_server_ethaddr, fastboot_remote_ip,
 			    fastboot_remote_port, fastboot_our_port, len);
@@ -244,6 +311,12 @@ static void boot_downloaded_image(void)
 	net_set_state(NETLOOP_SUCCESS);
 }
 
+/* How far a sequence number is ahead of the one expected next */
+static unsigned short ahead(unsigned short seq)
+{
+	return seq - sequence_number;
+}
+
 /**
  * fastboot_handler() - Incoming UDP packet handler.
  *
@@ -258,8 +331,6 @@ static void fastboot_handler(uchar *packet, unsigned int dport,
 			     unsigned int len)
 {
 	struct fastboot_header header;
-	char fastboot_data[DATA_SIZE] = {0};
-	unsigned int fastboot_data_len = 0;
 
 	if (dport != fastboot_our_port)
 		return;
@@ -277,27 +348,33 @@ static void fastboot_handler(uchar *packet, unsigned int dport,
 
 	switch (header.id) {
 	case FASTBOOT_QUERY:
-		fastboot_send(header, fastboot_data, 0, 0);
+		fastboot_send(header, (char *)packet, 0, 0);
 		break;
 	case FASTBOOT_INIT:
 	case FASTBOOT_FASTBOOT:
-		fastboot_data_len = len;
-		if (len > 0)
-			memcpy(fastboot_data, packet, len);
 		if (header.seq == sequence_number) {
-			fastboot_send(header, fastboot_data,
-				      fastboot_data_len, 0);
+			fastboot_send(header, (char *)packet, len, 0);
 			sequence_number++;
+			lost_acked = false;
+		} else if (unacked || (!lost_acked &&
+				       ahead(header.seq) < window_size)) {
+			/*
+			 * A packet in the window was lost, perhaps the first
+			 * one, or the host is resending: tell it where we got
+			 * to. The rest of the window is likely to follow a lost
+			 * packet, so only do this once until it is resent
+			 */
+			fastboot_send_ack();
+			lost_acked = true;
 		} else if (header.seq == sequence_number - 1) {
 			/* Retransmit last sent packet */
-			fastboot_send(header, fastboot_data,
-				      fastboot_data_len, 1);
+			fastboot_send(header, (char *)packet, len, 1);
 		}
 		break;
 	default:
 		pr_err("ID %d not implemented.\n", header.id);
 		header.id = FASTBOOT_ERROR;
-		fastboot_send(header, fastboot_data, 0, 0);
+		fastboot_send(header, (char *)packet, 0, 0);
 		break;
 	}
 }
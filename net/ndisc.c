@@ -0,0 +1,392 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * IPv6 neighbour discovery (RFC 4861) and address autoconfiguration
+ * (RFC 4862)
+ *
+ * As with ARP, only one packet can wait for a neighbour at a time. Duplicate
+ * address detection is not done.
+ */
+
+#include <common.h>
+#include <env.h>
+#include <log.h>
+#include <ndisc.h>
+#include <net.h>
+#include <net6.h>
+
+struct in6_addr net_nd_sol_packet_ip6;
+struct in6_addr net_nd_rep_packet_ip6;
+uchar *net_nd_packet_mac;
+int net_nd_tx_packet_size;
+ulong net_nd_timer_start;
+int net_nd_try;
+
+/**
+ * struct ndisc_entry - A neighbour whose MAC address we know
+ *
+ * @ip6:	Its IPv6 address
+ * @enetaddr:	Its MAC address
+ * @valid:	true if this entry is in use
+ */
+struct ndisc_entry {
+	struct in6_addr ip6;
+	u8 enetaddr[ARP_HLEN];
+	bool valid;
+};
+
+static struct ndisc_entry ndisc_cache[NDISC_CACHE_SIZE];
+/* Entry to replace next once the cache is full */
+static int ndisc_cache_next;
+
+/* Buffer for our own messages, so that a waiting packet is not overwritten */
+static uchar *ndisc_tx_packet;
+static uchar ndisc_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
+
+/* Number of router solicitations sent while running the RS protocol */
+static int ndisc_rs_count;
+
+static const struct in6_addr ndisc_all_routers = {
+	.s6_addr = { 0xff, 0x02, [15] = 0x02 }
+};
+
+static const struct in6_addr ndisc_all_nodes = {
+	.s6_addr = { 0xff, 0x02, [15] = 0x01 }
+};
+
+void ndisc_init(void)
+{
+	ndisc_tx_packet = &ndisc_tx_packet_buf[0] + (PKTALIGN - 1);
+	ndisc_tx_packet -= (ulong)ndisc_tx_packet % PKTALIGN;
+	ndisc_flush();
+}
+
+void ndisc_flush(void)
+{
+	memset(ndisc_cache, '\0', sizeof(ndisc_cache));
+	ndisc_cache_next = 0;
+	net_copy_ip6(&net_nd_sol_packet_ip6, &net_null_addr_ip6);
+	net_nd_packet_mac = NULL;
+	net_nd_tx_packet_size = 0;
+}
+
+bool ndisc_lookup(const struct in6_addr *ip6, u8 enetaddr[ARP_HLEN])
+{
+	int i;
+
+	for (i = 0; i < NDISC_CACHE_SIZE; i++) {
+		if (ndisc_cache[i].valid &&
+		    !memcmp(&ndisc_cache[i].ip6, ip6, IN6ADDRSZ)) {
+			memcpy(enetaddr, ndisc_cache[i].enetaddr, ARP_HLEN);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void ndisc_update(const struct in6_addr *ip6,
+			 const u8 enetaddr[ARP_HLEN])
+{
+	struct ndisc_entry *entry = NULL;
+	int i;
+
+	if (ip6_is_unspecified_addr(ip6) || ip6_is_multicast_addr(ip6))
+		return;
+	for (i = 0; i < NDISC_CACHE_SIZE; i++) {
+		if (ndisc_cache[i].valid &&
+		    !memcmp(&ndisc_cache[i].ip6, ip6, IN6ADDRSZ)) {
+			entry = &ndisc_cache[i];
+			break;
+		}
+	}
+	if (!entry) {
+		entry = &ndisc_cache[ndisc_cache_next];
+		ndisc_cache_next = (ndisc_cache_next + 1) % NDISC_CACHE_SIZE;
+		net_copy_ip6(&entry->ip6, ip6);
+		entry->valid = true;
+	}
+	memcpy(entry->enetaddr, enetaddr, ARP_HLEN);
+}
+
+/* Find the link-layer address option of the given type, if there is one */
+static const u8 *ndisc_find_lladdr(const u8 *opt, int len, int type)
+{
+	while (len >= 8 && opt[1]) {
+		if (opt[0] == type && opt[1] == ND_OPT_LLADDR_LEN)
+			return opt + 2;
+		len -= opt[1] * 8;
+		opt += opt[1] * 8;
+	}
+
+	return NULL;
+}
+
+static int ndisc_add_lladdr(u8 *opt, int type)
+{
+	opt[0] = type;
+	opt[1] = ND_OPT_LLADDR_LEN;
+	memcpy(opt + 2, net_ethaddr, ARP_HLEN);
+
+	return ND_OPT_LLADDR_SIZE;
+}
+
+/* Fill in the headers of an ICMPv6 message in ndisc_tx_packet and send it */
+static void ndisc_send(const u8 *enetaddr, const struct in6_addr *src,
+		       const struct in6_addr *dest, int len)
+{
+	struct icmp6_hdr *icmp;
+	int eth_hdr_size;
+	u8 mcast_ether[ARP_HLEN];
+	u16 csum;
+
+	if (ip6_is_multicast_addr(dest)) {
+		ip6_make_mult_ethdstaddr(mcast_ether, dest);
+		enetaddr = mcast_ether;
+	}
+	eth_hdr_size = net_set_ether(ndisc_tx_packet, enetaddr, PROT_IPV6);
+	/* Neighbour discovery is only valid within the link (hop limit 255) */
+	ip6_add_hdr(ndisc_tx_packet + eth_hdr_size, src, dest, IPPROTO_ICMPV6,
+		    255, len);
+
+	icmp = (void *)ndisc_tx_packet + eth_hdr_size + IP6_HDR_SIZE;
+	icmp->icmp6_code = 0;
+	icmp->icmp6_cksum = 0;
+	csum = csum_ipv6_magic(src, dest, len, IPPROTO_ICMPV6,
+			       csum_partial((uchar *)icmp, len, 0));
+	icmp->icmp6_cksum = htons(csum);
+
+	net_send_packet(ndisc_tx_packet, eth_hdr_size + IP6_HDR_SIZE + len);
+}
+
+static struct icmp6_hdr *ndisc_msg(void)
+{
+	return (void *)ndisc_tx_packet + net_eth_hdr_size() + IP6_HDR_SIZE;
+}
+
+static void ndisc_send_ns(const struct in6_addr *target)
+{
+	struct nd_msg *msg = (struct nd_msg *)ndisc_msg();
+	struct in6_addr snma;
+	int len;
+
+	debug_cond(DEBUG_DEV_PKT, "NS for %pI6c, try %d\n", target,
+		   net_nd_try);
+	msg->icmph.icmp6_type = ICMPV6_NEIGHBOR_SOLICIT;
+	msg->icmph.un.data = 0;
+	net_copy_ip6(&msg->target, target);
+	len = sizeof(*msg) + ndisc_add_lladdr(msg->opt, ND_OPT_SOURCE_LL_ADDR);
+
+	ip6_make_snma(&snma, target);
+	ndisc_send(NULL, ip6_src_addr(target), &snma, len);
+}
+
+static void ndisc_send_na(const u8 *enetaddr, const struct in6_addr *dest,
+			  const struct in6_addr *target, bool solicited)
+{
+	struct nd_msg *msg = (struct nd_msg *)ndisc_msg();
+	u32 flags = ND_NA_FLAG_OVERRIDE;
+	int len;
+
+	if (solicited)
+		flags |= ND_NA_FLAG_SOLICITED;
+	msg->icmph.icmp6_type = ICMPV6_NEIGHBOR_ADVERT;
+	msg->icmph.un.data = htonl(flags);
+	net_copy_ip6(&msg->target, target);
+	len = sizeof(*msg) + ndisc_add_lladdr(msg->opt, ND_OPT_TARGET_LL_ADDR);
+
+	ndisc_send(enetaddr, target, dest, len);
+}
+
+static void ndisc_send_rs(void)
+{
+	struct rs_msg *msg = (struct rs_msg *)ndisc_msg();
+	int len;
+
+	msg->icmph.icmp6_type = ICMPV6_ROUTER_SOLICIT;
+	msg->icmph.un.data = 0;
+	len = sizeof(*msg) + ndisc_add_lladdr(msg->opt, ND_OPT_SOURCE_LL_ADDR);
+
+	ndisc_send(NULL, &net_link_local_ip6, &ndisc_all_routers, len);
+}
+
+void ndisc_request(void)
+{
+	ndisc_send_ns(&net_nd_rep_packet_ip6);
+}
+
+int ndisc_timeout_check(void)
+{
+	ulong t;
+
+	if (!ndisc_is_waiting())
+		return 0;
+
+	t = get_timer(0);
+
+	/* check for NDISC timeout */
+	if ((t - net_nd_timer_start) > CONFIG_ARP_TIMEOUT) {
+		net_nd_try++;
+
+		if (net_nd_try >= CONFIG_NET_RETRY_COUNT) {
+			puts("\nNDISC Retry count exceeded; starting again\n");
+			net_nd_try = 0;
+			net_set_state(NETLOOP_FAIL);
+		} else {
+			net_nd_timer_start = t;
+			ndisc_request();
+		}
+	}
+
+	return 1;
+}
+
+/* Take our global address from a prefix that is meant for SLAAC */
+static void ndisc_use_prefix(const struct nd_opt_prefix_info *pi)
+{
+	struct in6_addr addr;
+	char buf[60];
+
+	if (pi->len != sizeof(*pi) / 8 || !(pi->flags & ND_OPT_PI_FLAG_AUTO) ||
+	    pi->prefix_len != 64 || !pi->valid_lifetime ||
+	    ip6_is_link_local_addr(&pi->prefix))
+		return;
+	if (!ip6_is_unspecified_addr(&net_ip6))
+		return;
+
+	memcpy(&addr, &pi->prefix, 8);
+	ip6_make_eui64(&addr, net_ethaddr);
+	net_copy_ip6(&net_ip6, &addr);
+	net_prefix_length = pi->prefix_len;
+
+	sprintf(buf, "%pI6c/%d", &net_ip6, net_prefix_length);
+	env_set("ip6addr", buf);
+}
+
+static int ndisc_receive_ra(struct ip6_hdr *ip6, struct ra_msg *msg, int len)
+{
+	const struct nd_opt_prefix_info *pi;
+	u16 lifetime = ntohl(msg->icmph.un.data) & 0xffff;
+	const u8 *opt = msg->opt;
+	char buf[50];
+
+	/* Only routers on the link may send these */
+	if (!ip6_is_link_local_addr(&ip6->saddr))
+		return -EINVAL;
+
+	for (len -= sizeof(*msg); len >= 8 && opt[1]; len -= opt[1] * 8,
+	     opt += opt[1] * 8) {
+		if (opt[1] * 8 > len)
+			return -EINVAL;
+		pi = (const struct nd_opt_prefix_info *)opt;
+		if (opt[0] == ND_OPT_PREFIX_INFO)
+			ndisc_use_prefix(pi);
+	}
+
+	if (lifetime && ip6_is_unspecified_addr(&net_gateway6)) {
+		net_copy_ip6(&net_gateway6, &ip6->saddr);
+		sprintf(buf, "%pI6c", &net_gateway6);
+		env_set("gatewayip6", buf);
+	}
+
+	if (ndisc_rs_count && !ip6_is_unspecified_addr(&net_ip6)) {
+		printf("IPv6 address %pI6c/%d from router %pI6c\n", &net_ip6,
+		       net_prefix_length, &ip6->saddr);
+		ndisc_rs_count = 0;
+		net_set_state(NETLOOP_SUCCESS);
+	}
+
+	return 0;
+}
+
+int ndisc_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len)
+{
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	struct nd_msg *msg = (struct nd_msg *)icmp;
+	const u8 *lladdr;
+	int mlen = len - IP6_HDR_SIZE;
+
+	/* Messages from beyond the link are not to be trusted */
+	if (ip6->hop_limit != 255 || icmp->icmp6_code)
+		return -EINVAL;
+
+	switch (icmp->icmp6_type) {
+	case ICMPV6_NEIGHBOR_SOLICIT:
+		if (mlen < sizeof(*msg) || !ip6_is_our_addr(&msg->target))
+			return -EINVAL;
+		lladdr = ndisc_find_lladdr(msg->opt, mlen - sizeof(*msg),
+					   ND_OPT_SOURCE_LL_ADDR);
+		if (lladdr)
+			ndisc_update(&ip6->saddr, lladdr);
+
+		debug_cond(DEBUG_DEV_PKT, "Got NS from %pI6c, sending NA\n",
+			   &ip6->saddr);
+		if (ip6_is_unspecified_addr(&ip6->saddr))
+			ndisc_send_na(NULL, &ndisc_all_nodes, &msg->target,
+				      false);
+		else
+			ndisc_send_na(lladdr ?: et->et_src, &ip6->saddr,
+				      &msg->target, true);
+		return 0;
+	case ICMPV6_NEIGHBOR_ADVERT:
+		if (mlen < sizeof(*msg))
+			return -EINVAL;
+		lladdr = ndisc_find_lladdr(msg->opt, mlen - sizeof(*msg),
+					   ND_OPT_TARGET_LL_ADDR);
+		if (!lladdr)
+			lladdr = et->et_src;
+		ndisc_update(&msg->target, lladdr);
+
+		/* are we waiting for this one? */
+		if (!ndisc_is_waiting() ||
+		    memcmp(&msg->target, &net_nd_rep_packet_ip6, IN6ADDRSZ))
+			return 0;
+
+		debug_cond(DEBUG_DEV_PKT, "Got NA, set eth addr (%pM)\n",
+			   lladdr);
+		if (net_nd_packet_mac)
+			memcpy(net_nd_packet_mac, lladdr, ARP_HLEN);
+		memcpy(((struct ethernet_hdr *)net_tx_packet)->et_dest, lladdr,
+		       ARP_HLEN);
+		net_send_packet(net_tx_packet, net_nd_tx_packet_size);
+
+		/* no request pending now */
+		net_copy_ip6(&net_nd_sol_packet_ip6, &net_null_addr_ip6);
+		net_nd_tx_packet_size = 0;
+		net_nd_packet_mac = NULL;
+		return 0;
+	case ICMPV6_ROUTER_ADVERT:
+		if (mlen < sizeof(struct ra_msg))
+			return -EINVAL;
+		lladdr = ndisc_find_lladdr(((struct ra_msg *)icmp)->opt,
+					   mlen - sizeof(struct ra_msg),
+					   ND_OPT_SOURCE_LL_ADDR);
+		if (lladdr)
+			ndisc_update(&ip6->saddr, lladdr);
+		return ndisc_receive_ra(ip6, (struct ra_msg *)icmp, mlen);
+	default:
+		/* We are not a router, so ignore solicitations for one */
+		return -EINVAL;
+	}
+}
+
+static void ndisc_rs_timeout_handler(void)
+{
+	if (ndisc_rs_count >= NDISC_RS_COUNT) {
+		puts("\nNo router advertisement received\n");
+		ndisc_rs_count = 0;
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	ndisc_rs_count++;
+	net_set_timeout_handler(NDISC_RS_INTERVAL, ndisc_rs_timeout_handler);
+	ndisc_send_rs();
+}
+
+void ndisc_rs_start(void)
+{
+	printf("Using %s device\n", eth_get_name());
+	puts("Sending IPv6 router solicitation\n");
+
+	ndisc_rs_count = 0;
+	ndisc_rs_timeout_handler();
+}
@@ -90,9 +90,13 @@
 #include <errno.h>
 #include <image.h>
 #include <log.h>
+#include <ndisc.h>
 #include <net.h>
+#include <net6.h>
 #include <net/fastboot.h>
+#include <net/tcp.h>
 #include <net/tftp.h>
+#include <net/wget.h>
 #if defined(CONFIG_CMD_PCAP)
 #include <net/pcap.h>
 #endif
@@ -140,10 +144,16 @@ u8 net_server_ethaddr[6];
 struct in_addr	net_ip;
 /* Server IP addr (0 = unknown) */
 struct in_addr	net_server_ip;
+/* Multicast group joined (0 = none) */
+struct in_addr	net_mcast_addr;
 /* Current receive packet */
 uchar *net_rx_packet;
 /* Current rx packet length */
 int		net_rx_packet_len;
+/* Payload of the current rx packet, if the driver placed it elsewhere */
+uchar *net_rx_payload;
+/* Length of the headers left in net_rx_packet when net_rx_payload is set */
+static int	net_rx_hdr_len;
 /* IP packet ID */
 static unsigned	net_ip_id;
 /* Ethernet bcast address */
@@ -189,6 +199,8 @@ static rxhand_icmp_f *packet_icmp_handler;
 #endif
 /* Current timeout handler */
 static thand_f *time_handler;
+/* Current RX placement handler */
+static rxplace_f *rx_place_handler;
 /* Time base value */
 static ulong	time_start;
 /* Current timeout value */
@@ -340,15 +352,20 @@ void net_auto_load(void)
 
 static int net_init_loop(void)
 {
-	if (eth_get_dev())
+	if (eth_get_dev()) {
 		memcpy(net_ethaddr, eth_get_ethaddr(), 6);
-	else
+		if (IS_ENABLED(CONFIG_IPV6)) {
+			ip6_make_lladdr(&net_link_local_ip6, net_ethaddr);
+			ndisc_flush();
+		}
+	} else {
 		/*
 		 * Not ideal, but there's no way to get the actual error, and I
 		 * don't feel like fixing all the users of eth_get_dev to deal
 		 * with errors.
 		 */
 		return -ENONET;
+	}
 
 	return 0;
 }
@@ -358,11 +375,23 @@ static void net_clear_handlers(void)
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
 	net_set_timeout_handler(0, NULL);
+	net_set_rx_place_handler(NULL);
+}
+
+void net_mcast_leave(void)
+{
+	if (!net_mcast_addr.s_addr)
+		return;
+	eth_mcast_join(net_mcast_addr, 0);
+	net_mcast_addr.s_addr = 0;
 }
 
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+	net_mcast_leave();
+	if (IS_ENABLED(CONFIG_PROT_TCP))
+		tcp_reset_state();
 }
 
 int net_init(void)
@@ -382,6 +411,8 @@ int net_init(void)
 				(i + 1) * PKTSIZE_ALIGN;
 		}
 		arp_init();
+		if (IS_ENABLED(CONFIG_IPV6))
+			ndisc_init();
 		net_clear_handlers();
 
 		/* Only need to setup buffer pointers once. */
@@ -404,6 +435,17 @@ int net_loop(enum proto_t protocol)
 #if defined(CONFIG_CMD_PING)
 	if (protocol != PING)
 		net_ping_ip.s_addr = 0;
+#endif
+#if defined(CONFIG_CMD_PING6)
+	if (protocol != PING6)
+		net_copy_ip6(&net_ping_ip6, &net_null_addr_ip6);
+#endif
+#if defined(CONFIG_IPV6)
+	/* Without a static address, ask a router for one first (SLAAC) */
+	if (net_use_ip6 && protocol != RS && ip6_is_unspecified_addr(&net_ip6)) {
+		if (net_loop(RS) < 0)
+			puts("Using the link-local address only\n");
+	}
 #endif
 	net_restarted = 0;
 	net_dev_exists = 0;
@@ -497,6 +539,16 @@ restart:
 			ping_start();
 			break;
 #endif
+#if defined(CONFIG_CMD_PING6)
+		case PING6:
+			ping6_start();
+			break;
+#endif
+#if defined(CONFIG_IPV6)
+		case RS:
+			ndisc_rs_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_NFS) && !defined(CONFIG_SPL_BUILD)
 		case NFS:
 			nfs_start();
@@ -526,6 +578,11 @@ restart:
 		case WOL:
 			wol_start();
 			break;
+#endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
 #endif
 		default:
 			break;
@@ -562,6 +619,8 @@ restart:
 		WATCHDOG_RESET();
 		if (arp_timeout_check() > 0)
 			time_start = get_timer(0);
+		if (IS_ENABLED(CONFIG_IPV6) && ndisc_timeout_check() > 0)
+			time_start = get_timer(0);
 
 		/*
 		 *	Check the ethernet for a new packet.  The ethernet
@@ -577,6 +636,8 @@ restart:
 		if (ctrlc()) {
 			/* cancel any ARP that may not have completed */
 			net_arp_wait_packet_ip.s_addr = 0;
+			if (IS_ENABLED(CONFIG_IPV6))
+				ndisc_flush();
 
 			net_cleanup_loop();
 			eth_halt();
@@ -708,6 +769,8 @@ int net_start_again(void)
 		retry_forever = 0;
 	}
 
+	/* Leave the group while the device which joined it is current */
+	net_mcast_leave();
 	if ((!retry_forever) && (net_try_count > retrycnt)) {
 		eth_halt();
 		net_set_state(NETLOOP_FAIL);
@@ -801,10 +864,91 @@ void net_set_timeout_handler(ulong iv, thand_f *f)
 	}
 }
 
+void net_set_rx_place_handler(rxplace_f *f)
+{
+	rx_place_handler = f;
+}
+
+bool net_rx_place(struct eth_rx_place *place)
+{
+	int app_hdr_len, max_len, port;
+
+	place->payload = NULL;
+	place->placed = false;
+	/* Only IPv4 for now, and nothing that must see the whole packet */
+	if (!rx_place_handler || (IS_ENABLED(CONFIG_IPV6) && net_use_ip6))
+		return false;
+#if defined(CONFIG_CMD_PCAP)
+	if (pcap_active())
+		return false;
+#endif
+#if defined(CONFIG_API) || defined(CONFIG_EFI_LOADER)
+	if (push_packet)
+		return false;
+#endif
+	place->payload = rx_place_handler(&app_hdr_len, &max_len, &port);
+	if (!place->payload)
+		return false;
+	place->hdr_len = net_eth_hdr_size() + IP_UDP_HDR_SIZE + app_hdr_len;
+	place->max_len = max_len;
+	place->port = port;
+
+	return true;
+}
+
+/*
+ * Check that a split packet is an unfragmented UDP packet for @port with the
+ * headers that were expected, so that the payload starts at net_rx_hdr_len
+ */
+static bool net_rx_split_ok(uchar *in_packet, int port)
+{
+	struct ethernet_hdr *et = (struct ethernet_hdr *)in_packet;
+	int eth_hdr_size = net_eth_hdr_size();
+	struct ip_udp_hdr *ip;
+	ushort proto;
+
+	ip = (struct ip_udp_hdr *)(in_packet + eth_hdr_size);
+	proto = ntohs(et->et_protlen);
+	if (eth_hdr_size == VLAN_ETHER_HDR_SIZE) {
+		if (proto != PROT_VLAN)
+			return false;
+		proto = ntohs(((struct vlan_ethernet_hdr *)et)->vet_type);
+	}
+
+	return proto == PROT_IP && ip->ip_hl_v == 0x45 &&
+		ip->ip_p == IPPROTO_UDP && ntohs(ip->udp_dst) == port &&
+		!(ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG)) &&
+		ntohs(ip->udp_len) > net_rx_hdr_len - eth_hdr_size - IP_HDR_SIZE;
+}
+
+void net_rx_unsplit(void)
+{
+	if (!net_rx_payload)
+		return;
+	memcpy(net_rx_packet + net_rx_hdr_len, net_rx_payload,
+	       net_rx_packet_len - net_rx_hdr_len);
+	net_rx_payload = NULL;
+}
+
+void net_process_received_split(uchar *in_packet, int len,
+				const struct eth_rx_place *place)
+{
+	net_rx_packet = in_packet;
+	net_rx_packet_len = len;
+	net_rx_payload = place->payload;
+	net_rx_hdr_len = place->hdr_len;
+	if (!net_rx_split_ok(in_packet, place->port))
+		net_rx_unsplit();
+	net_process_received_packet(in_packet, len);
+	net_rx_payload = NULL;
+}
+
 uchar *net_get_async_tx_pkt_buf(void)
 {
 	if (arp_is_waiting())
 		return arp_tx_packet; /* If we are waiting, we already sent */
+	else if (IS_ENABLED(CONFIG_IPV6) && ndisc_is_waiting())
+		return arp_tx_packet; /* likewise for neighbour discovery */
 	else
 		return net_tx_packet;
 }
@@ -847,6 +991,14 @@ int net_send_ip_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 				   payload_len);
 		pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 		break;
+#if defined(CONFIG_PROT_TCP)
+	case IPPROTO_TCP:
+		pkt_hdr_size = eth_hdr_size +
+			tcp_set_tcp_header(pkt + eth_hdr_size, dest, dport,
+					   sport, payload_len, action,
+					   tcp_seq_num, tcp_ack_num);
+		break;
+#endif
 	default:
 		return -EINVAL;
 	}
@@ -1187,6 +1339,12 @@ void net_process_received_packet(uchar *in_packet, int len)
 	case PROT_RARP:
 		rarp_receive(ip, len);
 		break;
+#endif
+#ifdef CONFIG_IPV6
+	case PROT_IPV6:
+		debug_cond(DEBUG_NET_PKT, "Got IPv6\n");
+		net_ip6_handler(et, (struct ip6_hdr *)ip, len);
+		break;
 #endif
 	case PROT_IP:
 		debug_cond(DEBUG_NET_PKT, "Got IP\n");
@@ -1219,7 +1377,9 @@ void net_process_received_packet(uchar *in_packet, int len)
 		/* If it is not for us, ignore it */
 		dst_ip = net_read_ip(&ip->ip_dst);
 		if (net_ip.s_addr && dst_ip.s_addr != net_ip.s_addr &&
-		    dst_ip.s_addr != 0xFFFFFFFF) {
+		    dst_ip.s_addr != 0xFFFFFFFF &&
+		    (!net_mcast_addr.s_addr ||
+		     dst_ip.s_addr != net_mcast_addr.s_addr)) {
 				return;
 		}
 		/* Read source IP address for later use */
@@ -1256,6 +1416,11 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#if defined(CONFIG_PROT_TCP)
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive((struct ip_tcp_hdr *)ip, len);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1283,11 +1448,18 @@ void net_process_received_packet(uchar *in_packet, int len)
 			sumptr = (u8 *)&ip->udp_src;
 
 			while (sumlen > 1) {
+				/* Carry on in the payload if it was placed */
+				if (net_rx_payload &&
+				    sumptr == net_rx_packet + net_rx_hdr_len)
+					sumptr = net_rx_payload;
 				/* inlined ntohs() to avoid alignment errors */
 				xsum += (sumptr[0] << 8) + sumptr[1];
 				sumptr += 2;
 				sumlen -= 2;
 			}
+			if (net_rx_payload &&
+			    sumptr == net_rx_packet + net_rx_hdr_len)
+				sumptr = net_rx_payload;
 			if (sumlen > 0)
 				xsum += (sumptr[0] << 8) + sumptr[0];
 			while ((xsum >> 16) != 0) {
@@ -1339,8 +1511,25 @@ static int net_check_prereq(enum proto_t protocol)
 		}
 		goto common;
 #endif
+#if defined(CONFIG_CMD_PING6)
+	case PING6:
+		if (ip6_is_unspecified_addr(&net_ping_ip6)) {
+			puts("*** ERROR: ping address not given\n");
+			return 1;
+		}
+		goto common6;
+#endif
 #if defined(CONFIG_CMD_DNS)
 	case DNS:
+#if defined(CONFIG_IPV6)
+		if (net_use_ip6) {
+			if (ip6_is_unspecified_addr(&net_dns_server6)) {
+				puts("*** ERROR: DNS server address not given\n");
+				return 1;
+			}
+			goto common6;
+		}
+#endif
 		if (net_dns_server.s_addr == 0) {
 			puts("*** ERROR: DNS server address not given\n");
 			return 1;
@@ -1356,10 +1545,23 @@ static int net_check_prereq(enum proto_t protocol)
 
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 		/* Fall through */
 	case TFTPGET:
 	case TFTPPUT:
+#if defined(CONFIG_IPV6)
+		if (net_use_ip6) {
+			if (ip6_is_unspecified_addr(&net_server_ip6) &&
+			    !is_serverip6_in_cmd()) {
+				puts("*** ERROR: `serverip6' not set\n");
+				return 1;
+			}
+			goto common6;
+		}
+#endif
 		if (net_server_ip.s_addr == 0 && !is_serverip_in_cmd()) {
 			puts("*** ERROR: `serverip' not set\n");
 			return 1;
@@ -1381,6 +1583,11 @@ common:
 
 #ifdef CONFIG_CMD_RARP
 	case RARP:
+#endif
+#ifdef CONFIG_IPV6
+	/* IPv6 needs no configured address: there is always a link-local one */
+	case RS:
+common6:
 #endif
 	case BOOTP:
 	case CDP:
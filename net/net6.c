@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * IPv6 layer
+ *
+ * Builds and checks IPv6 and UDP headers, passes received packets on to
+ * neighbour discovery, ping6 or the UDP handler, and answers echo requests.
+ * Only packets without extension headers are handled.
+ */
+
+#include <common.h>
+#include <env.h>
+#include <env_internal.h>
+#include <log.h>
+#include <ndisc.h>
+#include <net.h>
+#include <net6.h>
+
+const struct in6_addr net_null_addr_ip6;
+struct in6_addr net_ip6;
+struct in6_addr net_link_local_ip6;
+u32 net_prefix_length;
+struct in6_addr net_gateway6;
+struct in6_addr net_server_ip6;
+struct in6_addr net_rx_src_ip6;
+struct in6_addr net_dns_server6;
+bool net_use_ip6;
+
+static int on_ip6addr(const char *name, const char *value, enum env_op op,
+		      int flags)
+{
+	const char *mask;
+	size_t len;
+
+	if (flags & H_PROGRAMMATIC)
+		return 0;
+
+	if (op == env_op_delete) {
+		net_prefix_length = 0;
+		net_copy_ip6(&net_ip6, &net_null_addr_ip6);
+		return 0;
+	}
+
+	/* The prefix length is optional; a /64 subnet is by far the most usual */
+	mask = strchr(value, '/');
+	if (mask) {
+		net_prefix_length = dectoul(mask + 1, NULL);
+		len = mask - value;
+	} else {
+		net_prefix_length = 64;
+		len = strlen(value);
+	}
+
+	return string_to_ip6(value, len, &net_ip6);
+}
+U_BOOT_ENV_CALLBACK(ip6addr, on_ip6addr);
+
+static int on_ip6_var(struct in6_addr *addr, const char *value,
+		      enum env_op op, int flags)
+{
+	if (flags & H_PROGRAMMATIC)
+		return 0;
+
+	if (op == env_op_delete) {
+		net_copy_ip6(addr, &net_null_addr_ip6);
+		return 0;
+	}
+
+	return string_to_ip6(value, strlen(value), addr);
+}
+
+static int on_gatewayip6(const char *name, const char *value, enum env_op op,
+			 int flags)
+{
+	return on_ip6_var(&net_gateway6, value, op, flags);
+}
+U_BOOT_ENV_CALLBACK(gatewayip6, on_gatewayip6);
+
+static int on_serverip6(const char *name, const char *value, enum env_op op,
+			int flags)
+{
+	return on_ip6_var(&net_server_ip6, value, op, flags);
+}
+U_BOOT_ENV_CALLBACK(serverip6, on_serverip6);
+
+static int on_dnsip6(const char *name, const char *value, enum env_op op,
+		     int flags)
+{
+	return on_ip6_var(&net_dns_server6, value, op, flags);
+}
+U_BOOT_ENV_CALLBACK(dnsip6, on_dnsip6);
+
+bool ip6_is_our_addr(const struct in6_addr *addr)
+{
+	return !memcmp(addr, &net_link_local_ip6, IN6ADDRSZ) ||
+	       (!ip6_is_unspecified_addr(&net_ip6) &&
+		!memcmp(addr, &net_ip6, IN6ADDRSZ));
+}
+
+void ip6_make_eui64(struct in6_addr *addr, const u8 enetaddr[ARP_HLEN])
+{
+	/* Flip the universal/local bit and put ff:fe in the middle */
+	addr->s6_addr[8] = enetaddr[0] ^ 0x02;
+	addr->s6_addr[9] = enetaddr[1];
+	addr->s6_addr[10] = enetaddr[2];
+	addr->s6_addr[11] = 0xff;
+	addr->s6_addr[12] = 0xfe;
+	addr->s6_addr[13] = enetaddr[3];
+	addr->s6_addr[14] = enetaddr[4];
+	addr->s6_addr[15] = enetaddr[5];
+}
+
+void ip6_make_lladdr(struct in6_addr *lladdr, const u8 enetaddr[ARP_HLEN])
+{
+	memset(lladdr, '\0', IN6ADDRSZ);
+	lladdr->s6_addr[0] = 0xfe;
+	lladdr->s6_addr[1] = 0x80;
+	ip6_make_eui64(lladdr, enetaddr);
+}
+
+void ip6_make_snma(struct in6_addr *mcast_addr, const struct in6_addr *ip6_addr)
+{
+	/* ff02::1:ff00:0/104 plus the last 24 bits of the address */
+	memset(mcast_addr, '\0', IN6ADDRSZ);
+	mcast_addr->s6_addr[0] = 0xff;
+	mcast_addr->s6_addr[1] = 0x02;
+	mcast_addr->s6_addr[11] = 0x01;
+	mcast_addr->s6_addr[12] = 0xff;
+	mcast_addr->s6_addr[13] = ip6_addr->s6_addr[13];
+	mcast_addr->s6_addr[14] = ip6_addr->s6_addr[14];
+	mcast_addr->s6_addr[15] = ip6_addr->s6_addr[15];
+}
+
+void ip6_make_mult_ethdstaddr(u8 enetaddr[ARP_HLEN],
+			      const struct in6_addr *mcast_addr)
+{
+	enetaddr[0] = 0x33;
+	enetaddr[1] = 0x33;
+	memcpy(&enetaddr[2], &mcast_addr->s6_addr[12], 4);
+}
+
+bool ip6_addr_in_subnet(const struct in6_addr *our_addr,
+			const struct in6_addr *neigh_addr, u32 prefix_length)
+{
+	int bytes = min(prefix_length, 128U) / 8;
+	int bits = min(prefix_length, 128U) % 8;
+	u8 mask;
+
+	if (memcmp(our_addr, neigh_addr, bytes))
+		return false;
+	if (!bits)
+		return true;
+	mask = 0xff << (8 - bits);
+
+	return !((our_addr->s6_addr[bytes] ^ neigh_addr->s6_addr[bytes]) &
+		 mask);
+}
+
+const struct in6_addr *ip6_src_addr(const struct in6_addr *dest)
+{
+	if (ip6_is_unspecified_addr(&net_ip6) ||
+	    ip6_is_link_local_addr(dest) || ip6_is_multicast_addr(dest))
+		return &net_link_local_ip6;
+
+	return &net_ip6;
+}
+
+unsigned int csum_partial(const unsigned char *buff, int len, unsigned int sum)
+{
+	while (len > 1) {
+		sum += buff[0] << 8 | buff[1];
+		buff += 2;
+		len -= 2;
+	}
+	if (len > 0)
+		sum += buff[0] << 8;
+
+	return sum;
+}
+
+u16 csum_ipv6_magic(const struct in6_addr *saddr, const struct in6_addr *daddr,
+		    u16 len, u8 proto, unsigned int csum)
+{
+	csum = csum_partial(saddr->s6_addr, IN6ADDRSZ, csum);
+	csum = csum_partial(daddr->s6_addr, IN6ADDRSZ, csum);
+	csum += len + proto;
+	while (csum >> 16)
+		csum = (csum & 0xffff) + (csum >> 16);
+
+	return ~csum & 0xffff;
+}
+
+int ip6_add_hdr(uchar *xip, const struct in6_addr *src,
+		const struct in6_addr *dest, int nextheader, int hoplimit,
+		int payload_len)
+{
+	struct ip6_hdr *ip6 = (struct ip6_hdr *)xip;
+
+	ip6->ver_tc_flow = htonl(IP6_VERSION << 28);
+	ip6->payload_len = htons(payload_len);
+	ip6->nexthdr = nextheader;
+	ip6->hop_limit = hoplimit;
+	net_copy_ip6(&ip6->saddr, src);
+	net_copy_ip6(&ip6->daddr, dest);
+
+	return IP6_HDR_SIZE;
+}
+
+/* Work out the neighbour that a packet for @dest must be sent to */
+static const struct in6_addr *ip6_next_hop(const struct in6_addr *dest)
+{
+	if (ip6_is_link_local_addr(dest) ||
+	    ip6_addr_in_subnet(&net_ip6, dest, net_prefix_length))
+		return dest;
+	if (ip6_is_unspecified_addr(&net_gateway6)) {
+		puts("## Warning: gatewayip6 needed but not set\n");
+		return dest;
+	}
+
+	return &net_gateway6;
+}
+
+int net_send_ip6_packet(uchar *ether, const struct in6_addr *dest,
+			int nextheader, int payload_len)
+{
+	const struct in6_addr *next_hop;
+	u8 mcast_ether[ARP_HLEN];
+	int eth_hdr_size;
+
+	/* make sure the net_tx_packet is initialized (net_init() was called) */
+	assert(net_tx_packet);
+	if (!net_tx_packet)
+		return -EINVAL;
+
+	if (ip6_is_multicast_addr(dest)) {
+		ip6_make_mult_ethdstaddr(mcast_ether, dest);
+		ether = mcast_ether;
+	}
+
+	eth_hdr_size = net_set_ether(net_tx_packet, ether, PROT_IPV6);
+	ip6_add_hdr(net_tx_packet + eth_hdr_size, ip6_src_addr(dest), dest,
+		    nextheader, IP6_HOP_LIMIT, payload_len);
+
+	next_hop = ip6_next_hop(dest);
+	if (!memcmp(ether, net_null_ethaddr, ARP_HLEN) &&
+	    ndisc_lookup(next_hop, ether))
+		memcpy(((struct ethernet_hdr *)net_tx_packet)->et_dest, ether,
+		       ARP_HLEN);
+
+	/* if the MAC address is still not known, ask the neighbours */
+	if (!memcmp(ether, net_null_ethaddr, ARP_HLEN)) {
+		debug_cond(DEBUG_DEV_PKT, "sending NS for %pI6c\n", next_hop);
+
+		net_copy_ip6(&net_nd_sol_packet_ip6, dest);
+		net_copy_ip6(&net_nd_rep_packet_ip6, next_hop);
+		net_nd_packet_mac = ether;
+		net_nd_tx_packet_size = eth_hdr_size + IP6_HDR_SIZE +
+					payload_len;
+		net_nd_try = 1;
+		net_nd_timer_start = get_timer(0);
+		ndisc_request();
+		return 1;	/* waiting */
+	}
+
+	debug_cond(DEBUG_DEV_PKT, "sending IPv6 to %pI6c/%pM\n", dest, ether);
+	net_send_packet(net_tx_packet, eth_hdr_size + IP6_HDR_SIZE +
+			payload_len);
+
+	return 0;	/* transmitted */
+}
+
+int net_send_udp_packet6(uchar *ether, const struct in6_addr *dest, int dport,
+			 int sport, int len)
+{
+	struct udp_hdr *udp;
+	u16 csum;
+
+	udp = (struct udp_hdr *)(net_tx_packet + net_eth_hdr_size() +
+				 IP6_HDR_SIZE);
+	udp->udp_src = htons(sport);
+	udp->udp_dst = htons(dport);
+	udp->udp_len = htons(UDP_HDR_SIZE + len);
+	udp->udp_xsum = 0;
+
+	/* The checksum is not optional in IPv6; 0 is sent as all ones */
+	csum = csum_ipv6_magic(ip6_src_addr(dest), dest, UDP_HDR_SIZE + len,
+			       IPPROTO_UDP,
+			       csum_partial((uchar *)udp, UDP_HDR_SIZE + len, 0));
+	udp->udp_xsum = htons(csum ?: 0xffff);
+
+	return net_send_ip6_packet(ether, dest, IPPROTO_UDP, UDP_HDR_SIZE + len);
+}
+
+/* Answer an echo request by turning the packet round */
+static int ip6_echo_reply(struct ethernet_hdr *et, struct ip6_hdr *ip6,
+			  int len)
+{
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	int plen = ntohs(ip6->payload_len);
+	int eth_hdr_size;
+	uchar *tx_packet;
+	u16 csum;
+
+	if (ip6_is_multicast_addr(&ip6->daddr))
+		return -EINVAL;
+
+	eth_hdr_size = net_update_ether(et, et->et_src, PROT_IPV6);
+	net_copy_ip6(&ip6->daddr, &ip6->saddr);
+	net_copy_ip6(&ip6->saddr, ip6_src_addr(&ip6->daddr));
+	ip6->hop_limit = IP6_HOP_LIMIT;
+
+	icmp->icmp6_type = ICMPV6_ECHO_REPLY;
+	icmp->icmp6_cksum = 0;
+	csum = csum_ipv6_magic(&ip6->saddr, &ip6->daddr, plen, IPPROTO_ICMPV6,
+			       csum_partial((uchar *)icmp, plen, 0));
+	icmp->icmp6_cksum = htons(csum);
+
+	debug_cond(DEBUG_DEV_PKT, "Got ICMPv6 ECHO REQUEST, return %d bytes\n",
+		   eth_hdr_size + len);
+	tx_packet = net_get_async_tx_pkt_buf();
+	memcpy(tx_packet, et, eth_hdr_size + len);
+	net_send_packet(tx_packet, eth_hdr_size + len);
+
+	return 0;
+}
+
+int net_ip6_handler(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len)
+{
+	struct in_addr zero_ip = { .s_addr = 0 };
+	struct icmp6_hdr *icmp;
+	struct udp_hdr *udp;
+	int plen;
+
+	if (len < IP6_HDR_SIZE)
+		return -EINVAL;
+	if (ntohl(ip6->ver_tc_flow) >> 28 != IP6_VERSION)
+		return -EINVAL;
+	plen = ntohs(ip6->payload_len);
+	if (len < IP6_HDR_SIZE + plen)
+		return -EINVAL;
+	len = IP6_HDR_SIZE + plen;
+
+	/* If it is not for us, ignore it */
+	if (!ip6_is_our_addr(&ip6->daddr) &&
+	    !ip6_is_multicast_addr(&ip6->daddr))
+		return -EINVAL;
+
+	switch (ip6->nexthdr) {
+	case IPPROTO_ICMPV6:
+		if (plen < ICMP6_HDR_SIZE)
+			return -EINVAL;
+		icmp = (struct icmp6_hdr *)(ip6 + 1);
+		if (csum_ipv6_magic(&ip6->saddr, &ip6->daddr, plen,
+				    IPPROTO_ICMPV6,
+				    csum_partial((uchar *)icmp, plen, 0))) {
+			debug("ICMPv6 checksum bad\n");
+			return -EINVAL;
+		}
+
+		switch (icmp->icmp6_type) {
+		case ICMPV6_ECHO_REQUEST:
+			return ip6_echo_reply(et, ip6, len);
+#if defined(CONFIG_CMD_PING6)
+		case ICMPV6_ECHO_REPLY:
+			return ping6_receive(et, ip6, len);
+#endif
+		case ICMPV6_ROUTER_SOLICIT:
+		case ICMPV6_ROUTER_ADVERT:
+		case ICMPV6_NEIGHBOR_SOLICIT:
+		case ICMPV6_NEIGHBOR_ADVERT:
+			return ndisc_receive(et, ip6, len);
+		default:
+			return -EINVAL;
+		}
+	case IPPROTO_UDP:
+		if (plen < UDP_HDR_SIZE)
+			return -EINVAL;
+		udp = (struct udp_hdr *)(ip6 + 1);
+		if (ntohs(udp->udp_len) < UDP_HDR_SIZE ||
+		    ntohs(udp->udp_len) > plen)
+			return -EINVAL;
+		if (csum_ipv6_magic(&ip6->saddr, &ip6->daddr,
+				    ntohs(udp->udp_len), IPPROTO_UDP,
+				    csum_partial((uchar *)udp,
+						 ntohs(udp->udp_len), 0))) {
+			debug("UDP checksum bad\n");
+			return -EINVAL;
+		}
+
+		debug_cond(DEBUG_DEV_PKT,
+			   "received UDP (to=%pI6c, from=%pI6c, len=%d)\n",
+			   &ip6->daddr, &ip6->saddr, len);
+
+		/*
+		 * The handlers take an IPv4 source, so pass zero. Those which
+		 * care who sent the packet check net_rx_src_ip6 instead.
+		 */
+		net_copy_ip6(&net_rx_src_ip6, &ip6->saddr);
+		net_get_udp_handler()((uchar *)(udp + 1), ntohs(udp->udp_dst),
+				      zero_ip, ntohs(udp->udp_src),
+				      ntohs(udp->udp_len) - UDP_HDR_SIZE);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+bool is_serverip6_in_cmd(void)
+{
+	return net_boot_file_name[0] == '[' &&
+	       strstr(net_boot_file_name, "]:");
+}
+
+int net_parse_bootfile6(struct in6_addr *ipaddr, char *filename, int max_len)
+{
+	const char *name = net_boot_file_name;
+	char *end;
+
+	if (!*name)
+		return 0;
+
+	if (is_serverip6_in_cmd()) {
+		end = strstr(name, "]:");
+		if (string_to_ip6(name + 1, end - name - 1, ipaddr))
+			return -EINVAL;
+		name = end + 2;
+	}
+	strlcpy(filename, name, max_len);
+
+	return 1;
+}
@@ -26,6 +26,12 @@
  * NFSv2 is still used by default. But if server does not support NFSv2, then
  * NFSv3 is used, if available on NFS server. */
 
+/* NOTE 5: Up to CONFIG_NFS_READ_WINDOW READ requests are kept in flight.
+ * Each one remembers its RPC id and file range, so replies may come back in
+ * any order and are stored where they belong. The end of the file is found
+ * from the first short (or, with NFSv3, EOF-flagged) reply; the transfer is
+ * complete once every request below that point has been answered. */
+
 #include <common.h>
 #include <command.h>
 #include <display_options.h>
@@ -37,11 +43,13 @@
 #include <net.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <linux/log2.h>
 #include "nfs.h"
 #include "bootp.h"
 #include <time.h>
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
+#define NFS_HASH_SIZE	5120	/* Bytes loaded per hash		*/
 #define NFS_RETRY_COUNT 30
 
 #define NFS_RPC_ERR	1
@@ -49,10 +57,28 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static const ulong nfs_timeout = CONFIG_NFS_TIMEOUT;
 
+/**
+ * struct nfs_read_slot - A READ request waiting for its reply
+ *
+ * @id:		RPC id of the request, 0 if the slot is free
+ * @offset:	File offset of the first byte requested
+ * @len:	Number of bytes requested
+ */
+struct nfs_read_slot {
+	unsigned long id;
+	int offset;
+	int len;
+};
+
+static struct nfs_read_slot nfs_read_slots[CONFIG_NFS_READ_WINDOW];
+static int nfs_read_size;	/* Bytes asked for by each READ */
+static int nfs_offset;		/* Next file offset to ask for */
+static int nfs_eof_offset;	/* Size of the file, INT_MAX until known */
+static ulong nfs_rx_bytes;	/* Bytes received, for the hashes */
+static uint nfs_hashes;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static unsigned int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -389,6 +415,100 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+static void nfs_read_slot_send(struct nfs_read_slot *slot)
+{
+	nfs_read_req(slot->offset, slot->len);
+	slot->id = rpc_id;
+}
+
+/* Keep the window full until the end of the file is reached */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(nfs_read_slots); i++) {
+		slot = &nfs_read_slots[i];
+		if (slot->id)
+			continue;
+		if (nfs_offset >= nfs_eof_offset)
+			break;
+		slot->offset = nfs_offset;
+		slot->len = nfs_read_size;
+		nfs_offset += nfs_read_size;
+		nfs_read_slot_send(slot);
+	}
+}
+
+/* Send every outstanding READ again, after a timeout */
+static void nfs_read_resend(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(nfs_read_slots); i++) {
+		if (nfs_read_slots[i].id)
+			nfs_read_slot_send(&nfs_read_slots[i]);
+	}
+}
+
+static struct nfs_read_slot *nfs_read_find(unsigned long id)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(nfs_read_slots); i++) {
+		if (id && nfs_read_slots[i].id == id)
+			return &nfs_read_slots[i];
+	}
+
+	return NULL;
+}
+
+static bool nfs_read_busy(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(nfs_read_slots); i++) {
+		if (nfs_read_slots[i].id)
+			return true;
+	}
+
+	return false;
+}
+
+/* Forget all outstanding READs; late replies are then dropped */
+static void nfs_read_cancel(void)
+{
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+}
+
+int nfs_calc_read_size(int size, int maxdefrag)
+{
+	if (maxdefrag)
+		size = min_t(int, size,
+			     maxdefrag - IP_UDP_HDR_SIZE - NFS_READ_HDR_SIZE);
+
+	return rounddown_pow_of_two(max(size, 1024));
+}
+
+static void nfs_read_start(void)
+{
+	int maxdefrag = 0;
+
+	nfs_read_size = NFS_READ_SIZE;
+	if (supported_nfs_versions & NFSV2_FLAG)
+		nfs_read_size = min(nfs_read_size, NFS2_MAX_READ_SIZE);
+#ifdef CONFIG_NET_MAXDEFRAG
+	maxdefrag = CONFIG_NET_MAXDEFRAG;
+#endif
+	nfs_read_size = nfs_calc_read_size(nfs_read_size, maxdefrag);
+	nfs_offset = 0;
+	nfs_eof_offset = INT_MAX;
+	nfs_rx_bytes = 0;
+	nfs_hashes = 0;
+	nfs_read_cancel();
+	nfs_read_fill();
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -419,7 +539,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -660,20 +780,26 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+static int nfs_read_reply(uchar *pkt, unsigned len,
+			  struct nfs_read_slot **slotp, bool *eofp)
 {
 	struct rpc_t rpc_pkt;
+	struct nfs_read_slot *slot;
+	unsigned int hdr_len;
 	int rlen;
-	uchar *data_ptr;
+	int data_off;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	/* Only the header is copied; the data is stored straight from pkt */
+	hdr_len = min_t(unsigned int, len, NFS_READ_HDR_SIZE);
+	memcpy(&rpc_pkt.u.data[0], pkt, hdr_len);
+	memset(&rpc_pkt.u.data[hdr_len], '\0', NFS_READ_HDR_SIZE - hdr_len);
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	slot = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!slot)
 		return -NFS_RPC_DROP;
+	*slotp = slot;
 
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
@@ -686,38 +812,67 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		data_off = (uchar *)&(rpc_pkt.u.reply.data[19]) -
+			(uchar *)&rpc_pkt;
+		/* NFSv2 has no EOF flag; only the last block is short */
+		*eofp = rlen < slot->len;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
-		/* Skip unused values :
-			EOF:		32 bits value,
+		*eofp = rpc_pkt.u.reply.data[2 + nfsv3_data_offset] != 0;
+		/* Skip unused value :
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		data_off = (uchar *)
+			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]) -
+			(uchar *)&rpc_pkt;
 	}
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	if (rlen < 0 || rlen > slot->len || data_off + rlen > len)
+		return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	if (store_block(pkt + data_off, slot->offset, rlen))
+		return -9999;
 
 	return rlen;
 }
 
+/* Account for a READ reply and keep the window full */
+static void nfs_read_done(struct nfs_read_slot *slot, int rlen, bool eof)
+{
+	nfs_rx_bytes += rlen;
+	while (nfs_hashes < nfs_rx_bytes / NFS_HASH_SIZE) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+
+	if (!rlen || eof) {
+		nfs_eof_offset = min(nfs_eof_offset, slot->offset + rlen);
+		slot->id = 0;
+	} else if (rlen < slot->len) {
+		/* The server sent less than asked for; ask for the rest */
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_slot_send(slot);
+	} else {
+		slot->id = 0;
+	}
+
+	nfs_read_fill();
+	if (!nfs_read_busy()) {
+		nfs_download_state = NETLOOP_SUCCESS;
+		nfs_state = STATE_UMOUNT_REQ;
+		nfs_send();
+	}
+}
+
 /**************************************************************************
 Interfaces of U-BOOT
 **************************************************************************/
@@ -738,12 +893,15 @@ static void nfs_timeout_handler(void)
 static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			unsigned src, unsigned len)
 {
+	struct nfs_read_slot *slot;
+	bool eof;
 	int rlen;
 	int reply;
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* Only READ replies may carry more data than struct rpc_t holds */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
 		return;
 
 	if (dest != nfs_our_port)
@@ -810,9 +968,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_start();
 		}
 		break;
 
@@ -835,22 +991,20 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		break;
 
 	case STATE_READ_REQ:
-		rlen = nfs_read_reply(pkt, len);
+		rlen = nfs_read_reply(pkt, len, &slot, &eof);
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0) {
+			nfs_read_done(slot, rlen, eof);
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
+			nfs_read_cancel();
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
+			debug("NFS READ error (%d)\n", rlen);
+			nfs_read_cancel();
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		}
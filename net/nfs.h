@@ -38,12 +38,24 @@
 /*
  * Block size used for NFS read accesses.  A RPC reply packet (including  all
  * headers) must fit within a single Ethernet frame to avoid fragmentation.
- * However, if CONFIG_IP_DEFRAG is set, a bigger value could be used.  In any
- * case, most NFS servers are optimized for a power of 2.
+ * However, if CONFIG_IP_DEFRAG is set, CONFIG_NFS_READ_SIZE selects a bigger
+ * value.  In any case, most NFS servers are optimized for a power of 2.
  */
+#ifdef CONFIG_NFS_READ_SIZE
+#define NFS_READ_SIZE	CONFIG_NFS_READ_SIZE
+#else
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
+#endif
+#define NFS2_MAX_READ_SIZE	8192	/* NFSv2 servers never send more */
 #define NFS_MAX_ATTRS	26
 
+/*
+ * Room for the data in replies other than READ.  READ data is stored straight
+ * from the received packet, so only its header goes through struct rpc_t.
+ */
+#define NFS_RPC_DATA_SIZE	1024
+#define NFS_READ_HDR_SIZE	((6 + NFS_MAX_ATTRS) * sizeof(uint32_t))
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
@@ -56,8 +68,7 @@ enum rpc_accept_stat {
 
 struct rpc_t {
 	union {
-		uint8_t data[NFS_READ_SIZE + (6 + NFS_MAX_ATTRS) *
-			sizeof(uint32_t)];
+		uint8_t data[NFS_RPC_DATA_SIZE + NFS_READ_HDR_SIZE];
 		struct {
 			uint32_t id;
 			uint32_t type;
@@ -74,13 +85,27 @@ struct rpc_t {
 			uint32_t verifier;
 			uint32_t v2;
 			uint32_t astatus;
-			uint32_t data[NFS_READ_SIZE / sizeof(uint32_t) +
+			uint32_t data[NFS_RPC_DATA_SIZE / sizeof(uint32_t) +
 				NFS_MAX_ATTRS];
 		} reply;
 	} u;
 };
 void nfs_start(void);	/* Begin NFS */
 
+/**
+ * nfs_calc_read_size() - Work out how many bytes to ask for in each READ
+ *
+ * The reply to a READ must fit in the IP reassembly buffer, and servers work
+ * best with a power of two. A 1024-byte READ fits in a single Ethernet frame,
+ * so it needs no reassembly and is always allowed.
+ *
+ * @size:	Preferred number of bytes
+ * @maxdefrag:	Size of the reassembly buffer, or 0 if there is none
+ * Return: largest power of two no more than @size whose reply fits in
+ *	@maxdefrag, and at least 1024
+ */
+int nfs_calc_read_size(int size, int maxdefrag);
+
 
 /**********************************************************************/
 
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * ICMPv6 echo (ping6)
+ *
+ * Echo requests sent to us are answered in net6.c whether or not this is
+ * built; this sends our own requests and waits for the reply.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <net.h>
+#include <net6.h>
+
+static ushort ping6_seq_number;
+/* MAC address of the next hop, filled in by neighbour discovery */
+static uchar ping6_ethaddr[ARP_HLEN];
+
+/* The IPv6 address to ping */
+struct in6_addr net_ping_ip6;
+
+static int ping6_send(void)
+{
+	struct icmp6_hdr *icmp;
+	u16 csum;
+
+	icmp = (struct icmp6_hdr *)(net_tx_packet + net_eth_hdr_size() +
+				    IP6_HDR_SIZE);
+	icmp->icmp6_type = ICMPV6_ECHO_REQUEST;
+	icmp->icmp6_code = 0;
+	icmp->icmp6_cksum = 0;
+	icmp->un.echo.id = 0;
+	icmp->un.echo.sequence = htons(ping6_seq_number++);
+	csum = csum_ipv6_magic(ip6_src_addr(&net_ping_ip6), &net_ping_ip6,
+			       ICMP6_HDR_SIZE, IPPROTO_ICMPV6,
+			       csum_partial((uchar *)icmp, ICMP6_HDR_SIZE, 0));
+	icmp->icmp6_cksum = htons(csum);
+
+	memset(ping6_ethaddr, '\0', ARP_HLEN);
+
+	return net_send_ip6_packet(ping6_ethaddr, &net_ping_ip6, IPPROTO_ICMPV6,
+				   ICMP6_HDR_SIZE);
+}
+
+static void ping6_timeout_handler(void)
+{
+	eth_halt();
+	net_set_state(NETLOOP_FAIL);	/* we did not get the reply */
+}
+
+void ping6_start(void)
+{
+	printf("Using %s device\n", eth_get_name());
+	net_set_timeout_handler(10000UL, ping6_timeout_handler);
+
+	ping6_send();
+}
+
+int ping6_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len)
+{
+	if (memcmp(&ip6->saddr, &net_ping_ip6, IN6ADDRSZ))
+		return -EINVAL;
+
+	net_set_state(NETLOOP_SUCCESS);
+
+	return 0;
+}
@@ -0,0 +1,547 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * This is just enough TCP to download a file quickly: one connection, opened
+ * by us, which sends little and receives a lot.
+ *
+ * The receive window is not buffered here. Each segment is passed straight to
+ * the user, who stores it at its offset in the stream, so the window can stay
+ * fully open. Segments that arrive after a lost one are kept as well, and we
+ * send a duplicate ACK for each of them so the server retransmits the missing
+ * segment without waiting for its timer (fast retransmit). There is no SACK:
+ * once the gap is filled a single cumulative ACK covers everything received.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <net.h>
+#include <time.h>
+#include <asm/unaligned.h>
+#include <net/tcp.h>
+
+/* Base tick of the connection timer, used to flush delayed ACKs */
+#define TCP_TICK_MS		20
+/* Initial and largest retransmission timeout */
+#define TCP_RTO_MS		500
+#define TCP_RTO_MAX_MS		4000
+/* Give up after this many retransmissions of the same segment */
+#define TCP_MAX_RETRIES		8
+/* Give up if the server sends nothing for this long */
+#define TCP_IDLE_MS		20000
+/* Duplicate ACKs that trigger a fast retransmit */
+#define TCP_DUP_ACKS		3
+/* Number of segments received before an ACK is sent at once */
+#define TCP_ACK_EVERY		2
+/* Number of separate ranges of data held beyond a gap */
+#define TCP_OOO_MAX		8
+
+/**
+ * struct tcp_range - A range of data received beyond a gap
+ *
+ * @start:	Offset of the first byte in the stream
+ * @end:	Offset of the byte after the last one
+ */
+struct tcp_range {
+	u32 start;
+	u32 end;
+};
+
+static enum tcp_state tcp_state;
+static struct in_addr tcp_remote_ip;
+static uchar tcp_remote_ether[ARP_HLEN];
+static int tcp_remote_port;
+static int tcp_our_port;
+static tcp_rx_handler_f *tcp_rx_handler;
+static tcp_event_f *tcp_event_handler;
+
+/* Sending: sequence numbers and the segment not yet acknowledged */
+static u32 tcp_snd_una;
+static u32 tcp_snd_nxt;
+static u32 tcp_tx_seq;
+static uint tcp_tx_len;
+static u8 tcp_tx_flags;
+static uchar tcp_tx_buf[TCP_MSS];
+static uint tcp_peer_mss;
+static ulong tcp_tx_time;
+static ulong tcp_rto;
+static int tcp_retries;
+static int tcp_dup_acks;
+
+/* Receiving: sequence number of stream offset 0 and what has arrived */
+static u32 tcp_rcv_base;
+static u32 tcp_rx_len;
+static bool tcp_fin_rcvd;
+static u32 tcp_rcv_wnd;
+static u8 tcp_rcv_wscale;
+static bool tcp_wscale_ok;
+static int tcp_ack_pending;
+static ulong tcp_rx_time;
+static struct tcp_range tcp_ooo[TCP_OOO_MAX];
+static int tcp_ooo_count;
+
+static inline bool tcp_seq_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static u16 tcp_checksum(struct ip_tcp_hdr *ip, uint tcp_len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} __packed pseudo;
+
+	net_copy_ip(&pseudo.src, &ip->ip_src);
+	net_copy_ip(&pseudo.dst, &ip->ip_dst);
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(tcp_len);
+
+	return add_ip_checksums(sizeof(pseudo),
+				compute_ip_checksum(&pseudo, sizeof(pseudo)),
+				compute_ip_checksum(&ip->tcp_src, tcp_len));
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 seq, u32 ack)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)pkt;
+	uchar *opt = pkt + IP_TCP_HDR_SIZE;
+	int hdr_len = IP_TCP_HDR_SIZE;
+	u32 win = tcp_rcv_wnd;
+
+	if (action & TCP_SYN) {
+		/* The window in a SYN is never scaled */
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		opt[4] = TCP_OPT_NOP;
+		opt[5] = TCP_OPT_WS;
+		opt[6] = 3;
+		opt[7] = tcp_rcv_wscale;
+		hdr_len += TCP_SYN_OPT_SIZE;
+	} else if (tcp_wscale_ok) {
+		win >>= tcp_rcv_wscale;
+	}
+
+	net_set_ip_header(pkt, dest, net_ip, hdr_len + payload_len,
+			  IPPROTO_TCP);
+
+	ip->tcp_src = htons(sport);
+	ip->tcp_dst = htons(dport);
+	ip->tcp_seq = htonl(seq);
+	ip->tcp_ack = htonl(action & TCP_ACK ? ack : 0);
+	ip->tcp_hlen = (hdr_len - IP_HDR_SIZE) << 2;
+	ip->tcp_flags = action;
+	ip->tcp_win = htons(min_t(u32, win, 0xffff));
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = tcp_checksum(ip, hdr_len - IP_HDR_SIZE + payload_len);
+
+	return hdr_len;
+}
+
+static int tcp_send_segment(u8 flags, u32 seq, const void *data, uint len)
+{
+	uchar *pkt;
+
+	pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+	if (flags & TCP_SYN)
+		pkt += TCP_SYN_OPT_SIZE;
+	if (len)
+		memcpy(pkt, data, len);
+	tcp_ack_pending = 0;
+
+	return net_send_ip_packet(tcp_remote_ether, tcp_remote_ip,
+				  tcp_remote_port, tcp_our_port, len,
+				  IPPROTO_TCP, flags, seq,
+				  tcp_rcv_base + tcp_rx_len + tcp_fin_rcvd);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+static void tcp_send_rst(void)
+{
+	tcp_send_segment(TCP_RST | TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+/* Send whatever part of the pending segment has not been acknowledged */
+static void tcp_retransmit(void)
+{
+	uint skip = tcp_snd_una - tcp_tx_seq;
+	u8 flags = tcp_tx_flags;
+
+	if (flags & TCP_SYN)
+		skip = 0;
+	else
+		skip = min(skip, tcp_tx_len);
+	tcp_send_segment(flags, tcp_snd_una, tcp_tx_buf + skip,
+			 tcp_tx_len - skip);
+	tcp_tx_time = get_timer(0);
+}
+
+static void tcp_queue_segment(u8 flags, const void *data, uint len)
+{
+	tcp_tx_seq = tcp_snd_nxt;
+	tcp_tx_flags = flags;
+	tcp_tx_len = len;
+	if (len)
+		memcpy(tcp_tx_buf, data, len);
+	tcp_snd_nxt += len + !!(flags & (TCP_SYN | TCP_FIN));
+	tcp_retries = 0;
+	tcp_dup_acks = 0;
+	tcp_retransmit();
+}
+
+static void tcp_finish(enum tcp_event event)
+{
+	tcp_event_f *handler = tcp_event_handler;
+
+	tcp_reset_state();
+	if (handler)
+		handler(event);
+}
+
+static void tcp_timer(void)
+{
+	ulong now = get_timer(0);
+
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (tcp_ack_pending)
+		tcp_send_ack();
+
+	if (tcp_snd_una != tcp_snd_nxt && now - tcp_tx_time >= tcp_rto) {
+		if (++tcp_retries > TCP_MAX_RETRIES) {
+			tcp_finish(TCP_EV_TIMEOUT);
+			return;
+		}
+		log_debug("retransmit %u after %lu ms\n", tcp_snd_una, tcp_rto);
+		tcp_rto = min(tcp_rto * 2, (ulong)TCP_RTO_MAX_MS);
+		tcp_retransmit();
+	} else if (now - tcp_rx_time >= TCP_IDLE_MS) {
+		tcp_finish(TCP_EV_TIMEOUT);
+		return;
+	}
+
+	net_set_timeout_handler(TCP_TICK_MS, tcp_timer);
+}
+
+int tcp_connect(struct in_addr dest, int dport, tcp_rx_handler_f *rx,
+		tcp_event_f *event)
+{
+	tcp_reset_state();
+
+	tcp_remote_ip = dest;
+	tcp_remote_port = dport;
+	/* Use a pseudo-random port, as TFTP does */
+	tcp_our_port = 1024 + (get_timer(0) % 3072);
+	memset(tcp_remote_ether, '\0', ARP_HLEN);
+	tcp_rx_handler = rx;
+	tcp_event_handler = event;
+
+	tcp_rcv_wnd = CONFIG_TCP_RCV_WINDOW;
+	for (tcp_rcv_wscale = 0; tcp_rcv_wnd >> tcp_rcv_wscale > 0xffff;)
+		tcp_rcv_wscale++;
+	tcp_peer_mss = 536;
+	tcp_rto = TCP_RTO_MS;
+	tcp_rx_time = get_timer(0);
+
+	/* Clock-driven initial sequence number, as RFC 793 suggests */
+	tcp_snd_nxt = (u32)get_ticks();
+	tcp_snd_una = tcp_snd_nxt;
+	tcp_state = TCP_SYN_SENT;
+	net_set_timeout_handler(TCP_TICK_MS, tcp_timer);
+	tcp_queue_segment(TCP_SYN, NULL, 0);
+
+	return 0;
+}
+
+int tcp_send(const void *data, uint len)
+{
+	if (tcp_state != TCP_ESTABLISHED && tcp_state != TCP_CLOSE_WAIT)
+		return -ENOTCONN;
+	if (tcp_snd_una != tcp_snd_nxt)
+		return -EBUSY;
+	if (len > tcp_peer_mss || len > TCP_MSS)
+		return -E2BIG;
+
+	tcp_queue_segment(TCP_ACK | TCP_PUSH, data, len);
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp_state == TCP_SYN_SENT) {
+		tcp_reset_state();
+		return;
+	}
+	if (tcp_state != TCP_ESTABLISHED && tcp_state != TCP_CLOSE_WAIT)
+		return;
+
+	tcp_rx_handler = NULL;
+	tcp_event_handler = NULL;
+	tcp_state = TCP_FIN_WAIT;
+	if (tcp_snd_una != tcp_snd_nxt) {
+		/* Add the FIN to the segment still in flight */
+		tcp_tx_flags |= TCP_FIN;
+		tcp_snd_nxt++;
+		tcp_retransmit();
+	} else {
+		tcp_queue_segment(TCP_FIN | TCP_ACK, NULL, 0);
+	}
+}
+
+enum tcp_state tcp_get_state(void)
+{
+	return tcp_state;
+}
+
+u32 tcp_get_rx_len(void)
+{
+	return tcp_rx_len;
+}
+
+void tcp_reset_state(void)
+{
+	tcp_state = TCP_CLOSED;
+	tcp_rx_handler = NULL;
+	tcp_event_handler = NULL;
+	tcp_tx_len = 0;
+	tcp_rx_len = 0;
+	tcp_fin_rcvd = false;
+	tcp_wscale_ok = false;
+	tcp_ack_pending = 0;
+	tcp_ooo_count = 0;
+}
+
+static void tcp_parse_options(const uchar *opt, int len)
+{
+	int size;
+
+	while (len > 0) {
+		if (opt[0] == TCP_OPT_EOL)
+			break;
+		if (opt[0] == TCP_OPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		size = opt[1];
+		if (opt[0] == TCP_OPT_MSS && size == 4)
+			tcp_peer_mss = get_unaligned_be16(opt + 2);
+		else if (opt[0] == TCP_OPT_WS && size == 3)
+			tcp_wscale_ok = true;
+		opt += size;
+		len -= size;
+	}
+}
+
+/* Record data received beyond a gap; returns false if there is no room */
+static bool tcp_ooo_add(u32 start, u32 end)
+{
+	int i, j;
+
+	for (i = 0; i < tcp_ooo_count && tcp_ooo[i].end < start; i++)
+		;
+
+	if (i < tcp_ooo_count && tcp_ooo[i].start <= end) {
+		/* Widen this range and swallow any that it now reaches */
+		tcp_ooo[i].start = min(tcp_ooo[i].start, start);
+		tcp_ooo[i].end = max(tcp_ooo[i].end, end);
+		for (j = i + 1; j < tcp_ooo_count &&
+		     tcp_ooo[j].start <= tcp_ooo[i].end; j++)
+			tcp_ooo[i].end = max(tcp_ooo[i].end, tcp_ooo[j].end);
+		memmove(&tcp_ooo[i + 1], &tcp_ooo[j],
+			(tcp_ooo_count - j) * sizeof(*tcp_ooo));
+		tcp_ooo_count -= j - i - 1;
+		return true;
+	}
+
+	if (tcp_ooo_count == TCP_OOO_MAX)
+		return false;
+	memmove(&tcp_ooo[i + 1], &tcp_ooo[i],
+		(tcp_ooo_count - i) * sizeof(*tcp_ooo));
+	tcp_ooo[i].start = start;
+	tcp_ooo[i].end = end;
+	tcp_ooo_count++;
+
+	return true;
+}
+
+/* Move past any held data that now follows on; returns true if there was any */
+static bool tcp_ooo_merge(void)
+{
+	int n;
+
+	for (n = 0; n < tcp_ooo_count && tcp_ooo[n].start <= tcp_rx_len; n++)
+		tcp_rx_len = max(tcp_rx_len, tcp_ooo[n].end);
+	if (!n)
+		return false;
+	tcp_ooo_count -= n;
+	memmove(tcp_ooo, &tcp_ooo[n], tcp_ooo_count * sizeof(*tcp_ooo));
+
+	return true;
+}
+
+static void tcp_receive_data(u32 seq, const uchar *data, uint len, u8 flags)
+{
+	u32 offset = seq - tcp_rcv_base;
+	u32 end = offset + len;
+	u32 limit = tcp_rx_len + tcp_rcv_wnd;
+	bool filled;
+
+	/* A repeat of data we already have: perhaps our ACK was lost */
+	if (tcp_seq_before(end, tcp_rx_len + 1)) {
+		tcp_send_ack();
+		return;
+	}
+	if (tcp_seq_before(offset, tcp_rx_len)) {
+		data += tcp_rx_len - offset;
+		offset = tcp_rx_len;
+	}
+	if (!tcp_seq_before(offset, limit)) {
+		tcp_send_ack();
+		return;
+	}
+	if (tcp_seq_before(limit, end))
+		end = limit;
+	len = end - offset;
+
+	if (offset != tcp_rx_len) {
+		/* Keep it if we can, and tell the server about the gap at once */
+		if (!tcp_rx_handler(offset, data, len))
+			tcp_ooo_add(offset, end);
+		tcp_send_ack();
+		return;
+	}
+
+	if (tcp_rx_handler(offset, data, len)) {
+		tcp_send_rst();
+		tcp_reset_state();
+		return;
+	}
+	tcp_rx_len = end;
+	filled = tcp_ooo_merge();
+	if (filled || (flags & TCP_PUSH) || ++tcp_ack_pending >= TCP_ACK_EVERY)
+		tcp_send_ack();
+	if (tcp_event_handler)
+		tcp_event_handler(TCP_EV_DATA);
+}
+
+static void tcp_receive_ack(u32 ack, bool dup_candidate)
+{
+	/* Ignore an ACK for something we never sent */
+	if (tcp_seq_before(tcp_snd_nxt, ack))
+		return;
+
+	if (tcp_seq_before(tcp_snd_una, ack)) {
+		tcp_snd_una = ack;
+		tcp_dup_acks = 0;
+		if (ack == tcp_snd_nxt) {
+			tcp_tx_len = 0;
+			tcp_retries = 0;
+			tcp_rto = TCP_RTO_MS;
+		}
+		return;
+	}
+
+	/* The same ACK again means the server is missing our segment */
+	if (dup_candidate && tcp_snd_una != tcp_snd_nxt &&
+	    ++tcp_dup_acks == TCP_DUP_ACKS) {
+		log_debug("fast retransmit %u\n", tcp_snd_una);
+		tcp_retransmit();
+	}
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, int len)
+{
+	int tcp_len = len - IP_HDR_SIZE;
+	const uchar *data;
+	uint hdr_len, dlen;
+	u32 seq, ack;
+	u8 flags;
+
+	if (tcp_state == TCP_CLOSED || tcp_len < TCP_HDR_SIZE)
+		return;
+	if (net_read_ip(&ip->ip_src).s_addr != tcp_remote_ip.s_addr ||
+	    ntohs(ip->tcp_src) != tcp_remote_port ||
+	    ntohs(ip->tcp_dst) != tcp_our_port)
+		return;
+
+	hdr_len = (ip->tcp_hlen >> 4) * 4;
+	if (hdr_len < TCP_HDR_SIZE || hdr_len > tcp_len)
+		return;
+	if (tcp_checksum(ip, tcp_len)) {
+		debug("TCP wrong checksum\n");
+		return;
+	}
+
+	flags = ip->tcp_flags;
+	seq = ntohl(ip->tcp_seq);
+	ack = ntohl(ip->tcp_ack);
+	data = (uchar *)&ip->tcp_src + hdr_len;
+	dlen = tcp_len - hdr_len;
+	tcp_rx_time = get_timer(0);
+
+	if (flags & TCP_RST) {
+		tcp_finish(TCP_EV_RESET);
+		return;
+	}
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if ((flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK) ||
+		    ack != tcp_snd_nxt)
+			return;
+		tcp_parse_options((uchar *)ip + IP_TCP_HDR_SIZE,
+				  hdr_len - TCP_HDR_SIZE);
+		tcp_rcv_base = seq + 1;
+		tcp_receive_ack(ack, false);
+		tcp_state = TCP_ESTABLISHED;
+		tcp_send_ack();
+		if (tcp_event_handler)
+			tcp_event_handler(TCP_EV_CONNECTED);
+		return;
+	}
+
+	if (flags & TCP_ACK)
+		tcp_receive_ack(ack, !dlen && !(flags & (TCP_SYN | TCP_FIN)));
+
+	/* Our ACK of the SYN was lost, so the server sent it again */
+	if (flags & TCP_SYN) {
+		tcp_send_ack();
+		return;
+	}
+
+	if (dlen && tcp_rx_handler && !tcp_fin_rcvd)
+		tcp_receive_data(seq, data, dlen, flags);
+
+	/* Only take the FIN once everything before it has arrived */
+	if ((flags & TCP_FIN) && tcp_state != TCP_CLOSED &&
+	    seq + dlen - tcp_rcv_base == tcp_rx_len) {
+		if (!tcp_fin_rcvd) {
+			tcp_fin_rcvd = true;
+			tcp_send_ack();
+			if (tcp_state == TCP_FIN_WAIT) {
+				tcp_reset_state();
+			} else {
+				tcp_state = TCP_CLOSE_WAIT;
+				if (tcp_event_handler)
+					tcp_event_handler(TCP_EV_CLOSED);
+			}
+		} else {
+			tcp_send_ack();
+		}
+	}
+}
@@ -15,6 +15,7 @@
 #include <log.h>
 #include <mapmem.h>
 #include <net.h>
+#include <net6.h>
 #include <asm/global_data.h>
 #include <net/tftp.h>
 #include "bootp.h"
@@ -27,6 +28,8 @@ DECLARE_GLOBAL_DATA_PTR;
 #define TIMEOUT		5000UL
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
+/* Shortest retransmit timeout in adaptive mode */
+#define TFTP_RTO_MIN	50UL
 
 /*
  *	TFTP operations.
@@ -66,6 +69,13 @@ enum {
 };
 
 static struct in_addr tftp_remote_ip;
+#ifdef CONFIG_IPV6
+/* The server's IPv6 address, used instead while net_use_ip6 is set */
+static struct in6_addr tftp_remote_ip6;
+#define tftp_use_ip6	net_use_ip6
+#else
+#define tftp_use_ip6	false
+#endif
 /* The UDP port at their end */
 static int	tftp_remote_port;
 /* The UDP port at our end */
@@ -96,6 +106,25 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Out-of-order blocks received since that nack */
+static ushort	tftp_nack_count;
+/* Current retransmit timeout */
+static ulong	tftp_rto;
+/* Number of blocks found missing in this transfer */
+static uint	tftp_losses;
+#ifdef CONFIG_TFTP_ADAPTIVE
+/* Window to ask for; kept between transfers so that it can adapt */
+static ushort	tftp_adapt_window;
+/* Smoothed round-trip time (ms, scaled by 8) and its variation (by 4) */
+static ulong	tftp_srtt;
+static ulong	tftp_rttvar;
+static bool	tftp_have_rtt;
+/* Time at which the packet being timed was sent */
+static ulong	tftp_rtt_start;
+/* The first block after this one ends the measurement */
+static ushort	tftp_rtt_block;
+static bool	tftp_rtt_timing;
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -150,6 +179,27 @@ static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
 
+#ifdef CONFIG_TFTP_MULTICAST
+/* Ask the server for a multicast transfer (RFC 2090) */
+static bool	tftp_mcast_wanted;
+/* The server agreed and we have joined its group */
+static bool	tftp_mcast_active;
+/* We are the master client, which acknowledges blocks for the group */
+static bool	tftp_mcast_master;
+/* The UDP port the group receives on */
+static int	tftp_mcast_port;
+/* Blocks received so far, one bit each, as they may come in any order */
+static u8	tftp_mcast_bitmap[TFTP_SEQUENCE_SIZE / 8];
+/* Number of blocks received */
+static ulong	tftp_mcast_received;
+/* First block not received yet */
+static ulong	tftp_mcast_hole;
+/* The final (short) block, or 0 if not seen yet */
+static ulong	tftp_mcast_last;
+#else
+#define tftp_mcast_wanted	false
+#endif
+
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
 	ulong offset = block * tftp_block_size + tftp_block_wrap_offset -
@@ -172,7 +222,9 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	}
 #endif
 	ptr = map_sysmem(store_addr, len);
-	memcpy(ptr, src, len);
+	/* The driver may have put the block here already */
+	if (ptr != src)
+		memcpy(ptr, src, len);
 	unmap_sysmem(ptr);
 
 	if (net_boot_file_size < newsize)
@@ -181,6 +233,48 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+/*
+ * Ask the driver to put the data of the next block straight where
+ * store_block() would copy it, leaving the opcode and block number behind
+ */
+static void *tftp_rx_place(int *app_hdr_len, int *max_len, int *port)
+{
+	ulong offset = tftp_cur_block * tftp_block_size +
+		       tftp_block_wrap_offset;
+	ulong store_addr = tftp_load_addr + offset;
+	int len = tftp_block_size;
+	void *ptr;
+
+	/* Each block must arrive in a single frame, in order */
+	if (tftp_state != STATE_DATA || tftp_put_active || tftp_use_ip6 ||
+	    tftp_block_size > 1500 - IP_UDP_HDR_SIZE - 4)
+		return NULL;
+#ifdef CONFIG_TFTP_MULTICAST
+	if (tftp_mcast_active)
+		return NULL;
+#endif
+#ifdef CONFIG_TFTP_TSIZE
+	/* Nothing goes beyond the end of the file */
+	if (tftp_tsize) {
+		if (offset >= tftp_tsize)
+			return NULL;
+		len = min_t(ulong, len, tftp_tsize - offset);
+	}
+#endif
+#ifdef CONFIG_LMB
+	if (tftp_load_size && store_addr + len >
+	    tftp_load_addr + tftp_load_size)
+		return NULL;
+#endif
+	ptr = map_sysmem(store_addr, len);
+	unmap_sysmem(ptr);
+	*app_hdr_len = 4;
+	*max_len = len;
+	*port = tftp_our_port;
+
+	return ptr;
+}
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
@@ -259,6 +353,52 @@ static void restart(const char *msg)
 	net_start_again();
 }
 
+#ifdef CONFIG_TFTP_ADAPTIVE
+/* Time the reply to the packet just sent, unless already timing one */
+static void tftp_rtt_begin(void)
+{
+	if (tftp_rtt_timing)
+		return;
+	tftp_rtt_start = get_timer(0);
+	tftp_rtt_block = tftp_cur_block;
+	tftp_rtt_timing = true;
+}
+
+/* Update the retransmit timeout from a new sample, as in RFC 6298 */
+static void tftp_rtt_end(void)
+{
+	ulong rtt = get_timer(tftp_rtt_start);
+	long err;
+
+	tftp_rtt_timing = false;
+	if (!tftp_have_rtt) {
+		tftp_srtt = rtt << 3;
+		tftp_rttvar = rtt << 1;
+		tftp_have_rtt = true;
+	} else {
+		err = rtt - (tftp_srtt >> 3);
+		tftp_srtt += err;
+		if (err < 0)
+			err = -err;
+		tftp_rttvar += err - (tftp_rttvar >> 2);
+	}
+	tftp_rto = (tftp_srtt >> 3) + tftp_rttvar;
+	tftp_rto = clamp(tftp_rto, TFTP_RTO_MIN, timeout_ms);
+}
+#else
+static inline void tftp_rtt_begin(void) {}
+#endif
+
+/* Note a missing block; the next request then asks for a smaller window */
+static void tftp_note_loss(void)
+{
+#ifdef CONFIG_TFTP_ADAPTIVE
+	if (!tftp_losses)
+		tftp_adapt_window = max(tftp_adapt_window / 2, 1);
+#endif
+	tftp_losses++;
+}
+
 /*
  * Check if the block number has wrapped, and update progress
  *
@@ -283,6 +423,12 @@ static void update_block_number(void)
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
+	/*
+	 * Frames already received in the same batch must not be stored or
+	 * placed after the end of the file
+	 */
+	net_set_udp_handler(NULL);
+	net_set_rx_place_handler(NULL);
 #ifdef CONFIG_TFTP_TSIZE
 	/* Print hash marks for the last packet received */
 	while (tftp_tsize && tftp_tsize_num_hash < 49) {
@@ -297,8 +443,17 @@ static void tftp_complete(void)
 		puts("\n\t ");	/* Line up with "Loading: " */
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
+		if (tftp_windowsize > 1 || tftp_losses)
+			printf(" (window %d, %u lost)", tftp_windowsize,
+			       tftp_losses);
 	}
 	puts("\ndone\n");
+#ifdef CONFIG_TFTP_ADAPTIVE
+	/* A clean transfer means the next one can try a larger window */
+	if (!tftp_put_active && !tftp_losses)
+		tftp_adapt_window = min(tftp_adapt_window * 2,
+					(int)tftp_window_size_option);
+#endif
 	if (IS_ENABLED(CONFIG_CMD_BOOTEFI)) {
 		if (!tftp_put_active)
 			efi_set_bootdev("Net", "", tftp_filename,
@@ -308,6 +463,30 @@ static void tftp_complete(void)
 	net_set_state(NETLOOP_SUCCESS);
 }
 
+/* The window size to ask the server for */
+static int tftp_request_window(void)
+{
+#ifdef CONFIG_TFTP_ADAPTIVE
+	return tftp_adapt_window;
+#else
+	return tftp_window_size_option;
+#endif
+}
+
+/*
+ * The block size to ask the server for. IPv6 packets are not reassembled,
+ * so each block must fit in one Ethernet frame.
+ */
+static int tftp_request_blksize(void)
+{
+	/* 4 bytes of TFTP opcode and block number precede the data */
+	if (tftp_use_ip6)
+		return min_t(int, tftp_block_size_option,
+			     1500 - IP6_UDPHDR_SIZE - 4);
+
+	return tftp_block_size_option;
+}
+
 static void tftp_send(void)
 {
 	uchar *pkt;
@@ -320,7 +499,8 @@ static void tftp_send(void)
 	 *	We will always be sending some sort of packet, so
 	 *	cobble together the packet headers now.
 	 */
-	pkt = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+	pkt = net_tx_packet + net_eth_hdr_size() +
+	      (tftp_use_ip6 ? IP6_UDPHDR_SIZE : IP_UDP_HDR_SIZE);
 
 	switch (tftp_state) {
 	case STATE_SEND_RRQ:
@@ -349,15 +529,20 @@ static void tftp_send(void)
 #endif
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
-				0, tftp_block_size_option, 0);
+				0, tftp_request_blksize(), 0);
 
 		/* try for more effic. window size.
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_request_window() > 1 &&
+		    !tftp_mcast_wanted)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_request_window(), 0);
+#ifdef CONFIG_TFTP_MULTICAST
+		if (tftp_state == STATE_SEND_RRQ && tftp_mcast_wanted)
+			pkt += sprintf((char *)pkt, "multicast%c%c", 0, 0);
+#endif
 		len = pkt - xp;
 		break;
 
@@ -422,8 +607,14 @@ static void tftp_send(void)
 		break;
 	}
 
-	net_send_udp_packet(net_server_ethaddr, tftp_remote_ip,
-			    tftp_remote_port, tftp_our_port, len);
+#ifdef CONFIG_IPV6
+	if (tftp_use_ip6)
+		net_send_udp_packet6(net_server_ethaddr, &tftp_remote_ip6,
+				     tftp_remote_port, tftp_our_port, len);
+	else
+#endif
+		net_send_udp_packet(net_server_ethaddr, tftp_remote_ip,
+				    tftp_remote_port, tftp_our_port, len);
 
 	if (err_pkt)
 		net_set_state(NETLOOP_FAIL);
@@ -441,6 +632,107 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+#ifdef CONFIG_TFTP_MULTICAST
+static bool tftp_mcast_test(ulong block)
+{
+	return tftp_mcast_bitmap[block / 8] & BIT(block % 8);
+}
+
+/*
+ * Leave the multicast group, if we joined one. The network loop leaves it
+ * too if the transfer fails or is aborted.
+ */
+static void tftp_mcast_leave(void)
+{
+	net_mcast_leave();
+	tftp_mcast_active = false;
+}
+
+/*
+ * Handle the "multicast" option in an OACK, which is "addr,port,mc". Only the
+ * first OACK has to give the group; later ones just say whether we are now
+ * the master client.
+ */
+static int tftp_mcast_oack(const char *val)
+{
+	struct in_addr addr;
+	char buf[32];
+	char *port, *mc;
+	int ret;
+
+	strlcpy(buf, val, sizeof(buf));
+	port = strchr(buf, ',');
+	mc = port ? strchr(port + 1, ',') : NULL;
+	if (!mc)
+		return -EINVAL;
+	*port++ = '\0';
+	*mc++ = '\0';
+	tftp_mcast_master = dectoul(mc, NULL) == 1;
+	debug("Multicast oack: %s:%s, %s\n", buf, port,
+	      tftp_mcast_master ? "master" : "listening");
+	if (tftp_mcast_active)
+		return 0;
+
+	addr = string_to_ip(buf);
+	if ((ntohl(addr.s_addr) >> 28) != 0xe || !*port)
+		return -EINVAL;
+	/* A device that cannot filter multicast may receive it anyway */
+	ret = eth_mcast_join(addr, 1);
+	if (ret && ret != -ENOSYS)
+		return ret;
+
+	net_mcast_addr = addr;
+	tftp_mcast_port = dectoul(port, NULL);
+	tftp_mcast_active = true;
+	memset(tftp_mcast_bitmap, '\0', sizeof(tftp_mcast_bitmap));
+	tftp_mcast_received = 0;
+	tftp_mcast_hole = 1;
+	tftp_mcast_last = 0;
+	new_transfer();
+
+	return 0;
+}
+
+/* Store a block sent to the group; they need not arrive in order */
+static void tftp_mcast_data(ulong block, uchar *data, unsigned int len)
+{
+	if (!block || (tftp_mcast_last && block > tftp_mcast_last))
+		return;
+	tftp_state = STATE_DATA;
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+
+	if (!tftp_mcast_test(block)) {
+		if (store_block(block, data, len)) {
+			tftp_mcast_leave();
+			eth_halt();
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+		tftp_mcast_bitmap[block / 8] |= BIT(block % 8);
+		if (len < tftp_block_size)
+			tftp_mcast_last = block;
+		/* Show progress by the number of blocks received */
+		tftp_cur_block = ++tftp_mcast_received;
+		show_block_marker();
+	}
+	while (tftp_mcast_hole < TFTP_SEQUENCE_SIZE &&
+	       tftp_mcast_test(tftp_mcast_hole))
+		tftp_mcast_hole++;
+
+	/* Acknowledge everything up to the first block still missing */
+	tftp_cur_block = tftp_mcast_hole - 1;
+	if (tftp_mcast_last && tftp_mcast_hole > tftp_mcast_last) {
+		/* Tell the server we are done, even if not the master */
+		tftp_send();
+		tftp_mcast_leave();
+		tftp_complete();
+		return;
+	}
+	if (tftp_mcast_master)
+		tftp_send();
+}
+#endif
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -450,11 +742,20 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	u16 timeout_val_rcvd;
 
 	if (dest != tftp_our_port) {
+#ifdef CONFIG_TFTP_MULTICAST
+		if (!tftp_mcast_active || dest != tftp_mcast_port)
+#endif
 			return;
 	}
 	if (tftp_state != STATE_SEND_RRQ && src != tftp_remote_port &&
 	    tftp_state != STATE_RECV_WRQ && tftp_state != STATE_SEND_WRQ)
 		return;
+#ifdef CONFIG_IPV6
+	/* @sip is zero for IPv6, so check the sender here */
+	if (tftp_use_ip6 &&
+	    memcmp(&net_rx_src_ip6, &tftp_remote_ip6, sizeof(tftp_remote_ip6)))
+		return;
+#endif
 
 	if (len < 2)
 		return;
@@ -463,6 +764,10 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	s = (__be16 *)pkt;
 	proto = *s++;
 	pkt = (uchar *)s;
+	/* Only the data of the expected block can be used where it was put */
+	if (ntohs(proto) != TFTP_DATA ||
+	    ntohs(*s) != (ushort)(tftp_cur_block + 1))
+		net_rx_unsplit();
 	switch (ntohs(proto)) {
 	case TFTP_RRQ:
 		break;
@@ -513,6 +818,10 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("%c", pkt[i]);
 		}
 		debug("\n");
+#ifdef CONFIG_TFTP_ADAPTIVE
+		if (tftp_state == STATE_SEND_RRQ && tftp_rtt_timing)
+			tftp_rtt_end();
+#endif
 		tftp_state = STATE_OACK;
 		tftp_remote_port = src;
 		/*
@@ -526,7 +835,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 					dectoul((char *)pkt + i + 8, NULL);
 				debug("Blocksize oack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
-				if (tftp_block_size > tftp_block_size_option) {
+				if (tftp_block_size > tftp_request_blksize()) {
 					printf("Invalid blk size(=%d)\n",
 					       tftp_block_size);
 					tftp_state = STATE_INVALID_OPTION;
@@ -557,8 +866,30 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("windowsize = %s, %d\n",
 				      (char *)pkt + i + 11, tftp_windowsize);
 			}
+#ifdef CONFIG_TFTP_MULTICAST
+			if (strcasecmp((char *)pkt + i, "multicast") == 0 &&
+			    tftp_mcast_oack((char *)pkt + i + 10)) {
+				printf("Invalid multicast option '%s'\n",
+				       (char *)pkt + i + 10);
+				tftp_state = STATE_INVALID_OPTION;
+			}
+#endif
 		}
 
+#ifdef CONFIG_TFTP_MULTICAST
+		if (tftp_mcast_active && tftp_state == STATE_OACK) {
+			if (tftp_mcast_received)
+				tftp_state = STATE_DATA;
+			net_set_timeout_handler(timeout_ms,
+						tftp_timeout_handler);
+			/* The master asks for the first block still missing */
+			tftp_cur_block = tftp_mcast_hole - 1;
+			if (tftp_mcast_master)
+				tftp_send();
+			break;
+		}
+#endif
+
 		tftp_next_ack = tftp_windowsize;
 
 #ifdef CONFIG_CMD_TFTPPUT
@@ -569,12 +900,20 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 #endif
 		tftp_send(); /* Send ACK or first data block */
+		if (!tftp_put_active)
+			tftp_rtt_begin();
 		break;
 	case TFTP_DATA:
 		if (len < 2)
 			return;
 		len -= 2;
 
+#ifdef CONFIG_TFTP_MULTICAST
+		if (tftp_mcast_active) {
+			tftp_mcast_data(ntohs(*(__be16 *)pkt), pkt + 2, len);
+			break;
+		}
+#endif
 		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
 			debug("Received unexpected block: %d, expected: %d\n",
 			      ntohs(*(__be16 *)pkt),
@@ -584,10 +923,23 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 * all other buffers in the window
 			 * that will arrive will cause a sending NACK.
 			 * This just overwellms the server, let's just send one.
+			 * Only if a whole window more arrives without the
+			 * missing block was the resent one lost too, so send
+			 * another rather than wait for the timeout.
 			 */
-			if (tftp_last_nack != tftp_cur_block) {
+			if (tftp_last_nack != tftp_cur_block ||
+			    (tftp_windowsize > 1 &&
+			     ++tftp_nack_count >= tftp_windowsize)) {
+				/* A block from further on means one is lost */
+				if (tftp_last_nack != tftp_cur_block &&
+				    tftp_state == STATE_DATA &&
+				    (ushort)(ntohs(*(__be16 *)pkt) -
+					     tftp_cur_block) <
+				    TFTP_SEQUENCE_SIZE / 2)
+					tftp_note_loss();
 				tftp_send();
 				tftp_last_nack = tftp_cur_block;
+				tftp_nack_count = 0;
 				tftp_next_ack = (ushort)(tftp_cur_block +
 							 tftp_windowsize);
 			}
@@ -627,9 +979,16 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		update_block_number();
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+#ifdef CONFIG_TFTP_ADAPTIVE
+		if (tftp_rtt_timing &&
+		    tftp_cur_block == (ushort)(tftp_rtt_block + 1))
+			tftp_rtt_end();
+#endif
+		net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
 
-		if (store_block(tftp_cur_block, pkt + 2, len)) {
+		if (store_block(tftp_cur_block,
+				net_rx_payload ? net_rx_payload : pkt + 2,
+				len)) {
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			break;
@@ -647,6 +1006,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		 */
 		if (tftp_cur_block == tftp_next_ack) {
 			tftp_send();
+			tftp_rtt_begin();
 			tftp_next_ack += tftp_windowsize;
 		}
 		break;
@@ -676,16 +1036,43 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	}
 }
 
+/* Send our last packet again after a timeout, if it is ours to send */
+static void tftp_resend(void)
+{
+	if (tftp_state == STATE_RECV_WRQ)
+		return;
+#ifdef CONFIG_TFTP_MULTICAST
+	/* Only the master client may prompt the server */
+	if (tftp_mcast_active && !tftp_mcast_master)
+		return;
+#endif
+	tftp_send();
+}
 
 static void tftp_timeout_handler(void)
 {
+	if (tftp_state == STATE_DATA)
+		tftp_note_loss();
+#ifdef CONFIG_TFTP_ADAPTIVE
+	/* No RTT sample from a packet that is sent again */
+	tftp_rtt_timing = false;
+	if (tftp_rto < timeout_ms) {
+		/*
+		 * Back off quickly from the estimated timeout; only timeouts
+		 * of the full length count towards the limit
+		 */
+		tftp_rto = min(tftp_rto * 2, timeout_ms);
+		net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
+		tftp_resend();
+		return;
+	}
+#endif
 	if (++timeout_count > timeout_count_max) {
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-		if (tftp_state != STATE_RECV_WRQ)
-			tftp_send();
+		net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
+		tftp_resend();
 	}
 }
 
@@ -708,6 +1095,69 @@ static int tftp_init_load_addr(void)
 	return 0;
 }
 
+static void tftp_init_remote(enum proto_t protocol)
+{
+	tftp_remote_ip = net_server_ip;
+	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
+		sprintf(default_filename, "%02X%02X%02X%02X.img",
+			net_ip.s_addr & 0xFF,
+			(net_ip.s_addr >>  8) & 0xFF,
+			(net_ip.s_addr >> 16) & 0xFF,
+			(net_ip.s_addr >> 24) & 0xFF);
+
+		strncpy(tftp_filename, default_filename, DEFAULT_NAME_LEN);
+		tftp_filename[DEFAULT_NAME_LEN - 1] = 0;
+
+		printf("*** Warning: no boot file name; using '%s'\n",
+		       tftp_filename);
+	}
+
+	printf("Using %s device\n", eth_get_name());
+	printf("TFTP %s server %pI4; our IP address is %pI4",
+#ifdef CONFIG_CMD_TFTPPUT
+	       protocol == TFTPPUT ? "to" : "from",
+#else
+	       "from",
+#endif
+	       &tftp_remote_ip, &net_ip);
+
+	/* Check if we need to send across this subnet */
+	if (net_gateway.s_addr && net_netmask.s_addr) {
+		struct in_addr our_net;
+		struct in_addr remote_net;
+
+		our_net.s_addr = net_ip.s_addr & net_netmask.s_addr;
+		remote_net.s_addr = tftp_remote_ip.s_addr & net_netmask.s_addr;
+		if (our_net.s_addr != remote_net.s_addr)
+			printf("; sending through gateway %pI4", &net_gateway);
+	}
+	putc('\n');
+}
+
+#ifdef CONFIG_IPV6
+static int tftp_init_remote6(enum proto_t protocol)
+{
+	tftp_remote_ip6 = net_server_ip6;
+	if (net_parse_bootfile6(&tftp_remote_ip6, tftp_filename,
+				MAX_LEN) != 1) {
+		puts("*** ERROR: no boot file name or bad server address\n");
+		net_set_state(NETLOOP_FAIL);
+		return -EINVAL;
+	}
+
+	printf("Using %s device\n", eth_get_name());
+	printf("TFTP %s server %pI6c; our IPv6 address is %pI6c\n",
+#ifdef CONFIG_CMD_TFTPPUT
+	       protocol == TFTPPUT ? "to" : "from",
+#else
+	       "from",
+#endif
+	       &tftp_remote_ip6, ip6_src_addr(&tftp_remote_ip6));
+
+	return 0;
+}
+#endif
+
 void tftp_start(enum proto_t protocol)
 {
 #if CONFIG_NET_TFTP_VARS
@@ -747,44 +1197,32 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
-	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
-
-	tftp_remote_ip = net_server_ip;
-	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
-		sprintf(default_filename, "%02X%02X%02X%02X.img",
-			net_ip.s_addr & 0xFF,
-			(net_ip.s_addr >>  8) & 0xFF,
-			(net_ip.s_addr >> 16) & 0xFF,
-			(net_ip.s_addr >> 24) & 0xFF);
-
-		strncpy(tftp_filename, default_filename, DEFAULT_NAME_LEN);
-		tftp_filename[DEFAULT_NAME_LEN - 1] = 0;
-
-		printf("*** Warning: no boot file name; using '%s'\n",
-		       tftp_filename);
-	}
-
-	printf("Using %s device\n", eth_get_name());
-	printf("TFTP %s server %pI4; our IP address is %pI4",
-#ifdef CONFIG_CMD_TFTPPUT
-	       protocol == TFTPPUT ? "to" : "from",
-#else
-	       "from",
+#ifdef CONFIG_TFTP_ADAPTIVE
+	/* Start with the largest window allowed; losses shrink it later */
+	if (!tftp_adapt_window || tftp_adapt_window > tftp_window_size_option)
+		tftp_adapt_window = tftp_window_size_option;
+	tftp_have_rtt = false;
+	tftp_rtt_timing = false;
+#endif
+	tftp_rto = timeout_ms;
+	tftp_losses = 0;
+#ifdef CONFIG_TFTP_MULTICAST
+	/* A restarted transfer joins the group again if the server says so */
+	tftp_mcast_leave();
+	tftp_mcast_wanted = protocol != TFTPPUT && !tftp_use_ip6 &&
+			    env_get_yesno("tftpmcast") == 1;
 #endif
-	       &tftp_remote_ip, &net_ip);
 
-	/* Check if we need to send across this subnet */
-	if (net_gateway.s_addr && net_netmask.s_addr) {
-		struct in_addr our_net;
-		struct in_addr remote_net;
+	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_request_window(), timeout_ms);
 
-		our_net.s_addr = net_ip.s_addr & net_netmask.s_addr;
-		remote_net.s_addr = tftp_remote_ip.s_addr & net_netmask.s_addr;
-		if (our_net.s_addr != remote_net.s_addr)
-			printf("; sending through gateway %pI4", &net_gateway);
-	}
-	putc('\n');
+#ifdef CONFIG_IPV6
+	if (tftp_use_ip6) {
+		if (tftp_init_remote6(protocol))
+			return;
+	} else
+#endif
+		tftp_init_remote(protocol);
 
 	printf("Filename '%s'.", tftp_filename);
 
@@ -824,6 +1262,7 @@ void tftp_start(enum proto_t protocol)
 
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
+	net_set_rx_place_handler(tftp_rx_place);
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
 #endif
@@ -843,6 +1282,7 @@ void tftp_start(enum proto_t protocol)
 	tftp_cur_block = 0;
 	tftp_windowsize = 1;
 	tftp_last_nack = 0;
+	tftp_nack_count = 0;
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
@@ -853,6 +1293,8 @@ void tftp_start(enum proto_t protocol)
 #endif
 
 	tftp_send();
+	if (!tftp_put_active)
+		tftp_rtt_begin();
 }
 
 #ifdef CONFIG_CMD_TFTPSRV
@@ -875,6 +1317,8 @@ void tftp_start_server(void)
 	timeout_count_max = tftp_timeout_count_max;
 	timeout_count = 0;
 	timeout_ms = TIMEOUT;
+	tftp_rto = timeout_ms;
+	tftp_losses = 0;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 	/* Revert tftp_block_size to dflt */
@@ -891,6 +1335,7 @@ void tftp_start_server(void)
 
 	tftp_state = STATE_RECV_WRQ;
 	net_set_udp_handler(tftp_handler);
+	net_set_rx_place_handler(tftp_rx_place);
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Download a file over HTTP
+ *
+ * The file is fetched with a plain HTTP/1.1 GET and the body is written
+ * straight to the load address as it arrives, at its offset in the file, so
+ * nothing is copied twice. Only "200 OK" responses are accepted; redirects,
+ * chunked encoding and HTTPS are not supported.
+ */
+
+#include <common.h>
+#include <display_options.h>
+#include <efi_loader.h>
+#include <env.h>
+#include <image.h>
+#include <lmb.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/global_data.h>
+#include <linux/sizes.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Space for the response status line and headers */
+#define WGET_HDR_MAX		2048
+/* Amount of data shown by each '#' */
+#define WGET_HASH_SIZE		SZ_64K
+#define HASHES_PER_LINE		65
+
+static struct in_addr wget_server_ip;
+static int wget_server_port;
+static char wget_path[1024];
+static ulong wget_load_addr;
+static ulong wget_load_size;
+static ulong wget_time_start;
+
+/* Response state */
+static char wget_hdr[WGET_HDR_MAX + 1];
+static uint wget_hdr_len;
+static bool wget_hdr_done;
+static u32 wget_body_start;
+static long wget_content_len;
+static uint wget_hashes;
+
+static void wget_restart(const char *msg)
+{
+	printf("\n%s; starting again\n", msg);
+	net_start_again();
+}
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget error: %s\nNot retrying...\n", msg);
+	net_set_state(NETLOOP_FAIL);
+}
+
+static int wget_parse_header(void)
+{
+	char *line, *next, *p;
+	int status;
+
+	if (strncmp(wget_hdr, "HTTP/1.", 7)) {
+		wget_fail("not an HTTP response");
+		return -EPROTO;
+	}
+	next = strstr(wget_hdr, "\r\n");
+	p = strchr(wget_hdr, ' ');
+	status = p ? simple_strtoul(p + 1, NULL, 10) : 0;
+	if (status != 200) {
+		*next = '\0';
+		printf("\nHTTP error: '%s'", wget_hdr);
+		wget_fail("server did not send the file");
+		return -ENOENT;
+	}
+
+	wget_content_len = -1;
+	for (line = next + 2; line < wget_hdr + wget_body_start - 2;
+	     line = next + 2) {
+		next = strstr(line, "\r\n");
+		if (!strncasecmp(line, "Content-Length:", 15)) {
+			wget_content_len = simple_strtoul(skip_spaces(line + 15),
+							  NULL, 10);
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18)) {
+			*next = '\0';
+			if (strstr(line, "chunked")) {
+				wget_fail("chunked encoding is not supported");
+				return -EPROTONOSUPPORT;
+			}
+		}
+	}
+
+	if (wget_content_len >= 0 &&
+	    (ulong)wget_content_len > wget_load_size) {
+		wget_fail("file is too large for the available memory");
+		return -E2BIG;
+	}
+
+	return 0;
+}
+
+static int wget_rx(u32 offset, const uchar *data, uint len)
+{
+	char *end;
+	uint n;
+	void *ptr;
+
+	if (!wget_hdr_done) {
+		/* Headers are parsed in order; the server resends the rest */
+		if (offset != wget_hdr_len)
+			return -EAGAIN;
+		n = min(len, WGET_HDR_MAX - wget_hdr_len);
+		memcpy(wget_hdr + wget_hdr_len, data, n);
+		wget_hdr_len += n;
+		wget_hdr[wget_hdr_len] = '\0';
+
+		end = strstr(wget_hdr, "\r\n\r\n");
+		if (!end) {
+			if (wget_hdr_len < WGET_HDR_MAX)
+				return 0;
+			wget_fail("HTTP headers too long");
+			return -E2BIG;
+		}
+		wget_body_start = end + 4 - wget_hdr;
+		if (wget_parse_header())
+			return -EINVAL;
+		wget_hdr_done = true;
+
+		if (offset + len <= wget_body_start)
+			return 0;
+		data += wget_body_start - offset;
+		len -= wget_body_start - offset;
+		offset = wget_body_start;
+	}
+
+	offset -= wget_body_start;
+	if (offset + len > wget_load_size) {
+		wget_fail("file is too large for the available memory");
+		return -E2BIG;
+	}
+	ptr = map_sysmem(wget_load_addr + offset, len);
+	memcpy(ptr, data, len);
+	unmap_sysmem(ptr);
+
+	return 0;
+}
+
+static void wget_send_request(void)
+{
+	char req[1200];
+	int len, ret;
+
+	len = snprintf(req, sizeof(req), "GET %s%s HTTP/1.1\r\nHost: %pI4",
+		       *wget_path == '/' ? "" : "/", wget_path,
+		       &wget_server_ip);
+	if (wget_server_port != WGET_HTTP_PORT)
+		len += snprintf(req + len, sizeof(req) - len, ":%d",
+				wget_server_port);
+	len += snprintf(req + len, sizeof(req) - len,
+			"\r\nUser-Agent: U-Boot\r\nConnection: close\r\n\r\n");
+
+	ret = len < sizeof(req) ? tcp_send(req, len) : -E2BIG;
+	if (ret)
+		wget_fail("cannot send request");
+}
+
+static void wget_done(ulong size)
+{
+	ulong time;
+
+	tcp_close();
+	net_boot_file_size = size;
+
+	time = get_timer(wget_time_start);
+	if (time > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(size / time * 1000, "/s");
+	}
+	puts("\ndone\n");
+	if (IS_ENABLED(CONFIG_CMD_BOOTEFI))
+		efi_set_bootdev("Net", "", wget_path,
+				map_sysmem(wget_load_addr, 0), size);
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_event(enum tcp_event event)
+{
+	ulong size = 0;
+
+	if (wget_hdr_done)
+		size = tcp_get_rx_len() - wget_body_start;
+
+	switch (event) {
+	case TCP_EV_CONNECTED:
+		wget_send_request();
+		break;
+	case TCP_EV_DATA:
+		if (!wget_hdr_done)
+			break;
+		while (wget_hashes < size / WGET_HASH_SIZE) {
+			putc('#');
+			if (!(++wget_hashes % HASHES_PER_LINE))
+				puts("\n\t ");
+		}
+		if (wget_content_len >= 0 && size >= (ulong)wget_content_len)
+			wget_done(size);
+		break;
+	case TCP_EV_CLOSED:
+		/* Without a Content-Length the end of the file is the close */
+		if (wget_hdr_done && wget_content_len < 0)
+			wget_done(size);
+		else
+			wget_restart("Connection closed early");
+		break;
+	case TCP_EV_RESET:
+		wget_restart("Connection reset by server");
+		break;
+	case TCP_EV_TIMEOUT:
+		wget_restart("Retry count exceeded");
+		break;
+	}
+}
+
+/* Work out how much can be loaded at image_load_addr without hitting lmb */
+static int wget_init_load_addr(void)
+{
+	wget_load_size = ULONG_MAX;
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+
+	wget_load_size = lmb_get_free_size(&lmb, image_load_addr);
+	if (!wget_load_size)
+		return -1;
+#endif
+	wget_load_addr = image_load_addr;
+
+	return 0;
+}
+
+void wget_start(void)
+{
+	char *ep;
+
+	wget_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&wget_server_ip, wget_path,
+				sizeof(wget_path))) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	wget_server_port = WGET_HTTP_PORT;
+	ep = env_get("httpdstp");
+	if (ep)
+		wget_server_port = simple_strtol(ep, NULL, 10);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+
+	if (wget_init_load_addr()) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		puts("\nwget error: ");
+		puts("trying to overwrite reserved memory...\n");
+		return;
+	}
+	printf("Load address: 0x%lx\n", wget_load_addr);
+	puts("Loading: *\b");
+
+	wget_hdr_len = 0;
+	wget_hdr_done = false;
+	wget_hashes = 0;
+	wget_time_start = get_timer(0);
+
+	tcp_connect(wget_server_ip, wget_server_port, wget_rx, wget_event);
+}
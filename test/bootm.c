@@ -7,6 +7,8 @@
 
 #include <common.h>
 #include <bootm.h>
+#include <hash.h>
+#include <image.h>
 #include <asm/global_data.h>
 #include <test/suites.h>
 #include <test/test.h>
@@ -238,6 +240,75 @@ static int bootm_test_subst_both(struct unit_test_state *uts)
 }
 BOOTM_TEST(bootm_test_subst_both, 0);
 
+#if CONFIG_IS_ENABLED(FIT)
+/* Images in the FIT used to test verification, and the size of each */
+#define FIT_TEST_IMAGES		3
+#define FIT_TEST_IMAGE_SIZE	0x1000
+
+/* Set up a FIT holding the images in @data, each with a sha256 hash */
+static int setup_fit(struct unit_test_state *uts, void *fit, int size,
+		     const u8 *data)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int images, node, value_len, i;
+	char name[20];
+
+	ut_assertok(fdt_create_empty_tree(fit, size));
+	images = fdt_add_subnode(fit, 0, "images");
+	ut_assert(images >= 0);
+	for (i = 0; i < FIT_TEST_IMAGES; i++) {
+		const u8 *img = data + i * FIT_TEST_IMAGE_SIZE;
+
+		snprintf(name, sizeof(name), "image-%d", i);
+		node = fdt_add_subnode(fit, images, name);
+		ut_assert(node >= 0);
+		ut_assertok(fdt_setprop(fit, node, FIT_DATA_PROP, img,
+					FIT_TEST_IMAGE_SIZE));
+		node = fdt_add_subnode(fit, node, "hash-1");
+		ut_assert(node >= 0);
+		ut_assertok(fdt_setprop_string(fit, node, FIT_ALGO_PROP,
+					       "sha256"));
+		value_len = sizeof(value);
+		ut_assertok(hash_block("sha256", img, FIT_TEST_IMAGE_SIZE,
+				       value, &value_len));
+		ut_assertok(fdt_setprop(fit, node, FIT_VALUE_PROP, value,
+					value_len));
+	}
+
+	return 0;
+}
+
+/* Test checking the hashes of all images in a FIT */
+static int bootm_test_fit_verify(struct unit_test_state *uts)
+{
+	u8 data[FIT_TEST_IMAGES * FIT_TEST_IMAGE_SIZE];
+	u64 fit[(sizeof(data) + 0x1000) / sizeof(u64)];
+	const void *img;
+	size_t size;
+	int node, i;
+
+	for (i = 0; i < FIT_TEST_IMAGES; i++)
+		memset(data + i * FIT_TEST_IMAGE_SIZE, 'a' + i,
+		       FIT_TEST_IMAGE_SIZE);
+	ut_assertok(setup_fit(uts, fit, sizeof(fit), data));
+	ut_asserteq(1, fit_all_image_verify(fit));
+
+	/* A hash worked out for the previous check must not be used again */
+	node = fdt_path_offset(fit, "/images/image-2");
+	ut_assert(node >= 0);
+	ut_assertok(fit_image_get_data(fit, node, &img, &size));
+	ut_asserteq(FIT_TEST_IMAGE_SIZE, size);
+	((u8 *)img)[size - 1] ^= 1;
+	ut_asserteq(0, fit_all_image_verify(fit));
+
+	((u8 *)img)[size - 1] ^= 1;
+	ut_asserteq(1, fit_all_image_verify(fit));
+
+	return 0;
+}
+BOOTM_TEST(bootm_test_fit_verify, 0);
+#endif
+
 int do_ut_bootm(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	struct unit_test *tests = UNIT_TEST_SUITE_START(bootm_test);
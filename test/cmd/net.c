@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Helpers for tests which load a file from a server attached to the sandbox
+ * Ethernet driver
+ */
+
+#include <common.h>
+#include <command.h>
+#include <env.h>
+#include <mapmem.h>
+#include <asm/eth.h>
+#include <test/net.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+int net_test_run(sandbox_eth_tx_hand_f *server, void *srv, const char *cmd)
+{
+	int ret;
+
+	sandbox_eth_set_tx_handler(0, server);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	ret = run_command(cmd, 0);
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+
+	return ret;
+}
+
+int net_test_load(struct unit_test_state *uts, sandbox_eth_tx_hand_f *server,
+		  void *srv, const char *cmd, void *file, uint size, uint seed)
+{
+	char *buf;
+
+	ut_fill_pattern(file, size, seed);
+	ut_assertok(net_test_run(server, srv, cmd));
+
+	ut_asserteq(size, env_get_hex("filesize", 0));
+	buf = map_sysmem(NET_TEST_ADDR, size);
+	ut_asserteq_mem(file, buf, size);
+	unmap_sysmem(buf);
+
+	return 0;
+}
@@ -0,0 +1,681 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for TFTP
+ *
+ * A TFTP server is attached to the sandbox Ethernet driver. For multicast TFTP
+ * (RFC 2090) it answers a request as if another client were already the
+ * master of a transfer that is part way through: the first blocks we see are
+ * from the middle of the file. It then makes us the master and sends whatever
+ * we ask for. Otherwise, over IPv4 or IPv6, it just sends each block in turn.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <console.h>
+#include <dm.h>
+#include <env.h>
+#include <log.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net6.h>
+#include <time.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <test/net.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TFTP_TEST_BLKSIZE	512
+#define TFTP_TEST_BLOCKS	5
+#define TFTP_TEST_SIZE		((TFTP_TEST_BLOCKS - 1) * TFTP_TEST_BLKSIZE + 100)
+#define TFTP_TEST_GROUP		"239.255.1.1"
+#define TFTP_TEST_GROUP_PORT	1758
+#define TFTP_TEST_SRV_PORT	2000
+#define TFTP_TEST_MAX_ACKS	10
+
+/* TFTP operations */
+#define TFTP_RRQ		1
+#define TFTP_DATA		3
+#define TFTP_ACK		4
+#define TFTP_ERROR		5
+#define TFTP_OACK		6
+
+/**
+ * enum tftp_test_stop - how the server ends a multicast transfer early
+ *
+ * @TFTP_TEST_FINISH:	Send the whole file
+ * @TFTP_TEST_CTRLC:	Press Ctrl-C once the client is the master
+ * @TFTP_TEST_ERROR:	Send an error once the client is the master
+ */
+enum tftp_test_stop {
+	TFTP_TEST_FINISH,
+	TFTP_TEST_CTRLC,
+	TFTP_TEST_ERROR,
+};
+
+/**
+ * struct tftp_test_srv - State of the test TFTP server
+ *
+ * @file:	File being served
+ * @client_port: UDP port the client sent its request from
+ * @acks:	Blocks acknowledged by the client, in order
+ * @num_acks:	Number of entries in @acks
+ * @got_mcast:	true if the client asked for the multicast option
+ * @sent_mcast:	true if a block was delivered to the group
+ * @stray:	Send a full block after the last one, which must be ignored
+ * @stop:	How to end a multicast transfer
+ * @was_joined:	true if the client had joined the group when it became the
+ *		master
+ * @window:	Window size the client asked for
+ * @drop_block:	Block to drop once, along with the reply to the first ACK
+ *		which the client sends again when it is missing, or 0
+ * @drop_time:	Time at which the client started waiting for @drop_block
+ * @resend_ms:	Time the client waited before each repeated ACK
+ * @num_resends: Number of entries in @resend_ms
+ */
+struct tftp_test_srv {
+	u8 file[TFTP_TEST_SIZE];
+	int client_port;
+	int acks[TFTP_TEST_MAX_ACKS];
+	int num_acks;
+	bool got_mcast;
+	bool sent_mcast;
+	bool stray;
+	enum tftp_test_stop stop;
+	bool was_joined;
+	int window;
+	int drop_block;
+	ulong drop_time;
+	ulong resend_ms[2];
+	int num_resends;
+};
+
+static const u8 tftp_test_group_mac[ARP_HLEN] = {
+	0x01, 0x00, 0x5e, 0x7f, 0x01, 0x01
+};
+
+static int sb_tftp_reply(struct udevice *dev, void *packet, bool mcast,
+			 const void *data, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+	struct in_addr dest;
+	int dport;
+
+	/* Behave like a device that filters out groups it has not joined */
+	if (mcast) {
+		if (!priv->mcast_joined ||
+		    memcmp(priv->mcast_hwaddr, tftp_test_group_mac, ARP_HLEN))
+			return 0;
+		srv->sent_mcast = true;
+	}
+
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return -EOVERFLOW;
+
+	if (mcast) {
+		memcpy(eth_recv->et_dest, tftp_test_group_mac, ARP_HLEN);
+		dest = string_to_ip(TFTP_TEST_GROUP);
+		dport = TFTP_TEST_GROUP_PORT;
+	} else {
+		memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+		dest = net_read_ip(&ip->ip_src);
+		dport = srv->client_port;
+	}
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ipr, dest, net_read_ip(&ip->ip_dst),
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ipr->udp_src = htons(TFTP_TEST_SRV_PORT);
+	ipr->udp_dst = htons(dport);
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+	memcpy(ipr + 1, data, len);
+
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len);
+
+	return 0;
+}
+
+/* Write a DATA packet for a block into @buf, returning its length */
+static uint sb_tftp_fill_data(struct tftp_test_srv *srv, u8 *buf, int block)
+{
+	uint offset = (block - 1) * TFTP_TEST_BLKSIZE;
+	uint len = min(TFTP_TEST_SIZE - offset, (uint)TFTP_TEST_BLKSIZE);
+
+	buf[0] = 0;
+	buf[1] = TFTP_DATA;
+	buf[2] = block >> 8;
+	buf[3] = block;
+	memcpy(buf + 4, srv->file + offset, len);
+
+	return 4 + len;
+}
+
+static int sb_tftp_data(struct udevice *dev, void *packet, int block,
+			bool mcast)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	u8 buf[4 + TFTP_TEST_BLKSIZE];
+	uint len;
+
+	len = sb_tftp_fill_data(priv->priv, buf, block);
+
+	return sb_tftp_reply(dev, packet, mcast, buf, len);
+}
+
+#if defined(CONFIG_TFTP_MULTICAST) || defined(CONFIG_TFTP_ADAPTIVE)
+static int sb_tftp_oack(struct udevice *dev, void *packet, const char *opt,
+			const char *val)
+{
+	char buf[64];
+	int len;
+
+	buf[0] = 0;
+	buf[1] = TFTP_OACK;
+	len = 2 + sprintf(buf + 2, "%s%c%s", opt, 0, val) + 1;
+
+	return sb_tftp_reply(dev, packet, false, buf, len);
+}
+#endif
+
+static int sb_tftp4_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u8 buf[4 + TFTP_TEST_BLKSIZE];
+	u8 *req = (u8 *)(ip + 1);
+	int block, ret;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	switch (req[1]) {
+	case TFTP_RRQ:
+		srv->client_port = ntohs(ip->udp_src);
+		/* Ignore the options, so blocks are the default 512 bytes */
+		return sb_tftp_data(dev, packet, 1, false);
+	case TFTP_ACK:
+		block = req[2] << 8 | req[3];
+		if (srv->num_acks < TFTP_TEST_MAX_ACKS)
+			srv->acks[srv->num_acks++] = block;
+		if (block >= TFTP_TEST_BLOCKS)
+			break;
+		ret = sb_tftp_data(dev, packet, block + 1, false);
+		if (ret || !srv->stray || block + 1 != TFTP_TEST_BLOCKS)
+			return ret;
+
+		/* Follow the last block with another in the same batch */
+		buf[0] = 0;
+		buf[1] = TFTP_DATA;
+		buf[2] = 0;
+		buf[3] = block + 2;
+		memset(buf + 4, 0xaa, TFTP_TEST_BLKSIZE);
+
+		return sb_tftp_reply(dev, packet, false, buf, sizeof(buf));
+	}
+
+	return 0;
+}
+
+static int tftp_test_placed_run(struct unit_test_state *uts, bool stray)
+{
+	struct tftp_test_srv srv;
+	struct udevice *dev;
+	ulong placed;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+
+	memset(&srv, '\0', sizeof(srv));
+	srv.stray = stray;
+	placed = eth_get_stats(dev)->rx_placed;
+	ut_assertok(net_test_load(uts, sb_tftp4_handler, &srv,
+				  "tftpboot 1000000 192.0.2.2:test.bin",
+				  srv.file, TFTP_TEST_SIZE, 1));
+
+	/* The first block arrives before the transfer has started */
+	ut_asserteq(TFTP_TEST_BLOCKS - 1,
+		    eth_get_stats(dev)->rx_placed - placed);
+	ut_asserteq(TFTP_TEST_BLOCKS, srv.num_acks);
+
+	return 0;
+}
+
+/* Blocks after the first go straight into the load buffer */
+static int dm_test_tftp_placed(struct unit_test_state *uts)
+{
+	return tftp_test_placed_run(uts, false);
+}
+DM_TEST(dm_test_tftp_placed, UT_TESTF_SCAN_FDT);
+
+/* A frame which follows the last block is not placed after the file */
+static int dm_test_tftp_placed_end(struct unit_test_state *uts)
+{
+	char cmp[2 * TFTP_TEST_BLKSIZE];
+	char *guard;
+
+	guard = map_sysmem(NET_TEST_ADDR + TFTP_TEST_SIZE, sizeof(cmp));
+	memset(cmp, 0x55, sizeof(cmp));
+	memcpy(guard, cmp, sizeof(cmp));
+
+	ut_assertok(tftp_test_placed_run(uts, true));
+	ut_asserteq_mem(cmp, guard, sizeof(cmp));
+	unmap_sysmem(guard);
+
+	return 0;
+}
+DM_TEST(dm_test_tftp_placed_end, UT_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_TFTP_MULTICAST
+static int sb_tftp_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	const char *opt, *end;
+	u8 *req;
+	int block;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	req = (u8 *)(ip + 1);
+	switch (req[1]) {
+	case TFTP_RRQ:
+		srv->client_port = ntohs(ip->udp_src);
+		end = (char *)req + ntohs(ip->udp_len) - UDP_HDR_SIZE;
+		for (opt = (char *)req + 2; opt < end; opt += strlen(opt) + 1) {
+			if (!strcmp(opt, "multicast"))
+				srv->got_mcast = true;
+		}
+
+		/* Another client is the master and has had blocks 1 and 2 */
+		sb_tftp_oack(dev, packet, "multicast",
+			     TFTP_TEST_GROUP ",1758,0");
+		sb_tftp_data(dev, packet, 3, true);
+		sb_tftp_data(dev, packet, 4, true);
+
+		/* That client has finished, so we take over */
+		return sb_tftp_oack(dev, packet, "multicast", ",,1");
+	case TFTP_ACK:
+		block = req[2] << 8 | req[3];
+		if (srv->num_acks < TFTP_TEST_MAX_ACKS)
+			srv->acks[srv->num_acks++] = block;
+		if (!block)
+			srv->was_joined = priv->mcast_joined;
+		if (srv->stop == TFTP_TEST_CTRLC) {
+			console_in_puts("\x03");
+			return 0;
+		} else if (srv->stop == TFTP_TEST_ERROR) {
+			char err[16];
+
+			err[0] = 0;
+			err[1] = TFTP_ERROR;
+			err[2] = 0;
+			err[3] = 1;	/* file not found, so no retry */
+			strcpy(err + 4, "Gone");
+
+			return sb_tftp_reply(dev, packet, false, err, 9);
+		}
+		if (block < TFTP_TEST_BLOCKS)
+			return sb_tftp_data(dev, packet, block + 1, true);
+		break;
+	}
+
+	return 0;
+}
+
+static int tftp_test_mcast_run(struct tftp_test_srv *srv)
+{
+	int ret;
+
+	env_set("tftpmcast", "yes");
+	ret = net_test_run(sb_tftp_handler, srv,
+			   "tftpboot 1000000 192.0.2.2:test.bin");
+	env_set("tftpmcast", NULL);
+
+	return ret;
+}
+
+static int dm_test_tftp_mcast(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	struct tftp_test_srv srv;
+	struct udevice *dev;
+	int ret;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	priv = dev_get_priv(dev);
+
+	memset(&srv, '\0', sizeof(srv));
+	env_set("tftpmcast", "yes");
+	ret = net_test_load(uts, sb_tftp_handler, &srv,
+			    "tftpboot 1000000 192.0.2.2:test.bin", srv.file,
+			    TFTP_TEST_SIZE, 0);
+	env_set("tftpmcast", NULL);
+	ut_assertok(ret);
+
+	ut_assert(srv.got_mcast);
+	ut_assert(srv.sent_mcast);
+	ut_assert(srv.was_joined);
+	ut_assert(!priv->mcast_joined);
+	ut_asserteq(0, net_mcast_addr.s_addr);
+
+	/*
+	 * Nothing is acknowledged before we are the master, then each ACK
+	 * skips the blocks already received from the group
+	 */
+	ut_asserteq(4, srv.num_acks);
+	ut_asserteq(0, srv.acks[0]);
+	ut_asserteq(1, srv.acks[1]);
+	ut_asserteq(4, srv.acks[2]);
+	ut_asserteq(5, srv.acks[3]);
+
+	return 0;
+}
+DM_TEST(dm_test_tftp_mcast, UT_TESTF_SCAN_FDT);
+
+/* Test that the group is left when a transfer is aborted or fails */
+static int dm_test_tftp_mcast_stop(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	struct tftp_test_srv srv;
+	struct udevice *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	priv = dev_get_priv(dev);
+
+	memset(&srv, '\0', sizeof(srv));
+	srv.stop = TFTP_TEST_CTRLC;
+	ut_asserteq(1, tftp_test_mcast_run(&srv));
+	clear_ctrlc();
+	ut_assert(srv.was_joined);
+	ut_assert(!priv->mcast_joined);
+	ut_asserteq(0, net_mcast_addr.s_addr);
+
+	memset(&srv, '\0', sizeof(srv));
+	srv.stop = TFTP_TEST_ERROR;
+	ut_asserteq(1, tftp_test_mcast_run(&srv));
+	ut_assert(srv.was_joined);
+	ut_assert(!priv->mcast_joined);
+	ut_asserteq(0, net_mcast_addr.s_addr);
+
+	return 0;
+}
+DM_TEST(dm_test_tftp_mcast_stop, UT_TESTF_SCAN_FDT | UT_TESTF_CONSOLE_REC);
+#endif
+
+#ifdef CONFIG_TFTP_ADAPTIVE
+/* Round-trip time simulated by the server for each request */
+#define TFTP_TEST_RTT_MS	100
+#define TFTP_TEST_TIMEOUT_MS	10000
+#define TFTP_TEST_WINDOW	4
+
+/* Send a window of blocks starting at @first */
+static int sb_tftp_window(struct udevice *dev, void *packet, int first)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	int block, ret;
+
+	timer_test_add_offset(TFTP_TEST_RTT_MS);
+	for (block = first;
+	     block < first + srv->window && block <= TFTP_TEST_BLOCKS;
+	     block++) {
+		if (block == srv->drop_block && !srv->drop_time)
+			continue;
+		ret = sb_tftp_data(dev, packet, block, false);
+		if (ret)
+			return ret;
+	}
+	if (srv->drop_block >= first && srv->drop_block < block &&
+	    !srv->drop_time)
+		srv->drop_time = get_timer(0);
+
+	return 0;
+}
+
+static int sb_tftp_win_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	const char *opt, *end;
+	char val[8];
+	u8 *req;
+	int block;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	req = (u8 *)(ip + 1);
+	switch (req[1]) {
+	case TFTP_RRQ:
+		srv->client_port = ntohs(ip->udp_src);
+		end = (char *)req + ntohs(ip->udp_len) - UDP_HDR_SIZE;
+		srv->window = 1;
+		for (opt = (char *)req + 2; opt < end; opt += strlen(opt) + 1) {
+			if (!strcmp(opt, "windowsize")) {
+				opt += strlen(opt) + 1;
+				srv->window = dectoul(opt, NULL);
+			}
+		}
+		timer_test_add_offset(TFTP_TEST_RTT_MS);
+		sprintf(val, "%d", srv->window);
+		return sb_tftp_oack(dev, packet, "windowsize", val);
+	case TFTP_ACK:
+		block = req[2] << 8 | req[3];
+		if (srv->num_acks < TFTP_TEST_MAX_ACKS)
+			srv->acks[srv->num_acks++] = block;
+
+		/* The client timed out waiting for the dropped block */
+		if (srv->drop_time && block == srv->drop_block - 1) {
+			srv->resend_ms[srv->num_resends++] =
+				get_timer(srv->drop_time);
+			srv->drop_time = get_timer(0);
+			if (srv->num_resends < ARRAY_SIZE(srv->resend_ms))
+				return 0;
+			srv->drop_block = 0;
+			srv->drop_time = 0;
+		}
+		if (block < TFTP_TEST_BLOCKS)
+			return sb_tftp_window(dev, packet, block + 1);
+		break;
+	}
+
+	return 0;
+}
+
+static int tftp_test_window_run(struct unit_test_state *uts,
+				struct tftp_test_srv *srv, int drop_block)
+{
+	srv->num_acks = 0;
+	srv->drop_block = drop_block;
+	srv->drop_time = 0;
+	srv->num_resends = 0;
+
+	return net_test_load(uts, sb_tftp_win_handler, srv,
+			     "tftpboot 1000000 192.0.2.2:test.bin", srv->file,
+			     TFTP_TEST_SIZE, 3);
+}
+
+/*
+ * Test that a lost window tail is asked for again after a timeout based on
+ * the round-trip time, backing off if that is lost too, and that a loss
+ * halves the window of the next transfer
+ */
+static int dm_test_tftp_adaptive(struct unit_test_state *uts)
+{
+	struct tftp_test_srv srv;
+	int i;
+
+	memset(&srv, '\0', sizeof(srv));
+	env_set_ulong("tftpwindowsize", TFTP_TEST_WINDOW);
+	env_set_ulong("tftptimeout", TFTP_TEST_TIMEOUT_MS);
+
+	/* Earlier transfers may have left a smaller window, so regrow it */
+	for (i = 0; i < 3 && srv.window != TFTP_TEST_WINDOW; i++)
+		ut_assertok(tftp_test_window_run(uts, &srv, 0));
+	ut_asserteq(TFTP_TEST_WINDOW, srv.window);
+	ut_asserteq(0, srv.acks[0]);
+	ut_asserteq(TFTP_TEST_WINDOW, srv.acks[1]);
+
+	/* Lose the last block of the first window, and its first resend */
+	ut_assertok(tftp_test_window_run(uts, &srv, TFTP_TEST_WINDOW));
+	ut_asserteq(TFTP_TEST_WINDOW, srv.window);
+	ut_asserteq(2, srv.num_resends);
+	log_debug("resent after %lu ms, then %lu ms\n", srv.resend_ms[0],
+		  srv.resend_ms[1]);
+
+	/* The timeout follows the round trip rather than tftptimeout... */
+	ut_assert(srv.resend_ms[0] >= TFTP_TEST_RTT_MS);
+	ut_assert(srv.resend_ms[0] < TFTP_TEST_TIMEOUT_MS / 2);
+	/* ...and doubles when the resent block is lost too */
+	ut_assert(srv.resend_ms[1] >= 2 * TFTP_TEST_RTT_MS);
+	ut_assert(srv.resend_ms[1] > srv.resend_ms[0]);
+
+	/* The next transfer asks for half the window... */
+	ut_assertok(tftp_test_window_run(uts, &srv, 0));
+	ut_asserteq(TFTP_TEST_WINDOW / 2, srv.window);
+
+	/* ...and the one after a clean transfer for the whole window again */
+	ut_assertok(tftp_test_window_run(uts, &srv, 0));
+	ut_asserteq(TFTP_TEST_WINDOW, srv.window);
+	env_set("tftpwindowsize", NULL);
+	env_set("tftptimeout", NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_tftp_adaptive, UT_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_IPV6
+/* Another host, which sends a copy of the first block with the wrong data */
+#define TFTP_TEST_STRAY_IP6	"2001:db8::3"
+
+static int sb_tftp6_data(struct udevice *dev, void *packet, int block,
+			 bool stray)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+	u8 buf[4 + TFTP_TEST_BLKSIZE];
+	struct ethernet_hdr *eth_recv;
+	struct in6_addr src;
+	struct ip6_hdr *ip6r;
+	struct udp_hdr *udp;
+	uint len, i;
+
+	len = sb_tftp_fill_data(srv, buf, block);
+	net_copy_ip6(&src, &ip6->daddr);
+	if (stray) {
+		for (i = 4; i < len; i++)
+			buf[i] = ~buf[i];
+		string_to_ip6(TFTP_TEST_STRAY_IP6, strlen(TFTP_TEST_STRAY_IP6),
+			      &src);
+	}
+
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return -EOVERFLOW;
+
+	memcpy(eth_recv->et_dest, ((struct ethernet_hdr *)packet)->et_src,
+	       ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IPV6);
+
+	ip6r = (void *)eth_recv + ETHER_HDR_SIZE;
+	ip6_add_hdr((uchar *)ip6r, &src, &ip6->saddr, IPPROTO_UDP,
+		    IP6_HOP_LIMIT, UDP_HDR_SIZE + len);
+	udp = (struct udp_hdr *)(ip6r + 1);
+	udp->udp_src = htons(TFTP_TEST_SRV_PORT);
+	udp->udp_dst = htons(srv->client_port);
+	udp->udp_len = htons(UDP_HDR_SIZE + len);
+	udp->udp_xsum = 0;
+	memcpy(udp + 1, buf, len);
+	udp->udp_xsum = htons(csum_ipv6_magic(&ip6r->saddr, &ip6r->daddr,
+					      UDP_HDR_SIZE + len, IPPROTO_UDP,
+					      csum_partial((uchar *)udp,
+							   UDP_HDR_SIZE + len,
+							   0)));
+
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP6_UDPHDR_SIZE + len);
+
+	return 0;
+}
+
+static int sb_tftp6_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct tftp_test_srv *srv = priv->priv;
+	struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+	struct udp_hdr *udp = (struct udp_hdr *)(ip6 + 1);
+	u8 *req = (u8 *)(udp + 1);
+	int block;
+
+	if (!sandbox_eth_nd_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(((struct ethernet_hdr *)packet)->et_protlen) != PROT_IPV6 ||
+	    ip6->nexthdr != IPPROTO_UDP)
+		return 0;
+
+	switch (req[1]) {
+	case TFTP_RRQ:
+		srv->client_port = ntohs(udp->udp_src);
+		/* Ignore the options, so blocks are the default 512 bytes */
+		sb_tftp6_data(dev, packet, 1, true);
+		return sb_tftp6_data(dev, packet, 1, false);
+	case TFTP_ACK:
+		block = req[2] << 8 | req[3];
+		if (srv->num_acks < TFTP_TEST_MAX_ACKS)
+			srv->acks[srv->num_acks++] = block;
+		if (block < TFTP_TEST_BLOCKS)
+			return sb_tftp6_data(dev, packet, block + 1, false);
+		break;
+	}
+
+	return 0;
+}
+
+/* Load over IPv6, ignoring a block which another host sends first */
+static int dm_test_tftp_ip6(struct unit_test_state *uts)
+{
+	struct tftp_test_srv srv;
+	int ret;
+	int i;
+
+	memset(&srv, '\0', sizeof(srv));
+	ut_assertok(run_command("setenv ip6addr 2001:db8::1", 0));
+	ret = net_test_load(uts, sb_tftp6_handler, &srv,
+			    "tftpboot 1000000 [2001:db8::2]:test.bin -ipv6",
+			    srv.file, TFTP_TEST_SIZE, 2);
+	ut_assertok(run_command("setenv ip6addr", 0));
+	ut_assertok(ret);
+
+	/* Every block is acknowledged in turn */
+	ut_asserteq(TFTP_TEST_BLOCKS, srv.num_acks);
+	for (i = 0; i < TFTP_TEST_BLOCKS; i++)
+		ut_asserteq(i + 1, srv.acks[i]);
+	ut_assert(!net_use_ip6);
+
+	return 0;
+}
+DM_TEST(dm_test_tftp_ip6, UT_TESTF_SCAN_FDT);
+#endif
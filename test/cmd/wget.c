@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test for the wget command
+ *
+ * A tiny HTTP server is attached to the sandbox Ethernet driver. It sends its
+ * response in small segments, one per ACK, and can deliver the second and
+ * third in the wrong order to exercise the handling of a gap in the stream.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <console.h>
+#include <dm.h>
+#include <env.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <net/tcp.h>
+#include <test/net.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define WGET_TEST_BODY		4000
+#define WGET_TEST_SEG		1000
+
+/**
+ * struct wget_test_srv - State of the test HTTP server
+ *
+ * @resp:	Complete response, headers and body
+ * @resp_len:	Number of bytes in @resp
+ * @isn:	Our initial sequence number
+ * @client_next: Next sequence number expected from the client
+ * @sent:	Number of bytes of @resp sent so far
+ * @swap:	Send the second and third segments in the wrong order
+ * @fin_sent:	true once the whole response and a FIN have been sent
+ * @got_request: true if the expected request was received
+ * @bad_xsum:	Number of segments from the client with a bad checksum
+ */
+struct wget_test_srv {
+	char resp[WGET_TEST_BODY + 100];
+	uint resp_len;
+	u32 isn;
+	u32 client_next;
+	uint sent;
+	bool swap;
+	bool fin_sent;
+	bool got_request;
+	int bad_xsum;
+};
+
+/*
+ * Work out the TCP checksum a byte at a time, without using the network
+ * stack's checksum code, so that the test can check what the client sends.
+ * This gives the value to send if @ip->tcp_xsum is zero, or zero if the
+ * segment's checksum is valid.
+ */
+static u16 sb_tcp_checksum(struct ip_tcp_hdr *ip, uint tcp_len)
+{
+	const u8 *addr = (const u8 *)&ip->ip_src;
+	const u8 *seg = (const u8 *)&ip->tcp_src;
+	u32 sum;
+	uint i;
+
+	/* The pseudo-header holds both addresses, the protocol and length */
+	sum = IPPROTO_TCP + tcp_len;
+	for (i = 0; i < 2 * sizeof(struct in_addr); i += 2)
+		sum += addr[i] << 8 | addr[i + 1];
+	for (i = 0; i < tcp_len; i++)
+		sum += i & 1 ? seg[i] : seg[i] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return htons(~sum & 0xffff);
+}
+
+static int sb_tcp_reply(struct udevice *dev, void *packet, u8 flags, u32 seq,
+			const void *data, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct wget_test_srv *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct ip_tcp_hdr *tcpr;
+
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return -EOVERFLOW;
+
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	tcpr = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)tcpr, net_read_ip(&tcp->ip_src),
+			  net_read_ip(&tcp->ip_dst), IP_TCP_HDR_SIZE + len,
+			  IPPROTO_TCP);
+	tcpr->tcp_src = tcp->tcp_dst;
+	tcpr->tcp_dst = tcp->tcp_src;
+	tcpr->tcp_seq = htonl(seq);
+	tcpr->tcp_ack = htonl(srv->client_next);
+	tcpr->tcp_hlen = TCP_HDR_SIZE << 2;
+	tcpr->tcp_flags = flags;
+	tcpr->tcp_win = htons(0xffff);
+	tcpr->tcp_xsum = 0;
+	tcpr->tcp_urg = 0;
+	memcpy(tcpr + 1, data, len);
+	tcpr->tcp_xsum = sb_tcp_checksum(tcpr, TCP_HDR_SIZE + len);
+
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP_TCP_HDR_SIZE + len);
+
+	return 0;
+}
+
+static int sb_http_send(struct udevice *dev, void *packet, uint offset)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct wget_test_srv *srv = priv->priv;
+	uint len = min(srv->resp_len - offset, (uint)WGET_TEST_SEG);
+
+	srv->sent = max(srv->sent, offset + len);
+
+	return sb_tcp_reply(dev, packet, TCP_ACK | TCP_PUSH,
+			    srv->isn + 1 + offset, srv->resp + offset, len);
+}
+
+static int sb_http_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct wget_test_srv *srv = priv->priv;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	const char *req;
+	uint hdr_len, dlen;
+	u32 ack;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (tcp->ip_p != IPPROTO_TCP)
+		return 0;
+	if (sb_tcp_checksum(tcp, ntohs(tcp->ip_len) - IP_HDR_SIZE)) {
+		srv->bad_xsum++;
+		return 0;
+	}
+
+	hdr_len = (tcp->tcp_hlen >> 4) * 4;
+	dlen = ntohs(tcp->ip_len) - IP_HDR_SIZE - hdr_len;
+	if (tcp->tcp_flags & TCP_SYN) {
+		srv->client_next = ntohl(tcp->tcp_seq) + 1;
+		return sb_tcp_reply(dev, packet, TCP_SYN | TCP_ACK, srv->isn,
+				    NULL, 0);
+	}
+	if (tcp->tcp_flags & (TCP_FIN | TCP_RST))
+		return 0;
+
+	if (dlen) {
+		req = (const char *)&tcp->tcp_src + hdr_len;
+		srv->client_next = ntohl(tcp->tcp_seq) + dlen;
+		srv->got_request = !strncmp(req, "GET /test.bin HTTP/1.1\r\n",
+					    24);
+		return sb_http_send(dev, packet, 0);
+	}
+
+	/* Send more once everything so far is acknowledged */
+	ack = ntohl(tcp->tcp_ack) - srv->isn - 1;
+	if (ack != srv->sent)
+		return 0;
+	if (srv->swap && ack == WGET_TEST_SEG) {
+		sb_http_send(dev, packet, 2 * WGET_TEST_SEG);
+		return sb_http_send(dev, packet, WGET_TEST_SEG);
+	}
+	if (srv->sent < srv->resp_len)
+		return sb_http_send(dev, packet, srv->sent);
+	if (!srv->fin_sent) {
+		srv->fin_sent = true;
+		return sb_tcp_reply(dev, packet, TCP_FIN | TCP_ACK,
+				    srv->isn + 1 + srv->sent, NULL, 0);
+	}
+
+	return 0;
+}
+
+static int wget_test_run(struct unit_test_state *uts,
+			 struct wget_test_srv *srv, bool content_len)
+{
+	char *body;
+
+	srv->resp_len = sprintf(srv->resp, "HTTP/1.1 200 OK\r\n");
+	if (content_len)
+		srv->resp_len += sprintf(srv->resp + srv->resp_len,
+					 "Content-Length: %d\r\n",
+					 WGET_TEST_BODY);
+	srv->resp_len += sprintf(srv->resp + srv->resp_len, "\r\n");
+	body = srv->resp + srv->resp_len;
+	srv->resp_len += WGET_TEST_BODY;
+	srv->isn = 0x12345678;
+
+	env_set("loadaddr", NULL);
+	ut_assertok(net_test_load(uts, sb_http_handler, srv,
+				  "wget 1000000 192.0.2.2:/test.bin", body,
+				  WGET_TEST_BODY, 0));
+
+	ut_assert(srv->got_request);
+	ut_asserteq(0, srv->bad_xsum);
+
+	return 0;
+}
+
+static int dm_test_wget_cmd(struct unit_test_state *uts)
+{
+	struct wget_test_srv srv;
+
+	/* Content-Length given, with a gap that is filled later */
+	memset(&srv, '\0', sizeof(srv));
+	srv.swap = true;
+	ut_assertok(wget_test_run(uts, &srv, true));
+
+	/* No Content-Length, so the server closing marks the end */
+	memset(map_sysmem(NET_TEST_ADDR, WGET_TEST_BODY), '\0',
+	       WGET_TEST_BODY);
+	memset(&srv, '\0', sizeof(srv));
+	ut_assertok(wget_test_run(uts, &srv, false));
+	ut_assert(srv.fin_sent);
+
+	return 0;
+}
+DM_TEST(dm_test_wget_cmd, UT_TESTF_SCAN_FDT);
@@ -536,6 +536,161 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#if CONFIG_IS_ENABLED(IMAGE_DECOMP_STREAM)
+/**
+ * struct mem_stream - Memory-backed stream for image_decomp_stream()
+ *
+ * @strm:	Stream to pass to image_decomp_stream()
+ * @data:	Compressed data
+ * @size:	Number of bytes in @data
+ * @pos:	Number of bytes already read
+ */
+struct mem_stream {
+	struct image_stream strm;
+	const char *data;
+	ulong size;
+	ulong pos;
+};
+
+/* Hand out tiny pieces, so that headers are split across reads */
+#define STREAM_READ_SIZE	7
+
+static int mem_stream_read(struct image_stream *strm, void *buf, ulong len,
+			   ulong *actread)
+{
+	struct mem_stream *ms = container_of(strm, struct mem_stream, strm);
+
+	len = min(len, (ulong)STREAM_READ_SIZE);
+	len = min(len, ms->size - ms->pos);
+	memcpy(buf, ms->data + ms->pos, len);
+	ms->pos += len;
+	*actread = len;
+
+	return 0;
+}
+
+static void mem_stream_init(struct mem_stream *ms, const void *data,
+			    ulong size)
+{
+	ms->strm.read = mem_stream_read;
+	ms->data = data;
+	ms->size = size;
+	ms->pos = 0;
+}
+
+/* zstd -19 -c /tmp/plain.txt > /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* As with lz4, use data compressed on the host */
+	ut_asserteq(in_size, strlen(plain));
+	ut_asserteq_mem(plain, in, in_size);
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+/**
+ * run_stream_test() - Run tests on streaming decompression
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   mutate_func compress)
+{
+	ulong compress_size = TEST_BUFFER_SIZE;
+	char compress_buff[TEST_BUFFER_SIZE];
+	char uncompress_buff[TEST_BUFFER_SIZE];
+	struct mem_stream ms;
+	ulong unc_len, len;
+
+	printf("Testing: %s\n", genimg_get_comp_name(comp_type));
+	unc_len = strlen(plain);
+	ut_assertok(compress(uts, (void *)plain, unc_len, compress_buff,
+			     compress_size, &compress_size));
+
+	/* Detect the compression type from the data */
+	memset(uncompress_buff, '\0', sizeof(uncompress_buff));
+	mem_stream_init(&ms, compress_buff, compress_size);
+	ut_assertok(image_decomp_stream(-1, uncompress_buff,
+					sizeof(uncompress_buff), &ms.strm,
+					&len));
+	ut_asserteq(unc_len, len);
+	ut_asserteq_mem(plain, uncompress_buff, unc_len);
+
+	/* Too little space */
+	mem_stream_init(&ms, compress_buff, compress_size);
+	ut_asserteq(-ENOSPC, image_decomp_stream(comp_type, uncompress_buff,
+						 unc_len - 1, &ms.strm, &len));
+
+	/* Truncated data */
+	if (comp_type == IH_COMP_NONE)
+		return 0;
+	mem_stream_init(&ms, compress_buff, compress_size / 2);
+	ut_assert(image_decomp_stream(comp_type, uncompress_buff,
+				      sizeof(uncompress_buff), &ms.strm,
+				      &len));
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lzma(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZMA, compress_using_lzma);
+}
+COMPRESSION_TEST(compression_test_stream_lzma, 0);
+
+static int compression_test_stream_none(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_stream_none, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZ4, compress_using_lz4);
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+#endif
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
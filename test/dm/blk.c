@@ -5,7 +5,12 @@
 
 #include <common.h>
 #include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <os.h>
 #include <part.h>
+#include <sandboxblockdev.h>
+#include <time.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
@@ -334,3 +339,281 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+/* Test that the block cache indexes, reads ahead and tracks writes */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char buf[8 * 512], cmp[4 * 512];
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_plat(blk);
+
+	/* Two entries of four blocks each */
+	blkcache_configure(4, 2, 8 * 512);
+	for (i = 0; i < 8; i++)
+		memset(buf + i * 512, 'a' + i, 512);
+	ut_asserteq(8, blk_dwrite(desc, 0, 8, buf));
+
+	/* A single-block miss reads the whole entry ahead */
+	ut_asserteq(1, blk_dread(desc, 1, 1, cmp));
+	ut_asserteq('b', cmp[0]);
+	ut_asserteq(1, blk_dread(desc, 3, 1, cmp));
+	ut_asserteq('d', cmp[0]);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(1, stats.entries);
+	ut_asserteq(4 * 512, stats.bytes);
+
+	/* A read spanning a cached and an uncached entry */
+	ut_asserteq(2, blk_dread(desc, 3, 2, cmp));
+	ut_asserteq_mem(buf + 3 * 512, cmp, 2 * 512);
+	ut_asserteq(4, blk_dread(desc, 2, 4, cmp));
+	ut_asserteq_mem(buf + 2 * 512, cmp, 4 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(2, stats.entries);
+
+	/* Writes update the cached data */
+	memset(buf + 2 * 512, 'z', 512);
+	ut_asserteq(1, blk_dwrite(desc, 2, 1, buf + 2 * 512));
+	ut_asserteq(1, blk_dread(desc, 2, 1, cmp));
+	ut_asserteq('z', cmp[0]);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(0, stats.misses);
+
+	/* A third entry evicts the least-recently-used one */
+	ut_asserteq(1, blk_dread(desc, 8, 1, cmp));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.evictions);
+	ut_asserteq(2, stats.entries);
+	ut_asserteq(1, blk_dread(desc, 2, 1, cmp));
+	ut_asserteq('z', cmp[0]);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+
+	blkcache_configure(8, 256, CONFIG_BLOCK_CACHE_SIZE);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+#define ASYNC_BLKS		64
+/* Simulated access time of each transfer on the host device */
+#define ASYNC_LATENCY_US	1000
+
+static void blk_async_done(struct blk_req *req)
+{
+	int *count = req->priv;
+
+	(*count)++;
+}
+
+static void blk_async_setup(struct blk_req *req, struct udevice *dev,
+			    lbaint_t start, void *buffer, bool write,
+			    int *count)
+{
+	memset(req, '\0', sizeof(*req));
+	req->dev = dev;
+	req->start = start;
+	req->blkcnt = 1;
+	req->buffer = buffer;
+	req->write = write;
+	req->done = blk_async_done;
+	req->priv = count;
+}
+
+/* Test that queued transfers overlap and return the right data */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	const char *fname = "blk_async.img";
+	struct blk_req reqs[ASYNC_BLKS], req;
+	struct host_block_dev *host_dev;
+	ulong start, one_us, queued_us;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char *buf, *cmp;
+	int fd, i, count;
+
+	buf = malloc(ASYNC_BLKS * 512);
+	ut_assertnonnull(buf);
+	cmp = malloc(ASYNC_BLKS * 512);
+	ut_assertnonnull(cmp);
+	ut_fill_pattern(buf, ASYNC_BLKS * 512, 0);
+
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(ASYNC_BLKS * 512, os_write(fd, buf, ASYNC_BLKS * 512));
+	os_close(fd);
+
+	ut_assertok(host_dev_bind(0, (char *)fname, false));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+	host_dev = dev_get_plat(dev);
+	host_dev->latency_us = ASYNC_LATENCY_US;
+
+	/* The callback only runs from blk_poll() */
+	count = 0;
+	blk_async_setup(&req, dev, 3, cmp, false, &count);
+	ut_assertok(blk_submit(&req));
+	ut_asserteq(0, count);
+	ut_asserteq(false, req.complete);
+	ut_asserteq(1, blk_wait(&req));
+	ut_asserteq(1, count);
+	ut_asserteq_mem(buf + 3 * 512, cmp, 512);
+
+	/* One block at a time pays the latency for each */
+	count = 0;
+	memset(cmp, '\0', ASYNC_BLKS * 512);
+	start = timer_get_us();
+	for (i = 0; i < ASYNC_BLKS; i++) {
+		blk_async_setup(&reqs[i], dev, i, cmp + i * 512, false,
+				&count);
+		ut_assertok(blk_submit(&reqs[i]));
+		ut_asserteq(1, blk_wait(&reqs[i]));
+	}
+	one_us = timer_get_us() - start;
+	ut_asserteq(ASYNC_BLKS, count);
+	ut_asserteq_mem(buf, cmp, ASYNC_BLKS * 512);
+
+	/* Queued requests are all in flight at once */
+	count = 0;
+	memset(cmp, '\0', ASYNC_BLKS * 512);
+	start = timer_get_us();
+	for (i = 0; i < ASYNC_BLKS; i++) {
+		blk_async_setup(&reqs[i], dev, i, cmp + i * 512, false,
+				&count);
+		ut_assertok(blk_submit(&reqs[i]));
+	}
+	ut_asserteq(0, count);
+	for (i = 0; i < ASYNC_BLKS; i++)
+		ut_asserteq(false, reqs[i].complete);
+	ut_assertok(blk_drain(dev));
+	queued_us = timer_get_us() - start;
+	ut_asserteq(ASYNC_BLKS, count);
+	for (i = 0; i < ASYNC_BLKS; i++)
+		ut_asserteq(1, reqs[i].result);
+	ut_asserteq_mem(buf, cmp, ASYNC_BLKS * 512);
+	log_debug("%lu us one at a time, %lu us queued\n", one_us, queued_us);
+
+	/* A synchronous read waits for a queued write */
+	memset(buf, 'w', 512);
+	blk_async_setup(&req, dev, 5, buf, true, &count);
+	ut_assertok(blk_submit(&req));
+	ut_asserteq(1, blk_dread(desc, 5, 1, cmp));
+	ut_assert(req.complete);
+	ut_asserteq_mem(buf, cmp, 512);
+
+	ut_assertok(host_dev_bind(0, NULL, false));
+	os_unlink(fname);
+	free(cmp);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that devices without native support complete requests synchronously */
+static int dm_test_blk_async_fallback(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char buf[2 * 512], cmp[2 * 512];
+	struct blk_req req;
+	int count = 0;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_plat(blk);
+	ut_assertnull(blk_get_ops(blk)->submit);
+
+	memset(buf, 'f', sizeof(buf));
+	blk_async_setup(&req, blk, 10, buf, true, &count);
+	req.blkcnt = 2;
+	ut_assertok(blk_submit(&req));
+	ut_asserteq(0, count);
+	ut_asserteq(2, blk_wait(&req));
+	ut_asserteq(1, count);
+
+	ut_asserteq(2, blk_dread(desc, 10, 2, cmp));
+	ut_asserteq_mem(buf, cmp, sizeof(cmp));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async_fallback, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/**
+ * struct blk_chain - records the order in which callbacks run
+ *
+ * @next:	Request for the first callback to submit, or NULL once done
+ * @order:	Index of each request, in the order its callback ran
+ * @count:	Number of callbacks which have run
+ * @depth:	Number of callbacks running at present
+ * @nested:	true if a callback ran while another was running
+ */
+struct blk_chain {
+	struct blk_req *next;
+	char order[4];
+	int count;
+	int depth;
+	bool nested;
+};
+
+static void blk_chain_done(struct blk_req *req)
+{
+	struct blk_chain *chain = req->priv;
+	struct blk_req *next = chain->next;
+
+	if (chain->depth++)
+		chain->nested = true;
+	chain->order[chain->count++] = 'a' + req->start;
+	if (next) {
+		chain->next = NULL;
+		blk_submit(next);
+	}
+	chain->depth--;
+}
+
+/* Test that a completion callback can start another transfer */
+static int dm_test_blk_async_chain(struct unit_test_state *uts)
+{
+	struct blk_req reqs[3];
+	struct blk_chain chain;
+	struct udevice *dev;
+	char buf[3][512];
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &dev));
+
+	memset(&chain, '\0', sizeof(chain));
+	for (i = 0; i < 3; i++) {
+		blk_async_setup(&reqs[i], dev, i, buf[i], false, NULL);
+		reqs[i].done = blk_chain_done;
+		reqs[i].priv = &chain;
+	}
+	chain.next = &reqs[2];
+
+	ut_assertok(blk_submit(&reqs[0]));
+	ut_assertok(blk_submit(&reqs[1]));
+	ut_assertok(blk_drain(dev));
+	ut_asserteq(3, chain.count);
+	ut_asserteq_str("abc", chain.order);
+	ut_asserteq(false, chain.nested);
+	for (i = 0; i < 3; i++)
+		ut_asserteq(1, reqs[i].result);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async_chain, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
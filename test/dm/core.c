@@ -1366,3 +1366,94 @@ static int dm_test_dev_get_mem(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_dev_get_mem, UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+/* Private data for test_async_drv */
+struct test_async_priv {
+	int polls;
+};
+
+static int test_async_probe(struct udevice *dev)
+{
+	dm_testdrv_op_count[DM_TEST_OP_PROBE]++;
+
+	return -EINPROGRESS;
+}
+
+/* Finish after ping_add polls, failing if that is negative */
+static int test_async_probe_poll(struct udevice *dev)
+{
+	struct dm_test_pdata *pdata = dev_get_plat(dev);
+	struct test_async_priv *priv = dev_get_priv(dev);
+
+	if (++priv->polls < abs(pdata->ping_add))
+		return -EAGAIN;
+
+	return pdata->ping_add < 0 ? -EIO : 0;
+}
+
+U_BOOT_DRIVER(test_async_drv) = {
+	.name	= "test_async_drv",
+	.id	= UCLASS_TEST,
+	.probe	= test_async_probe,
+	.priv_auto	= sizeof(struct test_async_priv),
+	PROBE_POLL_PTR(test_async_probe_poll)
+};
+
+static const struct dm_test_pdata test_pdata_async[] = {
+	{ .ping_add		= 3, },
+	{ .ping_add		= 5, },
+	{ .ping_add		= -2, },
+};
+
+/* Test finishing probing devices in the background */
+static int dm_test_probe_async(struct unit_test_state *uts)
+{
+	struct driver_info info = { .name = "test_async_drv" };
+	struct test_async_priv *priv;
+	struct udevice *dev[3];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(dev); i++) {
+		info.plat = &test_pdata_async[i];
+		ut_assertok(device_bind_by_name(uts->root, false, &info,
+						&dev[i]));
+		ut_assertok(device_probe_async(dev[i]));
+		ut_assert(device_active(dev[i]));
+		ut_assert(dev_get_flags(dev[i]) & DM_FLAG_PROBE_PENDING);
+	}
+	ut_asserteq(3, dm_testdrv_op_count[DM_TEST_OP_PROBE]);
+	ut_asserteq(0, dm_testdrv_op_count[DM_TEST_OP_POST_PROBE]);
+
+	/* Waiting for the first lets the others make progress too */
+	ut_assertok(device_probe(dev[0]));
+	ut_assert(!(dev_get_flags(dev[0]) & DM_FLAG_PROBE_PENDING));
+	ut_asserteq(1, dm_testdrv_op_count[DM_TEST_OP_POST_PROBE]);
+	priv = dev_get_priv(dev[1]);
+	ut_asserteq(2, priv->polls);
+	ut_assert(!device_active(dev[2]));
+
+	ut_asserteq(1, device_poll_pending());
+	ut_asserteq(3, priv->polls);
+	ut_assertok(device_probe(dev[1]));
+	ut_asserteq(5, priv->polls);
+	ut_asserteq(0, device_poll_pending());
+	ut_asserteq(2, dm_testdrv_op_count[DM_TEST_OP_POST_PROBE]);
+
+	/* Probing a device which failed fails the same way */
+	ut_asserteq(-EIO, device_probe(dev[2]));
+	ut_assert(!device_active(dev[2]));
+
+	/* Removing a pending device waits for it first */
+	ut_assertok(device_remove(dev[1], DM_REMOVE_NORMAL));
+	ut_assertok(device_probe_async(dev[1]));
+	ut_assert(dev_get_flags(dev[1]) & DM_FLAG_PROBE_PENDING);
+	ut_assertok(device_remove(dev[1], DM_REMOVE_NORMAL));
+	ut_assert(!device_active(dev[1]));
+	ut_asserteq(3, dm_testdrv_op_count[DM_TEST_OP_POST_PROBE]);
+	ut_asserteq(0, device_poll_pending());
+
+	return 0;
+}
+DM_TEST(dm_test_probe_async, 0);
+#endif
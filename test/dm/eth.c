@@ -7,12 +7,15 @@
  */
 
 #include <common.h>
+#include <command.h>
 #include <dm.h>
 #include <env.h>
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <ndisc.h>
 #include <net.h>
+#include <net6.h>
 #include <asm/eth.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -460,3 +463,191 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, UT_TESTF_SCAN_FDT);
+
+static int dm_test_eth_rx_batch(struct unit_test_state *uts)
+{
+	struct eth_stats *stats, before;
+	struct udevice *dev;
+	int i, n;
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_loop(PING));
+
+	/* The ARP and ping exchanges are counted */
+	dev = eth_get_dev();
+	stats = eth_get_stats(dev);
+	ut_assert(stats->rx_packets >= 2);
+	ut_assert(stats->tx_packets >= 2);
+	before = *stats;
+
+	/* Fill the receive ring and try to add one more */
+	ut_assertok(eth_init());
+	for (i = 0; i < CONFIG_ETH_RX_RING_SIZE; i++)
+		ut_assertok(sandbox_eth_recv_arp_req(dev));
+	ut_asserteq(-EOVERFLOW, sandbox_eth_recv_arp_req(dev));
+	ut_asserteq(before.rx_overruns + 1, stats->rx_overruns);
+
+	/* Each poll takes a whole batch and we answer every request */
+	n = min(CONFIG_ETH_RX_RING_SIZE, ETH_PACKETS_BATCH_RECV);
+	ut_asserteq(n, eth_rx());
+	ut_asserteq(before.rx_packets + n, stats->rx_packets);
+	ut_asserteq(before.tx_packets + n, stats->tx_packets);
+
+	while (eth_rx() > 0)
+		;
+	ut_asserteq(before.rx_packets + CONFIG_ETH_RX_RING_SIZE,
+		    stats->rx_packets);
+	ut_asserteq(before.rx_errors, stats->rx_errors);
+	eth_halt();
+
+	ut_assertok(run_command("net stats", 0));
+
+	return 0;
+}
+DM_TEST(dm_test_eth_rx_batch, UT_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_IPV6
+static int dm_test_eth_ip6_addr(struct unit_test_state *uts)
+{
+	const u8 enetaddr[ARP_HLEN] = { 0x00, 0x00, 0x11, 0x22, 0x33, 0x44 };
+	struct in6_addr addr, addr2;
+	char buf[50];
+
+	ut_assertok(string_to_ip6("2001:db8::1", 11, &addr));
+	ut_asserteq(htons(0x2001), addr.s6_addr16[0]);
+	ut_asserteq(htons(0xdb8), addr.s6_addr16[1]);
+	ut_asserteq(htons(1), addr.s6_addr16[7]);
+	sprintf(buf, "%pI6c", &addr);
+	ut_asserteq_str("2001:db8::1", buf);
+	sprintf(buf, "%pI6", &addr);
+	ut_asserteq_str("2001:0db8:0000:0000:0000:0000:0000:0001", buf);
+
+	/* Only the given length is parsed */
+	ut_assertok(string_to_ip6("fe80::1/64", 7, &addr2));
+	ut_assert(ip6_is_link_local_addr(&addr2));
+	ut_asserteq(-EINVAL, string_to_ip6("1::2::3", 7, &addr2));
+	ut_asserteq(-EINVAL, string_to_ip6("1:2:3:4:5:6:7", 13, &addr2));
+	ut_asserteq(-EINVAL, string_to_ip6("12345::", 7, &addr2));
+
+	ip6_make_lladdr(&addr2, enetaddr);
+	sprintf(buf, "%pI6c", &addr2);
+	ut_asserteq_str("fe80::200:11ff:fe22:3344", buf);
+
+	ip6_make_snma(&addr2, &addr);
+	sprintf(buf, "%pI6c", &addr2);
+	ut_asserteq_str("ff02::1:ff00:1", buf);
+
+	ut_assertok(string_to_ip6("2001:db8::ff:2", 14, &addr2));
+	ut_assert(ip6_addr_in_subnet(&addr, &addr2, 64));
+	ut_assert(!ip6_addr_in_subnet(&addr, &addr2, 120));
+
+	return 0;
+}
+DM_TEST(dm_test_eth_ip6_addr, 0);
+
+static int dm_test_eth_ping6(struct unit_test_state *uts)
+{
+	env_set("ethact", "eth@10002000");
+	ut_assertok(run_command("setenv ip6addr 2001:db8::1/64", 0));
+	ut_assertok(run_command("ping6 2001:db8::2", 0));
+	ut_assertok(run_command("setenv ip6addr", 0));
+
+	/* The reply came back to our global address after an NS/NA */
+	ut_assert(!ndisc_is_waiting());
+	ut_assert(ip6_is_unspecified_addr(&net_ip6));
+
+	return 0;
+}
+DM_TEST(dm_test_eth_ping6, UT_TESTF_SCAN_FDT);
+
+/* Answer a router solicitation with an advertisement of 2001:db8:1::/64 */
+static int sb_ra_handler(struct udevice *dev, void *packet, unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	const struct in6_addr all_nodes = {
+		.s6_addr = { 0xff, 0x02, [15] = 0x01 }
+	};
+	struct nd_opt_prefix_info *pi;
+	struct ethernet_hdr *eth_recv;
+	struct in6_addr router;
+	struct ip6_hdr *ip6r;
+	struct ra_msg *ra;
+	int plen;
+
+	if (!sandbox_eth_nd_req_to_reply(dev, packet, len))
+		return 0;
+	if (!sandbox_eth_ping6_req_to_reply(dev, packet, len))
+		return 0;
+	if (ip6->nexthdr != IPPROTO_ICMPV6 ||
+	    icmp->icmp6_type != ICMPV6_ROUTER_SOLICIT)
+		return 0;
+
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return -EOVERFLOW;
+	memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IPV6);
+
+	ra = (void *)eth_recv + ETHER_HDR_SIZE + IP6_HDR_SIZE;
+	memset(ra, '\0', sizeof(*ra) + ND_OPT_LLADDR_SIZE + sizeof(*pi));
+	ra->icmph.icmp6_type = ICMPV6_ROUTER_ADVERT;
+	ra->icmph.un.data = htonl(64 << 24 | 1800);
+	ra->opt[0] = ND_OPT_SOURCE_LL_ADDR;
+	ra->opt[1] = ND_OPT_LLADDR_LEN;
+	memcpy(&ra->opt[2], priv->fake_host_hwaddr, ARP_HLEN);
+	pi = (void *)&ra->opt[ND_OPT_LLADDR_SIZE];
+	pi->type = ND_OPT_PREFIX_INFO;
+	pi->len = sizeof(*pi) / 8;
+	pi->prefix_len = 64;
+	pi->flags = ND_OPT_PI_FLAG_ONLINK | ND_OPT_PI_FLAG_AUTO;
+	pi->valid_lifetime = htonl(86400);
+	pi->preferred_lifetime = htonl(14400);
+	string_to_ip6("2001:db8:1::", 12, &pi->prefix);
+	plen = sizeof(*ra) + ND_OPT_LLADDR_SIZE + sizeof(*pi);
+
+	ip6r = (void *)eth_recv + ETHER_HDR_SIZE;
+	string_to_ip6("fe80::1", 7, &router);
+	ip6_add_hdr((uchar *)ip6r, &router, &all_nodes, IPPROTO_ICMPV6, 255,
+		    plen);
+	ra->icmph.icmp6_cksum = htons(csum_ipv6_magic(&router, &all_nodes,
+						      plen, IPPROTO_ICMPV6,
+						      csum_partial((uchar *)ra,
+								   plen, 0)));
+
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP6_HDR_SIZE + plen);
+
+	return 0;
+}
+
+static int dm_test_eth_slaac(struct unit_test_state *uts)
+{
+	struct in6_addr expect;
+	char buf[50];
+
+	env_set("ethact", "eth@10002000");
+	ut_assertok(run_command("setenv ip6addr", 0));
+	ut_assertok(run_command("setenv gatewayip6", 0));
+	sandbox_eth_set_tx_handler(0, sb_ra_handler);
+	ut_assertok(run_command("ping6 2001:db8:1::2", 0));
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	/* The address is the advertised prefix and our interface ID */
+	ut_assertok(string_to_ip6("2001:db8:1::", 12, &expect));
+	ip6_make_eui64(&expect, net_ethaddr);
+	ut_asserteq_mem(&expect, &net_ip6, IN6ADDRSZ);
+	ut_asserteq(64, net_prefix_length);
+	sprintf(buf, "%pI6c/64", &expect);
+	ut_asserteq_str(buf, env_get("ip6addr"));
+	ut_asserteq_str("fe80::1", env_get("gatewayip6"));
+
+	ut_assertok(run_command("setenv ip6addr", 0));
+	ut_assertok(run_command("setenv gatewayip6", 0));
+
+	return 0;
+}
+DM_TEST(dm_test_eth_slaac, UT_TESTF_SCAN_FDT);
+#endif
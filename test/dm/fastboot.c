@@ -7,6 +7,8 @@
 #include <dm.h>
 #include <fastboot.h>
 #include <fb_mmc.h>
+#include <malloc.h>
+#include <mapmem.h>
 #include <mmc.h>
 #include <part.h>
 #include <part_efi.h>
@@ -93,3 +95,225 @@ static int dm_test_fastboot_mmc_part(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_fastboot_mmc_part, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/* Buffer for the streaming test, and an image which does not fit in it */
+#define FB_STREAM_ADDR		0x1000000
+#define FB_STREAM_BUF_SIZE	0x8000
+#define FB_STREAM_IMG_SIZE	40000
+
+static int fb_test_cmd(struct unit_test_state *uts, const char *cmd,
+		       const char *expect)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	char buf[FASTBOOT_COMMAND_LEN];
+
+	strlcpy(buf, cmd, sizeof(buf));
+	fastboot_handle_command(buf, response);
+	ut_asserteq_strn(expect, response);
+
+	return 0;
+}
+
+static int dm_test_fastboot_mmc_stream(struct unit_test_state *uts)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	char str_disk_guid[UUID_STR_LEN + 1];
+	struct blk_desc *mmc_dev_desc;
+	struct disk_partition parts[2] = {
+		{
+			.start = 48,
+			.size = 96,
+			.name = "test1",
+		},
+		{
+			.start = 144,
+			.size = 1,
+			.name = "test2",
+		},
+	};
+	char cmd[FASTBOOT_COMMAND_LEN];
+	u8 *img, *readback;
+	uint pos, len;
+	void *buf;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &mmc_dev_desc));
+	if (CONFIG_IS_ENABLED(RANDOM_UUID)) {
+		gen_rand_uuid_str(parts[0].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(parts[1].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(str_disk_guid, UUID_STR_FORMAT_STD);
+	}
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+
+	img = malloc(FB_STREAM_IMG_SIZE);
+	readback = malloc(96 * mmc_dev_desc->blksz);
+	ut_assertnonnull(img);
+	ut_assertnonnull(readback);
+	ut_fill_pattern(img, FB_STREAM_IMG_SIZE, 0);
+
+	buf = map_sysmem(FB_STREAM_ADDR, FB_STREAM_BUF_SIZE);
+	fastboot_init(buf, FB_STREAM_BUF_SIZE);
+
+	/* Without streaming, the image is too large to download */
+	sprintf(cmd, "download:%08x", FB_STREAM_IMG_SIZE);
+	ut_assertok(fb_test_cmd(uts, cmd, "FAIL"));
+
+	ut_assertok(fb_test_cmd(uts, "oem stream:test1", "OKAY"));
+	ut_assertok(fb_test_cmd(uts, cmd, "DATA"));
+
+	/* Pieces which do not fit evenly in the halves of the buffer */
+	for (pos = 0; pos < FB_STREAM_IMG_SIZE; pos += len) {
+		len = min(1000U, FB_STREAM_IMG_SIZE - pos);
+		fastboot_data_download(img + pos, len, response);
+		ut_asserteq_str("", response);
+	}
+	ut_asserteq(0, fastboot_data_remaining());
+	fastboot_data_complete(response);
+	ut_asserteq_str("OKAY", response);
+
+	/* The image is already written, padded to a whole block */
+	ut_assertok(fb_test_cmd(uts, "flash:test2", "FAIL"));
+	ut_assertok(fb_test_cmd(uts, "flash:test1", "OKAY"));
+	ut_asserteq(79, blk_dread(mmc_dev_desc, 48, 79, readback));
+	ut_asserteq_mem(img, readback, FB_STREAM_IMG_SIZE);
+	for (i = FB_STREAM_IMG_SIZE; i < 79 * mmc_dev_desc->blksz; i++)
+		ut_asserteq(0, readback[i]);
+
+	/* An image too large for the partition is refused as it arrives */
+	sprintf(cmd, "download:%08x", 97 * 512);
+	ut_assertok(fb_test_cmd(uts, cmd, "DATA"));
+	for (pos = 0; pos < 97 * 512; pos += len) {
+		len = min(1000U, 97 * 512 - pos);
+		fastboot_data_download(img, len, response);
+		ut_asserteq_str("", response);
+	}
+	fastboot_data_complete(response);
+	ut_asserteq_strn("FAIL", response);
+	ut_assertok(fb_test_cmd(uts, "flash:test1", "FAIL"));
+
+	ut_assertok(fb_test_cmd(uts, "oem stream", "OKAY"));
+	unmap_sysmem(buf);
+	free(readback);
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_mmc_stream, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Largest request and packet size used when receiving like the USB gadget */
+#define FB_STREAM_REQ_SIZE	0x4000
+#define FB_STREAM_MAXPACKET	512
+#define FB_STREAM_RX_BUF_SIZE	0x10000
+#define FB_STREAM_RX_IMG_SIZE	200000
+
+/*
+ * Set up a request for the next part of a download as rx_setup_dl() does,
+ * and have it receive its data at once. Return the number of bytes received,
+ * or 0 if only a short packet is left.
+ */
+static u32 fb_test_rx_req(const u8 *img, uint pos)
+{
+	void *buf;
+	u32 len;
+
+	buf = fastboot_data_buf(&len);
+	len = min_t(u32, len, FB_STREAM_REQ_SIZE);
+	len -= len % FB_STREAM_MAXPACKET;
+	memcpy(buf, img + pos, len);
+
+	return len;
+}
+
+/* Receive straight into the buffer, writing while the next request runs */
+static int dm_test_fastboot_mmc_stream_rx(struct unit_test_state *uts)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	char str_disk_guid[UUID_STR_LEN + 1];
+	struct blk_desc *mmc_dev_desc;
+	struct disk_partition part = {
+		.start = 48,
+		.size = 400,
+		.name = "test1",
+	};
+	char cmd[FASTBOOT_COMMAND_LEN];
+	u8 *img, *readback;
+	uint pos, blks;
+	void *buf;
+	u32 len;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &mmc_dev_desc));
+	if (CONFIG_IS_ENABLED(RANDOM_UUID)) {
+		gen_rand_uuid_str(part.uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(str_disk_guid, UUID_STR_FORMAT_STD);
+	}
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, &part, 1));
+
+	blks = DIV_ROUND_UP(FB_STREAM_RX_IMG_SIZE, mmc_dev_desc->blksz);
+	img = malloc(FB_STREAM_RX_IMG_SIZE);
+	readback = malloc(blks * mmc_dev_desc->blksz);
+	ut_assertnonnull(img);
+	ut_assertnonnull(readback);
+	for (i = 0; i < FB_STREAM_RX_IMG_SIZE; i++)
+		img[i] = i * 7 + (i >> 9);
+
+	buf = map_sysmem(FB_STREAM_ADDR, FB_STREAM_RX_BUF_SIZE);
+	fastboot_init(buf, FB_STREAM_RX_BUF_SIZE);
+
+	ut_assertok(fb_test_cmd(uts, "oem stream:test1", "OKAY"));
+	sprintf(cmd, "download:%08x", FB_STREAM_RX_IMG_SIZE);
+	ut_assertok(fb_test_cmd(uts, cmd, "DATA"));
+
+	pos = 0;
+	len = fb_test_rx_req(img, pos);
+	ut_asserteq(FB_STREAM_REQ_SIZE, len);
+	while (len) {
+		fastboot_data_received(len, response);
+		ut_asserteq_str("", response);
+		pos += len;
+
+		/*
+		 * The next request is queued, and may receive its data, before
+		 * this one is written
+		 */
+		len = fb_test_rx_req(img, pos);
+		fastboot_data_flush();
+
+		/* Each request is written without waiting for a full half */
+		if (pos == FB_STREAM_REQ_SIZE) {
+			ut_asserteq(pos / mmc_dev_desc->blksz,
+				    blk_dread(mmc_dev_desc, 48,
+					      pos / mmc_dev_desc->blksz,
+					      readback));
+			ut_asserteq_mem(img, readback, pos);
+		}
+	}
+
+	/* A short packet at the end goes through the endpoint buffer */
+	ut_assert(pos < FB_STREAM_RX_IMG_SIZE);
+	fastboot_data_download(img + pos, FB_STREAM_RX_IMG_SIZE - pos,
+			       response);
+	ut_asserteq_str("", response);
+	ut_asserteq(0, fastboot_data_remaining());
+	fastboot_data_complete(response);
+	ut_asserteq_str("OKAY", response);
+
+	ut_assertok(fb_test_cmd(uts, "flash:test1", "OKAY"));
+	ut_asserteq(blks, blk_dread(mmc_dev_desc, 48, blks, readback));
+	ut_asserteq_mem(img, readback, FB_STREAM_RX_IMG_SIZE);
+
+	/* What is left in the buffer is not the image, so cannot be booted */
+	ut_assertok(fb_test_cmd(uts, "boot", "FAIL"));
+
+	ut_assertok(fb_test_cmd(uts, "oem stream", "OKAY"));
+	unmap_sysmem(buf);
+	free(readback);
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_mmc_stream_rx,
+	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
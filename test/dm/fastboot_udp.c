@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for fastboot over UDP
+ *
+ * A fastboot host is attached to the sandbox Ethernet driver. It starts a
+ * session asking to send several download packets per reply, then downloads
+ * an image, losing one packet on the way.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <fastboot.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/eth.h>
+#include <asm/unaligned.h>
+#include <dm/test.h>
+#include <net/fastboot.h>
+#include <test/ut.h>
+
+#define FB_TEST_ADDR		0x1000000
+#define FB_TEST_SIZE		0x4000
+#define FB_TEST_WINDOW		4
+#define FB_TEST_HOST_PORT	45000
+
+enum {
+	FB_TEST_QUERY = 1,
+	FB_TEST_INIT = 2,
+	FB_TEST_FASTBOOT = 3,
+};
+
+/* Where the host is in the session */
+enum fb_test_step {
+	STEP_QUERY,
+	STEP_INIT,
+	STEP_DOWNLOAD,		/* sent "download", waiting for empty reply */
+	STEP_DOWNLOAD_RESP,	/* asked for the response, waiting for DATA */
+	STEP_DATA,
+	STEP_COMPLETE,		/* sent the final empty packet */
+	STEP_DONE,
+	STEP_FAILED,
+};
+
+/**
+ * struct fb_test_host - State of the test fastboot host
+ *
+ * @data:	Image being downloaded
+ * @step:	Where the host is in the session
+ * @seq:	Sequence number of the next new packet
+ * @data_seq:	Sequence number of the first data packet
+ * @acked:	Data packets acknowledged by the device
+ * @sent:	Data packets sent, including any lost
+ * @chunk:	Bytes of data in each data packet
+ * @window:	Data packets which may be sent before a reply
+ * @data_replies: Number of replies received to data packets
+ * @lose:	Data packet to lose the first time it is sent, counting from 0
+ * @lost:	true once a data packet has been lost
+ */
+struct fb_test_host {
+	u8 data[FB_TEST_SIZE];
+	enum fb_test_step step;
+	ushort seq;
+	ushort data_seq;
+	int acked;
+	int sent;
+	int chunk;
+	int window;
+	int data_replies;
+	int lose;
+	bool lost;
+};
+
+static int sb_fb_push(struct udevice *dev, int id, ushort seq,
+		      const void *data, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+	u8 *buf;
+
+	eth_recv = sandbox_eth_recv_buf(dev);
+	if (!eth_recv)
+		return -EOVERFLOW;
+
+	memcpy(eth_recv->et_dest, eth_get_ethaddr(), ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ipr, net_ip, string_to_ip("1.1.2.2"),
+			  IP_UDP_HDR_SIZE + 4 + len, IPPROTO_UDP);
+	ipr->udp_src = htons(FB_TEST_HOST_PORT);
+	ipr->udp_dst = htons(CONFIG_UDP_FUNCTION_FASTBOOT_PORT);
+	ipr->udp_len = htons(UDP_HDR_SIZE + 4 + len);
+	ipr->udp_xsum = 0;
+	buf = (u8 *)(ipr + 1);
+	buf[0] = id;
+	buf[1] = 0;
+	put_unaligned_be16(seq, buf + 2);
+	memcpy(buf + 4, data, len);
+
+	sandbox_eth_recv_push(dev, ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4 + len);
+
+	return 0;
+}
+
+static int sb_fb_cmd(struct udevice *dev, struct fb_test_host *host,
+		     const char *cmd)
+{
+	return sb_fb_push(dev, FB_TEST_FASTBOOT, host->seq++, cmd, strlen(cmd));
+}
+
+/* Send new data packets until the window is full */
+static int sb_fb_send_data(struct udevice *dev, struct fb_test_host *host)
+{
+	int total = DIV_ROUND_UP(FB_TEST_SIZE, host->chunk);
+	int ret;
+
+	while (host->sent < total && host->sent < host->acked + host->window) {
+		uint offset = host->sent * host->chunk;
+		uint len = min((uint)host->chunk, FB_TEST_SIZE - offset);
+		ushort seq = host->data_seq + host->sent++;
+
+		if (seq == host->data_seq + host->lose && !host->lost) {
+			host->lost = true;
+			continue;
+		}
+		ret = sb_fb_push(dev, FB_TEST_FASTBOOT, seq, host->data + offset,
+				 len);
+		if (ret)
+			return ret;
+	}
+	host->seq = host->data_seq + host->sent;
+
+	return 0;
+}
+
+static int sb_fb_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct fb_test_host *host = priv->priv;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u8 *reply = (u8 *)(ip + 1);
+	int reply_len;
+	char cmd[32];
+	u8 init[6];
+	ushort seq;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	reply_len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	seq = get_unaligned_be16(reply + 2);
+	switch (host->step) {
+	case STEP_QUERY:
+		/* Start where the device says, asking for a window */
+		host->seq = get_unaligned_be16(reply + 4);
+		put_unaligned_be16(1, init);
+		put_unaligned_be16(8192, init + 2);
+		put_unaligned_be16(FB_TEST_WINDOW, init + 4);
+		host->step = STEP_INIT;
+		return sb_fb_push(dev, FB_TEST_INIT, host->seq++, init,
+				  sizeof(init));
+	case STEP_INIT:
+		if (reply_len != 4 + sizeof(init))
+			break;
+		host->chunk = get_unaligned_be16(reply + 6) - 4;
+		host->window = get_unaligned_be16(reply + 8);
+		host->step = STEP_DOWNLOAD;
+		sprintf(cmd, "download:%08x", FB_TEST_SIZE);
+		return sb_fb_cmd(dev, host, cmd);
+	case STEP_DOWNLOAD:
+		host->step = STEP_DOWNLOAD_RESP;
+		return sb_fb_cmd(dev, host, "");
+	case STEP_DOWNLOAD_RESP:
+		if (strncmp((char *)reply + 4, "DATA", 4))
+			break;
+		host->step = STEP_DATA;
+		host->data_seq = host->seq;
+		return sb_fb_send_data(dev, host);
+	case STEP_DATA:
+		/* Each reply acknowledges everything up to its sequence */
+		host->data_replies++;
+		host->acked = (ushort)(seq - host->data_seq) + 1;
+		/* If not everything sent was received, go back */
+		host->sent = host->acked;
+		if (host->acked < DIV_ROUND_UP(FB_TEST_SIZE, host->chunk))
+			return sb_fb_send_data(dev, host);
+		host->step = STEP_COMPLETE;
+		return sb_fb_cmd(dev, host, "");
+	case STEP_COMPLETE:
+		if (strncmp((char *)reply + 4, "OKAY", 4))
+			break;
+		host->step = STEP_DONE;
+		return 0;
+	default:
+		return 0;
+	}
+	host->step = STEP_FAILED;
+
+	return 0;
+}
+
+/*
+ * Download an image with a window of packets, losing one, and return the
+ * number of replies to data packets
+ */
+static int fastboot_udp_window_run(struct unit_test_state *uts, int lose,
+				   int *data_replies)
+{
+	struct fb_test_host host;
+	struct udevice *dev;
+	char *buf;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+
+	memset(&host, '\0', sizeof(host));
+	host.lose = lose;
+	ut_fill_pattern(host.data, FB_TEST_SIZE, 0);
+
+	buf = map_sysmem(FB_TEST_ADDR, FB_TEST_SIZE);
+	memset(buf, '\0', FB_TEST_SIZE);
+	fastboot_init(buf, FB_TEST_SIZE);
+
+	sandbox_eth_set_tx_handler(0, sb_fb_handler);
+	sandbox_eth_set_priv(0, &host);
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_init());
+	ut_assertok(eth_init());
+	fastboot_start_server();
+
+	/* The host speaks first, so drive the device by hand */
+	ut_assertok(sb_fb_push(dev, FB_TEST_QUERY, 0, NULL, 0));
+	for (i = 0; i < 100 && host.step < STEP_DONE; i++)
+		eth_rx();
+
+	eth_halt();
+	net_set_udp_handler(NULL);
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	ut_asserteq(STEP_DONE, host.step);
+
+	/* The device allows a full Ethernet frame and the window we asked */
+	ut_asserteq(1472 - 4, host.chunk);
+	ut_asserteq(FB_TEST_WINDOW, host.window);
+	*data_replies = host.data_replies;
+
+	ut_asserteq(FB_TEST_SIZE, env_get_hex("filesize", 0));
+	ut_asserteq_mem(host.data, buf, FB_TEST_SIZE);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int dm_test_fastboot_udp_window(struct unit_test_state *uts)
+{
+	int replies;
+
+	/*
+	 * Twelve packets take a reply per window, plus one for the lost
+	 * packet: 1-4, 5 (6 lost), 6-9, 10-12
+	 */
+	ut_assertok(fastboot_udp_window_run(uts, 5, &replies));
+	ut_asserteq(4, replies);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_udp_window, UT_TESTF_SCAN_FDT);
+
+/* Losing the first packet of a window is reported by the packet after it */
+static int dm_test_fastboot_udp_window_first(struct unit_test_state *uts)
+{
+	int replies;
+
+	/* 1-4, 4 again (5 lost), 5-8, 9-12 */
+	ut_assertok(fastboot_udp_window_run(uts, FB_TEST_WINDOW, &replies));
+	ut_asserteq(4, replies);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_udp_window_first, UT_TESTF_SCAN_FDT);
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the FAT filesystem
+ *
+ * These build a small FAT16 filesystem in a file on the host and read it
+ * through a sandbox host block device.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <fat.h>
+#include <malloc.h>
+#include <os.h>
+#include <sandboxblockdev.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FAT_TEST_SECT		512
+/* Number of FAT16 entries in each block of the FAT which is cached */
+#define FAT_TEST_WIN		(FATBUFBLOCKS * FAT_TEST_SECT / 2)
+/* Clusters in the filesystem, enough for a FAT16 */
+#define FAT_TEST_TOTAL		((FATBUFWAYS + 2) * FAT_TEST_WIN)
+#define FAT_TEST_FAT_SECTS	DIV_ROUND_UP((FAT_TEST_TOTAL + 2) * 2, \
+					     FAT_TEST_SECT)
+#define FAT_TEST_ROOT_SECT	(1 + FAT_TEST_FAT_SECTS)
+#define FAT_TEST_DATA_SECT	(FAT_TEST_ROOT_SECT + 1)
+#define FAT_TEST_SECTS		(FAT_TEST_DATA_SECT + FAT_TEST_TOTAL)
+/* Times the file's cluster chain goes round the cached blocks */
+#define FAT_TEST_PASSES		3
+#define FAT_TEST_CLUSTERS	((FATBUFWAYS + 1) * FAT_TEST_PASSES)
+#define FAT_TEST_SIZE		(FAT_TEST_CLUSTERS * FAT_TEST_SECT)
+
+/* Write @count sectors at @sect in the image */
+static int fat_test_write(struct unit_test_state *uts, int fd, uint sect,
+			  const void *buf, uint count)
+{
+	ut_asserteq(sect * FAT_TEST_SECT,
+		    os_lseek(fd, sect * FAT_TEST_SECT, OS_SEEK_SET));
+	ut_asserteq(count * FAT_TEST_SECT,
+		    os_write(fd, buf, count * FAT_TEST_SECT));
+
+	return 0;
+}
+
+/*
+ * Cluster holding part @i of the file. Each one is in the next cached block
+ * of the FAT, going round one more block than can be cached.
+ */
+static uint fat_test_clust(int i)
+{
+	int ways = FATBUFWAYS + 1;
+
+	return (i % ways) * FAT_TEST_WIN + 16 + i / ways;
+}
+
+/* Build a filesystem holding FRAG.BIN, which has the data in @buf */
+static int fat_test_build(struct unit_test_state *uts, const char *fname,
+			  const u8 *buf)
+{
+	u8 sect[FAT_TEST_SECT];
+	volume_info *vi;
+	boot_sector *bs;
+	dir_entry *dent;
+	__le16 *fat;
+	uint clust;
+	int fd, i;
+
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+
+	memset(sect, '\0', sizeof(sect));
+	bs = (boot_sector *)sect;
+	bs->sector_size[1] = FAT_TEST_SECT >> 8;
+	bs->cluster_size = 1;
+	bs->reserved = cpu_to_le16(1);
+	bs->fats = 1;
+	bs->dir_entries[0] = FAT_TEST_SECT / sizeof(dir_entry);
+	bs->sectors[0] = FAT_TEST_SECTS & 0xff;
+	bs->sectors[1] = FAT_TEST_SECTS >> 8;
+	bs->media = 0xf8;
+	bs->fat_length = cpu_to_le16(FAT_TEST_FAT_SECTS);
+	vi = (volume_info *)&bs->fat32_length;
+	vi->ext_boot_sign = 0x29;
+	memcpy(vi->fs_type, FAT16_SIGN, SIGNLEN);
+	sect[FAT_TEST_SECT - 2] = 0x55;
+	sect[FAT_TEST_SECT - 1] = 0xaa;
+	ut_assertok(fat_test_write(uts, fd, 0, sect, 1));
+
+	fat = calloc(FAT_TEST_FAT_SECTS, FAT_TEST_SECT);
+	ut_assertnonnull(fat);
+	fat[0] = cpu_to_le16(0xfff8);
+	fat[1] = cpu_to_le16(0xffff);
+	for (i = 0; i < FAT_TEST_CLUSTERS; i++) {
+		clust = fat_test_clust(i);
+		fat[clust] = cpu_to_le16(i + 1 < FAT_TEST_CLUSTERS ?
+					 fat_test_clust(i + 1) : 0xffff);
+		ut_assertok(fat_test_write(uts, fd,
+					   FAT_TEST_DATA_SECT + clust - 2,
+					   buf + i * FAT_TEST_SECT, 1));
+	}
+	ut_assertok(fat_test_write(uts, fd, 1, fat, FAT_TEST_FAT_SECTS));
+	free(fat);
+
+	memset(sect, '\0', sizeof(sect));
+	dent = (dir_entry *)sect;
+	memcpy(dent->nameext.name, "FRAG    ", 8);
+	memcpy(dent->nameext.ext, "BIN", 3);
+	dent->attr = ATTR_ARCH;
+	dent->start = cpu_to_le16(fat_test_clust(0));
+	dent->size = cpu_to_le32(FAT_TEST_SIZE);
+	ut_assertok(fat_test_write(uts, fd, FAT_TEST_ROOT_SECT, sect, 1));
+
+	/* Make the image as long as the filesystem */
+	memset(sect, '\0', sizeof(sect));
+	ut_assertok(fat_test_write(uts, fd, FAT_TEST_SECTS - 1, sect, 1));
+	os_close(fd);
+
+	return 0;
+}
+
+/*
+ * Test reading a file whose cluster chain keeps moving to a block of the FAT
+ * which is not cached, so that each step replaces the least recently used
+ * block
+ */
+static int dm_test_fat_cache_evict(struct unit_test_state *uts)
+{
+	const char *fname = "fat_cache.img";
+	struct blk_desc *desc;
+	struct udevice *dev;
+	loff_t actread;
+	u8 *buf, *cmp;
+
+	buf = malloc(FAT_TEST_SIZE);
+	ut_assertnonnull(buf);
+	cmp = calloc(1, FAT_TEST_SIZE);
+	ut_assertnonnull(cmp);
+	ut_fill_pattern(buf, FAT_TEST_SIZE, 0);
+	ut_assertok(fat_test_build(uts, fname, buf));
+
+	ut_assertok(host_dev_bind(0, (char *)fname, false));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+	ut_assertok(fat_register_device(desc, 0));
+
+	ut_assertok(fat_read_file("frag.bin", cmp, 0, 0, &actread));
+	ut_asserteq(FAT_TEST_SIZE, actread);
+	ut_asserteq_mem(buf, cmp, FAT_TEST_SIZE);
+
+	/* Reading from part way along follows the chain to find the start */
+	memset(cmp, '\0', FAT_TEST_SIZE);
+	ut_assertok(fat_read_file("frag.bin", cmp, FAT_TEST_SIZE / 2, 0,
+				  &actread));
+	ut_asserteq(FAT_TEST_SIZE - FAT_TEST_SIZE / 2, actread);
+	ut_asserteq_mem(buf + FAT_TEST_SIZE / 2, cmp, actread);
+
+	fat_close();
+	ut_assertok(host_dev_bind(0, NULL, false));
+	os_unlink(fname);
+	free(cmp);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_fat_cache_evict, UT_TESTF_SCAN_FDT);
@@ -3,9 +3,13 @@
 #include <common.h>
 #include <dm.h>
 #include <log.h>
+#include <malloc.h>
 #include <of_live.h>
+#include <time.h>
+#include <asm/global_data.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
+#include <dm/of_access.h>
 #include <dm/of_extra.h>
 #include <dm/root.h>
 #include <dm/test.h>
@@ -13,6 +17,8 @@
 #include <test/test.h>
 #include <test/ut.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 static int dm_test_ofnode_compatible(struct unit_test_state *uts)
 {
 	ofnode root_node = ofnode_path("/");
@@ -40,6 +46,128 @@ static int dm_test_ofnode_get_by_phandle(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_ofnode_get_by_phandle, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+#define PHANDLE_TEST_MAX	512
+#define PHANDLE_TEST_PASSES	20
+
+/* Collect the phandles of @parent and the nodes below it */
+static int ofnode_collect_phandles(ofnode parent, u32 *phandles, int count)
+{
+	ofnode node;
+
+	if (!ofnode_read_u32(parent, "phandle", &phandles[count]) &&
+	    count < PHANDLE_TEST_MAX - 1)
+		count++;
+	ofnode_for_each_subnode(node, parent)
+		count = ofnode_collect_phandles(node, phandles, count);
+
+	return count;
+}
+
+/* Find a node by searching the whole tree, as was done before the index */
+static ofnode ofnode_search_phandle(u32 phandle)
+{
+	struct device_node *np;
+
+	if (!of_live_active())
+		return offset_to_ofnode(fdt_node_offset_by_phandle(gd->fdt_blob,
+								   phandle));
+	for_each_of_allnodes(np)
+		if (np->phandle == phandle)
+			break;
+
+	return np_to_ofnode(np);
+}
+
+/*
+ * Check that every phandle in the tree is found through the index. How long
+ * that takes against searching the tree is logged when debugging.
+ */
+static int dm_test_ofnode_phandle_index(struct unit_test_state *uts)
+{
+	ulong start, indexed_us, searched_us;
+	u32 *phandles;
+	int count, pass, i;
+	ofnode node;
+
+	phandles = calloc(PHANDLE_TEST_MAX, sizeof(u32));
+	ut_assertnonnull(phandles);
+	count = ofnode_collect_phandles(ofnode_root(), phandles, 0);
+	ut_assert(count > 10);
+
+	for (i = 0; i < count; i++) {
+		node = ofnode_get_by_phandle(phandles[i]);
+		ut_assert(ofnode_valid(node));
+		ut_assert(ofnode_equal(ofnode_search_phandle(phandles[i]),
+				       node));
+	}
+
+	start = timer_get_us();
+	for (pass = 0; pass < PHANDLE_TEST_PASSES; pass++)
+		for (i = 0; i < count; i++)
+			ofnode_get_by_phandle(phandles[i]);
+	indexed_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (pass = 0; pass < PHANDLE_TEST_PASSES; pass++)
+		for (i = 0; i < count; i++)
+			ofnode_search_phandle(phandles[i]);
+	searched_us = timer_get_us() - start;
+
+	log_debug("%s tree: %d phandles x %d: %lu us indexed, %lu us searched\n",
+		  of_live_active() ? "live" : "flat", count,
+		  PHANDLE_TEST_PASSES, indexed_us, searched_us);
+	free(phandles);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_phandle_index, UT_TESTF_SCAN_FDT);
+
+/* Probe @parent and every device below it, returning how many probed */
+static int ofnode_probe_all(struct udevice *parent)
+{
+	struct udevice *dev;
+	int count = 0;
+
+	device_foreach_child(dev, parent) {
+		if (!device_probe(dev))
+			count++;
+		count += ofnode_probe_all(dev);
+	}
+
+	return count;
+}
+
+/*
+ * Probe the whole tree with and without the phandle table, which must make
+ * no difference to which devices probe. How long each takes is logged when
+ * debugging.
+ */
+static int dm_test_ofnode_phandle_probe(struct unit_test_state *uts)
+{
+	ulong start, indexed_us, searched_us;
+	int indexed, searched;
+
+	start = timer_get_us();
+	indexed = ofnode_probe_all(dm_root());
+	indexed_us = timer_get_us() - start;
+	ut_assert(indexed > 10);
+	ut_assertok(device_remove(dm_root(), DM_REMOVE_NORMAL));
+
+	ut_assertok(of_build_phandle_table(NULL));
+	start = timer_get_us();
+	searched = ofnode_probe_all(dm_root());
+	searched_us = timer_get_us() - start;
+	ut_assertok(device_remove(dm_root(), DM_REMOVE_NORMAL));
+	ut_assertok(of_build_phandle_table(gd_of_root()));
+	ut_asserteq(indexed, searched);
+
+	log_debug("%d devices: %lu us indexed, %lu us searched\n", indexed,
+		  indexed_us, searched_us);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_phandle_probe, UT_TESTF_SCAN_FDT | UT_TESTF_LIVE_TREE);
+
 static int dm_test_ofnode_by_prop_value(struct unit_test_state *uts)
 {
 	const char propname[] = "compatible";
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SquashFS filesystem
+ *
+ * These build a small uncompressed SquashFS filesystem in a file on the host
+ * and read it through a sandbox host block device. The data is changed on
+ * the host part way through, so that each read shows whether it came from
+ * the cache or from the device.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <fs.h>
+#include <malloc.h>
+#include <os.h>
+#include <part.h>
+#include <sandboxblockdev.h>
+#include <squashfs.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include "../../fs/squashfs/sqfs_decompressor.h"
+#include "../../fs/squashfs/sqfs_filesystem.h"
+
+#define SQFS_TEST_SECT		512
+/* Files in each fragment block, and fragment blocks in the filesystem */
+#define SQFS_TEST_PER_FRAG	2
+#define SQFS_TEST_FRAGS		(SQFS_FRAGMENT_CACHE_SIZE + 1)
+#define SQFS_TEST_FILES		(SQFS_TEST_PER_FRAG * SQFS_TEST_FRAGS)
+#define SQFS_TEST_FILE_SIZE	600
+#define SQFS_TEST_FRAG_SIZE	(SQFS_TEST_PER_FRAG * SQFS_TEST_FILE_SIZE)
+#define SQFS_TEST_DATA_SIZE	(SQFS_TEST_FRAGS * SQFS_TEST_FRAG_SIZE)
+/* Fragment blocks come straight after the superblock */
+#define SQFS_TEST_DATA_START	SQFS_TEST_SECT
+#define SQFS_TEST_IMG_SIZE	(16 * SQFS_TEST_SECT)
+
+/* Metadata blocks and fragment blocks which are stored uncompressed */
+#define SQFS_TEST_META_RAW	BIT(15)
+#define SQFS_TEST_FRAG_RAW	BIT(24)
+
+/* Add an uncompressed metadata block of @size bytes at @pos in @img */
+static void *sqfs_test_meta(u8 *img, uint *pos, uint size)
+{
+	void *data = img + *pos + SQFS_HEADER_SIZE;
+
+	put_unaligned_le16(SQFS_TEST_META_RAW | size, img + *pos);
+	*pos += SQFS_HEADER_SIZE + size;
+
+	return data;
+}
+
+/*
+ * Build a filesystem holding files f0, f1... in its root directory, each
+ * stored in a fragment block shared with the files next to it
+ */
+static int sqfs_test_build(struct unit_test_state *uts, const char *fname,
+			   const u8 *data)
+{
+	struct squashfs_fragment_block_entry *frag;
+	struct squashfs_directory_header *hdr;
+	struct squashfs_directory_entry *dent;
+	struct squashfs_super_block *sblk;
+	struct squashfs_reg_inode *reg;
+	struct squashfs_dir_inode *dir;
+	uint pos, dir_size, frag_table;
+	u8 *img, *ptr;
+	int fd, i;
+
+	img = calloc(1, SQFS_TEST_IMG_SIZE);
+	ut_assertnonnull(img);
+	memcpy(img + SQFS_TEST_DATA_START, data, SQFS_TEST_DATA_SIZE);
+	pos = SQFS_TEST_DATA_START + SQFS_TEST_DATA_SIZE;
+
+	/* Inodes 1 to SQFS_TEST_FILES are the files, the last is the root */
+	sblk = (struct squashfs_super_block *)img;
+	sblk->inode_table_start = cpu_to_le64(pos);
+	reg = sqfs_test_meta(img, &pos, SQFS_TEST_FILES * sizeof(*reg) +
+			     sizeof(*dir));
+	for (i = 0; i < SQFS_TEST_FILES; i++, reg++) {
+		reg->inode_type = cpu_to_le16(SQFS_REG_TYPE);
+		reg->mode = cpu_to_le16(0644);
+		reg->inode_number = cpu_to_le32(i + 1);
+		reg->fragment = cpu_to_le32(i / SQFS_TEST_PER_FRAG);
+		reg->offset = cpu_to_le32(i % SQFS_TEST_PER_FRAG *
+					  SQFS_TEST_FILE_SIZE);
+		reg->file_size = cpu_to_le32(SQFS_TEST_FILE_SIZE);
+	}
+
+	/* Entries are named f0, f1..., so have two-character names */
+	dir_size = sizeof(*hdr) + SQFS_TEST_FILES * (sizeof(*dent) + 2);
+	dir = (struct squashfs_dir_inode *)reg;
+	dir->inode_type = cpu_to_le16(SQFS_DIR_TYPE);
+	dir->mode = cpu_to_le16(0755);
+	dir->inode_number = cpu_to_le32(SQFS_TEST_FILES + 1);
+	dir->nlink = cpu_to_le32(2);
+	dir->file_size = cpu_to_le16(dir_size + SQFS_EMPTY_FILE_SIZE);
+	dir->parent_inode = cpu_to_le32(SQFS_TEST_FILES + 2);
+
+	sblk->directory_table_start = cpu_to_le64(pos);
+	hdr = sqfs_test_meta(img, &pos, dir_size);
+	hdr->count = SQFS_TEST_FILES - 1;
+	hdr->inode_number = 1;
+	ptr = (u8 *)(hdr + 1);
+	for (i = 0; i < SQFS_TEST_FILES; i++) {
+		dent = (struct squashfs_directory_entry *)ptr;
+		dent->offset = i * sizeof(*reg);
+		dent->inode_offset = i;
+		dent->type = SQFS_REG_TYPE;
+		dent->name_size = 1;
+		dent->name[0] = 'f';
+		dent->name[1] = '0' + i;
+		ptr += sizeof(*dent) + 2;
+	}
+
+	/* The fragment table, then the index of its metadata blocks */
+	frag_table = pos;
+	frag = sqfs_test_meta(img, &pos, SQFS_TEST_FRAGS * sizeof(*frag));
+	for (i = 0; i < SQFS_TEST_FRAGS; i++) {
+		frag[i].start = SQFS_TEST_DATA_START + i * SQFS_TEST_FRAG_SIZE;
+		frag[i].size = SQFS_TEST_FRAG_RAW | SQFS_TEST_FRAG_SIZE;
+	}
+	sblk->fragment_table_start = cpu_to_le64(pos);
+	put_unaligned_le64(frag_table, img + pos);
+	pos += sizeof(u64);
+	ut_assert(pos <= SQFS_TEST_IMG_SIZE);
+
+	sblk->s_magic = cpu_to_le32(SQFS_MAGIC_NUMBER);
+	sblk->inodes = cpu_to_le32(SQFS_TEST_FILES + 1);
+	sblk->block_size = cpu_to_le32(4096);
+	sblk->block_log = cpu_to_le16(12);
+	sblk->fragments = cpu_to_le32(SQFS_TEST_FRAGS);
+	sblk->compression = cpu_to_le16(SQFS_COMP_ZLIB);
+	sblk->s_major = cpu_to_le16(4);
+	sblk->root_inode = cpu_to_le64(SQFS_TEST_FILES * sizeof(*reg));
+	sblk->bytes_used = cpu_to_le64(pos);
+	sblk->id_table_start = cpu_to_le64(pos);
+	sblk->xattr_id_table_start = cpu_to_le64(~0ULL);
+	sblk->export_table_start = cpu_to_le64(~0ULL);
+
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(SQFS_TEST_IMG_SIZE, os_write(fd, img, SQFS_TEST_IMG_SIZE));
+	os_close(fd);
+	free(img);
+
+	return 0;
+}
+
+/* Change the contents of all the fragment blocks in the image to @data */
+static int sqfs_test_rewrite(struct unit_test_state *uts, const char *fname,
+			     const u8 *data)
+{
+	int fd;
+
+	fd = os_open(fname, OS_O_RDWR);
+	ut_assert(fd >= 0);
+	ut_asserteq(SQFS_TEST_DATA_START,
+		    os_lseek(fd, SQFS_TEST_DATA_START, OS_SEEK_SET));
+	ut_asserteq(SQFS_TEST_DATA_SIZE,
+		    os_write(fd, data, SQFS_TEST_DATA_SIZE));
+	os_close(fd);
+
+	return 0;
+}
+
+/* Read file @num and check that it holds its part of @data */
+static int sqfs_test_check(struct unit_test_state *uts, int num,
+			   const u8 *data)
+{
+	u8 buf[SQFS_TEST_FILE_SIZE];
+	char name[4];
+	loff_t actread;
+
+	snprintf(name, sizeof(name), "f%d", num);
+	memset(buf, '\0', sizeof(buf));
+	ut_assertok(sqfs_read(name, buf, 0, 0, &actread));
+	ut_asserteq(SQFS_TEST_FILE_SIZE, actread);
+	ut_asserteq_mem(data + num * SQFS_TEST_FILE_SIZE, buf,
+			SQFS_TEST_FILE_SIZE);
+
+	return 0;
+}
+
+/*
+ * Test that fragment blocks are kept while the filesystem is mounted, that
+ * the least recently used one is dropped for a new one, and that nothing is
+ * kept from one mount to the next
+ */
+static int dm_test_sqfs_frag_cache(struct unit_test_state *uts)
+{
+	const char *fname = "sqfs_cache.img";
+	struct disk_partition part;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	u8 *old, *new;
+	int i;
+
+	old = malloc(SQFS_TEST_DATA_SIZE);
+	ut_assertnonnull(old);
+	new = malloc(SQFS_TEST_DATA_SIZE);
+	ut_assertnonnull(new);
+	ut_fill_pattern(old, SQFS_TEST_DATA_SIZE, 0);
+	ut_fill_pattern(new, SQFS_TEST_DATA_SIZE, 1);
+	ut_assertok(sqfs_test_build(uts, fname, old));
+
+	ut_assertok(host_dev_bind(0, (char *)fname, false));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+	memset(&part, '\0', sizeof(part));
+	part.size = desc->lba;
+	part.blksz = desc->blksz;
+	ut_assertok(sqfs_probe(desc, &part));
+
+	/* Fill the cache from all but the last fragment block, then change all */
+	for (i = 0; i < SQFS_FRAGMENT_CACHE_SIZE; i++)
+		ut_assertok(sqfs_test_check(uts, i * SQFS_TEST_PER_FRAG, old));
+	ut_assertok(sqfs_test_rewrite(uts, fname, new));
+
+	/* The first is still cached, and is now the most recently used */
+	ut_assertok(sqfs_test_check(uts, 1, old));
+
+	/* Reading the last drops the second, but keeps the first */
+	ut_assertok(sqfs_test_check(uts, SQFS_FRAGMENT_CACHE_SIZE *
+				    SQFS_TEST_PER_FRAG, new));
+	ut_assertok(sqfs_test_check(uts, 0, old));
+	ut_assertok(sqfs_test_check(uts, SQFS_TEST_PER_FRAG + 1, new));
+
+	/* Mounting again reads everything from the device */
+	sqfs_close();
+	ut_assertok(sqfs_probe(desc, &part));
+	ut_assertok(sqfs_test_check(uts, 1, new));
+	sqfs_close();
+
+	ut_assertok(host_dev_bind(0, NULL, false));
+	os_unlink(fname);
+	free(new);
+	free(old);
+
+	return 0;
+}
+DM_TEST(dm_test_sqfs_frag_cache, UT_TESTF_SCAN_FDT);
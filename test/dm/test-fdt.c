@@ -223,6 +223,54 @@ static int dm_test_fdt_pre_reloc(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_fdt_pre_reloc, 0);
 
+#if CONFIG_IS_ENABLED(DM_DEFER_BIND)
+/* Test binding nodes only when their devices are looked up */
+static int dm_test_fdt_defer_bind(struct unit_test_state *uts)
+{
+	struct dm_defer_state *state;
+	struct udevice *dev;
+	struct uclass *uc;
+	int deferred;
+
+	ut_assertok(dm_set_defer_bind(true));
+	ut_assertok(dm_scan_fdt(false));
+	state = dm_defer_state();
+	ut_assertnonnull(state);
+	deferred = state->deferred;
+	ut_assert(deferred > 0);
+	ut_asserteq(0, state->bound);
+	ut_assert(list_empty(&gd->dm_root->child_head));
+
+	/* Only the bus holding the dummy devices is bound, down to the last */
+	ut_assertok(uclass_find_first_device(UCLASS_TEST_DUMMY, &dev));
+	ut_assertnonnull(dev);
+	uc = uclass_find(UCLASS_TEST_DUMMY);
+	ut_asserteq(4, list_count_items(&uc->dev_head));
+	ut_asserteq(1, list_count_items(&gd->dm_root->child_head));
+	ut_asserteq_str("translation-test@8000", dev_read_name(dev->parent));
+	ut_assertnull(uclass_find(UCLASS_TEST_FDT));
+	ut_asserteq(deferred, state->deferred - state->bound + 1);
+
+	/* A node can be looked up directly */
+	ut_assertok(device_find_global_by_ofnode(ofnode_path("/a-test"), &dev));
+	ut_asserteq_str("a-test", dev->name);
+	uc = uclass_find(UCLASS_TEST_FDT);
+	ut_asserteq(1, list_count_items(&uc->dev_head));
+	ut_asserteq(2, list_count_items(&gd->dm_root->child_head));
+
+	/* A device which asks to be probed once bound is probed then */
+	ut_assertok(uclass_find_device_by_name(UCLASS_LED, "default_on", &dev));
+	ut_assert(dev_get_flags(dev) & DM_FLAG_ACTIVATED);
+
+	/* Binding nodes no longer deferred works as usual */
+	ut_assertok(dm_set_defer_bind(false));
+	ut_assertnull(dm_defer_state());
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_defer_bind, 0);
+#endif
+
 /* Test that sequence numbers are allocated properly */
 static int dm_test_fdt_uclass_seq(struct unit_test_state *uts)
 {
@@ -550,6 +598,27 @@ U_BOOT_DRIVER(fdt_dummy_drv) = {
 	.id	= UCLASS_TEST_DUMMY,
 };
 
+/* Comes after fdt_dummy_drv in the driver list, so is never used */
+U_BOOT_DRIVER(fdt_dummy_shadow_drv) = {
+	.name	= "fdt_dummy_shadow_drv",
+	.of_match	= fdt_dummy_ids,
+	.id	= UCLASS_TEST_DUMMY,
+};
+
+/* Test that the first of two drivers with the same compatible string binds */
+static int dm_test_fdt_compat_first(struct unit_test_state *uts)
+{
+	struct driver *drv = DM_DRIVER_GET(fdt_dummy_drv);
+	struct udevice *dev;
+
+	ut_assert(drv < DM_DRIVER_GET(fdt_dummy_shadow_drv));
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_DUMMY, 0, &dev));
+	ut_asserteq_ptr(drv, dev->driver);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_compat_first, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 static int dm_test_fdt_translation(struct unit_test_state *uts)
 {
 	struct udevice *dev;
@@ -6,6 +6,7 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/io.h>
@@ -63,6 +64,66 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/*
+ * Read 2MiB from a mass-storage device, returning the number of read
+ * commands its flash stick received and the number of VPD inquiries it had
+ */
+static int usb_flash_read_2m(struct unit_test_state *uts, int seq,
+			     const char *emul_name, int *readsp, int *vpdp)
+{
+	struct blk_desc *dev_desc;
+	struct udevice *dev, *blk, *emul;
+	int reads;
+	char *buf;
+
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, seq, &dev));
+	ut_assertok(device_find_first_child_by_uclass(dev, UCLASS_BLK, &blk));
+	dev_desc = dev_get_uclass_plat(blk);
+	ut_assertok(uclass_find_device_by_name(UCLASS_USB_EMUL, emul_name,
+					       &emul));
+
+	buf = malloc(4096 * 512);
+	ut_assertnonnull(buf);
+	reads = sandbox_usb_flash_get_reads(emul);
+	ut_asserteq(4096, blk_dread(dev_desc, 0, 4096, buf));
+	*readsp = sandbox_usb_flash_get_reads(emul) - reads;
+	*vpdp = sandbox_usb_flash_get_vpd_inquiries(emul);
+	ut_assertok(strcmp(buf, "this is a test"));
+	free(buf);
+
+	return 0;
+}
+
+/*
+ * Test that a large read from a SuperSpeed stick uses the transfer size it
+ * reports, while USB2 sticks keep to 240 blocks and are not asked
+ */
+static int dm_test_usb_flash_read_size(struct unit_test_state *uts)
+{
+	struct usb_device *udev;
+	struct udevice *dev;
+	int reads, vpd;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+
+	ut_assertok(usb_flash_read_2m(uts, 0, "flash-stick@0", &reads, &vpd));
+	ut_asserteq(18, reads);
+	ut_asserteq(0, vpd);
+
+	/* The third stick is SuperSpeed and allows 1024 blocks at a time */
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
+	udev = dev_get_parent_priv(dev);
+	ut_asserteq(USB_SPEED_SUPER, udev->speed);
+	ut_assertok(usb_flash_read_2m(uts, 2, "flash-stick@2", &reads, &vpd));
+	ut_asserteq(4, reads);
+	ut_asserteq(2, vpd);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_read_size, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
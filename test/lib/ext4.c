@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the ext4 extent map
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <ext_common.h>
+#include <ext4fs.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Extents held in the inode: logical block, length, physical block */
+static const struct {
+	u32 block;
+	u16 len;
+	u64 start;
+} ext4_test_ext[] = {
+	{ 0, 4, 1000 },
+	{ 4, 2, 0x123400000500ULL },
+	{ 10, 8, 200 },
+	{ 30, 1, 50 },
+};
+
+/* Set up @node as a file whose extent tree fits in its inode */
+static void ext4_test_node(struct ext2fs_node *node)
+{
+	struct ext4_extent_header *hdr;
+	struct ext4_extent *ext;
+	int i;
+
+	memset(node, '\0', sizeof(*node));
+	node->inode.flags = cpu_to_le32(EXT4_EXTENTS_FL);
+	hdr = (struct ext4_extent_header *)node->inode.b.blocks.dir_blocks;
+	hdr->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	hdr->eh_entries = cpu_to_le16(ARRAY_SIZE(ext4_test_ext));
+	hdr->eh_max = cpu_to_le16(ARRAY_SIZE(ext4_test_ext));
+	hdr->eh_depth = 0;
+
+	ext = (struct ext4_extent *)(hdr + 1);
+	for (i = 0; i < ARRAY_SIZE(ext4_test_ext); i++) {
+		ext[i].ee_block = cpu_to_le32(ext4_test_ext[i].block);
+		ext[i].ee_len = cpu_to_le16(ext4_test_ext[i].len);
+		ext[i].ee_start_hi = cpu_to_le16(ext4_test_ext[i].start >> 32);
+		ext[i].ee_start_lo = cpu_to_le32(ext4_test_ext[i].start);
+	}
+}
+
+/* Test mapping file blocks, in order and out of order, through the map */
+static int lib_test_ext4_map_block(struct unit_test_state *uts)
+{
+	struct ext_extent_map *map;
+	struct ext2fs_node node;
+	int i;
+
+	ext4_test_node(&node);
+
+	/* Reading in order moves along the extents */
+	for (i = 0; i < 4; i++)
+		ut_asserteq(1000 + i, ext4fs_map_block(&node, i, NULL));
+	map = node.extmap;
+	ut_assertnonnull(map);
+	ut_asserteq(ARRAY_SIZE(ext4_test_ext), map->count);
+	ut_asserteq_64(0x123400000500ULL + 1,
+		       ext4fs_map_block(&node, 5, NULL));
+	ut_asserteq(1, map->last);
+
+	/* Holes, and blocks past the end, are not allocated */
+	ut_asserteq(0, ext4fs_map_block(&node, 6, NULL));
+	ut_asserteq(0, ext4fs_map_block(&node, 9, NULL));
+	ut_asserteq(0, ext4fs_map_block(&node, 29, NULL));
+	ut_asserteq(0, ext4fs_map_block(&node, 31, NULL));
+
+	/* Jumping about finds the extent by searching */
+	ut_asserteq(50, ext4fs_map_block(&node, 30, NULL));
+	ut_asserteq(3, map->last);
+	ut_asserteq(1002, ext4fs_map_block(&node, 2, NULL));
+	ut_asserteq(0, map->last);
+	ut_asserteq(207, ext4fs_map_block(&node, 17, NULL));
+	ut_asserteq(2, map->last);
+	ut_asserteq(200, ext4fs_map_block(&node, 10, NULL));
+
+	/* The tree is only read into the map once */
+	ut_asserteq_ptr(map, node.extmap);
+	free(node.extmap);
+
+	return 0;
+}
+LIB_TEST(lib_test_ext4_map_block, 0);
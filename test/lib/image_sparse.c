@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for writing Android sparse images
+ *
+ * An image is written to a memory-backed store all at once, then again a few
+ * bytes at a time as a download would deliver it. Both must give the same
+ * result.
+ */
+
+#include <common.h>
+#include <fastboot.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Storage block and sparse block sizes */
+#define SP_BLKSZ		512
+#define SP_IMG_BLKSZ		2048
+/* Output size in sparse blocks, and the store, which has room to spare */
+#define SP_IMG_BLKS		12
+#define SP_STORE_BLKS		(SP_IMG_BLKS * SP_IMG_BLKSZ / SP_BLKSZ + 8)
+/* The file header is longer than ours, as a later format version might be */
+#define SP_FILE_HDR_SZ		(sizeof(sparse_header_t) + 4)
+#define SP_MAX_IMG		(SP_IMG_BLKS * SP_IMG_BLKSZ + 256)
+
+static lbaint_t sp_write(struct sparse_storage *info, lbaint_t blk,
+			 lbaint_t blkcnt, const void *buffer)
+{
+	memcpy(info->priv + blk * SP_BLKSZ, buffer, blkcnt * SP_BLKSZ);
+
+	return blkcnt;
+}
+
+static lbaint_t sp_reserve(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static u8 *sp_add_chunk(u8 *p, uint type, uint blks, uint data_len)
+{
+	chunk_header_t *chunk = (chunk_header_t *)p;
+
+	memset(chunk, '\0', sizeof(*chunk));
+	chunk->chunk_type = type;
+	chunk->chunk_sz = blks;
+	chunk->total_sz = sizeof(*chunk) + data_len;
+
+	return p + sizeof(*chunk);
+}
+
+/* Build an image with every kind of chunk, returning its size */
+static uint sp_make_image(u8 *img)
+{
+	sparse_header_t *hdr = (sparse_header_t *)img;
+	u8 *p = img + SP_FILE_HDR_SZ;
+
+	memset(img, '\0', SP_FILE_HDR_SZ);
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->file_hdr_sz = SP_FILE_HDR_SZ;
+	hdr->chunk_hdr_sz = sizeof(chunk_header_t);
+	hdr->blk_sz = SP_IMG_BLKSZ;
+	hdr->total_blks = SP_IMG_BLKS;
+	hdr->total_chunks = 5;
+
+	p = sp_add_chunk(p, CHUNK_TYPE_RAW, 3, 3 * SP_IMG_BLKSZ);
+	ut_fill_pattern(p, 3 * SP_IMG_BLKSZ, 0);
+	p += 3 * SP_IMG_BLKSZ;
+	p = sp_add_chunk(p, CHUNK_TYPE_FILL, 4, sizeof(u32));
+	*(u32 *)p = 0x12345678;
+	p += sizeof(u32);
+	p = sp_add_chunk(p, CHUNK_TYPE_DONT_CARE, 2, 0);
+	p = sp_add_chunk(p, CHUNK_TYPE_CRC32, 0, 0);
+	p = sp_add_chunk(p, CHUNK_TYPE_RAW, 3, 3 * SP_IMG_BLKSZ);
+	ut_fill_pattern(p, 3 * SP_IMG_BLKSZ, 1);
+	p += 3 * SP_IMG_BLKSZ;
+
+	return p - img;
+}
+
+static void sp_init_storage(struct sparse_storage *info, void *store)
+{
+	memset(store, '\xa5', SP_STORE_BLKS * SP_BLKSZ);
+	memset(info, '\0', sizeof(*info));
+	info->blksz = SP_BLKSZ;
+	info->start = 4;
+	info->size = SP_STORE_BLKS - info->start;
+	info->priv = store;
+	info->write = sp_write;
+	info->reserve = sp_reserve;
+}
+
+static int lib_test_image_sparse_stream(struct unit_test_state *uts)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
+	struct sparse_storage info;
+	u8 *img, *whole, *streamed;
+	struct sparse_stream ss;
+	uint size, received, used, step;
+	long ret;
+
+	img = malloc(SP_MAX_IMG);
+	whole = malloc(SP_STORE_BLKS * SP_BLKSZ);
+	streamed = malloc(SP_STORE_BLKS * SP_BLKSZ);
+	ut_assertnonnull(img);
+	ut_assertnonnull(whole);
+	ut_assertnonnull(streamed);
+	size = sp_make_image(img);
+	ut_assert(is_sparse_image(img));
+
+	sp_init_storage(&info, whole);
+	*response = '\0';
+	ut_assertok(write_sparse_image(&info, "test", img, response));
+	ut_asserteq_str("", response);
+
+	/* The fill chunk is written after the first raw chunk */
+	ut_asserteq(0x12345678,
+		    *(u32 *)(whole + (info.start + 3 * 4) * SP_BLKSZ));
+
+	/*
+	 * Deliver the image in pieces which split headers, the fill value and
+	 * blocks, passing anything not used again with the next piece
+	 */
+	for (step = 1; step < 1500; step += 333) {
+		sp_init_storage(&info, streamed);
+		sparse_stream_start(&ss, &info);
+		for (received = 0, used = 0; received < size;) {
+			received = min(received + step, size);
+			ret = sparse_stream_write(&ss, img + used,
+						  received - used, response);
+			ut_assert(ret >= 0);
+			used += ret;
+		}
+		ut_asserteq(size, used);
+		ut_assertok(sparse_stream_finish(&ss, "test", response));
+		ut_asserteq_mem(whole, streamed, SP_STORE_BLKS * SP_BLKSZ);
+	}
+
+	/* A stream which stops early is reported */
+	sp_init_storage(&info, streamed);
+	sparse_stream_start(&ss, &info);
+	ut_assert(sparse_stream_write(&ss, img, size - 1, response) >= 0);
+	ut_asserteq(-1, sparse_stream_finish(&ss, "test", response));
+
+	free(streamed);
+	free(whole);
+	free(img);
+
+	return 0;
+}
+LIB_TEST(lib_test_image_sparse_stream, 0);
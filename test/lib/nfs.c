@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for NFS
+ */
+
+#include <common.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include "../../net/nfs.h"
+
+/* Test the size of each READ request */
+static int lib_test_nfs_read_size(struct unit_test_state *uts)
+{
+	/* Without reassembly, the preferred size is rounded down */
+	ut_asserteq(1024, nfs_calc_read_size(1024, 0));
+	ut_asserteq(8192, nfs_calc_read_size(8192, 0));
+	ut_asserteq(4096, nfs_calc_read_size(6000, 0));
+
+	/* The reply to a 1024-byte READ needs no reassembly */
+	ut_asserteq(1024, nfs_calc_read_size(8192, 1024));
+	ut_asserteq(1024, nfs_calc_read_size(8192, 2048));
+
+	/* Otherwise the reply must fit in the reassembly buffer */
+	ut_asserteq(8192, nfs_calc_read_size(32768, 16384));
+	ut_asserteq(16384, nfs_calc_read_size(32768, 16384 + 1024));
+	ut_asserteq(32768, nfs_calc_read_size(32768, 65536));
+
+	return 0;
+}
+LIB_TEST(lib_test_nfs_read_size, 0);
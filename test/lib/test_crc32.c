@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for CRC32 and CRC32C
+ *
+ * These check the optimised CRC routines against a simple byte-wise version,
+ * at every alignment. The speed of each is logged when debugging.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Amount of data to checksum for each measurement */
+#define CRC_BENCH_SIZE		SZ_1M
+
+/* Bit-reflected polynomials */
+#define CRC32_POLY		0xedb88320
+#define CRC32C_POLY		0x82f63b78
+
+static const char crc_check_str[] = "123456789";
+
+static void crc_ref_init(uint *table, uint poly)
+{
+	uint c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = n;
+		for (k = 0; k < 8; k++)
+			c = c & 1 ? poly ^ (c >> 1) : c >> 1;
+		table[n] = c;
+	}
+}
+
+static uint crc_ref(const uint *table, uint crc, const u8 *buf, uint len)
+{
+	while (len--)
+		crc = table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static u8 *crc_bench_buf(void)
+{
+	u8 *buf;
+
+	buf = malloc(CRC_BENCH_SIZE);
+	if (buf)
+		ut_fill_pattern(buf, CRC_BENCH_SIZE, 0);
+
+	return buf;
+}
+
+static int lib_test_crc32(struct unit_test_state *uts)
+{
+	uint table[256];
+	uint off, len;
+	u8 *buf;
+
+	ut_asserteq(0xcbf43926, crc32(0, (u8 *)crc_check_str, 9));
+	ut_asserteq(0, crc32(0, NULL, 0));
+
+	buf = crc_bench_buf();
+	ut_assertnonnull(buf);
+	crc_ref_init(table, CRC32_POLY);
+
+	/* Cover each alignment and every length of the head and tail loops */
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len < 80; len++) {
+			ut_asserteq(crc_ref(table, 0x12345678, buf + off, len),
+				    crc32_no_comp(0x12345678, buf + off, len));
+		}
+	}
+
+	/* Splitting the data must not change the result */
+	ut_asserteq(crc32(0, buf, 1000),
+		    crc32(crc32(0, buf, 333), buf + 333, 667));
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32, 0);
+
+static int lib_test_crc32_bench(struct unit_test_state *uts)
+{
+	ulong start, us, ref_us;
+	uint table[256];
+	uint crc, ref;
+	u8 *buf;
+
+	buf = crc_bench_buf();
+	ut_assertnonnull(buf);
+	crc_ref_init(table, CRC32_POLY);
+
+	start = timer_get_us();
+	ref = crc_ref(table, 0, buf, CRC_BENCH_SIZE);
+	ref_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	crc = crc32_no_comp(0, buf, CRC_BENCH_SIZE);
+	us = timer_get_us() - start;
+	free(buf);
+
+	ut_asserteq(ref, crc);
+	log_debug("byte-wise %lu MB/s, crc32 %lu MB/s\n",
+		  CRC_BENCH_SIZE / max(ref_us, 1UL),
+		  CRC_BENCH_SIZE / max(us, 1UL));
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_bench, 0);
+
+#if CONFIG_IS_ENABLED(CRC32C)
+static int lib_test_crc32c(struct unit_test_state *uts)
+{
+	uint table[256], ref_table[256];
+	uint off, len;
+	u8 *buf;
+
+	crc32c_init(table, CRC32C_POLY);
+	ut_asserteq(0xe3069283,
+		    ~crc32c_cal(~0, crc_check_str, 9, table));
+
+	buf = crc_bench_buf();
+	ut_assertnonnull(buf);
+	crc_ref_init(ref_table, CRC32C_POLY);
+
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len < 80; len++) {
+			ut_asserteq(crc_ref(ref_table, ~0, buf + off, len),
+				    crc32c_cal(~0, (char *)buf + off, len,
+					       table));
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32c, 0);
+#endif
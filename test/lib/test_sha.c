@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the SHA block functions
+ *
+ * These check that the sha*_process() functions, which may be accelerated,
+ * match the portable versions. The speed of each is logged when debugging.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Amount of data to hash for each measurement */
+#define SHA_BENCH_SIZE		SZ_1M
+
+union sha_bench_ctx {
+	sha1_context sha1;
+	sha256_context sha256;
+	sha512_context sha512;
+};
+
+/**
+ * sha_bench_func - Start a hash and process some data with it
+ *
+ * @ctx:	Context to use
+ * @data:	Data to process
+ * @len:	Length of @data, a multiple of the block size
+ * @generic:	true to use the portable block function
+ */
+typedef void (*sha_bench_func)(union sha_bench_ctx *ctx, const u8 *data,
+			       uint len, bool generic);
+
+/* Check a block function against the portable one and log their speeds */
+static int sha_bench(struct unit_test_state *uts, const char *name,
+		     sha_bench_func run)
+{
+	union sha_bench_ctx ctx, ctx_generic;
+	ulong start, us, generic_us;
+	u8 *buf;
+
+	buf = malloc(SHA_BENCH_SIZE);
+	ut_assertnonnull(buf);
+	ut_fill_pattern(buf, SHA_BENCH_SIZE, 0);
+
+	/* Clear the contexts, so that they can be compared as a whole */
+	memset(&ctx_generic, '\0', sizeof(ctx_generic));
+	memset(&ctx, '\0', sizeof(ctx));
+
+	start = timer_get_us();
+	run(&ctx_generic, buf, SHA_BENCH_SIZE, true);
+	generic_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	run(&ctx, buf, SHA_BENCH_SIZE, false);
+	us = timer_get_us() - start;
+	free(buf);
+
+	ut_asserteq_mem(&ctx_generic, &ctx, sizeof(ctx));
+	log_debug("%s: generic %lu MB/s, sha_process %lu MB/s\n", name,
+		  SHA_BENCH_SIZE / max(generic_us, 1UL),
+		  SHA_BENCH_SIZE / max(us, 1UL));
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(SHA1)
+static void sha1_bench_run(union sha_bench_ctx *ctx, const u8 *data,
+			   uint len, bool generic)
+{
+	sha1_starts(&ctx->sha1);
+	if (generic)
+		sha1_process_generic(&ctx->sha1, data, len / 64);
+	else
+		sha1_process(&ctx->sha1, data, len / 64);
+}
+
+static int lib_test_sha1_bench(struct unit_test_state *uts)
+{
+	return sha_bench(uts, "sha1", sha1_bench_run);
+}
+LIB_TEST(lib_test_sha1_bench, 0);
+#endif
+
+static void sha256_bench_run(union sha_bench_ctx *ctx, const u8 *data,
+			     uint len, bool generic)
+{
+	sha256_starts(&ctx->sha256);
+	if (generic)
+		sha256_process_generic(&ctx->sha256, data, len / 64);
+	else
+		sha256_process(&ctx->sha256, data, len / 64);
+}
+
+static int lib_test_sha256_bench(struct unit_test_state *uts)
+{
+	return sha_bench(uts, "sha256", sha256_bench_run);
+}
+LIB_TEST(lib_test_sha256_bench, 0);
+
+#if CONFIG_IS_ENABLED(SHA512)
+static void sha512_bench_run(union sha_bench_ctx *ctx, const u8 *data,
+			     uint len, bool generic)
+{
+	sha512_starts(&ctx->sha512);
+	if (generic)
+		sha512_process_generic(&ctx->sha512, data,
+				       len / SHA512_BLOCK_SIZE);
+	else
+		sha512_process(&ctx->sha512, data, len / SHA512_BLOCK_SIZE);
+}
+
+static int lib_test_sha512_bench(struct unit_test_state *uts)
+{
+	return sha_bench(uts, "sha512", sha512_bench_run);
+}
+LIB_TEST(lib_test_sha512_bench, 0);
+#endif
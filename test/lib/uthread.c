@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for cooperative threads
+ */
+
+#include <common.h>
+#include <log.h>
+#include <time.h>
+#include <uthread.h>
+#include <linux/delay.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Number of threads for the delay test */
+#define TEST_THREADS	4
+
+/* Number of steps each thread takes, and how long each waits for */
+#define TEST_STEPS	5
+#define TEST_STEP_MS	10
+
+struct test_thread {
+	struct uthread thr;
+	char id;
+	bool wait;
+	int steps;
+};
+
+/* Record of the order in which the threads ran */
+static char test_order[TEST_THREADS * TEST_STEPS + 1];
+static int test_pos;
+
+static void test_thread_fn(void *arg)
+{
+	struct test_thread *tt = arg;
+	int i;
+
+	for (i = 0; i < TEST_STEPS; i++) {
+		test_order[test_pos++] = tt->id;
+		if (tt->wait)
+			mdelay(TEST_STEP_MS);
+		else
+			uthread_schedule();
+		tt->steps++;
+	}
+}
+
+static void test_thread_setup(struct test_thread *tt, int count, bool wait)
+{
+	int i;
+
+	memset(test_order, '\0', sizeof(test_order));
+	test_pos = 0;
+	for (i = 0; i < count; i++) {
+		memset(&tt[i], '\0', sizeof(tt[i]));
+		tt[i].id = 'a' + i;
+		tt[i].wait = wait;
+	}
+}
+
+/* Test that threads take turns when they yield */
+static int lib_test_uthread_schedule(struct unit_test_state *uts)
+{
+	struct test_thread tt[2];
+	int i;
+
+	/* This does nothing without threads */
+	uthread_schedule();
+
+	test_thread_setup(tt, ARRAY_SIZE(tt), false);
+	for (i = 0; i < ARRAY_SIZE(tt); i++)
+		ut_assertok(uthread_create(&tt[i].thr, "test", test_thread_fn,
+					   &tt[i], 0));
+	ut_asserteq_str("", test_order);
+
+	for (i = 0; i < ARRAY_SIZE(tt); i++) {
+		ut_assertok(uthread_join(&tt[i].thr));
+		ut_asserteq(TEST_STEPS, tt[i].steps);
+	}
+	ut_asserteq_str("ababababab", test_order);
+
+	return 0;
+}
+LIB_TEST(lib_test_uthread_schedule, 0);
+
+/*
+ * Test that several threads which wait all finish. How long they take with
+ * their delays overlapped is logged when debugging.
+ */
+static int lib_test_uthread_delay(struct unit_test_state *uts)
+{
+	struct test_thread tt[TEST_THREADS];
+	ulong start, serial, overlapped;
+	int i;
+
+	test_thread_setup(tt, ARRAY_SIZE(tt), true);
+	start = get_timer(0);
+	for (i = 0; i < ARRAY_SIZE(tt); i++)
+		test_thread_fn(&tt[i]);
+	serial = get_timer(start);
+
+	test_thread_setup(tt, ARRAY_SIZE(tt), true);
+	start = get_timer(0);
+	for (i = 0; i < ARRAY_SIZE(tt); i++)
+		ut_assertok(uthread_create(&tt[i].thr, "test", test_thread_fn,
+					   &tt[i], 0));
+	for (i = 0; i < ARRAY_SIZE(tt); i++)
+		ut_assertok(uthread_join(&tt[i].thr));
+	overlapped = get_timer(start);
+
+	for (i = 0; i < ARRAY_SIZE(tt); i++)
+		ut_asserteq(TEST_STEPS, tt[i].steps);
+
+	log_debug("%d threads waiting %d ms: %ld ms one after another, %ld ms at once\n",
+		  TEST_THREADS, TEST_STEPS * TEST_STEP_MS, serial, overlapped);
+
+	return 0;
+}
+LIB_TEST(lib_test_uthread_delay, 0);
@@ -0,0 +1,74 @@
+# SPDX-License-Identifier: GPL-2.0
+
+# Test U-Boot's "nvme read" and "nvme write" commands. A transfer longer than
+# the controller's maximum transfer size is split into several commands, which
+# are queued together on the I/O queue. The test writes a pattern across such
+# a range, reads it back in one go and checks the CRC of the data.
+
+import pytest
+import u_boot_utils
+
+"""
+This test relies on boardenv_* to define which NVMe devices may be written.
+The range is overwritten, so it must not hold anything useful. For example,
+for QEMU with '-drive file=nvme.img,if=none,id=nvm -device nvme,drive=nvm':
+
+env__nvme_rw_configs = (
+    {
+        'fixture_id': 'qemu-nvme',
+        'devid': 0,
+        'sector': 0x800,
+        'count': 0x2000,
+    },
+)
+"""
+
+@pytest.mark.buildconfigspec('cmd_nvme')
+@pytest.mark.buildconfigspec('cmd_memory')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_nvme_rw(u_boot_console, env__nvme_rw_config):
+    """Test a large NVMe write and read-back.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        env__nvme_rw_config: The NVMe range to test.
+
+    Returns:
+        Nothing.
+    """
+
+    devid = env__nvme_rw_config['devid']
+    sector = env__nvme_rw_config['sector']
+    count = env__nvme_rw_config['count']
+    count_bytes = count * 512
+    ram_base = u_boot_utils.find_ram_base(u_boot_console)
+    addr = ram_base
+    addr_rd = ram_base + count_bytes
+
+    u_boot_console.run_command('nvme scan')
+    response = u_boot_console.run_command('nvme device %d' % devid)
+    assert 'is now current device' in response
+
+    # Write a pattern which differs in each block
+    u_boot_console.run_command('mw.l 0x%x 0x5a5a5a5a 0x%x' %
+                               (addr, count_bytes // 4))
+    for blk in range(0, count, 0x100):
+        u_boot_console.run_command('mw.l 0x%x 0x%x 1' %
+                                   (addr + blk * 512, blk))
+    response = u_boot_console.run_command('crc32 0x%x 0x%x' %
+                                          (addr, count_bytes))
+    expected_crc32 = response.split()[-1]
+
+    response = u_boot_console.run_command('nvme write 0x%x 0x%x 0x%x' %
+                                          (addr, sector, count))
+    assert '%d blocks written: OK' % count in response
+
+    # Read back into a cleared buffer
+    u_boot_console.run_command('mw.b 0x%x 0 0x%x' % (addr_rd, count_bytes))
+    response = u_boot_console.run_command('nvme read 0x%x 0x%x 0x%x' %
+                                          (addr_rd, sector, count))
+    assert '%d blocks read: OK' % count in response
+
+    response = u_boot_console.run_command('crc32 0x%x 0x%x' %
+                                          (addr_rd, count_bytes))
+    assert expected_crc32 in response
@@ -51,6 +51,15 @@ long ut_check_delta(ulong last)
 	return ut_check_free() - last;
 }
 
+void ut_fill_pattern(void *buf, ulong size, uint seed)
+{
+	u8 *ptr = buf;
+	ulong i;
+
+	for (i = 0; i < size; i++)
+		ptr[i] = i * 7 + (i >> 9) + seed;
+}
+
 static int readline_check(struct unit_test_state *uts)
 {
 	int ret;